@@ -29,6 +29,7 @@
 
 #include "platform.h"
 #include <string>
+#include <type_traits>
 
 /** \addtogroup Lib
   * @{
@@ -36,6 +37,30 @@
 
 namespace eve {
 
+template <typename> struct tvec2;
+template <typename> struct tvec3;
+template <typename> struct tvec4;
+
+/** Reverses the byte order of @p count consecutive values of @p width (2, 4 or 8) bytes at
+    @p data. Uses AVX2 or SSSE3 byte shuffles when the CPU supports them. */
+void byteswap(void* data, eve::size count, eve::size width);
+
+namespace detail {
+
+/** The arithmetic type making up the elements of write_array() and read_array(). */
+template <class T>
+struct array_scalar
+{
+  static_assert(std::is_arithmetic<T>::value, "write_array/read_array need arithmetic or vector elements.");
+  typedef T type;
+};
+
+template <class T> struct array_scalar<tvec2<T>> { typedef typename array_scalar<T>::type type; };
+template <class T> struct array_scalar<tvec3<T>> { typedef typename array_scalar<T>::type type; };
+template <class T> struct array_scalar<tvec4<T>> { typedef typename array_scalar<T>::type type; };
+
+} // detail
+
 class binarywriter
 {
 public:
@@ -48,6 +73,12 @@ public:
   /** Flushes the buffer. */
   void flush();
 
+  /** Starts a CRC32C checksum of the bytes written from now on. */
+  void begin_checksum();
+
+  /** Writes the checksum of the bytes written since begin_checksum() and stops checksumming. */
+  void end_checksum();
+
   binarywriter& operator<<(bool rhs) { write1(&rhs); return *this; }
   binarywriter& operator<<(eve::int8 rhs) { write1(&rhs); return *this; }
   binarywriter& operator<<(eve::uint8 rhs) { write1(&rhs); return *this; }
@@ -62,13 +93,25 @@ public:
   binarywriter& operator<<(const char* rhs);
   binarywriter& operator<<(const std::string& rhs);
 
+  /** Writes @p size raw bytes from @p data as they are (no endianness conversion). */
+  void write(const void* data, eve::size size);
+
+  /** Writes @p count arithmetic or vector values at once, in the same format as writing them
+      one by one. */
+  template <class T>
+  void write_array(const T* data, eve::size count);
+
 private:
+  void write_swapped(const void* data, eve::size count, eve::size width);
+  void put(const char* data, eve::size size);
   void write1(const void* data);
   void write2(const void* data);
   void write4(const void* data);
   void write8(const void* data);
 
   std::streambuf* m_buffer;
+  bool m_checksumming;
+  uint32 m_checksum;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -76,6 +119,8 @@ private:
 class binaryreader
 {
 public:
+  /** Reads from @p buffer. Every read and skip past its end throws a serialization_error, whose
+      column is the position in the stream. */
   binaryreader(std::streambuf* buffer);
 
    /** Sets the buffer to read from. */
@@ -93,14 +138,38 @@ public:
   binaryreader& operator>>(float& rhs) { read4(&rhs); return *this; }
   binaryreader& operator>>(double& rhs) { read8(&rhs); return *this; }
   binaryreader& operator>>(std::string& rhs);
+
+  /** Reads @p size raw bytes into @p data as they are (no endianness conversion). */
+  void read(void* data, eve::size size);
+
+  /** Discards the next @p size bytes of the buffer. */
+  void skip(eve::size size);
+
+  /** @returns the number of bytes read or skipped so far. */
+  eve::uint64 position() const { return m_position; }
+
+  /** Reads @p count values written by binarywriter::write_array() or one by one. */
+  template <class T>
+  void read_array(T* data, eve::size count);
+
+  /** Starts a CRC32C checksum of the bytes read from now on. */
+  void begin_checksum();
+
+  /** Reads the checksum written by binarywriter::end_checksum() and stops checksumming.
+      @returns false if it does not match the bytes read since begin_checksum(). */
+  bool end_checksum();
   
 private:
+  void get(char* data, eve::size size);
   void read1(void* data);
   void read2(void* data);
   void read4(void* data);
   void read8(void* data);
 
   std::streambuf* m_buffer;
+  bool m_checksumming;
+  uint32 m_checksum;
+  eve::uint64 m_position;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -118,6 +187,29 @@ public:
   }
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class T>
+void binarywriter::write_array(const T* data, eve::size count)
+{
+#ifdef EVE_BIG_ENDIAN
+  typedef typename detail::array_scalar<T>::type scalar;
+  write_swapped(data, count * eve::size(sizeof(T) / sizeof(scalar)), sizeof(scalar));
+#else
+  write(data, count * eve::size(sizeof(T)));
+#endif
+}
+
+template <class T>
+void binaryreader::read_array(T* data, eve::size count)
+{
+  read(data, count * eve::size(sizeof(T)));
+#ifdef EVE_BIG_ENDIAN
+  typedef typename detail::array_scalar<T>::type scalar;
+  byteswap(data, count * eve::size(sizeof(T) / sizeof(scalar)), sizeof(scalar));
+#endif
+}
+
 } // eve
 
 /** @} */
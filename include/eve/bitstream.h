@@ -0,0 +1,253 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "platform.h"
+#include <string>
+#include <streambuf>
+#include <type_traits>
+
+/** \addtogroup Lib
+  * @{
+  */
+
+namespace eve {
+
+/** Maps signed integers to unsigned ones so that small magnitudes stay small (0, -1, 1, -2...
+    become 0, 1, 2, 3...), which keeps negative numbers short once varint encoded. */
+inline uint64 zigzag_encode(int64 value)
+{
+  return (uint64(value) << 1) ^ uint64(value >> 63);
+}
+
+/** Inverse of zigzag_encode(). */
+inline int64 zigzag_decode(uint64 value)
+{
+  return int64(value >> 1) ^ -int64(value & 1);
+}
+
+/** A value written or read with an explicit number of bits. Create it with eve::bits(). */
+template <class T>
+struct bitfield
+{
+  T& value;
+  uint32 count;
+};
+
+template <class T>
+bitfield<T> bits(T& value, uint32 count)
+{
+  bitfield<T> field = { value, count };
+  return field;
+}
+
+template <class T>
+bitfield<const T> bits(const T& value, uint32 count)
+{
+  bitfield<const T> field = { value, count };
+  return field;
+}
+
+/** A real value written or read as an integer number of @p precision steps between @p min and
+    @p max. Create it with eve::quantized(). */
+template <class T>
+struct quantized_field
+{
+  T& value;
+  float min;
+  float max;
+  float precision;
+};
+
+template <class T>
+quantized_field<T> quantized(T& value, float min, float max, float precision)
+{
+  quantized_field<T> field = { value, min, max, precision };
+  return field;
+}
+
+template <class T>
+quantized_field<const T> quantized(const T& value, float min, float max, float precision)
+{
+  quantized_field<const T> field = { value, min, max, precision };
+  return field;
+}
+
+/** @returns the number of bits of a value quantized between @p min and @p max with steps of
+    @p precision. */
+uint32 quantized_bits(float min, float max, float precision);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Writes values packed at the bit level instead of byte aligned like eve::binarywriter.
+  *
+  * operator<< writes booleans as a single bit, bytes as 8 bits, wider integers as LEB128 varints
+  * (zigzag encoded if signed), reals in full and strings as a varint length followed by the
+  * characters. Use eve::bits() and eve::quantized() to choose the width of a value.
+  *
+  * Bits are buffered until a byte is complete. flush() pads the last byte with zeros and must
+  * be called before the buffer is read, the destructor does so. */
+class bitwriter
+{
+public:
+  bitwriter(std::streambuf* buffer);
+  ~bitwriter();
+
+  /** Sets the buffer to write to, flushing the current one. */
+  void buffer(std::streambuf* buffer);
+
+  /** Pads the pending bits to a byte boundary and flushes the buffer. */
+  void flush();
+
+  /** Pads the pending bits with zeros up to the next byte boundary. */
+  void align();
+
+  /** @returns the number of bits written so far, padding included. */
+  uint64 position() const { return m_position; }
+
+  /** Writes the @p count (up to 64) low bits of @p value. */
+  void write_bits(uint64 value, uint32 count);
+
+  /** Writes @p value as a LEB128 varint, 7 bits per byte. */
+  void write_varint(uint64 value);
+
+  /** Writes @p value zigzag and varint encoded. */
+  void write_zigzag(int64 value) { write_varint(zigzag_encode(value)); }
+
+  /** Writes @p value clamped to [@p min, @p max] in quantized_bits() bits, rounded to the nearest
+      multiple of @p precision. */
+  void write_quantized(float value, float min, float max, float precision);
+
+  bitwriter& operator<<(bool rhs) { write_bits(rhs ? 1 : 0, 1); return *this; }
+  bitwriter& operator<<(eve::int8 rhs) { write_bits(eve::uint8(rhs), 8); return *this; }
+  bitwriter& operator<<(eve::uint8 rhs) { write_bits(rhs, 8); return *this; }
+  bitwriter& operator<<(eve::int16 rhs) { write_zigzag(rhs); return *this; }
+  bitwriter& operator<<(eve::uint16 rhs) { write_varint(rhs); return *this; }
+  bitwriter& operator<<(eve::int32 rhs) { write_zigzag(rhs); return *this; }
+  bitwriter& operator<<(eve::uint32 rhs) { write_varint(rhs); return *this; }
+  bitwriter& operator<<(eve::int64 rhs) { write_zigzag(rhs); return *this; }
+  bitwriter& operator<<(eve::uint64 rhs) { write_varint(rhs); return *this; }
+  bitwriter& operator<<(float rhs);
+  bitwriter& operator<<(double rhs);
+  bitwriter& operator<<(const char* rhs);
+  bitwriter& operator<<(const std::string& rhs);
+
+  template <class T>
+  bitwriter& operator<<(const bitfield<T>& rhs)
+  {
+    write_bits(uint64(rhs.value), rhs.count);
+    return *this;
+  }
+
+  template <class T>
+  bitwriter& operator<<(const quantized_field<T>& rhs)
+  {
+    write_quantized(float(rhs.value), rhs.min, rhs.max, rhs.precision);
+    return *this;
+  }
+
+private:
+  std::streambuf* m_buffer;
+  uint64 m_bits;
+  uint32 m_count;
+  uint64 m_position;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Reads what eve::bitwriter wrote. Values must be read with the same types and widths as they
+  * were written.
+  *
+  * @throws std::runtime_error on reading past the end of the buffer or on a malformed varint. */
+class bitreader
+{
+public:
+  bitreader(std::streambuf* buffer);
+
+  /** Sets the buffer to read from, dropping the pending bits. */
+  void buffer(std::streambuf* buffer);
+
+  /** Drops the pending bits up to the next byte boundary. */
+  void align();
+
+  /** @returns the number of bits read so far, padding included. */
+  uint64 position() const { return m_position; }
+
+  /** Reads @p count (up to 64) bits. */
+  uint64 read_bits(uint32 count);
+
+  /** Reads a LEB128 varint. */
+  uint64 read_varint();
+
+  /** Reads a zigzag and varint encoded value. */
+  int64 read_zigzag() { return zigzag_decode(read_varint()); }
+
+  /** Reads a value written by bitwriter::write_quantized() with the same parameters. */
+  float read_quantized(float min, float max, float precision);
+
+  bitreader& operator>>(bool& rhs) { rhs = read_bits(1) != 0; return *this; }
+  bitreader& operator>>(char& rhs) { rhs = char(read_bits(8)); return *this; }
+  bitreader& operator>>(unsigned char& rhs) { rhs = (unsigned char)(read_bits(8)); return *this; }
+  bitreader& operator>>(int16& rhs) { rhs = int16(read_zigzag()); return *this; }
+  bitreader& operator>>(uint16& rhs) { rhs = uint16(read_varint()); return *this; }
+  bitreader& operator>>(int32& rhs) { rhs = int32(read_zigzag()); return *this; }
+  bitreader& operator>>(uint32& rhs) { rhs = uint32(read_varint()); return *this; }
+  bitreader& operator>>(long long& rhs) { rhs = read_zigzag(); return *this; }
+  bitreader& operator>>(unsigned long long& rhs) { rhs = read_varint(); return *this; }
+  bitreader& operator>>(float& rhs);
+  bitreader& operator>>(double& rhs);
+  bitreader& operator>>(std::string& rhs);
+
+  template <class T>
+  bitreader& operator>>(const bitfield<T>& rhs)
+  {
+    uint64 value = read_bits(rhs.count);
+    // sign extend signed fields narrower than 64 bits
+    if (std::is_signed<T>::value && rhs.count > 0 && rhs.count < 64 && (value >> (rhs.count - 1)) & 1)
+      value |= ~uint64(0) << rhs.count;
+    rhs.value = T(value);
+    return *this;
+  }
+
+  template <class T>
+  bitreader& operator>>(const quantized_field<T>& rhs)
+  {
+    rhs.value = T(read_quantized(rhs.min, rhs.max, rhs.precision));
+    return *this;
+  }
+
+private:
+  std::streambuf* m_buffer;
+  uint64 m_bits;
+  uint32 m_count;
+  uint64 m_position;
+};
+
+} // eve
+
+/** @} */
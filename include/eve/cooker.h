@@ -0,0 +1,145 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "resource.h"
+#include "uncopyable.h"
+#include "serialization/vector.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+/** \addtogroup Lib
+  * @{
+  */
+
+namespace eve {
+
+/** Converts resource sources into the form their loaders read fastest (binary descriptors, raw
+    pixels...) ahead of time.
+
+    Each artifact is stored in the cache directory under the hash of its source content, and a
+    manifest maps source paths to artifacts. Once eve::resource::use_cache() is given the same
+    directory, resources load from the artifacts instead of their sources.
+
+    Usage:
+    @code
+    eve::cooker cooker("cache");
+    cooker.add<eve::shader>(".fx.evedat");
+    cooker.add<eve::texture>(".evedat");
+    cooker.add<eve::pixelbuffer>(".png");
+    cooker.cook("data");
+    @endcode
+  */
+class cooker : uncopyable
+{
+public:
+  struct entry
+  {
+    entry() : size(0), modified(0) {}
+
+    std::string source;
+    std::string hash;
+    std::string artifact;
+    /** Size and modification time of the source when it was cooked (see stat_file()). */
+    eve::uint64 size;
+    eve::int64 modified;
+
+    eve_serializable(entry, source, hash, artifact, size, modified);
+  };
+
+  struct manifest
+  {
+    std::vector<entry> entries;
+
+    eve_serializable(manifest, entries);
+  };
+
+  /** Name of the manifest file inside the cache directory. */
+  static const char* const k_manifest;
+
+  /** @returns the manifest of the cache @p directory.
+      @throws eve::file_not_found_error if @p directory holds no manifest. */
+  static manifest read_manifest(const std::string& directory);
+
+  /** @returns the content hash of the file at @p path, as stored in the manifest. */
+  static std::string hash_file(const std::string& path);
+
+  /** Reads the size and last modification time of the file at @p path. The time is only
+      meant to be compared with another one read by this function.
+      @returns false if there is no such file. */
+  static bool stat_file(const std::string& path, eve::uint64& size, eve::int64& modified);
+
+  /** Creates a cooker writing to @p directory, keeping the artifacts it already contains. */
+  explicit cooker(const std::string& directory);
+
+  /** Cooks files whose name ends with @p suffix as @p T resources. When several suffixes
+      match, the longest one wins. */
+  template <class T>
+  void add(const std::string& suffix);
+
+  /** Cooks every file under @p root that matches a suffix and updates the manifest.
+      Files whose content did not change since the last cook are not cooked again. */
+  void cook(const std::string& root);
+
+  eve::size cooked() const { return m_cooked; }
+  eve::size skipped() const { return m_skipped; }
+  eve::size failed() const { return m_failed; }
+  /** @returns the number of matching files whose resource has no cooked form. */
+  eve::size uncooked() const { return m_uncooked; }
+
+private:
+  struct rule
+  {
+    std::string suffix;
+    std::function<resource*()> create;
+  };
+
+  const rule* find_rule(const std::string& path) const;
+  void cook_file(const std::string& path, const rule& rule);
+  void save_manifest() const;
+
+  std::string m_directory;
+  std::vector<rule> m_rules;
+  manifest m_manifest;
+  eve::size m_cooked;
+  eve::size m_skipped;
+  eve::size m_failed;
+  eve::size m_uncooked;
+};
+
+template <class T>
+void cooker::add(const std::string& suffix)
+{
+  rule r = { suffix, [] () -> resource* { return eve_new T; } };
+  m_rules.push_back(r);
+}
+
+} // eve
+
+/** @} */
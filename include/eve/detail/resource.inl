@@ -81,33 +81,46 @@ resource::ptr<T, Param>::~ptr()
 template <class T, class Param>
 void resource::ptr<T, Param>::load(const std::string& path)
 {
-  auto res = static_cast<T*>(resource::find(path));
-  if (!res)
-  {
-    eve::unique_ptr<resource>::type newres;
-    newres.reset(m_helper.create_resource());
-    newres->m_path = path;
-    res = static_cast<T*>(resource::process_new(std::move(newres)));
-  }
-  reset(res);
-  ++m_resource->m_references;
+  reset(static_cast<T*>(resource::acquire(path, [this] { return m_helper.create_resource(); }, false, m_host)));
+}
+
+template <class T, class Param>
+void resource::ptr<T, Param>::load_async(const std::string& path, std::function<void(const T&)> callback)
+{
+  reset(static_cast<T*>(resource::acquire(path, [this] { return m_helper.create_resource(); }, true, m_host)));
+  if (callback)
+    on_ready(std::move(callback));
+}
+
+template <class T, class Param>
+void resource::ptr<T, Param>::on_ready(std::function<void(const T&)> callback) const
+{
+  if (!m_resource)
+    return;
+  const T* res = m_resource;
+  resource::when_ready(m_resource, [res, callback] { callback(*res); });
 }
 
 template <class T, class Param>
 resource::ptr<T, Param>& resource::ptr<T, Param>::operator=(const ptr& rhs)
 {
-  m_host = rhs.m_host;
+  // retained first, rhs may be this
+  if (rhs.m_resource)
+    resource::retain(rhs.m_resource, rhs.m_host);
   reset(rhs.m_resource);
-  if (m_resource)
-    ++m_resource->m_references;
+  m_host = rhs.m_host;
+  m_source = rhs.m_source;
   return *this;
 }
 
 template <class T, class Param>
 resource::ptr<T, Param>& resource::ptr<T, Param>::operator=(ptr&& rhs)
 {
-  m_host = rhs.m_host;
+  if (this == &rhs)
+    return *this;
   reset(rhs.m_resource);
+  m_host = rhs.m_host;
+  m_source = std::move(rhs.m_source);
   rhs.m_resource = nullptr;
   return *this;
 }
@@ -116,23 +129,10 @@ template <class T, class Param>
 void resource::ptr<T, Param>::reset(T* res)
 {
   if (m_resource)
-  {
-    if (m_host)
-      m_resource->remove_dependant(m_host);
-
-    if (--m_resource->m_references == 0)
-    {
-      resource::dispose(m_resource);
-    }
-  }
-
-  m_resource = res;  
-
-  if (m_resource && m_host)
-    m_resource->add_dependant(m_host);
+    resource::release(m_resource, m_host);
+  m_resource = res;
 }
 
-
 template <class T, class Param>
 T* resource::helper<T, Param>::create_resource()
 {
@@ -162,11 +162,53 @@ public:
   static void deserialize(serialization::parser& parser, resource::ptr<T, Param>& instance)
   {
     parser.check(parser.STRING);
+    instance.m_source = parser.token();
+    parser.scan();
+    if (!resource::cooking())
+      instance.load(resolve(instance));
+  }
+
+  static std::string resolve(const resource::ptr<T, Param>& instance)
+  {
     std::string path = instance.host()->path();
     eve::path::pop(path);
-    eve::path::push(path, parser.token());
-    parser.scan();
-    instance.load(path);
+    eve::path::push(path, instance.source());
+    return path;
+  }
+};
+
+template <class T, class Param>
+class json_serializer<resource::ptr<T, Param>>
+{
+public:
+  static void serialize(const resource::ptr<T, Param>&, std::ostream&, const std::string&)
+  {
+    throw std::logic_error("Cannot serialize a resource::ptr. Implement this maybe?");
+  }
+
+  static void deserialize(serialization::json_reader& reader, resource::ptr<T, Param>& instance)
+  {
+    auto relative = reader.string();
+    instance.m_source.assign(relative.begin(), relative.end());
+    if (!resource::cooking())
+      instance.load(text_serializer<resource::ptr<T, Param>>::resolve(instance));
+  }
+};
+
+template <class T, class Param>
+class binary_serializer<resource::ptr<T, Param>>
+{
+public:
+  static void serialize(const resource::ptr<T, Param>& instance, binarywriter& writer)
+  {
+    writer << instance.source();
+  }
+
+  static void deserialize(binaryreader& reader, resource::ptr<T, Param>& instance)
+  {
+    reader >> instance.m_source;
+    if (!resource::cooking())
+      instance.load(text_serializer<resource::ptr<T, Param>>::resolve(instance));
   }
 };
 
@@ -174,8 +216,20 @@ public:
 
 template<class T>
 void deserializable_resource<T>::load(std::istream& source)
+{
+  if (resource::read_cooked_header(source))
+    eve::deserialize_as_binary<T>(source, static_cast<T&>(*this));
+  else
+    eve::deserialize_as_text<T>(source, static_cast<T&>(*this));
+}
+
+template<class T>
+bool deserializable_resource<T>::cook(std::istream& source, std::ostream& output)
 {
   eve::deserialize_as_text<T>(source, static_cast<T&>(*this));
+  resource::write_cooked_header(output);
+  eve::serialize_as_binary<T>(static_cast<T&>(*this), output);
+  return true;
 }
 
 template<class T>
@@ -183,6 +237,7 @@ void deserializable_resource<T>::on_reload()
 {
   resource::source source(path());
   load(*source);
+  finalize();
 }
 
 } // eve
@@ -0,0 +1,149 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+namespace eve {
+namespace detail {
+
+/** Swaps the byte order of @p value, for big endian targets. */
+template <class T>
+inline T swap_bytes(T value)
+{
+  char* bytes = reinterpret_cast<char*>(&value);
+  std::reverse(bytes, bytes + sizeof(T));
+  return value;
+}
+
+} // detail
+
+template <class Sink>
+span_writer<Sink>::span_writer(Sink& sink)
+  : m_sink(&sink)
+  , m_data(nullptr)
+  , m_cursor(eve::size(sink.size()))
+  , m_capacity(eve::size(sink.size()))
+{
+  if (m_capacity > 0)
+    m_data = reinterpret_cast<char*>(&(*m_sink)[0]);
+}
+
+template <class Sink>
+span_writer<Sink>::~span_writer()
+{
+  flush();
+}
+
+template <class Sink>
+void span_writer<Sink>::flush()
+{
+  m_sink->resize(m_cursor);
+  m_capacity = m_cursor;
+}
+
+template <class Sink>
+void span_writer<Sink>::reserve(eve::size size)
+{
+  if (m_capacity - m_cursor < size)
+    grow(size);
+}
+
+template <class Sink>
+void span_writer<Sink>::grow(eve::size size)
+{
+  m_capacity = std::max(m_cursor + size, m_capacity * 2);
+  m_sink->resize(m_capacity);
+  m_data = reinterpret_cast<char*>(&(*m_sink)[0]);
+}
+
+template <class Sink>
+template <class T>
+void span_writer<Sink>::put(T value)
+{
+  eve_assert(m_capacity - m_cursor >= sizeof(T));
+#ifdef EVE_BIG_ENDIAN
+  value = detail::swap_bytes(value);
+#endif
+  std::memcpy(m_data + m_cursor, &value, sizeof(T));
+  m_cursor += sizeof(T);
+}
+
+template <class Sink>
+span_writer<Sink>& span_writer<Sink>::operator<<(const char* rhs)
+{
+  uint16 size = (uint16)strlen(rhs);
+  reserve(sizeof(size) + size);
+  *this << size;
+  write(rhs, size);
+  return *this;
+}
+
+template <class Sink>
+span_writer<Sink>& span_writer<Sink>::operator<<(const std::string& rhs)
+{
+  uint16 size = (uint16)rhs.size();
+  reserve(sizeof(size) + size);
+  *this << size;
+  write(rhs.c_str(), size);
+  return *this;
+}
+
+template <class Sink>
+void span_writer<Sink>::write(const void* data, eve::size size)
+{
+  if (m_capacity - m_cursor < size)
+    grow(size);
+  if (size > 0)
+    std::memcpy(m_data + m_cursor, data, size);
+  m_cursor += size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class Source>
+span_reader::span_reader(const Source& source)
+  : m_begin(source.size() ? reinterpret_cast<const char*>(&source[0]) : nullptr)
+  , m_cursor(m_begin)
+  , m_end(m_begin + source.size())
+{
+}
+
+template <class T>
+void span_reader::get(T& value)
+{
+  check(sizeof(T));
+  std::memcpy(&value, m_cursor, sizeof(T));
+#ifdef EVE_BIG_ENDIAN
+  value = detail::swap_bytes(value);
+#endif
+  m_cursor += sizeof(T);
+}
+
+} // eve
@@ -49,6 +49,10 @@ public:
   eve::window& window() { return m_window; }
   const eve::window& window() const { return m_window; }
 
+  /** Sets the time spent each frame finalizing resources loaded asynchronously, in seconds.
+      See eve::resource::finalize_pending(). */
+  void load_budget(double seconds) { m_load_budget = seconds; }
+
   template <typename State, typename... Args>
   void create_state(const Args&... args)
   {
@@ -91,6 +95,7 @@ private:
   eve::window m_window;
   std::unordered_map<eve::id, state*> m_states;
   state* m_top;
+  double m_load_budget;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
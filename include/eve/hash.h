@@ -0,0 +1,86 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "platform.h"
+#include <string>
+
+/** \addtogroup Lib
+  * @{
+  */
+
+namespace eve {
+namespace hash {
+
+/** @returns the CRC32C (Castagnoli) checksum of @p size bytes at @p data. Pass a previous result
+    as @p crc to checksum data given in pieces. Uses the SSE4.2 crc32 instruction when the CPU
+    supports it, slice-by-8 tables otherwise. */
+uint32 crc32c(const void* data, eve::size size, uint32 crc = 0);
+
+/** @returns the 64 bits XXH64 hash of @p size bytes at @p data. Meant for hash tables and
+    content hashes, not for security. */
+uint64 xxh64(const void* data, eve::size size, uint64 seed = 0);
+
+inline uint64 xxh64(const std::string& str, uint64 seed = 0) { return xxh64(str.data(), eve::size(str.size()), seed); }
+
+/** Computes crc32c() of data given in pieces. */
+class crc32c_state
+{
+public:
+  crc32c_state() : m_crc(0) { }
+
+  void reset() { m_crc = 0; }
+  void update(const void* data, eve::size size) { m_crc = crc32c(data, size, m_crc); }
+  uint32 digest() const { return m_crc; }
+
+private:
+  uint32 m_crc;
+};
+
+/** Computes xxh64() of data given in pieces. */
+class xxh64_state
+{
+public:
+  xxh64_state(uint64 seed = 0);
+
+  void reset(uint64 seed = 0);
+  void update(const void* data, eve::size size);
+  uint64 digest() const;
+
+private:
+  uint64 m_lanes[4];
+  uint64 m_seed;
+  uint64 m_length;
+  unsigned char m_pending[32];
+  eve::size m_npending;
+};
+
+} // hash
+} // eve
+
+/** @} */
@@ -29,16 +29,15 @@
 
 #include "eve/platform.h"
 #include "eve/uncopyable.h"
+#include "eve/net/socket.h"
 #include <streambuf>
+#include <vector>
 
 /** \addtogroup Net
   * @{
   */
 
 namespace eve { 
-
-class socket;
-
 namespace net {
 
 class buffer : private uncopyable, public std::streambuf
@@ -46,30 +45,73 @@ class buffer : private uncopyable, public std::streambuf
 public:
   typedef std::char_traits<char> traits;
 
-  /** Constructs this buffer and links it to @p socket.
-      It allocates an internal buffer with enough size so that
-      both send and receive buffers size are at least as big as
-      @p capacity. Therefore allocated buffer is double @p capacity. */
-  buffer(eve::socket* socket, eve::size capacity = 512);
+  /** Constructs this buffer and links it to @p stream, e.g. an eve::socket.
+      Both the send and the receive buffers are initially @p capacity bytes large.
+      Every receive reads as much as there is room for, and when the receive buffer fills up
+      it doubles, up to @p max_capacity, so that a busy connection needs few system calls. */
+  buffer(stream* stream, eve::size capacity = 512, eve::size max_capacity = 64 * 1024);
   buffer(buffer&& rhs);
   ~buffer();
 
-  /** Tries to receive some bytes into the input buffer.
+  /** Tries to receive the bytes waiting on the stream into the input buffer, without blocking.
       @returns true when input buffer is non empty, false otherwise. */
   bool try_fill();
 
+  /** @returns the number of received bytes not read yet. */
+  eve::size available() const { return eve::size(egptr() - gptr()); }
+
+  /** @returns the received bytes not read yet, contiguous in memory. available() tells how many.
+      @note The pointer is valid until the next read, fill or ensure(). */
+  const char* peek() const { return gptr(); }
+
+  /** Grows the input buffer so that it can hold at least @p size bytes. */
+  void reserve(eve::size size);
+
+  /** Blocks until at least @p size bytes are available, growing the input buffer if needed,
+      so that they can be parsed in place from peek().
+      @returns false if the connection was closed before. */
+  bool ensure(eve::size size);
+
+  /** Marks the first @p size bytes returned by peek() as read. */
+  void consume(eve::size size);
+
+  /** @returns the current size of the input buffer. */
+  eve::size input_capacity() const { return m_input_capacity; }
+
+  /** Queues @p size bytes at @p data to be sent right after what was written so far, without
+      copying them. The next synchronization sends everything queued with a single gathering call.
+      @note @p data must stay valid until then. */
+  void write_ref(const char* data, eve::size size);
+
+  /** Corks the stream, so that everything written until uncork() leaves in as few packets as
+      possible, e.g. all the messages of a frame. */
+  void cork();
+
+  /** Synchronizes the buffer and uncorks the stream, sending everything held back. */
+  void uncork();
+
   buffer& operator=(buffer&& rhs);
 
 protected:
   int sync() override;
   int_type underflow() override;
   int_type overflow(int_type meta = traits::eof()) override;
+  std::streamsize xsputn(const char_type* data, std::streamsize count) override;
+  std::streamsize xsgetn(char_type* data, std::streamsize count) override;
 
 private:
   void validate() const;
+  void freeze();
+  bool fill(bool block);
+  void reallocate_input(eve::size capacity);
 
-  socket* m_socket;
-  char* m_buffer;
+  stream* m_stream;
+  char* m_output;
+  char* m_input;
+  eve::size m_capacity;
+  eve::size m_input_capacity;
+  eve::size m_max_capacity;
+  std::vector<stream::chunk> m_chain;
 };
 
 } // net
@@ -0,0 +1,212 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/platform.h"
+#include "eve/uncopyable.h"
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** Carries several logical message streams over an unreliable datagram connection.
+    
+    Every datagram has a sequence number and acknowledges the latest 32 datagrams received from
+    the peer. Reliable messages stay queued until every datagram fragment carrying them has been
+    acknowledged, and unacknowledged fragments are resent once the retransmission timeout, derived
+    from the measured round trip time, expires. Messages larger than a datagram are split in
+    fragments and reassembled by the receiver.
+
+    The channel does no I/O: it passes outgoing datagrams to a transmit function and is fed the
+    incoming ones with receive(), so it works over any datagram transport. */
+class channel : private uncopyable
+{
+public:
+  enum class delivery : uint8
+  {
+    /** Messages are sent once and delivered as they arrive, if they arrive. */
+    unreliable,
+
+    /** Messages are resent until acknowledged and delivered as soon as they are complete. */
+    reliable_unordered,
+
+    /** Messages are resent until acknowledged and delivered in the order they were sent. */
+    reliable_ordered
+  };
+
+  struct config
+  {
+    /** Largest datagram sent, headers included. It must be the same at both ends. */
+    eve::size mtu;
+
+    /** Largest message accepted, both by send() and from the peer. */
+    eve::size max_message_size;
+
+    /** Lower and upper bounds of the retransmission timeout, in seconds. */
+    double min_rto;
+    double max_rto;
+
+    /** For default values initialization. */
+    config();
+  };
+
+  struct message
+  {
+    eve::uint8 stream;
+    std::vector<char> data;
+  };
+
+  /** Called with every datagram to be sent to the peer. */
+  typedef std::function<void(const char* data, eve::size size)> transmit;
+
+  channel(transmit transmit, const config& configuration = config());
+  ~channel();
+
+  /** Adds a logical stream with the @p delivery guarantees.
+      @returns the index of the stream, to be used with send(). Both ends must add the same streams
+               in the same order. */
+  eve::uint8 add_stream(delivery delivery);
+
+  /** Queues @p data to be sent on @p stream by the next update(). */
+  void send(eve::uint8 stream, const char* data, eve::size size);
+
+  /** Processes a datagram received from the peer at time @p now, in seconds.
+      @returns false if the datagram was malformed and ignored. */
+  bool receive(const char* data, eve::size size, double now);
+
+  /** Pops the next message ready to be delivered into @p message.
+      @returns false if there is none. */
+  bool pop(message& message);
+
+  /** Transmits queued messages, the retransmissions due by @p now and pending acknowledgements.
+      @param now current time in seconds, from any monotonic clock. */
+  void update(double now);
+
+  /** @returns the smoothed round trip time in seconds, 0 until measured. */
+  double rtt() const { return m_srtt; }
+
+  /** @returns the current retransmission timeout in seconds. It doubles whenever an update()
+      retransmits, up to max_rto, until the next round trip is measured. */
+  double rto() const { return m_rto; }
+
+  /** @returns the number of datagrams sent. */
+  eve::uint64 sent() const { return m_sent; }
+
+  /** @returns the number of fragments sent again after a timeout. */
+  eve::uint64 resent() const { return m_resent; }
+
+  /** @returns the number of messages queued and not yet acknowledged, or sent if unreliable. */
+  eve::size pending() const;
+
+private:
+  struct outgoing
+  {
+    eve::uint16 id;
+    std::vector<char> data;
+    std::vector<double> sent;
+    std::vector<bool> acked;
+    eve::size unacked;
+  };
+
+  struct incoming
+  {
+    std::vector<char> data;
+    std::vector<bool> received;
+    eve::size missing;
+    eve::size size;
+  };
+
+  struct stream
+  {
+    delivery mode;
+    eve::uint16 next_send;
+    eve::uint16 next_receive;
+    eve::uint16 newest_receive;
+    std::deque<outgoing> queue;
+    std::unordered_map<eve::uint16, incoming> partial;
+    std::unordered_map<eve::uint16, std::vector<char>> complete;
+    std::unordered_set<eve::uint16> delivered;
+  };
+
+  struct fragment_ref
+  {
+    eve::uint8 stream;
+    eve::uint16 id;
+    eve::uint16 fragment;
+  };
+
+  struct sent_packet
+  {
+    eve::uint16 sequence;
+    bool valid;
+    bool acked;
+    double time;
+    std::vector<fragment_ref> fragments;
+  };
+
+  eve::size fragment_size() const;
+  void acknowledge(eve::uint16 sequence, double now);
+  void process(eve::uint8 index, eve::uint16 id, eve::uint16 fragment, eve::uint16 count, const char* data, eve::uint16 size);
+  void deliver(eve::uint8 stream, std::vector<char>&& data);
+  void begin_packet();
+  void append(eve::uint8 stream, const outgoing& message, eve::uint16 fragment);
+  void flush_packet(double now);
+
+  transmit m_transmit;
+  config m_config;
+  std::vector<stream> m_streams;
+  std::deque<message> m_inbox;
+
+  std::vector<sent_packet> m_sent_packets;
+  std::vector<char> m_packet;
+  std::vector<fragment_ref> m_packet_fragments;
+  eve::uint16 m_sequence;
+
+  std::vector<eve::uint32> m_received;
+  eve::uint16 m_remote_sequence;
+  bool m_ack_pending;
+
+  double m_srtt;
+  double m_rttvar;
+  double m_rto;
+  eve::uint64 m_sent;
+  eve::uint64 m_resent;
+};
+
+} // net
+} // eve
+
+/** }@ */
@@ -0,0 +1,295 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/platform.h"
+#include "eve/uncopyable.h"
+#include "eve/net/socket.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <functional>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** Answers the time requests of clock_sync clients with the time of the server. */
+class time_service : private uncopyable
+{
+public:
+  /** @returns the current time in seconds. */
+  typedef std::function<double()> clock;
+
+  /** Constructs a service telling the time of @p time_source, or of a stopwatch started now
+      if none is passed. */
+  time_service(clock time_source = clock());
+
+  /** Writes into @p response the answer to the request @p data.
+      @returns the size of the response, 0 if @p data is not a time request. */
+  eve::size respond(const char* data, eve::size size, char* response);
+
+  /** Answers all the requests waiting on the datagram @p socket, without blocking.
+      @returns the number of requests answered. */
+  eve::size poll(eve::socket& socket);
+
+  /** @returns the time of the server. */
+  double now() const { return m_clock(); }
+
+private:
+  clock m_clock;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Estimates the clock of a server from NTP-style exchanges, and follows it smoothly.
+    
+    Each exchange measures the round trip time and the offset between the clocks. Exchanges
+    delayed by queuing, whose round trip time is well above the smallest recently measured, are
+    not trusted; the offset and the drift of the local clock are fitted by least squares over the
+    others. server_time() follows the estimate without ever going back nor jumping: once
+    synchronized, corrections are slewed in at a bounded rate. */
+class clock_sync : private uncopyable
+{
+public:
+  typedef time_service::clock clock;
+
+  struct config
+  {
+    /** Number of recent exchanges the estimate is based on. */
+    eve::size window;
+
+    /** Largest correction of server_time(), in seconds per second. */
+    double max_slew;
+
+    /** For default values initialization. */
+    config();
+  };
+
+  /** Size of requests and responses. */
+  static const eve::size message_size = 33;
+
+  /** Constructs a client reading the local time from @p time_source, or from a stopwatch
+      started now if none is passed. */
+  clock_sync(const config& configuration = config(), clock time_source = clock());
+
+  /** Writes a new request into @p data, which must hold message_size bytes.
+      @returns the size of the request. */
+  eve::size request(char* data);
+
+  /** Processes the response @p data.
+      @returns false if it is not the response to a request sent, e.g. a duplicate. */
+  bool receive(const char* data, eve::size size);
+
+  /** Sends a request to the time service at @p server through the datagram @p socket. */
+  void request(eve::socket& socket, const eve::socket::address& server);
+
+  /** Processes all the responses waiting on the datagram @p socket, without blocking.
+      @returns the number of responses processed. */
+  eve::size poll(eve::socket& socket);
+
+  /** @returns whether at least one exchange completed. */
+  bool synchronized() const { return !m_samples.empty(); }
+
+  /** @returns the estimated offset of the server clock from the local clock, now. */
+  double offset() const;
+
+  /** @returns the estimated rate at which the offset changes, in seconds per second. */
+  double drift() const { return m_drift; }
+
+  /** @returns the smallest round trip time of the recent exchanges. */
+  double rtt() const { return m_min_rtt; }
+
+  /** @returns the local time. */
+  double local_time() const { return m_clock(); }
+
+  /** @returns the estimated server time, monotonic and continuous once synchronized(). Before,
+      it is the local time, which the first estimate replaces even if it is behind. */
+  double server_time();
+
+private:
+  struct sample
+  {
+    double local;
+    double offset;
+    double rtt;
+  };
+
+  void estimate();
+
+  config m_config;
+  clock m_clock;
+  eve::uint32 m_sequence;
+  std::deque<std::pair<eve::uint32, double>> m_pending;
+  std::deque<sample> m_samples;
+
+  double m_min_rtt;
+  double m_reference;
+  double m_offset;
+  double m_drift;
+
+  bool m_slewing;
+  double m_applied;
+  double m_last_local;
+  double m_last_server;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Holds the states received from a server until their time comes, absorbing the variations of
+    network delay so that they are played at a steady pace.
+    
+    States are stamped with the server time they were produced at. They are played back a delay
+    behind the server time: the delay adapts to the measured transit time, interval between states
+    and jitter (estimated as in RFC 3550), moving gradually so that playback does not jump. */
+template <class T>
+class jitter_buffer
+{
+public:
+  /** @param min_delay and @p max_delay bound the playout delay, in seconds.
+      @param capacity is the number of states kept, the oldest are dropped beyond it. */
+  jitter_buffer(double min_delay = 0.05, double max_delay = 0.5, eve::size capacity = 64)
+    : m_min_delay(min_delay), m_max_delay(max_delay), m_capacity(capacity)
+    , m_delay(min_delay), m_jitter(0), m_transit(0), m_interval(0)
+    , m_last_timestamp(-1), m_last_arrival(0), m_played(-1), m_late(0) { }
+
+  /** Adds @p state produced at server time @p timestamp and received at server time @p arrival,
+      e.g. clock_sync::server_time().
+      @returns false if the state was dropped for arriving after its time or twice. */
+  bool push(double timestamp, double arrival, T state)
+  {
+    if (timestamp <= m_played)
+    {
+      ++m_late;
+      return false;
+    }
+
+    auto transit = arrival - timestamp;
+    if (m_last_timestamp < 0)
+      m_transit = transit;
+    else if (timestamp > m_last_timestamp)
+    {
+      auto interval = timestamp - m_last_timestamp;
+      auto d = (arrival - m_last_arrival) - interval;
+      m_jitter += (std::abs(d) - m_jitter) / 16;
+      m_transit += (transit - m_transit) / 16;
+      m_interval += (interval - m_interval) / 16;
+    }
+    if (timestamp > m_last_timestamp)
+    {
+      m_last_timestamp = timestamp;
+      m_last_arrival = arrival;
+    }
+
+    auto target = std::min(std::max(m_transit + m_interval + 4 * m_jitter, m_min_delay), m_max_delay);
+    m_delay += (target - m_delay) / 8;
+
+    auto at = std::upper_bound(m_states.begin(), m_states.end(), timestamp, [] (double t, const entry& e) { return t < e.first; });
+    if (at != m_states.begin() && (at - 1)->first == timestamp)
+      return false;
+    m_states.insert(at, entry(timestamp, std::move(state)));
+    if (m_states.size() > m_capacity)
+      m_states.pop_front();
+    return true;
+  }
+
+  /** Pops the oldest state due at server time @p now, for states played one by one.
+      @returns false if none is due yet. */
+  bool pop(double now, T& state)
+  {
+    if (m_states.empty() || m_states.front().first > now - m_delay)
+      return false;
+
+    m_played = m_states.front().first;
+    state = std::move(m_states.front().second);
+    m_states.pop_front();
+    return true;
+  }
+
+  /** Finds the states around the playout time of server time @p now, for interpolation. States
+      older than @p from are dropped.
+      @param alpha is set to the position of the playout time between them, from 0 to 1.
+      @returns false if no state is old enough yet. If playback caught up with the newest state
+               both are set to it. */
+  bool sample(double now, const T*& from, const T*& to, double& alpha)
+  {
+    auto playout = now - m_delay;
+    while (m_states.size() > 1 && m_states[1].first <= playout)
+      m_states.pop_front();
+    if (m_states.empty() || m_states.front().first > playout)
+      return false;
+
+    m_played = m_states.front().first;
+    from = &m_states.front().second;
+    if (m_states.size() == 1)
+    {
+      to = from;
+      alpha = 0;
+      return true;
+    }
+    to = &m_states[1].second;
+    alpha = (playout - m_states.front().first) / (m_states[1].first - m_states.front().first);
+    return true;
+  }
+
+  /** @returns the current playout delay, in seconds. */
+  double delay() const { return m_delay; }
+
+  /** @returns the estimated jitter, in seconds. */
+  double jitter() const { return m_jitter; }
+
+  /** @returns the number of states dropped for arriving too late. */
+  eve::size late() const { return m_late; }
+
+  /** @returns the number of states held. */
+  eve::size size() const { return eve::size(m_states.size()); }
+
+private:
+  typedef std::pair<double, T> entry;
+
+  double m_min_delay;
+  double m_max_delay;
+  eve::size m_capacity;
+  double m_delay;
+  double m_jitter;
+  double m_transit;
+  double m_interval;
+  double m_last_timestamp;
+  double m_last_arrival;
+  double m_played;
+  eve::size m_late;
+  std::deque<entry> m_states;
+};
+
+} // net
+} // eve
+
+/** }@ */
@@ -0,0 +1,127 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/platform.h"
+#include "eve/uncopyable.h"
+#include "eve/span.h"
+#include <vector>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+class buffer;
+
+/** Frames messages over a stream connection with a varint length prefix.
+    
+    Outgoing messages are staged and leave together, with a single send, on flush(), which is
+    meant to be called once per tick. Incoming frames are decoded straight from the input of the
+    net::buffer into blocks taken from a pool owned by the codec, so that once warmed up reading
+    messages does not allocate. */
+class message_codec : private uncopyable
+{
+public:
+  /** A received message. Its bytes return to the codec pool when it is destroyed or released,
+      which must happen before the codec is destroyed. */
+  class message : private uncopyable
+  {
+  public:
+    message();
+    message(message&& rhs);
+    ~message();
+
+    const char* data() const { return m_data; }
+    eve::size size() const { return m_size; }
+    bool empty() const { return m_data == nullptr; }
+
+    /** @returns a reader over the message bytes. */
+    eve::span_reader reader() const { return eve::span_reader(m_data, m_size); }
+
+    /** Gives the bytes back to the pool, leaving this message empty. */
+    void release();
+
+    message& operator=(message&& rhs);
+
+  private:
+    friend class message_codec;
+
+    message_codec* m_codec;
+    char* m_data;
+    eve::size m_size;
+    eve::uint8 m_class;
+  };
+
+  /** Constructs a codec reading and writing through @p buffer.
+      @param max_message_size larger incoming frames are a protocol error. */
+  message_codec(eve::net::buffer& buffer, eve::size max_message_size = 1024 * 1024);
+  ~message_codec();
+
+  /** Stages @p data as a message to be sent by the next flush(). */
+  void write(const char* data, eve::size size);
+
+  /** Stages the bytes in @p container as a message, e.g. a std::vector<char> filled by a span_writer. */
+  template <class Container>
+  void write(const Container& container) { write(container.size() ? &container[0] : nullptr, eve::size(container.size())); }
+
+  /** Sends all the staged messages at once.
+      @returns the number of bytes sent. */
+  eve::size flush();
+
+  /** Decodes the next message if it has been completely received, without blocking.
+      @returns false if no complete message is available yet, leaving @p message untouched.
+      @note Throws a socket_error if the frame is larger than the maximum message size. */
+  bool try_read(message& message);
+
+  /** Blocks until the next message has been received and decodes it.
+      @returns false if the connection was closed before.
+      @note Throws a socket_error if the frame is larger than the maximum message size. */
+  bool read(message& message);
+
+  /** @returns the number of pooled blocks waiting to be reused. */
+  eve::size pooled() const;
+
+private:
+  bool decode(message& message, bool block);
+  char* acquire(eve::size size, eve::uint8& size_class);
+  void recycle(char* data, eve::uint8 size_class);
+
+  eve::net::buffer* m_buffer;
+  eve::size m_max_message_size;
+  std::vector<char> m_outgoing;
+  std::vector<std::vector<char*>> m_pool;
+  eve::size m_outstanding;
+};
+
+} // net
+} // eve
+
+/** }@ */
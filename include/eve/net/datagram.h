@@ -0,0 +1,140 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/net/socket.h"
+#include "eve/uncopyable.h"
+#include <vector>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** A datagram held by a packet_ring. */
+struct packet
+{
+  /** Payload, pointing into the ring storage. It can hold up to packet_ring::packet_size() bytes. */
+  char* data;
+
+  /** Payload size in bytes. */
+  eve::size size;
+
+  /** Destination of a packet to be sent, sender of a received one. */
+  eve::socket::address address;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** A fixed-capacity queue of datagrams whose storage is allocated once at construction.
+    Packets are queued at the back and consumed from the front. The whole queue is sent, or the
+    free part refilled, with a single system call where supported (sendmmsg/recvmmsg on Linux),
+    without ever blocking. */
+class packet_ring : private uncopyable
+{
+public:
+  /** The largest UDP payload fitting an Ethernet frame without fragmentation. */
+  static const eve::size k_default_packet_size = 1472;
+
+  packet_ring(eve::size capacity, eve::size packet_size = k_default_packet_size);
+  ~packet_ring();
+
+  /** @returns the maximum number of queued packets. */
+  eve::size capacity() const { return eve::size(m_packets.size()); }
+
+  /** @returns the maximum payload of each packet. */
+  eve::size packet_size() const { return m_packet_size; }
+
+  /** @returns the number of queued packets. */
+  eve::size size() const { return m_count; }
+
+  bool empty() const { return m_count == 0; }
+  bool full() const { return m_count == capacity(); }
+
+  /** @returns the free packet following the last queued one. Fill it and then call push().
+      @note Throws a std::out_of_range if the ring is full. */
+  packet& back();
+
+  /** Queues the packet returned by back(). */
+  void push();
+
+  /** Copies @p data in a new packet queued to be sent to @p to.
+      @note Throws a std::out_of_range if the ring is full or @p size exceeds packet_size(). */
+  void push(const char* data, eve::size size, const eve::socket::address& to);
+
+  /** @returns the first queued packet.
+      @note Throws a std::out_of_range if the ring is empty. */
+  packet& front();
+
+  /** Removes the first queued packet. */
+  void pop();
+
+  /** Removes all queued packets. */
+  void clear();
+
+  /** Receives as many waiting datagrams as there are free packets, without blocking.
+      Datagrams larger than packet_size() are truncated.
+      @returns the number of packets queued.
+      @note On error it throws a socket_error. */
+  eve::size receive(eve::socket& socket);
+
+  /** Sends the queued packets without blocking and removes the ones sent.
+      @returns the number of packets sent, fewer than size() if the socket buffer filled up.
+      @note On error it throws a socket_error. */
+  eve::size send(eve::socket& socket);
+
+  /** Enables UDP segmentation offload on @p socket when the kernel supports it. Runs of queued
+      packets of the same size and destination then leave as a single datagram split by the kernel
+      (GSO), and datagrams coalesced on receive (GRO) are split back into packets by receive().
+      @returns true if offload is enabled, false if unsupported. */
+  bool enable_offload(eve::socket& socket);
+
+  /** @returns true if enable_offload() succeeded. */
+  bool offload() const { return m_offload; }
+
+private:
+  struct backend;
+
+  packet& at(eve::size index) { return m_packets[(m_head + index) % m_packets.size()]; }
+  eve::size receive_coalesced(eve::socket& socket);
+
+  std::vector<packet> m_packets;
+  char* m_storage;
+  eve::size m_packet_size;
+  eve::size m_head;
+  eve::size m_count;
+  bool m_offload;
+  backend* m_backend;
+};
+
+} // net
+} // eve
+
+/** }@ */
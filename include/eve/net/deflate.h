@@ -0,0 +1,161 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/platform.h"
+#include "eve/storage.h"
+#include "eve/uncopyable.h"
+#include "eve/net/stream.h"
+#include <vector>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** Compresses everything sent through another stream with deflate, and inflates what is received.
+    
+    It is meant to sit between a net::buffer and its socket. Each send is a unit: it is compressed
+    into the persistent zlib stream of its direction and flushed with Z_SYNC_FLUSH, so that a
+    net::buffer sync() leaves as a self-contained frame that the peer can inflate right away, while
+    the dictionary built from previous frames keeps compressing the next ones. Units smaller than
+    the threshold are sent as they are, since deflate cannot gain anything on a few bytes.
+    Both ends must wrap their stream in a deflate_stream. */
+class deflate_stream : public stream, private uncopyable
+{
+public:
+  struct config
+  {
+    /** zlib compression level, from 1 (fastest) to 9 (smallest), -1 for zlib's default. */
+    int level;
+
+    /** Units of fewer bytes are sent uncompressed. */
+    eve::size threshold;
+
+    /** Received units that inflate to more bytes are rejected with a socket_error. */
+    eve::size max_frame;
+
+    /** For default values initialization. */
+    config();
+  };
+
+  struct stats
+  {
+    /** Bytes passed to send() and bytes that actually went through the wrapped stream. */
+    eve::uint64 bytes_in;
+    eve::uint64 bytes_out;
+
+    /** Compressed bytes received and the bytes they inflated to. */
+    eve::uint64 wire_received;
+    eve::uint64 bytes_received;
+
+    /** Units sent compressed and uncompressed. */
+    eve::uint64 deflated;
+    eve::uint64 bypassed;
+
+    /** Seconds spent compressing and decompressing. */
+    double deflate_time;
+    double inflate_time;
+  };
+
+  /** Constructs this stream over @p stream, which it does not own. */
+  deflate_stream(stream* stream, const config& configuration = config());
+  ~deflate_stream();
+
+  /** Compresses and sends all of @p data, blocking until it has been sent.
+      @returns @p size. */
+  eve::size send(const char* data, eve::size size) override;
+  void send_all(const char* data, eve::size size) override;
+  void send_all(const chunk* chunks, eve::size count) override;
+
+  /** Blocks until some data has been received and inflated. Received data is inflated only as
+      it is read, at most 64 KiB ahead.
+      @returns the number of bytes received, 0 if the wrapped stream was closed.
+      @note Throws a socket_error if the received data is corrupted. */
+  eve::size receive(char* buffer, eve::size size) override;
+
+  /** Compresses @p data, unless what was compressed before is still waiting to be sent, and sends
+      as much as possible without blocking. What could not be sent leaves with the next call. */
+  bool try_send(const char* data, eve::size& size) override;
+  bool try_receive(char* buffer, eve::size& size) override;
+  void cork(bool corked) override;
+
+  /** Blocks until the compressed data left behind by try_send() has been sent. */
+  void flush();
+
+  /** Changes the compression level of the next units. */
+  void level(int level);
+
+  /** @returns the statistics of this stream. */
+  const stats& statistics() const { return m_stats; }
+
+  /** @returns how many bytes compression saved on the wire so far, negative if it cost some. */
+  eve::int64 bytes_saved() const { return eve::int64(m_stats.bytes_in) - eve::int64(m_stats.bytes_out); }
+
+  /** @returns the seconds spent compressing each megabyte sent. */
+  double deflate_cost() const { return m_stats.bytes_in ? m_stats.deflate_time * 1024 * 1024 / m_stats.bytes_in : 0; }
+
+private:
+  void frame(const chunk* chunks, eve::size count);
+  void deflate(const chunk* chunks, eve::size count);
+  bool try_flush();
+  bool decode();
+  eve::size inflate(const char* data, eve::size size);
+  eve::size take(char* buffer, eve::size size);
+
+  stream* m_stream;
+  config m_config;
+  stats m_stats;
+
+  // z_stream of each direction
+  fixed_storage<128> m_deflate;
+  fixed_storage<128> m_inflate;
+
+  // framed bytes waiting to be sent, from m_sent on
+  std::vector<char> m_outgoing;
+  eve::size m_sent;
+
+  // wire bytes not decoded yet and inflated bytes not read yet, from their offsets on
+  std::vector<char> m_wire;
+  eve::size m_wire_offset;
+  std::vector<char> m_plain;
+  eve::size m_plain_offset;
+
+  // what is left of the frame being decoded
+  eve::uint8 m_frame_kind;
+  eve::size m_frame_left;
+  eve::size m_frame_plain;
+  bool m_in_frame;
+};
+
+} // net
+} // eve
+
+/** }@ */
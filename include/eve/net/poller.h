@@ -0,0 +1,114 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/platform.h"
+#include "eve/uncopyable.h"
+#include "eve/utils.h"
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+
+class socket;
+
+namespace net {
+
+/** Waits for readiness on many sockets at once and dispatches it to a handler per socket.
+    On Linux it is backed by edge-triggered epoll: a handler is called once when a socket
+    becomes ready and then not again until new data arrives, so every handler must drain its
+    socket with the try_* methods until they return false. Other platforms fall back to a
+    level-triggered poll which honours the same contract. */
+class poller : private uncopyable
+{
+public:
+  enum class event : uint8
+  {
+    readable = eve_bit(0),
+    writable = eve_bit(1),
+
+    /** The peer hung up or an error is pending. Always reported, even if not requested. */
+    hangup = eve_bit(2)
+  };
+
+  typedef std::function<void(eve::socket& socket, eve::flagset<event> events)> handler;
+
+  poller();
+  ~poller();
+
+  /** Starts watching @p socket for @p events, calling @p handler when any of them occurs.
+      @note @p socket must outlive its registration. Throws a socket_error if already added. */
+  void add(eve::socket& socket, eve::flagset<event> events, handler handler);
+
+  /** Changes the events watched for @p socket. */
+  void modify(eve::socket& socket, eve::flagset<event> events);
+
+  /** Stops watching @p socket. It is safe to call from within a handler, also for other sockets
+      whose events have already been collected by the current poll(). */
+  void remove(eve::socket& socket);
+
+  /** Waits up to @p timeout milliseconds for events and dispatches them.
+      @param timeout 0 returns immediately, a negative value waits indefinitely.
+      @returns the number of handlers called. */
+  eve::size poll(int timeout);
+
+  /** @returns the number of registered sockets. */
+  eve::size size() const { return eve::size(m_entries.size()); }
+
+private:
+  struct entry
+  {
+    eve::socket* socket;
+    eve::flagset<event> events;
+    handler callback;
+    bool removed;
+  };
+  struct backend;
+
+  entry& find(eve::socket& socket);
+  
+  std::unordered_map<eve::socket*, entry*> m_entries;
+  std::vector<entry*> m_removed;
+  backend* m_backend;
+  bool m_dispatching;
+};
+
+inline eve::flagset<poller::event> operator|(poller::event a, poller::event b)
+{
+  return eve::flagset<poller::event>() | a | b;
+}
+
+} // net
+} // eve
+
+/** }@ */
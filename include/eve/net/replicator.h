@@ -0,0 +1,252 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/platform.h"
+#include "eve/uncopyable.h"
+#include "eve/singleton.h"
+#include "eve/serialization.h"
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** Replicates serializable objects to many clients, each seeing only the objects around it.
+    
+    Objects are registered with their serialization_info and a position. The world is divided in
+    a grid of square cells and every client watches the cells within its view radius: it is sent
+    the full state of an object when the object enters its view, the fields that changed while it
+    stays there, and a notice when it leaves.
+
+    The game calls touch() or move() on the objects it changed, and only those are serialized at
+    the next tick(): their fields are compared with what was last replicated and the changed ones
+    are appended to the snapshot of every client watching their cell. The cost of a tick thus
+    depends on the changed objects and on the clients whose view moved, never on the total number
+    of objects. Snapshots are deltas over the previous ones, so they must be delivered reliably and
+    in order, e.g. through a net::message_codec or a reliable net::channel stream. On the client
+    a net::replica applies them. */
+class replicator : private uncopyable
+{
+public:
+  typedef eve::uint32 object_id;
+  typedef eve::uint32 client_id;
+
+  struct config
+  {
+    /** Side of the cells of the interest grid, in world units. */
+    float cell_size;
+
+    /** For default values initialization. */
+    config();
+  };
+
+  struct stats
+  {
+    eve::size objects;
+    eve::size clients;
+
+    /** Of the last tick: cells holding objects or watched, objects serialized, fields that
+        changed and snapshot bytes sent. */
+    eve::size cells;
+    eve::size serialized;
+    eve::size fields;
+    eve::size bytes;
+  };
+
+  /** Called at every tick with the snapshot of each client that has something to receive. */
+  typedef std::function<void(client_id client, const char* data, eve::size size)> transmit;
+
+  replicator(transmit transmit, const config& configuration = config());
+
+  /** Starts replicating @p object, which must outlive its replication, at position @p x, @p y.
+      @param type tells the client which kind of object to create, see replica::bind().
+      @returns the id of the object. */
+  template <class T>
+  object_id add(T* object, eve::uint16 type, float x, float y)
+  {
+    return add(object, eve::singleton<typename T::serialization_info>::ref(), type, x, y);
+  }
+
+  object_id add(void* object, const eve::detail::serialization_info_base& info, eve::uint16 type, float x, float y);
+
+  /** Stops replicating object @p id, clients watching it are told that it left. */
+  void remove(object_id id);
+
+  /** Marks object @p id as changed, its fields are compared at the next tick. */
+  void touch(object_id id);
+
+  /** Moves object @p id to @p x, @p y and marks it as changed. */
+  void move(object_id id, float x, float y);
+
+  /** Adds a client viewing the objects within @p radius of @p x, @p y.
+      @returns the id of the client. */
+  client_id add_client(float x, float y, float radius);
+
+  /** Stops sending snapshots to client @p id. */
+  void remove_client(client_id id);
+
+  /** Moves the view of client @p id, taking effect at the next tick. */
+  void view(client_id id, float x, float y, float radius);
+
+  /** Builds the snapshot of every client and transmits those that are not empty. */
+  void tick();
+
+  /** @returns the statistics of the replicator. */
+  const stats& statistics() const { return m_stats; }
+
+private:
+  struct object
+  {
+    void* instance;
+    const eve::detail::serialization_info_base* info;
+    eve::uint16 type;
+    eve::int64 cell;
+    eve::size cell_index;
+    bool dirty;
+
+    // the fields as last replicated, one after the other
+    std::vector<char> bytes;
+    std::vector<eve::uint32> offsets;
+  };
+
+  struct client
+  {
+    int x0, y0, x1, y1;
+    int nx0, ny0, nx1, ny1;
+    bool moved;
+    eve::uint64 mark;
+    std::vector<char> snapshot;
+  };
+
+  struct cell
+  {
+    std::vector<object_id> objects;
+    std::vector<client_id> watchers;
+  };
+
+  eve::int64 cell_of(float x, float y) const;
+  void cells(float x, float y, float radius, int& x0, int& y0, int& x1, int& y1) const;
+  void watch(client_id id, client& c, int x, int y, bool watching);
+  void insert(object_id id, object& o);
+  void erase(object& o);
+  void serialize(object& o, std::vector<char>& bytes, std::vector<eve::uint32>& offsets);
+  void enter(client& c, object_id id, const object& o);
+  void update(client& c, object_id id, const object& o, const std::vector<eve::uint16>& fields);
+  void leave(client& c, object_id id);
+  std::vector<char>& snapshot(client& c);
+
+  transmit m_transmit;
+  config m_config;
+  std::unordered_map<object_id, object> m_objects;
+  std::unordered_map<client_id, client> m_clients;
+  std::unordered_map<eve::int64, cell> m_cells;
+  std::vector<object_id> m_dirty;
+  std::vector<client_id> m_pending;
+  object_id m_next_object;
+  client_id m_next_client;
+  eve::uint32 m_tick;
+  eve::uint64 m_mark;
+  stats m_stats;
+
+  std::vector<char> m_scratch;
+  std::vector<eve::uint32> m_scratch_offsets;
+  std::vector<eve::uint16> m_changed;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** The client side of a replicator: it applies the snapshots, creating, updating and destroying
+    the local instances of the replicated objects. */
+class replica : private uncopyable
+{
+public:
+  typedef replicator::object_id object_id;
+
+  replica();
+
+  /** Destroys the objects still in view. */
+  ~replica();
+
+  /** Creates objects of @p type with @p spawn and destroys them with @p despawn. */
+  template <class T>
+  void bind(eve::uint16 type, std::function<T*(object_id id)> spawn, std::function<void(object_id id, T* object)> despawn)
+  {
+    binding b;
+    b.info = &eve::singleton<typename T::serialization_info>::ref();
+    b.spawn = [spawn] (object_id id) -> void* { return spawn(id); };
+    b.despawn = [despawn] (object_id id, void* object) { despawn(id, static_cast<T*>(object)); };
+    m_bindings[type] = std::move(b);
+  }
+
+  /** Applies the snapshot @p data.
+      @note Throws a std::runtime_error if it is malformed or refers to an unbound type. */
+  void apply(const char* data, eve::size size);
+
+  /** @returns the local instance of object @p id, nullptr if it is not in view. */
+  template <class T>
+  T* get(object_id id) const
+  {
+    auto it = m_objects.find(id);
+    return it == m_objects.end() ? nullptr : static_cast<T*>(it->second.instance);
+  }
+
+  /** @returns the number of objects in view. */
+  eve::size size() const { return eve::size(m_objects.size()); }
+
+  /** @returns the tick of the last snapshot applied. */
+  eve::uint32 tick() const { return m_tick; }
+
+private:
+  struct binding
+  {
+    const eve::detail::serialization_info_base* info;
+    std::function<void*(object_id id)> spawn;
+    std::function<void(object_id id, void* object)> despawn;
+  };
+
+  struct local
+  {
+    void* instance;
+    eve::uint16 type;
+  };
+
+  std::unordered_map<eve::uint16, binding> m_bindings;
+  std::unordered_map<object_id, local> m_objects;
+  eve::uint32 m_tick;
+};
+
+} // net
+} // eve
+
+/** }@ */
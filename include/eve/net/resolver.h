@@ -0,0 +1,132 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/uncopyable.h"
+#include "eve/net/socket.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** Resolves hostnames on a thread of its own so that lookups never stall the game loop.
+    
+    Results are cached by hostname and port for a limited time, successful lookups only, and
+    queries already in flight are shared. Results are delivered either through a future or
+    through a callback, which is called from poll() on the thread calling it. */
+class resolver : private uncopyable
+{
+public:
+  struct result
+  {
+    /** Whether the hostname resolved to at least one address. */
+    bool ok;
+
+    /** The resolved addresses, IPv4 and IPv6 in the order the system prefers. */
+    std::vector<eve::socket::address> addresses;
+
+    /** Why the hostname could not be resolved. */
+    std::string error;
+  };
+
+  typedef std::function<void(const result&)> callback;
+
+  /** Constructs a resolver caching its results for @p ttl. */
+  resolver(std::chrono::milliseconds ttl = std::chrono::seconds(60));
+
+  /** Waits for the lookup in progress, if any, and drops the queued ones. */
+  ~resolver();
+
+  /** Resolves @p hostname, the addresses taking port @p port. */
+  std::future<result> resolve(const std::string& hostname, int port);
+
+  /** Resolves @p hostname, @p callback being called with the result by the next poll() after
+      the lookup completes. On a cache hit it is called by the next poll() as well. */
+  void resolve(const std::string& hostname, int port, callback callback);
+
+  /** Calls the callbacks of the completed lookups.
+      @returns the number of callbacks called. */
+  eve::size poll();
+
+  /** Forgets every cached result. */
+  void clear();
+
+  /** @returns whether a fresh result is cached for @p hostname and @p port. */
+  bool cached(const std::string& hostname, int port) const;
+
+private:
+  typedef std::chrono::steady_clock clock;
+  typedef std::shared_ptr<std::promise<result>> promise_ptr;
+
+  struct query
+  {
+    std::string hostname;
+    int port;
+    std::vector<promise_ptr> promises;
+    std::vector<callback> callbacks;
+  };
+
+  struct entry
+  {
+    std::shared_ptr<const result> value;
+    clock::time_point expiry;
+  };
+
+  void run();
+  std::shared_ptr<const result> lookup(const std::string& key) const;
+  void enqueue(const std::string& hostname, int port, promise_ptr promise, callback callback);
+
+  std::chrono::milliseconds m_ttl;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wakeup;
+  std::deque<std::string> m_queue;
+  std::unordered_map<std::string, query> m_pending;
+  std::unordered_map<std::string, entry> m_cache;
+  std::vector<std::pair<callback, std::shared_ptr<const result>>> m_completed;
+  bool m_stopping;
+  std::thread m_thread;
+};
+
+} // net
+} // eve
+
+/** }@ */
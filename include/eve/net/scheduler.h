@@ -0,0 +1,174 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/platform.h"
+#include "eve/uncopyable.h"
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** Decides the order in which the outgoing messages of a connection leave, within a bandwidth
+    budget.
+    
+    Messages are queued in classes. Each update() refills the token bucket of the connection and
+    those of the classes, then hands messages to the transmit function, most urgent first, while
+    tokens are left: urgency is the priority of the class plus the aging rate times the seconds
+    the message has waited, so that bulk transfers are slowed down, never starved, by a flow of
+    important events. Within a class messages leave in order.
+
+    Classes may be unreliable: their messages expire when too old to be useful, and a message
+    pushed with the key of a message still queued supersedes it, either replacing it or being
+    merged into it. The scheduler does no I/O, the transmit function would typically write to a
+    net::message_codec or a net::channel. */
+class scheduler : private uncopyable
+{
+public:
+  /** Merges @p data into the queued message @p queued it supersedes. */
+  typedef std::function<void(std::vector<char>& queued, const char* data, eve::size size)> merge_function;
+
+  /** Called with every message leaving, and the class it was pushed to. */
+  typedef std::function<void(eve::uint8 type, const char* data, eve::size size)> transmit;
+
+  struct class_config
+  {
+    /** Higher priorities leave first. */
+    double priority;
+
+    /** Bytes per second this class may use and bytes it may send at once, 0 meaning only the
+        connection budget limits it. */
+    double rate;
+    double burst;
+
+    /** Whether messages can be dropped, by expiry or by superseding. */
+    bool unreliable;
+
+    /** Seconds after which unreliable messages are dropped, 0 meaning never. It is counted from
+        the last time a message was superseded, as its content is then fresh again. */
+    double max_age;
+
+    /** Merges superseded messages, if not set the newest message replaces the queued one. */
+    merge_function merge;
+
+    /** For default values initialization: a reliable class of priority 0 without limits. */
+    class_config();
+  };
+
+  struct config
+  {
+    /** Bytes per second the connection may send, and bytes it may send at once. */
+    double rate;
+    double burst;
+
+    /** Priority gained by a message every second it waits. */
+    double aging;
+
+    /** For default values initialization. */
+    config();
+  };
+
+  struct metrics
+  {
+    /** What is queued right now. */
+    eve::size messages;
+    eve::size bytes;
+
+    /** Seconds the oldest queued message has waited. */
+    double oldest;
+
+    eve::uint64 sent;
+    eve::uint64 bytes_sent;
+    eve::uint64 superseded;
+    eve::uint64 expired;
+  };
+
+  scheduler(transmit transmit, const config& configuration = config());
+
+  /** Adds a class of messages configured with @p configuration.
+      @returns the index of the class, to be used with push(). */
+  eve::uint8 add_class(const class_config& configuration);
+
+  /** Changes the budget of the connection, e.g. after measuring its bandwidth. */
+  void configure(const config& configuration);
+
+  /** Queues @p data in class @p type. A non zero @p key in an unreliable class supersedes the
+      message queued with the same key, if any. Messages are stamped with the time of the last
+      update(). */
+  void push(eve::uint8 type, const char* data, eve::size size, eve::uint32 key = 0);
+
+  /** Transmits the messages the budget allows at time @p now, in seconds.
+      @returns the number of bytes transmitted. */
+  eve::size update(double now);
+
+  /** @returns the queue metrics of class @p type. */
+  metrics statistics(eve::uint8 type) const;
+
+  /** @returns the number of bytes queued in all classes. */
+  eve::size queued() const;
+
+private:
+  struct message
+  {
+    std::vector<char> data;
+    double queued;   // when first pushed, for aging
+    double updated;  // when last superseded, for expiry
+    eve::uint32 key;
+  };
+
+  struct queue
+  {
+    class_config config;
+    std::list<message> messages;
+    std::unordered_map<eve::uint32, std::list<message>::iterator> keys;
+    double tokens;
+    metrics counters;
+  };
+
+  void pop(queue& q) { erase(q, q.messages.begin()); }
+  void erase(queue& q, std::list<message>::iterator it);
+
+  transmit m_transmit;
+  config m_config;
+  std::vector<queue> m_queues;
+  double m_tokens;
+  double m_now;
+  bool m_started;
+};
+
+} // net
+} // eve
+
+/** }@ */
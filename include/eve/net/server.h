@@ -0,0 +1,179 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/memory.h"
+#include "eve/uncopyable.h"
+#include "eve/net/socket.h"
+#include "eve/net/poller.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** A TCP server spreading its connections over several worker threads.
+    
+    Each worker runs its own poller and, where SO_REUSEPORT is supported, its own listening
+    socket on the shared port, so the system balances new connections among workers without any
+    locking. Elsewhere the first worker accepts and deals connections out round-robin. Either way
+    a connection stays with one worker for its whole lifetime, and all the callbacks about it run
+    on that worker's thread. */
+class server : private uncopyable
+{
+public:
+  class connection : private uncopyable
+  {
+  public:
+    /** @returns the connected socket. */
+    eve::socket& socket() { return m_socket; }
+
+    /** @returns the index of the worker owning this connection. */
+    eve::size worker() const { return m_worker; }
+
+    /** Sends @p data without blocking: what the socket does not take at once is queued and
+        sent as the socket becomes writable, so that a slow peer never stalls the other
+        connections of its worker. */
+    void send(const char* data, eve::size size);
+
+    /** @returns the number of bytes queued by send() and not sent yet, e.g. to stop sending to
+        a peer that does not keep up. */
+    eve::size pending() const { return eve::size(m_pending.size()); }
+
+    /** Closes this connection once the current callback returns and what is pending is sent. */
+    void close() { m_closing = true; }
+
+    /** Free for the handler to attach its own state. */
+    void* user;
+
+  private:
+    friend class server;
+    connection(eve::socket&& socket, eve::size worker);
+
+    /** Sends what is pending until the socket would block.
+        @returns true if nothing is left. */
+    bool flush();
+
+    eve::socket m_socket;
+    eve::size m_worker;
+    bool m_closing;
+    std::vector<char> m_pending;
+    eve::net::poller* m_poller;
+    std::atomic<eve::uint64>* m_bytes_sent;
+  };
+
+  /** Reacts to the events of the connections of one worker. A handler is created per worker and
+      only ever called from that worker's thread, so its state needs no locking. */
+  class handler
+  {
+  public:
+    virtual ~handler() { }
+    virtual void connected(connection& /*connection*/) { }
+    virtual void received(connection& connection, const char* data, eve::size size) = 0;
+    virtual void disconnected(connection& /*connection*/) { }
+  };
+
+  /** Creates the handler of the worker with the index passed. */
+  typedef std::function<eve::unique_ptr<handler>::type(eve::size worker)> factory;
+
+  struct stats
+  {
+    eve::uint64 accepted;
+    eve::uint64 closed;
+    eve::uint64 bytes_received;
+    eve::uint64 bytes_sent;
+    eve::size connections;
+  };
+
+  /** Constructs a server that will create its handlers with @p factory. */
+  server(factory factory);
+
+  /** Stops the server if running. */
+  ~server();
+
+  /** Starts listening at @p port with @p workers threads, 0 meaning one per hardware thread.
+      @note Throws a socket_error if the port cannot be listened to. */
+  void start(eve::uint32 port, eve::size workers = 0);
+
+  /** Stops all workers, disconnecting every connection. */
+  void stop();
+
+  /** @returns the number of running workers. */
+  eve::size workers() const { return eve::size(m_workers.size()); }
+
+  /** @returns a snapshot of the statistics of worker @p worker. */
+  stats statistics(eve::size worker) const;
+
+private:
+  struct worker
+  {
+    eve::size index;
+    eve::unique_ptr<handler>::type events;
+    eve::socket listener;
+    eve::net::poller poller;
+    std::unordered_map<eve::socket*, eve::unique_ptr<connection>::type> connections;
+    std::vector<char> scratch;
+    std::thread thread;
+
+    // connections dealt out by the first worker when ports cannot be shared
+    std::mutex inbox_mutex;
+    std::vector<eve::socket> inbox;
+
+    std::atomic<eve::uint64> accepted;
+    std::atomic<eve::uint64> closed;
+    std::atomic<eve::uint64> bytes_received;
+    std::atomic<eve::uint64> bytes_sent;
+    std::atomic<eve::size> count;
+  };
+
+  void run(worker& w);
+  void accept(worker& w);
+  void attach(worker& w, eve::socket&& socket);
+  void ready(worker& w, connection& c, eve::flagset<poller::event> events);
+  void receive(worker& w, connection& c);
+  void detach(worker& w, connection& c);
+
+  factory m_factory;
+  std::vector<eve::unique_ptr<worker>::type> m_workers;
+  std::atomic<bool> m_running;
+  bool m_shared_port;
+  eve::size m_next;
+};
+
+} // net
+} // eve
+
+/** }@ */
@@ -0,0 +1,115 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/uncopyable.h"
+#include "eve/net/stream.h"
+#include "eve/net/socket.h"
+#include <string>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** A byte stream between two processes on the same host, through shared memory.
+    
+    One end creates a named segment holding a lock-free single-producer single-consumer ring per
+    direction, the other opens it by name. A message costs a copy into the ring and a copy out of
+    it, and a system call only when the other end is asleep waiting for it (a futex on Linux, an
+    event elsewhere). Each end must be used by one thread at a time. */
+class shm_channel : public stream, private uncopyable
+{
+public:
+  /** Constructs a closed channel, call create() or open() before using it. */
+  shm_channel();
+
+  /** Closes the channel if open. */
+  ~shm_channel();
+
+  /** Creates the segment @p name with rings of @p capacity bytes each, rounded up to a power of two.
+      A segment left behind by a creator that crashed is replaced.
+      @note Throws a socket_error if the segment cannot be created, e.g. if it already exists. */
+  void create(const std::string& name, eve::size capacity = 256 * 1024);
+
+  /** Opens the segment @p name created by the other end.
+      @note Throws a socket_error if there is no such segment. */
+  void open(const std::string& name);
+
+  /** Tells the other end that nothing more will be sent and releases the segment. The creator
+      also removes its name, so the channel cannot be opened anymore. */
+  void close();
+
+  /** @returns whether this end is open and the other end has not closed it. */
+  bool connected() const;
+
+  /** @returns the capacity in bytes of the ring of each direction. */
+  eve::size capacity() const;
+
+  /** Blocks until some of @p data has been copied into the ring. An end whose process exited
+      counts as closed, which a blocked call notices within 100 ms.
+      @note Throws a socket_error if the other end closed the channel. */
+  eve::size send(const char* data, eve::size size) override;
+
+  /** Blocks until some data has been copied out of the ring.
+      @returns the number of bytes received, 0 if the other end closed the channel. */
+  eve::size receive(char* buffer, eve::size size) override;
+
+  bool try_send(const char* data, eve::size& size) override;
+  bool try_receive(char* buffer, eve::size& size) override;
+
+private:
+  struct ring;
+  struct segment;
+
+  void open_events();
+  eve::size write(const char* data, eve::size size);
+  eve::size read(char* buffer, eve::size size);
+  bool peer_closed() const;
+  bool peer_alive();
+  void validate() const;
+
+  /** @returns whether the segment at @p path was created by a process that exited. */
+  static bool abandoned(const std::string& path);
+
+  std::string m_name;
+  segment* m_segment;
+  eve::size m_size;
+  eve::uint8 m_end;
+  bool m_owner;
+
+  // the mapping and the readable and writable events of both rings where futexes are missing
+  eve::uintptr m_handles[5];
+};
+
+} // net
+} // eve
+
+/** }@ */
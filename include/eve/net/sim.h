@@ -0,0 +1,207 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/platform.h"
+#include "eve/uncopyable.h"
+#include "eve/net/stream.h"
+#include "eve/net/socket.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <vector>
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** An in-memory link between two endpoints that simulates network conditions.
+    
+    Every byte sent is serialized at the configured bandwidth, then delayed by the latency plus a
+    jitter drawn from the configured distribution. Both endpoints are streams, so net::buffer and
+    everything above it works over them as over sockets: stream bytes are delayed but never lost
+    nor reordered, as TCP would deliver them. Datagrams sent with send_datagram() are also subject
+    to loss, reordering and to the queue limit, for protocols such as net::channel.
+
+    Time is read from a clock function, a stopwatch by default. Driven by a manual time source
+    and seeded, a link behaves the same on every run, so that protocol benchmarks are reproducible;
+    then only the non-blocking calls can be used, since nothing arrives until the caller moves the
+    time forward. Both endpoints may be used from different threads. */
+class sim_link : private uncopyable
+{
+public:
+  /** @returns the current time in seconds. */
+  typedef std::function<double()> clock;
+
+  enum class distribution : uint8
+  {
+    /** No jitter, every byte takes latency seconds. */
+    constant,
+
+    /** Uniformly between 0 and jitter seconds are added. */
+    uniform,
+
+    /** Normally distributed with jitter seconds of standard deviation, never below 0. */
+    normal,
+
+    /** Exponentially distributed with a mean of jitter seconds: mostly small, sometimes large. */
+    exponential
+  };
+
+  struct config
+  {
+    /** One-way delay in seconds, before jitter. */
+    double latency;
+
+    /** Spread of the additional delay in seconds, see distribution. */
+    double jitter;
+
+    /** How the additional delay is drawn. */
+    distribution delay;
+
+    /** Probability of a datagram being lost. */
+    double loss;
+
+    /** Probability of a datagram being held back by an extra latency, so that the following
+        ones overtake it. */
+    double reorder;
+
+    /** Bytes per second in each direction, 0 meaning unlimited. */
+    double bandwidth;
+
+    /** Bytes that may wait for bandwidth in each direction, 0 meaning unlimited. Beyond it
+        datagrams are dropped and stream sends block. */
+    eve::size queue_limit;
+
+    /** For default values initialization: a perfect link. */
+    config();
+  };
+
+  struct stats
+  {
+    eve::uint64 sent;
+    eve::uint64 delivered;
+    eve::uint64 dropped;
+    eve::uint64 bytes_delivered;
+  };
+
+  class endpoint : public stream, private uncopyable
+  {
+  public:
+    eve::size send(const char* data, eve::size size) override;
+    eve::size receive(char* buffer, eve::size size) override;
+    bool try_send(const char* data, eve::size& size) override;
+    bool try_receive(char* buffer, eve::size& size) override;
+
+    /** Sends the datagram @p data, that may be lost, reordered or dropped if the queue is full. */
+    void send_datagram(const char* data, eve::size size);
+
+    /** Tries to receive a datagram. Exceeding bytes are discarded.
+        @param size Input: the capacity of @p buffer.
+                    Output: after call, if true returned, contains the number of bytes received.
+        @returns true if a datagram was received, false if none has arrived yet. */
+    bool try_receive_datagram(char* buffer, eve::size& size);
+
+    /** Closes this end: the other one receives 0 bytes once everything sent before arrived. */
+    void close();
+
+    /** @returns the statistics of what this endpoint sent. */
+    stats statistics() const;
+
+  private:
+    friend class sim_link;
+    endpoint() { }
+
+    sim_link* m_link;
+    eve::size m_index;
+  };
+
+  /** Constructs a link with the @p configuration in both directions. Random draws use @p seed,
+      and the time is read from @p time_source, or from a stopwatch started now if none is passed. */
+  sim_link(const config& configuration = config(), unsigned seed = 0, clock time_source = clock());
+
+  /** Changes the conditions for what is sent from now on, e.g. to simulate a degradation. */
+  void configure(const config& configuration);
+
+  /** @returns the endpoint @p index, 0 or 1. What one sends the other receives. */
+  endpoint& at(eve::size index) { return m_endpoints[index]; }
+
+  /** @returns the time when the next piece of data in flight arrives, -1 if none. */
+  double next_arrival() const;
+
+private:
+  struct flight
+  {
+    double arrival;
+    eve::uint64 order;
+    bool datagram;
+    std::vector<char> data;
+  };
+
+  struct direction
+  {
+    // what is in flight, sorted by arrival
+    std::deque<flight> flying;
+    double busy_until;
+    double last_stream_arrival;
+
+    // what arrived
+    std::deque<char> bytes;
+    std::deque<std::vector<char>> datagrams;
+
+    bool closed;
+    stats counters;
+  };
+
+  double sample_delay();
+  eve::size queue_room(const direction& d, double now) const;
+  void transmit(direction& d, const char* data, eve::size size, bool datagram, bool lost, double now);
+  void deliver(direction& d, double now);
+  void wait(std::unique_lock<std::mutex>& lock, double until, double now);
+
+  config m_config;
+  clock m_clock;
+  bool m_manual;
+  std::mt19937 m_random;
+  eve::uint64 m_order;
+  direction m_directions[2];
+  endpoint m_endpoints[2];
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_changed;
+};
+
+} // net
+} // eve
+
+/** }@ */
@@ -29,7 +29,9 @@
 
 #include "eve/storage.h"
 #include "eve/exceptions.h"
+#include "eve/net/stream.h"
 #include <string>
+#include <vector>
 
 /** \addtogroup Net
   * @{
@@ -37,6 +39,8 @@
 
 namespace eve {
 
+namespace net { class packet_ring; }
+
 /** Error potentially thrown by any eve::socket method. */
 class socket_error : public eve::system_error
 {
@@ -49,7 +53,7 @@ public:
 
 /** This class provides a thin platform-independent abstraction layer over system sockets
     used for networking. */
-class socket : private uncopyable
+class socket : public net::stream, private uncopyable
 {
 public:
   enum class type : uint8
@@ -88,17 +92,38 @@ public:
     /** Sets this address to any address and port @p port. */
     void set(int port, domain domain = domain::IPv4);
     
-    /** Sets this address to hostname @p hostname and port @p port. */
+    /** Sets this address to hostname @p hostname and port @p port.
+        @note It blocks while resolving the hostname, see net::resolver for resolving it
+              asynchronously. Throws a socket_error if no address of @p domain is found. */
     void set(const std::string& hostname, int port, domain domain = domain::IPv4);
     
+    /** @returns the port of this address. */
+    int port() const;
+
+    /** @returns whether this is an IPv4 or an IPv6 address. */
+    domain family() const { return m_domain; }
+
+    /** @returns the numeric host of this address, e.g. "127.0.0.1" or "::1". */
+    std::string host() const;
+
+    /** Blocks while resolving @p hostname, returning its addresses of any family with port @p port.
+        It is thread-safe.
+        @note Throws a socket_error if the hostname cannot be resolved. */
+    static std::vector<address> resolve(const std::string& hostname, int port);
+
     address& operator=(const address& rhs);
+    bool operator==(const address& rhs) const;
+    bool operator!=(const address& rhs) const { return !(*this == rhs); }
 
   private:
     void initialize(domain domain);
+    void update_domain();
+    eve::size native_size() const;
 
     domain m_domain;
-    fixed_storage<16> m_pimpl;
+    fixed_storage<28> m_pimpl;
     friend class socket;
+    friend class net::packet_ring;
   };
 
 public:
@@ -123,6 +148,14 @@ public:
       @note On error or timeout it throws a socket_error. */
   void listen(eve::uint32 port, eve::size backlog);
 
+  /** Binds this socket to any address and port @p port so that datagrams can be received at it.
+      Pass 0 to let the system pick a free port, then query it with local_address().
+      @note On error it throws a socket_error. */
+  void bind(eve::uint32 port);
+
+  /** @returns the address this socket is bound to. */
+  address local_address() const;
+
   /** Blocks until a new socket connects.
       @note On error or timeout it throws a socket_error. */
   socket accept();
@@ -136,20 +169,20 @@ public:
       @param size the size in bytes of the data to be sent.
       @returns the actual number of bytes sent that could be < @p size.
       @note On error or timeout it throws a socket_error. */
-  eve::size send(const char* data, eve::size size);
+  eve::size send(const char* data, eve::size size) override;
 
   /** Blocks until all of @p data has been sent.
       @param data buffer of bytes containing the data to be sent.
       @param size the size in bytes of the data to be sent.
       @note On error or timeout it throws a socket_error. */
-  void send_all(const char* data, eve::size size);
+  void send_all(const char* data, eve::size size) override;
 
   /** Blocks until some data has been received.
       @param buffer target buffer that will hold received data.
       @param size the size in bytes of the data to be received.
       @returns the actual number of bytes received that could be < @p size.
       @note On error or timeout it throws a socket_error. */
-  eve::size receive(char* buffer, eve::size size);
+  eve::size receive(char* buffer, eve::size size) override;
 
   /** Blocks until all data has been received.
       @param buffer target buffer that will hold received data.
@@ -157,6 +190,28 @@ public:
       @note On error or timeout it throws a socket_error. */
   void receive_all(char* buffer, eve::size size);
   
+  /** Blocks until the datagram @p data has been sent to @p to.
+      @returns the number of bytes sent, datagrams are never sent partially.
+      @note On error it throws a socket_error. */
+  eve::size send_to(const char* data, eve::size size, const address& to);
+
+  /** Blocks until a datagram has been received.
+      @param buffer target buffer that will hold the datagram. Exceeding bytes are discarded.
+      @param from will be set to the address of the sender.
+      @returns the number of bytes received.
+      @note On error it throws a socket_error. */
+  eve::size receive_from(char* buffer, eve::size size, address& from);
+
+  /** Blocks until some of the bytes referenced by @p chunks have been sent, in order, by a single
+      gathering system call.
+      @returns the total number of bytes sent, that could be less than the sum of the chunks.
+      @note On error or timeout it throws a socket_error. */
+  eve::size send(const chunk* chunks, eve::size count);
+
+  /** Blocks until all the bytes referenced by @p chunks have been sent.
+      @note On error or timeout it throws a socket_error. */
+  void send_all(const chunk* chunks, eve::size count) override;
+
   /** Tries to accept a connection without blocking the thread.
       @param client will be set to the connected peer. Valid only if return true.
       @returns true if some peer actually connected, false if operation would block.
@@ -164,9 +219,10 @@ public:
   bool try_accept(socket& client);
 
   /** Tries to connect to target @p address.
-      @returns true if connection was performed, false if operation would block.
+      @returns true if connection was performed, false if operation would block. In the latter
+               case the connection completes in the background: call again until it returns true.
       @note On error or timeout it throws a socket_error. */
-  void try_connect(const address& address);
+  bool try_connect(const address& address);
   
   /** Tries to send some @p data without blocking.
       @param data buffer of bytes containing the data to be sent.
@@ -174,7 +230,7 @@ public:
                   Output: after call, if true returned, contains the number of bytes sent.
       @returns true if some data has been sent, false if operation would block.
       @note On error or timeout it throws a socket_error. */
-  bool try_send(const char* data, eve::size& size);
+  bool try_send(const char* data, eve::size& size) override;
 
   /** Tries to receive some data.
       @param buffer target buffer that will hold received data.
@@ -182,11 +238,53 @@ public:
                   Output: after call, if true returned, contains the number of bytes received.
       @returns true if some data was received, false if no data was waiting to be received.
       @note On error or timeout it throws a socket_error. */
-  bool try_receive(char* buffer, eve::size& size);
+  bool try_receive(char* buffer, eve::size& size) override;
+
+  /** Tries to send some of the bytes referenced by @p chunks without blocking.
+      @param size after call, if true returned, contains the total number of bytes sent.
+      @returns true if some data has been sent, false if operation would block.
+      @note On error it throws a socket_error. */
+  bool try_send(const chunk* chunks, eve::size count, eve::size& size);
+
+  /** Tries to send the datagram @p data to @p to without blocking.
+      @param size Input: the size in bytes of the datagram.
+                  Output: after call, if true returned, contains the number of bytes sent.
+      @returns true if the datagram has been sent, false if operation would block.
+      @note On error it throws a socket_error. */
+  bool try_send_to(const char* data, eve::size& size, const address& to);
+
+  /** Tries to receive a datagram without blocking.
+      @param size Input: the capacity of @p buffer.
+                  Output: after call, if true returned, contains the number of bytes received.
+      @param from will be set to the address of the sender if true returned.
+      @returns true if a datagram was received, false if none was waiting.
+      @note On error it throws a socket_error. */
+  bool try_receive_from(char* buffer, eve::size& size, address& from);
+
+  /** While corked a stream socket only sends full segments, so that many small writes leave as few
+      packets. Uncorking sends whatever is left right away.
+      @note Where TCP_CORK is not available this toggles Nagle's algorithm instead. */
+  void cork(bool corked) override;
+
+  /** Lets several sockets listen on the same port (SO_REUSEPORT), the system spreading incoming
+      connections among them. Must be called before listen().
+      @returns false if the platform does not support it. */
+  bool reuse_port(bool enabled);
+
+  /** Disables (true) or enables (false) Nagle's algorithm, i.e. whether small writes are sent
+      without waiting for outstanding acknowledgements. */
+  void nodelay(bool enabled);
 
   /** Shuts down the eventual connection if socket is connected.
       @note after calling this the socket will be in 'closed' state. */
   void shutdown();
+
+  /** Shuts down and releases the system socket.
+      @note after calling this the socket will be in 'invalid' state and can be created again. */
+  void close();
+
+  /** @returns the underlying system handle (a SOCKET on Windows, a file descriptor elsewhere). */
+  eve::uintptr native_handle() const;
   
   //// Operator overloads
   socket& operator=(socket&& rhs);
@@ -196,8 +294,12 @@ private:
   bool do_accept(socket& client, bool block);
   bool do_send(const char* data, eve::size& size, bool block);
   bool do_receive(char* buffer, eve::size& size, bool block);
+  bool do_send_gather(const chunk* chunks, eve::size count, eve::size& size, bool block);
+  bool do_send_to(const char* data, eve::size& size, const address& to, bool block);
+  bool do_receive_from(char* buffer, eve::size& size, address& from, bool block);
   bool check_result(int result, bool block, const std::string& errormsg);
   void make_blocking(bool blocking);
+  void set_option(int level, int option, int value);
   
   type m_type;
   state_ m_state;
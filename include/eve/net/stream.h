@@ -0,0 +1,88 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "eve/platform.h"
+
+/** \addtogroup Net
+  * @{
+  */
+
+namespace eve { 
+namespace net {
+
+/** A reliable, ordered byte stream between two connected ends. net::buffer works over any of
+    them, e.g. an eve::socket or a net::shm_channel. */
+class stream
+{
+public:
+  /** A view over caller-owned bytes, for sending several buffers at once. */
+  struct chunk
+  {
+    const char* data;
+    eve::size size;
+  };
+
+  virtual ~stream() { }
+
+  /** Blocks until some of @p data has been sent.
+      @returns the actual number of bytes sent that could be < @p size. */
+  virtual eve::size send(const char* data, eve::size size) = 0;
+
+  /** Blocks until all of @p data has been sent. */
+  virtual void send_all(const char* data, eve::size size);
+
+  /** Blocks until all the bytes referenced by @p chunks have been sent, in order. */
+  virtual void send_all(const chunk* chunks, eve::size count);
+
+  /** Blocks until some data has been received.
+      @returns the actual number of bytes received, 0 meaning the other end closed the stream. */
+  virtual eve::size receive(char* buffer, eve::size size) = 0;
+
+  /** Tries to send some @p data without blocking.
+      @param size Input: the size in bytes of the data to be sent.
+                  Output: after call, if true returned, contains the number of bytes sent.
+      @returns true if some data has been sent, false if operation would block. */
+  virtual bool try_send(const char* data, eve::size& size) = 0;
+
+  /** Tries to receive some data without blocking.
+      @param size Input: the capacity of @p buffer.
+                  Output: after call, if true returned, contains the number of bytes received,
+                  0 meaning the other end closed the stream.
+      @returns true if some data was received, false if none was waiting. */
+  virtual bool try_receive(char* buffer, eve::size& size) = 0;
+
+  /** While corked small writes may be held back and coalesced until uncorked. Does nothing by
+      default. */
+  virtual void cork(bool /*corked*/) { }
+};
+
+} // net
+} // eve
+
+/** }@ */
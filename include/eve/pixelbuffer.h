@@ -53,13 +53,21 @@ public:
   uint16 bits_per_channel() const { return m_bits_per_channel; }
   uint16 bits_per_pixel() const { return m_bits_per_pixel; }
 
+  /** Loads either a PNG image or the raw pixels cooked from one. */
   void load(std::istream& source) override;
   void unload();
 
+protected:
+  /** Decodes the PNG @p source into raw pixels. */
+  bool cook(std::istream& source, std::ostream& output) override;
+
 private:
   void on_reload() override;
   bool validatePNG(std::istream& source);
   bool loadPNG(std::istream& source);
+  void load_raw(std::istream& source);
+  void save_raw(std::ostream& output) const;
+  eve::size data_size() const { return m_size.x * m_size.y * m_bits_per_pixel / 8; }
 
   char* m_data;
   vec2u m_size;
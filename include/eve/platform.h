@@ -56,6 +56,20 @@
 #endif
 
 
+//// Instruction sets ////
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#  define EVE_X86
+#endif
+
+/** Lets a function use the instructions of @p _isa (e.g. "avx2") whatever the compiler flags.
+    Only call it after checking eve::cpu::supports(). */
+#ifdef _MSC_VER
+#  define eve_target(_isa)
+#else
+#  define eve_target(_isa) __attribute__((target(_isa)))
+#endif
+
+
 //// Forced inlining ////
 #if (defined(_MSC_VER))
 #  define eve_inline __forceinline
@@ -106,6 +120,111 @@ size arithmetic_type_size(arithmetic_type type);
 /** Returns a unique unsigned integer value each time it is called. */
 size unique_id();
 
+//// CPU features
+
+namespace cpu {
+
+/** Instruction set extensions, combined as a bit mask. */
+enum feature : uint32
+{
+  sse2     = 1 << 0,
+  sse3     = 1 << 1,
+  ssse3    = 1 << 2,
+  sse41    = 1 << 3,
+  sse42    = 1 << 4,
+  popcnt   = 1 << 5,
+  avx      = 1 << 6,
+  avx2     = 1 << 7,
+  fma      = 1 << 8,
+  bmi2     = 1 << 9,
+  avx512f  = 1 << 10,
+  avx512bw = 1 << 11,
+};
+
+/** @returns the features of the CPU, detected once by initialize_platform(). No feature is
+    reported before that. */
+uint32 features();
+
+/** @returns true if the CPU has all the @p required features. */
+inline bool supports(uint32 required) { return (features() & required) == required; }
+
+/** Hides the detected features missing from @p mask and rebinds every dispatcher, so that tests
+    can run each kernel variant. limit(~0u) shows all the detected features again. */
+void limit(uint32 mask);
+
+/** A kernel implementation and the features it needs. */
+template <class Fn>
+struct variant
+{
+  uint32 features;
+  Fn kernel;
+  const char* name;
+};
+
+/** Keeps the list of dispatchers that features changes rebind. */
+class dispatcher_base
+{
+public:
+  /** Rebinds every dispatcher to the current features. */
+  static void rebind_all();
+
+  virtual void bind() = 0;
+
+protected:
+  dispatcher_base();
+  ~dispatcher_base();
+
+private:
+  dispatcher_base(const dispatcher_base&);
+  dispatcher_base& operator=(const dispatcher_base&);
+
+  dispatcher_base* m_next;
+};
+
+/** Binds a function pointer to the fastest kernel variant the CPU supports.
+  *
+  * Variants are listed from the most generic, which must need no feature, to the fastest.
+  * Until initialize_platform() detects the features, the generic variant is used.
+  * @code
+  * static const eve::cpu::variant<sum_fn> k_sum[] = {
+  *   { 0, sum_scalar, "scalar" },
+  *   { eve::cpu::avx2, sum_avx2, "avx2" } };
+  * static eve::cpu::dispatcher<sum_fn> s_sum(k_sum);
+  * s_sum.kernel()(data, size);
+  * @endcode */
+template <class Fn>
+class dispatcher : public dispatcher_base
+{
+public:
+  template <eve::size N>
+  dispatcher(const variant<Fn> (&variants)[N])
+    : m_variants(variants), m_count(N), m_current(variants)
+  {
+    bind();
+  }
+
+  /** @returns the bound kernel. */
+  Fn kernel() const { return m_current->kernel; }
+
+  /** @returns the name of the bound kernel. */
+  const char* name() const { return m_current->name; }
+
+  void bind() override
+  {
+    m_current = m_variants;
+    for (eve::size i = 1; i < m_count; ++i)
+      if (supports(m_variants[i].features))
+        m_current = m_variants + i;
+  }
+
+private:
+  const variant<Fn>* m_variants;
+  eve::size m_count;
+  const variant<Fn>* m_current;
+};
+
+} // cpu
+
 } // eve
 
 /** }@ */
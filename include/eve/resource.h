@@ -29,8 +29,10 @@
 
 #include "memory.h"
 #include "serialization.h"
+#include "uncopyable.h"
 #include <vector>
 #include <fstream>
+#include <functional>
 
 /** \addtogroup Lib
   * @{
@@ -56,6 +58,11 @@ public:
   * only data. The resource class is an abstract class that is supposed to be
   * extended by concrete resources.
   *
+  * Loading is split in two steps: load() reads and parses the source and may run on a loader
+  * thread, finalize() does what must happen on the main thread, e.g. creating GL objects. A
+  * synchronous load runs both at once; ptr::load_async() leaves finalize() to
+  * finalize_pending(), which eve::game calls every frame.
+  *
   * TODO resource::get
   * TODO resource::ptr
   * TODO resource::host
@@ -84,10 +91,34 @@ public:
     ~ptr();
     
     void load(const std::string& path);
+
+    /** Starts loading @p path on a loader thread and returns at once. The pointer refers to the
+        resource right away, but it can be used only once ready().
+        @param callback is called on the main thread once the resource is ready, see on_ready(). */
+    void load_async(const std::string& path, std::function<void(const T&)> callback = nullptr);
+
+    /** @returns true once the resource is loaded and finalized, whether it succeeded or not. Loads
+        still pending when the resources are terminated are cancelled, they end up ready but not
+        valid and their callbacks are called. */
+    bool ready() const { return m_resource && resource::is_ready(m_resource); }
+
+    /** Blocks until the resource is ready, finalizing it and what it depends on right away.
+        Must be called from the main thread. */
+    void wait() const { if (m_resource) resource::finish(m_resource); }
+
+    /** Calls @p callback on the main thread once the resource is ready, at once if it already is.
+        The callback is kept by the resource, not by this pointer. Does nothing if this pointer
+        refers to no resource. */
+    void on_ready(std::function<void(const T&)> callback) const;
+
     void force_reload() { m_resource->reload(); }
     void reset() { reset(nullptr); }
 
     const resource_host* host() const { return m_host; }
+
+    /** @returns the path this pointer was deserialized from, relative to its host. */
+    const std::string& source() const { return m_source; }
+
     const T* get() const { return m_resource; }
     operator bool() const { return m_resource != nullptr; }
     operator const T*() const { return m_resource; }
@@ -101,6 +132,11 @@ public:
     resource_host* m_host;
     T* m_resource;
     helper<T, Param> m_helper;
+    std::string m_source;
+
+    template <class> friend class eve::text_serializer;
+    template <class> friend class eve::binary_serializer;
+    template <class> friend class eve::json_serializer;
   };
 
   class source
@@ -117,24 +153,114 @@ public:
   };
 
 public:
+  /** How use_cache() decides that an artifact still matches its source. */
+  enum class cache_check
+  {
+    trust,   // the manifest is trusted, e.g. in shipping builds where sources never change
+    stamp,   // the source size and modification time are those recorded when it was cooked
+    content  // the source content hash is unchanged, which reads the whole source (development)
+  };
+
+  /** Makes resources prefer the cooked artifacts in @p directory (see eve::cooker) over their
+      source files. An artifact is used only while its source passes @p check. */
+  static void use_cache(const std::string& directory, cache_check check = cache_check::stamp);
+
+  /** @returns true while this thread cooks resources. Resource pointers are then deserialized
+      without loading what they point to. */
+  static bool cooking() { return s_cooking; }
+
+  /** Sets the number of loader threads started by the first asynchronous load. By default there
+      is one per hardware thread but the main one. */
+  static void loader_threads(eve::size count);
+
+  /** Finalizes the resources loaded asynchronously, in the order they were loaded, until
+      @p budget seconds are spent. At least one is finalized if any is waiting.
+      @returns the number of resources finalized. */
+  static eve::size finalize_pending(double budget);
+
+  /** @returns the number of resources queued, being loaded or waiting to be finalized. */
+  static eve::size pending();
+
   resource();
   virtual ~resource();
 
+  /** @returns false if this resource failed to load. */
+  bool valid() const { return m_valid; }
+
   const std::string& path() const override { return m_path; }
   range<resource_host**> dependants() override;
   void reload();
 
 protected:
   virtual void load(std::istream& source) = 0;
+
+  /** Completes the loading on the main thread, after load() succeeded. Does nothing by
+      default. */
+  virtual void finalize();
+
   virtual void unload();
   virtual void on_reload() override = 0;
 
+  /** Converts @p source into a form that load() reads faster, e.g. binary instead of text.
+      The output must begin with write_cooked_header().
+      @returns false if this resource has no cooked form, which is the default. */
+  virtual bool cook(std::istream& source, std::ostream& output);
+
+  /** Marks @p output as a cooked artifact. */
+  static void write_cooked_header(std::ostream& output);
+
+  /** @returns true and skips the header if @p source is a cooked artifact, leaves @p source
+      untouched otherwise. */
+  static bool read_cooked_header(std::istream& source);
+
 private:
+  enum class status
+  {
+    queued,    // waiting for a loader thread
+    loading,   // load() running
+    loaded,    // waiting for finalize()
+    ready,
+    cancelled  // abandoned when the loader threads stopped, not valid
+  };
+
+  /** Marks this thread as cooking until destroyed, see cooking(). */
+  class cooking_scope : private uncopyable
+  {
+  public:
+    cooking_scope() : m_previous(s_cooking) { s_cooking = true; }
+    ~cooking_scope() { s_cooking = m_previous; }
+
+  private:
+    bool m_previous;
+  };
+
   /** \return the resource at @p path if alredy loaded, nullptr otherwise. */
   static resource* find(const std::string& path);
 
-  /** Loads @p res, a just created instance, and inserts it in the resource library. */
-  static resource* process_new(eve::unique_ptr<resource>::type res);
+  /** @returns the resource at @p path with one more reference, made dependant of @p host. If it
+      is not in the resource library it is created by @p create, inserted and loaded, on a loader
+      thread if @p async. A synchronous load waits for the resource to be ready. */
+  static resource* acquire(const std::string& path, const std::function<resource*()>& create, bool async, resource_host* host);
+
+  /** Adds a reference to @p res, made dependant of @p host. */
+  static void retain(resource* res, resource_host* host);
+
+  /** Removes a reference to @p res and its dependant @p host, disposing it on the last. */
+  static void release(resource* res, resource_host* host);
+
+  /** Opens the source of @p res and loads it. */
+  static void load_source(resource* res);
+
+  /** Finalizes @p res and calls its callbacks, on the main thread. */
+  static void finalize_loaded(resource* res);
+
+  /** Waits for @p res to be ready, or only loaded on a loader thread. */
+  static void finish(resource* res);
+
+  static bool is_ready(const resource* res);
+  static void when_ready(resource* res, std::function<void()> callback);
+  static void run_loader();
+  static void stop_loaders();
 
   /** @p resource is no longer needed (no references to it). Dispose it. */
   static void dispose(resource* resource);
@@ -147,10 +273,17 @@ private:
 
   eve::size m_references;
   bool m_valid;
+  status m_status;
+  bool m_loader_reference;
   std::string m_path;
   std::vector<resource_host*> m_dependants;
+  std::vector<std::function<void()>> m_callbacks;
+
+  static eve_thread_local bool s_cooking;
 
   template <class, class> friend class ptr;
+  friend class cooker;
+  friend void terminate_resources();
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -159,8 +292,12 @@ template <class T>
 class deserializable_resource : public resource
 {
 public:
+  /** Deserializes this resource from either its text source or its cooked binary form. */
   void load(std::istream& source) override;
   void on_reload() override;
+
+protected:
+  bool cook(std::istream& source, std::ostream& output) override;
 };
 
 } // eve
@@ -28,7 +28,15 @@
 #pragma once
 
 #include "platform.h"
+#include "binary.h"
+#include "range.h"
+#include "uncopyable.h"
+#include <functional>
+#include <memory>
 #include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
 #include <stdexcept>
 
 /** \addtogroup Lib
@@ -51,14 +59,18 @@
       m_fields = eve::range<const eve::detail::field*>(s_fields, s_fields + sizeof(s_fields) / sizeof(eve::detail::field));\
     }\
   };\
-  template<typename, bool, bool> friend struct eve::detail::text_serializer_helper;
+  template<typename, bool, bool> friend struct eve::detail::text_serializer_helper;\
+  template<typename, bool, bool> friend struct eve::detail::binary_serializer_helper;\
+  template<typename, bool, bool> friend struct eve::detail::json_serializer_helper;
 
 #define eve_declare_serializable\
   struct serialization_info : public eve::detail::serialization_info_base\
   {\
     serialization_info();\
   };\
-  template<typename, bool, bool> friend struct eve::detail::text_serializer_helper;
+  template<typename, bool, bool> friend struct eve::detail::text_serializer_helper;\
+  template<typename, bool, bool> friend struct eve::detail::binary_serializer_helper;\
+  template<typename, bool, bool> friend struct eve::detail::json_serializer_helper;
 
 #define eve_define_serializable(Class, ...)\
   Class :: serialization_info::serialization_info() : eve::detail::serialization_info_base(#Class)\
@@ -72,9 +84,18 @@
   };
 
 
-  #define __eve_field_named(f, n) eve::detail::field(n, & serialized_class :: f),
-  #define _eve_field_named(pair) __eve_field_named pair
+  #define __eve_field_named_2(f, n) eve::detail::field(n, & serialized_class :: f),
+  #define __eve_field_named_3(f, n, id) eve::detail::field(n, & serialized_class :: f, id),
+#ifdef _MSC_VER
+  #define _eve_field_named(tuple) _eve_pp_call(eve_pp_superpaste(__eve_field_named_, eve_pp_nargs tuple), tuple)
+#else
+  #define _eve_field_named(tuple) eve_pp_superpaste(__eve_field_named_, eve_pp_nargs tuple) tuple
+#endif
 
+/** Like eve_serializable but each field is a (member, "name") pair or a (member, "name", id)
+  * triple. The id is the stable tag the binary format uses to identify the field, it must be
+  * unique within the class and never be reused once a field is removed. Fields without an
+  * explicit id are tagged with their position (starting at 1). */
 #define eve_serializable_named(Class, ...)\
   struct serialization_info : public eve::detail::serialization_info_base\
   {\
@@ -182,6 +203,158 @@ private:
   char m_currchar;
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Utility class used for JSON deserialization. The whole source is loaded in memory and indexed
+  * once (the position of every structural character, string and scalar is recorded), values are
+  * then walked through the index and strings are returned as ranges into the source buffer. */
+class json_reader
+{
+public:
+  typedef range<const char*> string_range;
+
+  json_reader(std::istream* source, const std::string& file);
+  const std::string& filename() const { return m_file; }
+
+  /** @returns the line of the current token (computed on request, meant for diagnostics). */
+  eve::size line() const;
+
+  /** @returns the column of the current token (computed on request, meant for diagnostics). */
+  eve::size column() const;
+
+  /** @returns the first character of the current token or 0 at the end of the source. */
+  char peek() const { return m_cursor < m_index.size() ? m_source[m_index[m_cursor]] : 0; }
+  bool accept(char c);
+  void expect(char c);
+
+  /** Reads a string. The returned range points into the source when the string has no escape
+      sequences, otherwise into a scratch buffer valid until the next call to string(). */
+  string_range string();
+  double number();
+  bool boolean();
+
+  /** @returns true and moves to the next token if the current one is 'null'. */
+  bool accept_null();
+
+  /** Skips the current value, whatever its type. Shared instances defined in it are noted, see
+      skipped_shared(). */
+  void skip();
+
+  /** @returns the position of the value of the shared instance @p id if its definition was
+      skipped, 0 otherwise. */
+  eve::size skipped_shared(eve::uint32 id) const;
+
+  /** @returns the position of the current token, to seek() back to it later. */
+  eve::size position() const { return m_cursor; }
+  void seek(eve::size position) { m_cursor = position; }
+
+  void error(const std::string& diagnostic) const;
+
+private:
+  void index();
+
+  /** @returns the value of the 4 hexadecimal digits at @p p, before @p end. */
+  eve::uint32 read_hex4(const char* p, const char* end) const;
+
+  /** @returns true if the token at @p position starts with @p text. */
+  bool is_token(eve::size position, const char* text) const;
+
+  std::string m_source;
+  std::string m_file;
+  std::vector<eve::uint32> m_index;
+  eve::size m_cursor;
+  std::string m_scratch;
+  std::unordered_map<eve::uint32, eve::size> m_skipped_shared;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Tracks the identity of shared instances (see serialization/shared_ptr.h) during one
+  * serialization or deserialization, so that every shared instance is written once with an id and
+  * later occurrences are written as references to that id. Ids start at 1. Instances are told apart
+  * by address and type, so that a base and a derived pointer or a pointer to a first member are
+  * not mistaken for one another. */
+class identity_table : private uncopyable
+{
+public:
+  /** @returns the table of the serialization in progress on this thread.
+      @note it must be called within the lifetime of an identity_scope. */
+  static identity_table& current();
+
+  /** @returns the id of the instance of type @p type at @p ptr or 0 if it has not been written. */
+  eve::uint32 find(const void* ptr, const std::type_info& type) const;
+
+  /** Tracks the instance of type @p type at @p ptr being written and returns its new id. */
+  eve::uint32 insert(const void* ptr, const std::type_info& type);
+
+  /** @returns the instance read with id @p id or a null pointer if no such instance exists. */
+  std::shared_ptr<void> get(eve::uint32 id) const;
+
+  /** @returns the type of the instance read with id @p id or nullptr if no such instance exists. */
+  const std::type_info* type(eve::uint32 id) const;
+
+  /** Tracks @p instance of type @p type just read with id @p id. Ids are taken from the stream
+      rather than counted, as readers may skip fields holding shared instances.
+      @returns false if @p id is 0 or already used. */
+  bool insert(eve::uint32 id, const std::type_info& type, std::shared_ptr<void> instance);
+
+  /** Binary streams write shared instances after the root value rather than where they occur, so
+      that readers skipping a field never skip the only definition of an instance. @p write
+      writes the instance @p id, it is called by write_shared(). */
+  void defer(eve::uint32 id, std::function<void(binarywriter&)> write);
+
+  /** @p read reads the instance @p id, it is called by read_shared(). */
+  void defer(eve::uint32 id, std::function<void(binaryreader&)> read);
+
+  /** Writes the deferred instances, including those they refer to, each as (id, length,
+      payload), then a 0 id. */
+  void write_shared(binarywriter& writer);
+
+  /** Reads what write_shared() wrote and the deferred instances from it. Instances the reader
+      never referred to are skipped.
+      @note Throws a std::runtime_error if a referred instance is missing. */
+  void read_shared(binaryreader& reader);
+
+private:
+  typedef std::pair<const void*, std::type_index> written_key;
+
+  struct written_hash
+  {
+    std::size_t operator()(const written_key& key) const
+    {
+      return std::hash<const void*>()(key.first) ^ key.second.hash_code();
+    }
+  };
+
+  struct read_entry
+  {
+    std::shared_ptr<void> instance;
+    const std::type_info* type;
+  };
+
+  std::unordered_map<written_key, eve::uint32, written_hash> m_written;
+  std::unordered_map<eve::uint32, read_entry> m_read;
+  std::vector<std::pair<eve::uint32, std::function<void(binarywriter&)>>> m_writes;
+  std::unordered_map<eve::uint32, std::function<void(binaryreader&)>> m_reads;
+};
+
+/** Makes a new identity_table current on this thread for its lifetime and restores the previous
+  * one afterwards. Every top level serialize_as_* and deserialize_as_* function opens one, so that
+  * files read while another is being read (e.g. the dependencies of a resource) have ids of
+  * their own. */
+class identity_scope : private uncopyable
+{
+public:
+  identity_scope();
+  ~identity_scope();
+
+  identity_table& table() { return *m_table; }
+
+private:
+  identity_table* m_table;
+  identity_table* m_previous;
+};
+
 } // eve::serialization
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -205,6 +378,45 @@ public:
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/** Serializes in binary format the instance @p value into the stream @p output.
+  * Classes are written as a schema version followed by a list of tag-length-value fields, so that
+  * readers with a different schema can skip unknown fields without parsing them. */
+template <typename T>
+void serialize_as_binary(const T& value, std::ostream& output);
+
+/** Deserializes @p input in the binary format into the instance @p value. */
+template <typename T>
+void deserialize_as_binary(std::istream& input, T& value);
+
+/** Serializes the instance @p value into the stream @p output as JSON. Classes become objects
+  * keyed by field name, enums are written by name and containers as arrays. */
+template <typename T>
+void serialize_as_json(const T& value, std::ostream& output);
+
+/** Deserializes the JSON @p input into the instance @p value. Unknown keys are skipped. */
+template <typename T>
+void deserialize_as_json(std::istream& input, T& value);
+
+/** Specialize this template class to make new types serializable as JSON. */
+template <class T>
+class json_serializer
+{
+public:
+  static void serialize(const T& instance, std::ostream& output, const std::string& tab);
+  static void deserialize(serialization::json_reader& reader, T& instance);
+};
+
+/** Specialize this template class to make new types serializable in binary format. */
+template <class T>
+class binary_serializer
+{
+public:
+  static void serialize(const T& instance, binarywriter& writer);
+  static void deserialize(binaryreader& reader, T& instance);
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /** Use this class to expose a new linear container type (like vector or list) to the serializer.
   * It requires the class to be iterable and have the "push_back" method (TODO fix this). */
 template <class T>
@@ -215,6 +427,24 @@ public:
   static void deserialize(serialization::parser& parser, T& instance);
 };
 
+/** JSON counterpart of text_linear_container_serializer. */
+template <class T>
+class json_linear_container_serializer
+{
+public:
+  static void serialize(const T& instance, std::ostream& output, const std::string& tab);
+  static void deserialize(serialization::json_reader& reader, T& instance);
+};
+
+/** Binary counterpart of text_linear_container_serializer. */
+template <class T>
+class binary_linear_container_serializer
+{
+public:
+  static void serialize(const T& instance, binarywriter& writer);
+  static void deserialize(binaryreader& reader, T& instance);
+};
+
 } // eve
 
 #include "serialization/detail.inl"
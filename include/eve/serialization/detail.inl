@@ -31,7 +31,13 @@
 #include "../type_traits.h"
 #include "../range.h"
 #include "../singleton.h"
+#include <atomic>
+#include <limits>
+#include <mutex>
 #include <ostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
 
 namespace eve {
 
@@ -43,6 +49,22 @@ public:
   static void deserialize(serialization::parser& parser, std::string& instance);
 };
 
+template <>
+class json_serializer<std::string>
+{
+public:
+  static void serialize(const std::string& instance, std::ostream& output, const std::string& tab);
+  static void deserialize(serialization::json_reader& reader, std::string& instance);
+};
+
+template <>
+class binary_serializer<std::string>
+{
+public:
+  static void serialize(const std::string& instance, binarywriter& writer);
+  static void deserialize(binaryreader& reader, std::string& instance);
+};
+
 template <typename T>
 void text_linear_container_serializer<T>::serialize(const T& instance, std::ostream& output, const std::string& tab)
 {
@@ -55,8 +77,8 @@ void text_linear_container_serializer<T>::serialize(const T& instance, std::ostr
   for (auto& element: instance)
   {
     if (!inlined) output << mtab;
-    text_serializer<std::remove_cv<typename T::value_type>::type>::serialize(element, output, mtab);
-    if (i < nelements - 1) output << ", ";
+    text_serializer<typename std::remove_cv<typename T::value_type>::type>::serialize(element, output, mtab);
+    if (++i < nelements) output << ", ";
     if (!inlined) output << std::endl;
   }
   if (!inlined) output << tab;
@@ -73,13 +95,70 @@ void text_linear_container_serializer<T>::deserialize(serialization::parser& par
     do
     {
       typename T::value_type element;
-      text_serializer<std::remove_cv<typename T::value_type>::type>::deserialize(parser, element);
+      text_serializer<typename std::remove_cv<typename T::value_type>::type>::deserialize(parser, element);
       instance.emplace_back(std::move(element));
     } while (parser.accept(','));
   }
   parser.expect(']');
 }
 
+template <typename T>
+void json_linear_container_serializer<T>::serialize(const T& instance, std::ostream& output, const std::string& tab)
+{
+  const bool inlined = std::is_arithmetic<typename T::value_type>::value;
+  output << "[";
+  if (!inlined) output << '\n';
+  std::string mtab = tab + "  ";
+  eve::size i = 0;
+  auto nelements = instance.size();
+  for (auto& element: instance)
+  {
+    if (!inlined) output << mtab;
+    json_serializer<typename std::remove_cv<typename T::value_type>::type>::serialize(element, output, mtab);
+    if (++i < nelements) output << ", ";
+    if (!inlined) output << '\n';
+  }
+  if (!inlined) output << tab;
+  output << "]";
+}
+
+template <typename T>
+void json_linear_container_serializer<T>::deserialize(serialization::json_reader& reader, T& instance)
+{
+  reader.expect('[');
+  if (!reader.accept(']'))
+  {
+    do
+    {
+      typename T::value_type element;
+      json_serializer<typename std::remove_cv<typename T::value_type>::type>::deserialize(reader, element);
+      instance.emplace_back(std::move(element));
+    } while (reader.accept(','));
+    reader.expect(']');
+  }
+}
+
+template <typename T>
+void binary_linear_container_serializer<T>::serialize(const T& instance, binarywriter& writer)
+{
+  writer << eve::uint32(instance.size());
+  for (auto& element: instance)
+    binary_serializer<typename std::remove_cv<typename T::value_type>::type>::serialize(element, writer);
+}
+
+template <typename T>
+void binary_linear_container_serializer<T>::deserialize(binaryreader& reader, T& instance)
+{
+  eve::uint32 nelements;
+  reader >> nelements;
+  for (eve::uint32 i = 0; i < nelements; ++i)
+  {
+    typename T::value_type element;
+    binary_serializer<typename std::remove_cv<typename T::value_type>::type>::deserialize(reader, element);
+    instance.emplace_back(std::move(element));
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 namespace detail {
@@ -87,13 +166,20 @@ namespace detail {
 class field
 {
 public:
+  /** @param id is the stable tag of this field in the binary format, 0 means that the field is
+      tagged by its position in the class field list. */
   template<typename T, class Q>
-  field(const std::string name, Q T::*member)
+  field(const std::string name, Q T::*member, eve::uint16 id = 0)
     : m_name(name)
+    , m_id(id)
   {
     static const calltable s_table = {
       &field::serialize_as_text<Q>,
-      &field::deserialize_as_text<Q>
+      &field::deserialize_as_text<Q>,
+      &field::serialize_as_binary<Q>,
+      &field::deserialize_as_binary<Q>,
+      &field::serialize_as_json<Q>,
+      &field::deserialize_as_json<Q>
     };
 
     m_offset = (size)&(((T*)nullptr)->*member); // offset of member in class
@@ -102,14 +188,25 @@ public:
 
   const std::string& name() const { return m_name; }
 
+  /** @returns the explicit id of this field or 0 if the field is tagged by position. */
+  eve::uint16 id() const { return m_id; }
+
   void serialize_as_text(const void* object, std::ostream& output, const std::string& tab) const;
   void deserialize_as_text(serialization::parser& parser, void* object) const;
+  void serialize_as_binary(const void* object, binarywriter& writer) const;
+  void deserialize_as_binary(binaryreader& reader, void* object) const;
+  void serialize_as_json(const void* object, std::ostream& output, const std::string& tab) const;
+  void deserialize_as_json(serialization::json_reader& reader, void* object) const;
 
 private:
   struct calltable
   {
     void (*serialize_as_text)(const void* ptr, std::ostream& output, const std::string&);
     void (*deserialize_as_text)(serialization::parser& parser, void* object);
+    void (*serialize_as_binary)(const void* ptr, binarywriter& writer);
+    void (*deserialize_as_binary)(binaryreader& reader, void* object);
+    void (*serialize_as_json)(const void* ptr, std::ostream& output, const std::string&);
+    void (*deserialize_as_json)(serialization::json_reader& reader, void* object);
   };
 
   template<class Q>
@@ -126,7 +223,36 @@ private:
     eve::text_serializer<Q>::deserialize(parser, instance);
   }
 
+  template<class Q>
+  static void serialize_as_binary(const void* ptr, binarywriter& writer)
+  {
+    auto& instance = *static_cast<const Q*>(ptr);
+    eve::binary_serializer<Q>::serialize(instance, writer);
+  }
+
+  template<class Q>
+  static void deserialize_as_binary(binaryreader& reader, void* ptr)
+  {
+    auto& instance = *static_cast<Q*>(ptr);
+    eve::binary_serializer<Q>::deserialize(reader, instance);
+  }
+
+  template<class Q>
+  static void serialize_as_json(const void* ptr, std::ostream& output, const std::string& tab)
+  {
+    auto& instance = *static_cast<const Q*>(ptr);
+    eve::json_serializer<Q>::serialize(instance, output, tab);
+  }
+
+  template<class Q>
+  static void deserialize_as_json(serialization::json_reader& reader, void* ptr)
+  {
+    auto& instance = *static_cast<Q*>(ptr);
+    eve::json_serializer<Q>::deserialize(reader, instance);
+  }
+
   std::string m_name;
+  eve::uint16 m_id;
   size m_offset;
   const calltable* m_table;
 };
@@ -139,18 +265,50 @@ struct serialization_info_base
 {
 public:
   typedef range<const detail::field*> fields_range;
-  serialization_info_base(const std::string& name) : m_name(name) { }
+
+  /** Maps the fields of a binary stream written with some schema version to the fields of this
+      class, in stream order. A null entry means the field is unknown and must be skipped. */
+  struct read_plan
+  {
+    std::vector<eve::uint16> ids;
+    std::vector<const detail::field*> fields;
+  };
+
+  serialization_info_base(const std::string& name) : m_name(name), m_version(0) { }
   const std::string& name() const { return m_name; }
   const fields_range& fields() const { return m_fields; }
   eve::size num_fields() const { return eve::size(m_fields.end() - m_fields.begin()); }
   const detail::field* field(const std::string& name) const;
   const detail::field* field(eve::size index) const;
 
+  /** @returns the field named as the @p length characters at @p name or nullptr. */
+  const detail::field* field(const char* name, eve::size length) const;
+
+  /** @returns the field with binary tag @p id or nullptr if no such field exists. */
+  const detail::field* field_by_id(eve::uint16 id) const;
+
+  /** @returns the binary tag of the field at @p index. */
+  eve::uint16 field_id(eve::size index) const;
+
+  /** @returns a fingerprint of the field tags of this class. Two classes with the same tags in the
+      same order share the schema version. */
+  eve::uint32 schema_version() const;
+
+  /** @returns the read plan for streams written with schema @p version, or nullptr if none was
+      published yet. A published plan is never modified, it may be read from any thread. */
+  const read_plan* plan(eve::uint32 version) const;
+
+  /** Publishes @p plan, complete, for schema @p version unless another thread already did. */
+  void publish_plan(eve::uint32 version, read_plan plan) const;
+
 protected:
   fields_range m_fields;
 
 private:
   std::string m_name;
+  mutable std::atomic<eve::uint32> m_version;
+  mutable std::mutex m_plans_mutex;
+  mutable std::unordered_map<eve::uint32, read_plan> m_plans;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -161,6 +319,16 @@ void serialize_class_as_text(const serialization_info_base& info, const void* in
 void deserialize_class_as_text(const serialization_info_base& info, serialization::parser& parser,
                                              void* instance);
 
+void serialize_class_as_binary(const serialization_info_base& info, const void* instance, binarywriter& writer);
+
+void deserialize_class_as_binary(const serialization_info_base& info, binaryreader& reader, void* instance);
+
+void serialize_class_as_json(const serialization_info_base& info, const void* instance,
+                             std::ostream& output, const std::string& tab);
+
+void deserialize_class_as_json(const serialization_info_base& info, serialization::json_reader& reader,
+                               void* instance);
+
 template <typename T, bool IsArithmetic, bool IsEnum>
 struct text_serializer_helper
 {
@@ -168,13 +336,13 @@ struct text_serializer_helper
   static void serialize(const T& instance, std::ostream& output, const std::string& tab)
   {
     serialize_class_as_text(
-      eve::singleton<T::serialization_info>::ref(), &instance, output, tab);
+      eve::singleton<typename T::serialization_info>::ref(), &instance, output, tab);
   }
 
   static void deserialize(serialization::parser& parser, T& instance)
   {
     deserialize_class_as_text(
-      eve::singleton<T::serialization_info>::ref(), parser, &instance);
+      eve::singleton<typename T::serialization_info>::ref(), parser, &instance);
   }
 };
 
@@ -215,6 +383,85 @@ struct text_serializer_helper<bool, true, false>
   }
 };
 
+template <typename T, bool IsArithmetic, bool IsEnum>
+struct binary_serializer_helper
+{
+  static_assert(has_serialization_info<T>::value, "eve error: T is not serializable.");
+  static void serialize(const T& instance, binarywriter& writer)
+  {
+    serialize_class_as_binary(
+      eve::singleton<typename T::serialization_info>::ref(), &instance, writer);
+  }
+
+  static void deserialize(binaryreader& reader, T& instance)
+  {
+    deserialize_class_as_binary(
+      eve::singleton<typename T::serialization_info>::ref(), reader, &instance);
+  }
+};
+
+template <typename T>
+struct binary_serializer_helper<T, true, false>
+{
+  static void serialize(const T& instance, binarywriter& writer)
+  {
+    writer << instance;
+  }
+
+  static void deserialize(binaryreader& reader, T& instance)
+  {
+    reader >> instance;
+  }
+};
+
+template <typename T, bool IsArithmetic, bool IsEnum>
+struct json_serializer_helper
+{
+  static_assert(has_serialization_info<T>::value, "eve error: T is not serializable.");
+  static void serialize(const T& instance, std::ostream& output, const std::string& tab)
+  {
+    serialize_class_as_json(
+      eve::singleton<typename T::serialization_info>::ref(), &instance, output, tab);
+  }
+
+  static void deserialize(serialization::json_reader& reader, T& instance)
+  {
+    deserialize_class_as_json(
+      eve::singleton<typename T::serialization_info>::ref(), reader, &instance);
+  }
+};
+
+template <typename T>
+struct json_serializer_helper<T, true, false>
+{
+  static void serialize(const T& instance, std::ostream& output, const std::string&)
+  {
+    // enough digits for floating point values to round trip, unary + prints chars as numbers
+    auto precision = output.precision(std::numeric_limits<T>::max_digits10);
+    output << +instance;
+    output.precision(precision);
+  }
+
+  static void deserialize(serialization::json_reader& reader, T& instance)
+  {
+    instance = static_cast<T>(reader.number());
+  }
+};
+
+template <>
+struct json_serializer_helper<bool, true, false>
+{
+  static void serialize(const bool& instance, std::ostream& output, const std::string&)
+  {
+    output << (instance ? "true" : "false");
+  }
+
+  static void deserialize(serialization::json_reader& reader, bool& instance)
+  {
+    instance = reader.boolean();
+  }
+};
+
 // ENUM SERIALIZATION //////////////////////////////////////////////////////////////////////////////
 
 struct enum_value
@@ -228,6 +475,7 @@ struct enum_info;
 
 void serialize_enum_as_text(const char*  name, eve::uint32 instance, const enum_value* values, std::ostream& output);
 unsigned deserialize_enum_as_text(const char* name, const enum_value* values, serialization::parser& parser);
+unsigned deserialize_enum_as_json(const char* name, const enum_value* values, serialization::json_reader& reader);
 
 template <typename T>
 struct text_serializer_helper<T, false, true>
@@ -243,6 +491,38 @@ struct text_serializer_helper<T, false, true>
   }
 };
 
+template <typename T>
+struct json_serializer_helper<T, false, true>
+{
+  static void serialize(const T& instance, std::ostream& output, const std::string& tab)
+  {
+    output << '"';
+    serialize_enum_as_text(enum_info<T>::name, unsigned(instance), enum_info<T>::values, output);
+    output << '"';
+  }
+
+  static void deserialize(serialization::json_reader& reader, T& instance)
+  {
+    instance = (T)deserialize_enum_as_json(enum_info<T>::name, enum_info<T>::values, reader);
+  }
+};
+
+template <typename T>
+struct binary_serializer_helper<T, false, true>
+{
+  static void serialize(const T& instance, binarywriter& writer)
+  {
+    writer << eve::uint32(instance);
+  }
+
+  static void deserialize(binaryreader& reader, T& instance)
+  {
+    eve::uint32 value;
+    reader >> value;
+    instance = (T)value;
+  }
+};
+
 } // detail
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -262,14 +542,73 @@ void text_serializer<T>::deserialize(serialization::parser& parser, T& instance)
 template <typename T>
 void serialize_as_text(const T& instance, std::ostream& output)
 {
+  eve::serialization::identity_scope scope;
   eve::text_serializer<T>::serialize(instance, output, "");
 }
 
 template <typename T>
 void deserialize_as_text(std::istream& input, T& value)
 {
+  eve::serialization::identity_scope scope;
   eve::serialization::parser parser(&input, "stream");
   eve::text_serializer<T>::deserialize(parser, value);
 }
 
+template <typename T>
+void binary_serializer<T>::serialize(const T& instance, binarywriter& writer)
+{
+  eve::detail::binary_serializer_helper<T, std::is_arithmetic<T>::value, std::is_enum<T>::value>::serialize(instance, writer);
+}
+
+template <typename T>
+void binary_serializer<T>::deserialize(binaryreader& reader, T& instance)
+{
+  eve::detail::binary_serializer_helper<T, std::is_arithmetic<T>::value, std::is_enum<T>::value>::deserialize(reader, instance);
+}
+
+template <typename T>
+void serialize_as_binary(const T& instance, std::ostream& output)
+{
+  eve::serialization::identity_scope scope;
+  eve::binarywriter writer(output.rdbuf());
+  eve::binary_serializer<T>::serialize(instance, writer);
+  scope.table().write_shared(writer);
+}
+
+template <typename T>
+void deserialize_as_binary(std::istream& input, T& value)
+{
+  eve::serialization::identity_scope scope;
+  eve::binaryreader reader(input.rdbuf());
+  eve::binary_serializer<T>::deserialize(reader, value);
+  scope.table().read_shared(reader);
+}
+
+template <typename T>
+void json_serializer<T>::serialize(const T& instance, std::ostream& output, const std::string& tab)
+{
+  eve::detail::json_serializer_helper<T, std::is_arithmetic<T>::value, std::is_enum<T>::value>::serialize(instance, output, tab);
+}
+
+template <typename T>
+void json_serializer<T>::deserialize(serialization::json_reader& reader, T& instance)
+{
+  eve::detail::json_serializer_helper<T, std::is_arithmetic<T>::value, std::is_enum<T>::value>::deserialize(reader, instance);
+}
+
+template <typename T>
+void serialize_as_json(const T& instance, std::ostream& output)
+{
+  eve::serialization::identity_scope scope;
+  eve::json_serializer<T>::serialize(instance, output, "");
+}
+
+template <typename T>
+void deserialize_as_json(std::istream& input, T& value)
+{
+  eve::serialization::identity_scope scope;
+  eve::serialization::json_reader reader(&input, "stream");
+  eve::json_serializer<T>::deserialize(reader, value);
+}
+
 } // eve
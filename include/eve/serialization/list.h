@@ -37,4 +37,14 @@ class text_serializer<std::list<T>> : public eve::text_linear_container_serializ
 {
 };
 
+template <class T>
+class binary_serializer<std::list<T>> : public eve::binary_linear_container_serializer<std::list<T>>
+{
+};
+
+template <class T>
+class json_serializer<std::list<T>> : public eve::json_linear_container_serializer<std::list<T>>
+{
+};
+
 } // eve
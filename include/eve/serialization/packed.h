@@ -0,0 +1,244 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+#pragma once
+
+#include "../serialization.h"
+#include <algorithm>
+#include <type_traits>
+
+namespace eve {
+
+template <typename> struct tvec2;
+template <typename> struct tvec3;
+
+namespace serialization {
+
+/** Tells whether arrays of T can be serialized as a packed block of bytes instead of element by
+  * element. Specialize this for trivially copyable aggregates (e.g. a vertex made of floats only)
+  * setting value to true and scalar to the type of their components. */
+template <typename T>
+struct packed_traits
+{
+  static const bool value = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value;
+  typedef T scalar;
+};
+
+template <typename T>
+struct packed_traits<tvec2<T>>
+{
+  static const bool value = packed_traits<T>::value;
+  typedef T scalar;
+};
+
+template <typename T>
+struct packed_traits<tvec3<T>>
+{
+  static const bool value = packed_traits<T>::value;
+  typedef T scalar;
+};
+
+/** Arrays with fewer elements than this are written in plain text as a list of values. */
+static const eve::size k_packed_text_threshold = 16;
+
+/** Writes @p size bytes from @p data to @p output as a base64 block. */
+void encode_base64(const void* data, eve::size size, std::ostream& output);
+
+/** Decodes the base64 block @p input into @p data that must have room for decoded_size() bytes.
+    @returns false if @p input is not valid base64. */
+bool decode_base64(const std::string& input, void* data);
+
+/** @returns the number of bytes base64 block @p input decodes to. */
+eve::size decoded_size(const std::string& input);
+
+/** Converts @p count little endian scalars of @p width bytes at @p data to native endianness
+    and vice versa. It does nothing on little endian platforms. */
+void swap_little_endian(void* data, eve::size count, eve::size width);
+
+} // serialization
+
+/** Serializes contiguous containers of packable elements (see serialization::packed_traits) as a
+  * single block of bytes. The binary form is the element count followed by the raw little endian
+  * bytes, the text form is either a plain list (small arrays) or a 'base64 "..."' block. */
+template <class T>
+class packed_array_serializer
+{
+public:
+  typedef typename T::value_type value_type;
+  typedef serialization::packed_traits<value_type> traits;
+
+  static void serialize(const T& instance, std::ostream& output, const std::string& tab)
+  {
+    if (instance.size() < serialization::k_packed_text_threshold && serialize_list(instance, output, tab, is_scalar()))
+      return;
+
+    output << "base64 \"";
+#ifdef EVE_BIG_ENDIAN
+    T copy(instance);
+    swap(copy);
+    serialization::encode_base64(copy.data(), bytes(copy), output);
+#else
+    serialization::encode_base64(instance.data(), bytes(instance), output);
+#endif
+    output << '"';
+  }
+
+  static void deserialize(serialization::parser& parser, T& instance)
+  {
+    if (parser.lookahead() != parser.SYMBOL || parser.token() != "base64")
+    {
+      deserialize_list(parser, instance, is_scalar());
+      return;
+    }
+
+    parser.scan();
+    parser.check(parser.STRING);
+    const std::string& block = parser.token();
+    auto size = serialization::decoded_size(block);
+    if (size % sizeof(value_type))
+      throw serialization_error(parser.filename(), parser.line(), parser.column(), "packed array size is not a multiple of the element size.");
+    instance.resize(size / sizeof(value_type));
+    if (size && !serialization::decode_base64(block, instance.data()))
+      throw serialization_error(parser.filename(), parser.line(), parser.column(), "invalid base64 block.");
+    swap(instance);
+    parser.scan();
+  }
+
+  static void serialize(const T& instance, binarywriter& writer)
+  {
+    writer << eve::uint32(instance.size());
+    writer.write_array(instance.data(), eve::size(instance.size()));
+  }
+
+  static void deserialize(binaryreader& reader, T& instance)
+  {
+    eve::uint32 nelements;
+    reader >> nelements;
+
+    // grown a chunk at a time, so that a corrupt count fails at the end of the stream rather
+    // than allocating it all at once
+    const eve::size chunk = std::max<eve::size>(eve::size(64 * 1024 / sizeof(value_type)), 1);
+    instance.clear();
+    for (eve::size read = 0; read < nelements; )
+    {
+      auto count = std::min<eve::size>(nelements - read, chunk);
+      instance.resize(read + count);
+      reader.read_array(instance.data() + read, count);
+      read += count;
+    }
+  }
+
+private:
+  /** Only plain arithmetic values have a list form, aggregates are always packed. */
+  typedef std::is_same<value_type, typename traits::scalar> is_scalar;
+
+  static bool serialize_list(const T& instance, std::ostream& output, const std::string& tab, std::true_type)
+  {
+    text_linear_container_serializer<T>::serialize(instance, output, tab);
+    return true;
+  }
+
+  static bool serialize_list(const T&, std::ostream&, const std::string&, std::false_type)
+  {
+    return false;
+  }
+
+  static void deserialize_list(serialization::parser& parser, T& instance, std::true_type)
+  {
+    text_linear_container_serializer<T>::deserialize(parser, instance);
+  }
+
+  static void deserialize_list(serialization::parser& parser, T&, std::false_type)
+  {
+    throw serialization_error(parser.filename(), parser.line(), parser.column(), "expected a base64 block.");
+  }
+
+  static eve::size bytes(const T& instance)
+  {
+    return eve::size(instance.size() * sizeof(value_type));
+  }
+
+  static void swap(T& instance)
+  {
+    serialization::swap_little_endian(instance.data(),
+      bytes(instance) / sizeof(typename traits::scalar), sizeof(typename traits::scalar));
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Vectors are written to JSON as arrays of their components. */
+template <class T>
+class json_serializer<tvec2<T>>
+{
+public:
+  static void serialize(const tvec2<T>& instance, std::ostream& output, const std::string& tab)
+  {
+    output << '[';
+    json_serializer<T>::serialize(instance.x, output, tab);
+    output << ", ";
+    json_serializer<T>::serialize(instance.y, output, tab);
+    output << ']';
+  }
+
+  static void deserialize(serialization::json_reader& reader, tvec2<T>& instance)
+  {
+    reader.expect('[');
+    json_serializer<T>::deserialize(reader, instance.x);
+    reader.expect(',');
+    json_serializer<T>::deserialize(reader, instance.y);
+    reader.expect(']');
+  }
+};
+
+template <class T>
+class json_serializer<tvec3<T>>
+{
+public:
+  static void serialize(const tvec3<T>& instance, std::ostream& output, const std::string& tab)
+  {
+    output << '[';
+    json_serializer<T>::serialize(instance.x, output, tab);
+    output << ", ";
+    json_serializer<T>::serialize(instance.y, output, tab);
+    output << ", ";
+    json_serializer<T>::serialize(instance.z, output, tab);
+    output << ']';
+  }
+
+  static void deserialize(serialization::json_reader& reader, tvec3<T>& instance)
+  {
+    reader.expect('[');
+    json_serializer<T>::deserialize(reader, instance.x);
+    reader.expect(',');
+    json_serializer<T>::deserialize(reader, instance.y);
+    reader.expect(',');
+    json_serializer<T>::deserialize(reader, instance.z);
+    reader.expect(']');
+  }
+};
+
+} // eve
@@ -0,0 +1,268 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+#pragma once
+
+#include "../serialization.h"
+#include "../memory.h"
+#include <cstring>
+#include <memory>
+#include <typeinfo>
+
+namespace eve {
+
+namespace serialization {
+
+/** @returns a new default constructed, shareable instance of T allocated on the global heap. */
+template <class T>
+std::shared_ptr<T> make_shared_instance()
+{
+  return std::shared_ptr<T>(eve_new T, eve::global_deleter<T>());
+}
+
+} // serialization
+
+/** Shared instances are tracked by identity: the first occurrence of an instance within one
+  * serialization is written in full together with an id, later occurrences are written as a
+  * reference to that id and are resolved back to the same instance on load. A reference to an
+  * instance read with another type is an error.
+  * Text form: 'shared <id> <value>', 'ref <id>' or 'null'. */
+template <class T>
+class text_serializer<std::shared_ptr<T>>
+{
+public:
+  typedef typename std::remove_cv<T>::type value_type;
+
+  static void serialize(const std::shared_ptr<T>& instance, std::ostream& output, const std::string& tab)
+  {
+    if (!instance)
+    {
+      output << "null";
+      return;
+    }
+
+    auto& table = serialization::identity_table::current();
+    if (auto id = table.find(instance.get(), typeid(value_type)))
+    {
+      output << "ref " << id;
+      return;
+    }
+
+    output << "shared " << table.insert(instance.get(), typeid(value_type)) << ' ';
+    text_serializer<value_type>::serialize(*instance, output, tab);
+  }
+
+  static void deserialize(serialization::parser& parser, std::shared_ptr<T>& instance)
+  {
+    parser.check(parser.SYMBOL);
+    if (parser.token() == "null")
+    {
+      parser.scan();
+      instance.reset();
+      return;
+    }
+
+    bool shared = parser.token() == "shared";
+    if (!shared && parser.token() != "ref")
+      throw serialization_error(parser.filename(), parser.line(), parser.column(), "expected 'shared', 'ref' or 'null'.");
+    parser.scan();
+    parser.check(parser.NUMBER);
+    auto id = eve::uint32(parser.number());
+    parser.scan();
+
+    auto& table = serialization::identity_table::current();
+    if (shared)
+    {
+      auto object = serialization::make_shared_instance<value_type>();
+      if (!table.insert(id, typeid(value_type), object))
+        throw serialization_error(parser.filename(), parser.line(), parser.column(), "shared instance " + std::to_string(id) + " is defined twice.");
+      text_serializer<value_type>::deserialize(parser, *object);
+      instance = object;
+    }
+    else
+    {
+      auto type = table.type(id);
+      if (!type)
+        throw serialization_error(parser.filename(), parser.line(), parser.column(), "unresolved reference to shared instance " + std::to_string(id) + ".");
+      if (*type != typeid(value_type))
+        throw serialization_error(parser.filename(), parser.line(), parser.column(), "shared instance " + std::to_string(id) + " was read with another type.");
+      instance = std::static_pointer_cast<T>(table.get(id));
+    }
+  }
+};
+
+/** Binary form: the id of the instance, 0 for null. The instances themselves are written after
+  * the root value (see identity_table::write_shared()), so that skipping a field never skips the
+  * only definition of an instance. They are therefore default constructed until the whole stream
+  * is read. */
+template <class T>
+class binary_serializer<std::shared_ptr<T>>
+{
+public:
+  typedef typename std::remove_cv<T>::type value_type;
+
+  static void serialize(const std::shared_ptr<T>& instance, binarywriter& writer)
+  {
+    if (!instance)
+    {
+      writer << eve::uint32(0);
+      return;
+    }
+
+    auto& table = serialization::identity_table::current();
+    auto id = table.find(instance.get(), typeid(value_type));
+    if (!id)
+    {
+      id = table.insert(instance.get(), typeid(value_type));
+      std::shared_ptr<T> kept = instance;
+      table.defer(id, std::function<void(binarywriter&)>([kept] (binarywriter& writer)
+      {
+        binary_serializer<value_type>::serialize(*kept, writer);
+      }));
+    }
+    writer << id;
+  }
+
+  static void deserialize(binaryreader& reader, std::shared_ptr<T>& instance)
+  {
+    eve::uint32 id;
+    reader >> id;
+    if (id == 0)
+    {
+      instance.reset();
+      return;
+    }
+
+    auto& table = serialization::identity_table::current();
+    if (auto type = table.type(id))
+    {
+      if (*type != typeid(value_type))
+        throw std::runtime_error("Shared instance " + std::to_string(id) + " was read with another type.");
+      instance = std::static_pointer_cast<T>(table.get(id));
+      return;
+    }
+
+    auto object = serialization::make_shared_instance<value_type>();
+    table.insert(id, typeid(value_type), object);
+    table.defer(id, std::function<void(binaryreader&)>([object] (binaryreader& reader)
+    {
+      binary_serializer<value_type>::deserialize(reader, *object);
+    }));
+    instance = object;
+  }
+};
+
+/** JSON form: null, {"$ref": id} or {"$id": id, "$value": value}. A definition in a key the
+  * reader skipped is read when first referred to (see json_reader::skipped_shared()). */
+template <class T>
+class json_serializer<std::shared_ptr<T>>
+{
+public:
+  typedef typename std::remove_cv<T>::type value_type;
+
+  static void serialize(const std::shared_ptr<T>& instance, std::ostream& output, const std::string& tab)
+  {
+    if (!instance)
+    {
+      output << "null";
+      return;
+    }
+
+    auto& table = serialization::identity_table::current();
+    if (auto id = table.find(instance.get(), typeid(value_type)))
+    {
+      output << "{\"$ref\": " << id << "}";
+      return;
+    }
+
+    output << "{\"$id\": " << table.insert(instance.get(), typeid(value_type)) << ", \"$value\": ";
+    json_serializer<value_type>::serialize(*instance, output, tab);
+    output << "}";
+  }
+
+  static void deserialize(serialization::json_reader& reader, std::shared_ptr<T>& instance)
+  {
+    if (reader.accept_null())
+    {
+      instance.reset();
+      return;
+    }
+
+    reader.expect('{');
+    bool shared = is_key(reader.string(), "$id");
+    reader.expect(':');
+    auto id = eve::uint32(reader.number());
+
+    auto& table = serialization::identity_table::current();
+    if (shared)
+    {
+      reader.expect(',');
+      if (!is_key(reader.string(), "$value"))
+        reader.error("expected \"$value\".");
+      reader.expect(':');
+      instance = read(reader, table, id);
+      if (!instance)
+        reader.error("shared instance " + std::to_string(id) + " is defined twice.");
+    }
+    else if (auto type = table.type(id))
+    {
+      if (*type != typeid(value_type))
+        reader.error("shared instance " + std::to_string(id) + " was read with another type.");
+      instance = std::static_pointer_cast<T>(table.get(id));
+    }
+    else if (auto position = reader.skipped_shared(id))
+    {
+      // defined in a skipped key, read it there and come back
+      auto resume = reader.position();
+      reader.seek(position);
+      instance = read(reader, table, id);
+      reader.seek(resume);
+    }
+    else
+      reader.error("unresolved reference to shared instance " + std::to_string(id) + ".");
+    reader.expect('}');
+  }
+
+private:
+  /** Reads the value of the instance @p id.
+      @returns a null pointer if the id is already used. */
+  static std::shared_ptr<value_type> read(serialization::json_reader& reader, serialization::identity_table& table, eve::uint32 id)
+  {
+    auto object = serialization::make_shared_instance<value_type>();
+    if (!table.insert(id, typeid(value_type), object))
+      return nullptr;
+    json_serializer<value_type>::deserialize(reader, *object);
+    return object;
+  }
+
+  static bool is_key(const serialization::json_reader::string_range& key, const char* name)
+  {
+    auto length = eve::size(key.end() - key.begin());
+    return length == strlen(name) && memcmp(key.begin(), name, length) == 0;
+  }
+};
+
+} // eve
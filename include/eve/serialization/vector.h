@@ -28,12 +28,27 @@
 #pragma once
 
 #include "../serialization.h"
+#include "packed.h"
 #include <vector>
 
 namespace eve {
 
 template <class T>
-class text_serializer<std::vector<T>> : public eve::text_linear_container_serializer<std::vector<T>>
+class text_serializer<std::vector<T>> : public std::conditional<serialization::packed_traits<T>::value,
+  eve::packed_array_serializer<std::vector<T>>,
+  eve::text_linear_container_serializer<std::vector<T>>>::type
+{
+};
+
+template <class T>
+class binary_serializer<std::vector<T>> : public std::conditional<serialization::packed_traits<T>::value,
+  eve::packed_array_serializer<std::vector<T>>,
+  eve::binary_linear_container_serializer<std::vector<T>>>::type
+{
+};
+
+template <class T>
+class json_serializer<std::vector<T>> : public eve::json_linear_container_serializer<std::vector<T>>
 {
 };
 
@@ -60,6 +60,8 @@ public:
     void unload() override;
 
   protected:
+    /** Creates and compiles the stage from the source read by load(). */
+    void finalize() override;
     void on_reload() override;
 
   private:
@@ -81,6 +83,8 @@ public:
   void uniform(const std::string& name, float value);
   
 protected:
+  /** Creates and links the program from the stages, finalized before. */
+  void finalize() override;
   void on_reload() override;
 
 private:
@@ -0,0 +1,155 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#pragma once
+
+#include "debug.h"
+#include "platform.h"
+#include <string>
+
+/** \addtogroup Lib
+  * @{
+  */
+
+namespace eve {
+
+/** Writes the same format as eve::binarywriter straight into a contiguous @p Sink instead of
+  * going through a std::streambuf.
+  *
+  * @p Sink is any container of bytes with size(), resize() and contiguous operator[], such as
+  * std::vector<char> or std::string. Values are appended after its current content; the sink
+  * grows geometrically and is trimmed to the written size by flush().
+  *
+  * Primitives are not bounds checked (but in debug builds): reserve() room for a whole message
+  * of them before writing it. Strings and write() reserve their own room, once per call.
+  *
+  * Only the primitive and string operators of eve::binarywriter are mirrored. Types serialized
+  * through eve::binary_serializer, such as eve_serializable classes, still need a binarywriter. */
+template <class Sink>
+class span_writer
+{
+public:
+  span_writer(Sink& sink);
+  ~span_writer();
+
+  /** Trims the sink to the bytes written so far. */
+  void flush();
+
+  /** Makes room for @p size more bytes, which the next writes may then fill. */
+  void reserve(eve::size size);
+
+  /** @returns the number of bytes in the sink, including those it had before. */
+  eve::size size() const { return m_cursor; }
+
+  span_writer& operator<<(bool rhs) { put(rhs); return *this; }
+  span_writer& operator<<(eve::int8 rhs) { put(rhs); return *this; }
+  span_writer& operator<<(eve::uint8 rhs) { put(rhs); return *this; }
+  span_writer& operator<<(eve::int16 rhs) { put(rhs); return *this; }
+  span_writer& operator<<(eve::uint16 rhs) { put(rhs); return *this; }
+  span_writer& operator<<(eve::int32 rhs) { put(rhs); return *this; }
+  span_writer& operator<<(eve::uint32 rhs) { put(rhs); return *this; }
+  span_writer& operator<<(eve::int64 rhs) { put(rhs); return *this; }
+  span_writer& operator<<(eve::uint64 rhs) { put(rhs); return *this; }
+  span_writer& operator<<(float rhs) { put(rhs); return *this; }
+  span_writer& operator<<(double rhs) { put(rhs); return *this; }
+  span_writer& operator<<(const char* rhs);
+  span_writer& operator<<(const std::string& rhs);
+
+  /** Writes @p size raw bytes from @p data as they are (no endianness conversion). */
+  void write(const void* data, eve::size size);
+
+private:
+  template <class T>
+  void put(T value);
+  void grow(eve::size size);
+
+  Sink* m_sink;
+  char* m_data;
+  eve::size m_cursor;
+  eve::size m_capacity;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Reads the eve::binarywriter format from contiguous memory instead of a std::streambuf.
+  *
+  * It reads any contiguous memory, so it needs no source type parameter. Every read is checked
+  * against the end of the memory: unlike writes, reads cannot be reserved ahead since the size
+  * of a message is only known by reading it.
+  * @throws std::runtime_error when reading past the end.
+  *
+  * As with span_writer, types serialized through eve::binary_serializer need a binaryreader. */
+class span_reader
+{
+public:
+  span_reader(const void* data, eve::size size);
+
+  /** Reads the content of @p source, any container with size() and contiguous operator[]. */
+  template <class Source>
+  explicit span_reader(const Source& source);
+
+  /** @returns the number of bytes read so far. */
+  eve::size position() const { return eve::size(m_cursor - m_begin); }
+
+  /** @returns the number of bytes left to read. */
+  eve::size remaining() const { return eve::size(m_end - m_cursor); }
+
+  span_reader& operator>>(bool& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(char& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(unsigned char& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(int16& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(uint16& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(int32& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(uint32& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(long long& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(unsigned long long& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(float& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(double& rhs) { get(rhs); return *this; }
+  span_reader& operator>>(std::string& rhs);
+
+  /** Reads @p size raw bytes into @p data as they are (no endianness conversion). */
+  void read(void* data, eve::size size);
+
+  /** Discards the next @p size bytes. */
+  void skip(eve::size size);
+
+private:
+  template <class T>
+  void get(T& value);
+  void check(eve::size size) const { if (remaining() < size) overflow(); }
+  void overflow() const;
+
+  const char* m_begin;
+  const char* m_cursor;
+  const char* m_end;
+};
+
+} // eve
+
+/** @} */
+
+#include "detail/span.inl"
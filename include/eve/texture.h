@@ -114,8 +114,14 @@ public:
   void unload() override;
 
 protected:
+  /** Uploads the pixel buffer read by load(). */
+  void finalize() override;
+
   void on_reload() override;
 
+  /** Converts the text texture descriptor @p source into its binary form. */
+  bool cook(std::istream& source, std::ostream& output) override;
+
 private:
   void setup(type_t type, const vec2u& size, unsigned depth, typeformat_t format, channels_t channels, filtermode_t filtermode, wrapmode_t wrapmode, bool mipmap);
 
@@ -9,6 +9,7 @@ local build_deps = function(deps, suffix)
 end
 
 local deps = {"gtest", "gtest_main", "glew", "libpng16", "zlib"}
+local tool_deps = {"glew", "libpng16", "zlib"}
 
 solution "eve"
   language "C++"
@@ -29,6 +30,7 @@ solution "eve"
 
   configuration "linux"
     defines { "EVE_LINUX" }
+    links { "dl", "pthread", "rt" }
 
   configuration "windows"
     defines { "EVE_WINDOWS" }
@@ -95,3 +97,24 @@ solution "eve"
     configuration "Release"
       targetname "tests"
       links {"eve"}
+
+  -- tools
+  project "evecook"
+    kind "ConsoleApp"
+    includedirs { "include", "extern/include" }
+    files { "tools/evecook/**.cpp" }
+
+    configuration "Debug"
+      links (build_deps(tool_deps, "d"))
+    configuration "not Debug"
+      links (build_deps(tool_deps, ""))
+
+    configuration "Debug"
+      targetname "evecookd"
+      links {"eved"}
+    configuration "Optimized"
+      targetname "evecooko"
+      links {"eveo"}
+    configuration "Release"
+      targetname "evecook"
+      links {"eve"}
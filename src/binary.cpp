@@ -26,6 +26,15 @@
 \******************************************************************************/
 
 #include "eve/binary.h"
+#include "eve/hash.h"
+#include "eve/serialization.h"
+#include <cstring>
+#include <ios>
+#include <streambuf>
+
+#ifdef EVE_X86
+#  include <immintrin.h>
+#endif
 
 using namespace eve;
 
@@ -45,10 +54,119 @@ inline uint64 swap8(uint64 val)
     | (val << 8 & 0x000000FF00000000) | (val << 24 & 0x0000FF0000000000) | (val << 40 & 0x00FF000000000000) | (val << 56);
 }
 
+//// BYTESWAP KERNELS
+
+typedef void (*byteswap_kernel)(char* data, eve::size count, eve::size width);
+
+static void byteswap_scalar(char* data, eve::size count, eve::size width)
+{
+  switch (width)
+  {
+  case 2:
+    for (eve::size i = 0; i < count; ++i, data += 2)
+    {
+      uint16 t;
+      std::memcpy(&t, data, 2);
+      t = swap2(t);
+      std::memcpy(data, &t, 2);
+    }
+    break;
+  case 4:
+    for (eve::size i = 0; i < count; ++i, data += 4)
+    {
+      uint32 t;
+      std::memcpy(&t, data, 4);
+      t = swap4(t);
+      std::memcpy(data, &t, 4);
+    }
+    break;
+  case 8:
+    for (eve::size i = 0; i < count; ++i, data += 8)
+    {
+      uint64 t;
+      std::memcpy(&t, data, 8);
+      t = swap8(t);
+      std::memcpy(data, &t, 8);
+    }
+    break;
+  }
+}
+
+#ifdef EVE_X86
+
+/** Shuffle mask reversing every @p width bytes of a 16 bytes lane. */
+static void byteswap_mask(char mask[16], eve::size width)
+{
+  for (eve::size i = 0; i < 16; ++i)
+    mask[i] = char(i / width * width + width - 1 - i % width);
+}
+
+eve_target("ssse3")
+static void byteswap_ssse3(char* data, eve::size count, eve::size width)
+{
+  char bytes[16];
+  byteswap_mask(bytes, width);
+  const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+
+  eve::size size = count * width, i = 0;
+  for (; i + 16 <= size; i += 16)
+  {
+    auto p = reinterpret_cast<__m128i*>(data + i);
+    _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), mask));
+  }
+  byteswap_scalar(data + i, (size - i) / width, width);
+}
+
+eve_target("avx2")
+static void byteswap_avx2(char* data, eve::size count, eve::size width)
+{
+  char bytes[16];
+  byteswap_mask(bytes, width);
+  // the shuffle works within 16 bytes lanes, so both lanes use the same mask
+  const __m128i lane = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+  const __m256i mask = _mm256_broadcastsi128_si256(lane);
+
+  eve::size size = count * width, i = 0;
+  for (; i + 32 <= size; i += 32)
+  {
+    auto p = reinterpret_cast<__m256i*>(data + i);
+    _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), mask));
+  }
+  for (; i + 16 <= size; i += 16)
+  {
+    auto p = reinterpret_cast<__m128i*>(data + i);
+    _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), lane));
+  }
+  byteswap_scalar(data + i, (size - i) / width, width);
+}
+
+#endif
+
+static const cpu::variant<byteswap_kernel> k_byteswap_kernels[] =
+{
+  { 0, byteswap_scalar, "scalar" },
+#ifdef EVE_X86
+  { cpu::ssse3, byteswap_ssse3, "ssse3" },
+  { cpu::avx2, byteswap_avx2, "avx2" },
+#endif
+};
+
+static cpu::dispatcher<byteswap_kernel> s_byteswap(k_byteswap_kernels);
+
+void eve::byteswap(void* data, eve::size count, eve::size width)
+{
+  if (width > 1)
+    s_byteswap.kernel()(static_cast<char*>(data), count, width);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 binarywriter::binarywriter(std::streambuf* buffer)
-  : m_buffer(buffer) { }
+  : m_buffer(buffer)
+  , m_checksumming(false)
+  , m_checksum(0)
+{
+}
 
 binarywriter::~binarywriter()
 {
@@ -60,11 +178,30 @@ void binarywriter::flush()
   m_buffer->pubsync(); 
 }
 
+void binarywriter::begin_checksum()
+{
+  m_checksumming = true;
+  m_checksum = 0;
+}
+
+void binarywriter::end_checksum()
+{
+  m_checksumming = false;
+  *this << m_checksum;
+}
+
+inline void binarywriter::put(const char* data, eve::size size)
+{
+  m_buffer->sputn(data, size);
+  if (m_checksumming)
+    m_checksum = hash::crc32c(data, size, m_checksum);
+}
+
 binarywriter& binarywriter::operator<<(const char* rhs)
 {
   uint16 size = (uint16)strlen(rhs);
   *this << size;
-  m_buffer->sputn(rhs, size);
+  put(rhs, size);
   return *this;
 }
 
@@ -72,22 +209,46 @@ binarywriter& binarywriter::operator<<(const std::string& rhs)
 {
   uint16 size = (uint16)rhs.size();
   *this << size;
-  m_buffer->sputn(rhs.c_str(), size);
+  put(rhs.c_str(), size);
   return *this;
 }
 
+void binarywriter::write(const void* data, eve::size size)
+{
+  put(reinterpret_cast<const char*> (data), size);
+}
+
+void binarywriter::write_swapped(const void* data, eve::size count, eve::size width)
+{
+  // swap a copy by chunks, the caller's data is const
+  char scratch[1024];
+  auto bytes = static_cast<const char*>(data);
+  eve::size size = count * width;
+  while (size > 0)
+  {
+    auto chunk = size < sizeof(scratch) ? size : eve::size(sizeof(scratch));
+    std::memcpy(scratch, bytes, chunk);
+    byteswap(scratch, chunk / width, width);
+    put(scratch, chunk);
+    bytes += chunk;
+    size -= chunk;
+  }
+}
+
 void binarywriter::write1(const void* data)
 {
   m_buffer->sputc(*reinterpret_cast<const char*> (data));
+  if (m_checksumming)
+    m_checksum = hash::crc32c(data, 1, m_checksum);
 }
 
 void binarywriter::write2(const void* data)
 {
 #ifdef EVE_BIG_ENDIAN
   uint16 t = swap2(*reinterpret_cast<const uint16*> (data));
-  m_buffer->sputn(reinterpret_cast<const char*> (&t), 2);
+  put(reinterpret_cast<const char*> (&t), 2);
 #else
-  m_buffer->sputn(reinterpret_cast<const char*> (data), 2);
+  put(reinterpret_cast<const char*> (data), 2);
 #endif
 }
 
@@ -95,9 +256,9 @@ void binarywriter::write4(const void* data)
 {
 #ifdef EVE_BIG_ENDIAN
   uint32 t = swap4(*reinterpret_cast<const uint32*> (data));
-  m_buffer->sputn(reinterpret_cast<const char*> (&t), 4);
+  put(reinterpret_cast<const char*> (&t), 4);
 #else
-  m_buffer->sputn(reinterpret_cast<const char*> (data), 4);
+  put(reinterpret_cast<const char*> (data), 4);
 #endif
 }
 
@@ -105,62 +266,132 @@ void binarywriter::write8(const void* data)
 {
 #ifdef EVE_BIG_ENDIAN
   uint64 t = swap8(*reinterpret_cast<const uint64*> (data));
-  m_buffer->sputn(reinterpret_cast<const char*> (&t), 8);
+  put(reinterpret_cast<const char*> (&t), 8);
 #else
-  m_buffer->sputn(reinterpret_cast<const char*> (data), 8);
+  put(reinterpret_cast<const char*> (data), 8);
 #endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 binaryreader::binaryreader(std::streambuf* buffer)
-  : m_buffer(buffer) { }
+  : m_buffer(buffer)
+  , m_checksumming(false)
+  , m_checksum(0)
+  , m_position(0)
+{
+}
+
+void binaryreader::begin_checksum()
+{
+  m_checksumming = true;
+  m_checksum = 0;
+}
+
+bool binaryreader::end_checksum()
+{
+  m_checksumming = false;
+  uint32 expected;
+  *this >> expected;
+  return expected == m_checksum;
+}
+
+/** Throws for a read or a skip past the end of the buffer at @p position. */
+static void end_of_stream(eve::uint64 position)
+{
+  throw eve::serialization_error("binary stream", 0, eve::size(position), "unexpected end of stream.");
+}
+
+inline void binaryreader::get(char* data, eve::size size)
+{
+  auto read = m_buffer->sgetn(data, size);
+  if (read != std::streamsize(size))
+    end_of_stream(m_position + eve::uint64(read < 0 ? 0 : read));
+  m_position += size;
+  if (m_checksumming)
+    m_checksum = hash::crc32c(data, size, m_checksum);
+}
 
 binaryreader& binaryreader::operator>>(std::string& rhs)
 {
   uint16 size;
   *this >> size;
   rhs.resize(size);
-  m_buffer->sgetn(&rhs[0], size);
+  get(&rhs[0], size);
   rhs[size] = '\0';
   return *this;
 }
 
+void binaryreader::read(void* data, eve::size size)
+{
+  get(reinterpret_cast<char*> (data), size);
+}
+
+void binaryreader::skip(eve::size size)
+{
+  if (size == 0)
+    return;
+
+  // seek when the buffer supports it, otherwise consume the bytes. Seeking past the end may
+  // succeed, so the last byte skipped is read to make sure it exists.
+  if (!m_checksumming && m_buffer->pubseekoff(size - 1, std::ios::cur, std::ios::in) != std::streampos(-1))
+  {
+    if (std::streambuf::traits_type::eq_int_type(m_buffer->sbumpc(), std::streambuf::traits_type::eof()))
+      end_of_stream(m_position);
+    m_position += size;
+    return;
+  }
+
+  char scratch[256];
+  while (size > 0)
+  {
+    auto chunk = size < sizeof(scratch) ? size : eve::size(sizeof(scratch));
+    get(scratch, chunk);
+    size -= chunk;
+  }
+}
+
 void binaryreader::read1(void* data)
 {
-  *(char*)data = m_buffer->sbumpc();
+  auto c = m_buffer->sbumpc();
+  if (std::streambuf::traits_type::eq_int_type(c, std::streambuf::traits_type::eof()))
+    end_of_stream(m_position);
+  *(char*)data = std::streambuf::traits_type::to_char_type(c);
+  ++m_position;
+  if (m_checksumming)
+    m_checksum = hash::crc32c(data, 1, m_checksum);
 }
 
 
 void binaryreader::read2(void* data)
 {
 #ifdef EVE_BIG_ENDIAN
-  m_buffer->sgetn(reinterpret_cast<char*> (data), 2);
+  get(reinterpret_cast<char*> (data), 2);
   uint16* t = reinterpret_cast<uint16*> (data);
   *t = swap2(*t);
 #else
-  m_buffer->sgetn((char*) data, 2);
+  get((char*) data, 2);
 #endif
 }
 
 void binaryreader::read4(void* data)
 {
 #ifdef EVE_BIG_ENDIAN
-  m_buffer->sgetn(reinterpret_cast<char*> (data), 4);
+  get(reinterpret_cast<char*> (data), 4);
   uint32* t = reinterpret_cast<uint32*> (data);
   *t = swap4(*t);
 #else
-  m_buffer->sgetn((char*) data, 4);
+  get((char*) data, 4);
 #endif
 }
 
 void binaryreader::read8(void* data)
 {
 #ifdef EVE_BIG_ENDIAN
-  m_buffer->sgetn(reinterpret_cast<char*> (data), 8);
+  get(reinterpret_cast<char*> (data), 8);
   uint64* t = reinterpret_cast<uint64*> (data);
   *t = swap8(*t);
 #else
-  m_buffer->sgetn((char*)data, 8);
+  get((char*)data, 8);
 #endif
 }
\ No newline at end of file
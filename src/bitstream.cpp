@@ -0,0 +1,262 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/bitstream.h"
+#include "eve/debug.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace eve;
+
+uint32 eve::quantized_bits(float min, float max, float precision)
+{
+  eve_assert(max > min && precision > 0);
+  auto steps = uint64(std::ceil((max - min) / precision));
+  uint32 count = 0;
+  while (count < 64 && (steps >> count) != 0)
+    ++count;
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bitwriter::bitwriter(std::streambuf* buffer)
+  : m_buffer(buffer)
+  , m_bits(0)
+  , m_count(0)
+  , m_position(0)
+{
+}
+
+bitwriter::~bitwriter()
+{
+  flush();
+}
+
+void bitwriter::buffer(std::streambuf* buffer)
+{
+  flush();
+  m_buffer = buffer;
+}
+
+void bitwriter::flush()
+{
+  align();
+  m_buffer->pubsync();
+}
+
+void bitwriter::align()
+{
+  if (m_count != 0)
+    write_bits(0, 8 - m_count);
+}
+
+void bitwriter::write_bits(uint64 value, uint32 count)
+{
+  eve_assert(count <= 64);
+
+  // keep at most 39 bits pending so that they never overflow the accumulator
+  if (count > 32)
+  {
+    write_bits(value & 0xFFFFFFFF, 32);
+    value >>= 32;
+    count -= 32;
+  }
+
+  m_bits |= (value & ((uint64(1) << count) - 1)) << m_count;
+  m_count += count;
+  m_position += count;
+
+  while (m_count >= 8)
+  {
+    m_buffer->sputc(char(m_bits));
+    m_bits >>= 8;
+    m_count -= 8;
+  }
+}
+
+void bitwriter::write_varint(uint64 value)
+{
+  while (value >= 0x80)
+  {
+    write_bits((value & 0x7F) | 0x80, 8);
+    value >>= 7;
+  }
+  write_bits(value, 8);
+}
+
+void bitwriter::write_quantized(float value, float min, float max, float precision)
+{
+  auto count = quantized_bits(min, max, precision);
+  auto steps = uint64(std::ceil((max - min) / precision));
+  value = std::min(std::max(value, min), max);
+  auto step = std::min(uint64(std::floor((value - min) / precision + 0.5f)), steps);
+  write_bits(step, count);
+}
+
+bitwriter& bitwriter::operator<<(float rhs)
+{
+  uint32 bits;
+  std::memcpy(&bits, &rhs, sizeof(bits));
+  write_bits(bits, 32);
+  return *this;
+}
+
+bitwriter& bitwriter::operator<<(double rhs)
+{
+  uint64 bits;
+  std::memcpy(&bits, &rhs, sizeof(bits));
+  write_bits(bits, 64);
+  return *this;
+}
+
+bitwriter& bitwriter::operator<<(const char* rhs)
+{
+  return *this << std::string(rhs);
+}
+
+bitwriter& bitwriter::operator<<(const std::string& rhs)
+{
+  write_varint(rhs.size());
+  if (m_count == 0)
+  {
+    m_buffer->sputn(rhs.data(), rhs.size());
+    m_position += uint64(rhs.size()) * 8;
+  }
+  else
+  {
+    for (auto ch : rhs)
+      write_bits(uint8(ch), 8);
+  }
+  return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bitreader::bitreader(std::streambuf* buffer)
+  : m_buffer(buffer)
+  , m_bits(0)
+  , m_count(0)
+  , m_position(0)
+{
+}
+
+void bitreader::buffer(std::streambuf* buffer)
+{
+  m_buffer = buffer;
+  m_bits = 0;
+  m_count = 0;
+}
+
+void bitreader::align()
+{
+  m_position += m_count;
+  m_bits = 0;
+  m_count = 0;
+}
+
+uint64 bitreader::read_bits(uint32 count)
+{
+  eve_assert(count <= 64);
+
+  if (count > 32)
+  {
+    uint64 low = read_bits(32);
+    return low | (read_bits(count - 32) << 32);
+  }
+
+  while (m_count < count)
+  {
+    auto ch = m_buffer->sbumpc();
+    if (ch == std::streambuf::traits_type::eof())
+      throw std::runtime_error("bitreader: unexpected end of buffer.");
+    m_bits |= uint64(uint8(ch)) << m_count;
+    m_count += 8;
+  }
+
+  uint64 value = m_bits & ((uint64(1) << count) - 1);
+  m_bits >>= count;
+  m_count -= count;
+  m_position += count;
+  return value;
+}
+
+uint64 bitreader::read_varint()
+{
+  uint64 value = 0;
+  for (uint32 shift = 0; shift < 64; shift += 7)
+  {
+    auto byte = read_bits(8);
+    value |= (byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+  throw std::runtime_error("bitreader: malformed varint.");
+}
+
+float bitreader::read_quantized(float min, float max, float precision)
+{
+  auto step = read_bits(quantized_bits(min, max, precision));
+  return std::min(min + step * precision, max);
+}
+
+bitreader& bitreader::operator>>(float& rhs)
+{
+  auto bits = uint32(read_bits(32));
+  std::memcpy(&rhs, &bits, sizeof(rhs));
+  return *this;
+}
+
+bitreader& bitreader::operator>>(double& rhs)
+{
+  auto bits = read_bits(64);
+  std::memcpy(&rhs, &bits, sizeof(rhs));
+  return *this;
+}
+
+bitreader& bitreader::operator>>(std::string& rhs)
+{
+  auto size = read_varint();
+  rhs.resize(std::string::size_type(size));
+  if (size == 0)
+    return *this;
+
+  if (m_count == 0)
+  {
+    if (m_buffer->sgetn(&rhs[0], std::streamsize(size)) != std::streamsize(size))
+      throw std::runtime_error("bitreader: unexpected end of buffer.");
+    m_position += size * 8;
+  }
+  else
+  {
+    for (auto& ch : rhs)
+      ch = char(read_bits(8));
+  }
+  return *this;
+}
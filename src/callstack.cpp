@@ -31,13 +31,6 @@
 
 using namespace eve;
 
-#ifdef _MSC_VER
-
-#include <Windows.h>
-#include <DbgHelp.h>
-
-static const HANDLE s_process = GetCurrentProcess();
-
 callstack::symbol::symbol()
   : m_file("")
   , m_line(0)
@@ -56,6 +49,13 @@ callstack::callstack(bool capture, eve::size skipframes)
     this->capture(skipframes + 1);
 }
 
+#ifdef _MSC_VER
+
+#include <Windows.h>
+#include <DbgHelp.h>
+
+static const HANDLE s_process = GetCurrentProcess();
+
 void callstack::capture(eve::size skipframes)
 {
   m_size = CaptureStackBackTrace(skipframes + 1, k_max_trace_size, m_trace, (PDWORD)&m_hash);
@@ -93,6 +93,47 @@ callstack::symbol callstack::fetch(eve::size index) const
   return symbol;
 }
 
+#elif defined(EVE_LINUX)
+
+#include "eve/hash.h"
+#include <execinfo.h>
+#include <dlfcn.h>
+
+void callstack::capture(eve::size skipframes)
+{
+  static const eve::size k_max_skipframes = 32;
+  void* trace[k_max_trace_size + k_max_skipframes + 1];
+
+  // skip capture() itself too
+  skipframes = (skipframes < k_max_skipframes ? skipframes : k_max_skipframes) + 1;
+  int captured = backtrace(trace, int(k_max_trace_size + skipframes));
+  m_size = uint16(captured > int(skipframes) ? captured - int(skipframes) : 0);
+  memcpy(m_trace, trace + skipframes, m_size * sizeof(void*));
+  m_hash = eve::hash::crc32c(m_trace, m_size * eve_sizeof(void*));
+}
+
+callstack::symbol callstack::fetch(eve::size index) const
+{
+  eve_assert(index < m_size);
+
+  symbol symbol;
+
+  // dladdr only sees exported symbols and has no line information
+  Dl_info info;
+  if (dladdr(m_trace[index], &info))
+  {
+    if (info.dli_sname)
+    {
+      strncpy(symbol.m_function, info.dli_sname, symbol::k_max_function_length - 1);
+      symbol.m_function[symbol::k_max_function_length - 1] = 0;
+    }
+    if (info.dli_fname)
+      symbol.m_file = info.dli_fname;
+  }
+
+  return symbol;
+}
+
 #else
 #error Implement callstacks on this platform.
 #endif
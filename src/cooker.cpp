@@ -0,0 +1,278 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/cooker.h"
+#include "eve/exceptions.h"
+#include "eve/hash.h"
+#include "eve/log.h"
+#include "eve/path.h"
+#include "eve/utils.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#ifdef EVE_WINDOWS
+#  include <Windows.h>
+#else
+#  include <dirent.h>
+#  include <sys/stat.h>
+#endif
+
+using namespace eve;
+
+const char* const cooker::k_manifest = "manifest.evedat";
+
+//// PLATFORM FILESYSTEM
+
+static void make_directory(const std::string& path)
+{
+#ifdef EVE_WINDOWS
+  CreateDirectoryA(path.c_str(), NULL);
+#else
+  mkdir(path.c_str(), 0755);
+#endif
+}
+
+/** Appends to @p files the path of every regular file under @p directory, recursively. */
+static void list_files(const std::string& directory, std::vector<std::string>& files)
+{
+#ifdef EVE_WINDOWS
+  WIN32_FIND_DATAA data;
+  HANDLE handle = FindFirstFileA((directory + "/*").c_str(), &data);
+  if (handle == INVALID_HANDLE_VALUE)
+    return;
+  do
+  {
+    std::string name = data.cFileName;
+    if (name == "." || name == "..")
+      continue;
+    std::string path = directory;
+    eve::path::push(path, name);
+    if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      list_files(path, files);
+    else
+      files.push_back(path);
+  } while (FindNextFileA(handle, &data));
+  FindClose(handle);
+#else
+  DIR* dir = opendir(directory.c_str());
+  if (!dir)
+    return;
+  while (dirent* ent = readdir(dir))
+  {
+    std::string name = ent->d_name;
+    if (name == "." || name == "..")
+      continue;
+    std::string path = directory;
+    eve::path::push(path, name);
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+      continue;
+    if (S_ISDIR(info.st_mode))
+      list_files(path, files);
+    else if (S_ISREG(info.st_mode))
+      files.push_back(path);
+  }
+  closedir(dir);
+#endif
+}
+
+static bool ends_with(const std::string& str, const std::string& suffix)
+{
+  return str.size() >= suffix.size()
+    && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cooker::manifest cooker::read_manifest(const std::string& directory)
+{
+  std::string path = directory;
+  eve::path::push(path, k_manifest);
+  std::ifstream file = eve::open_fstream(path);
+  manifest result;
+  eve::deserialize_as_text(file, result);
+  return result;
+}
+
+std::string cooker::hash_file(const std::string& path)
+{
+  std::ifstream file = eve::open_fstream(path);
+
+  hash::xxh64_state state;
+  char buffer[4096];
+  while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+    state.update(buffer, eve::size(file.gcount()));
+
+  auto hash = state.digest();
+  char hex[17];
+  std::sprintf(hex, "%08x%08x", eve::uint32(hash >> 32), eve::uint32(hash));
+  return hex;
+}
+
+bool cooker::stat_file(const std::string& path, eve::uint64& size, eve::int64& modified)
+{
+#ifdef EVE_WINDOWS
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+    return false;
+  size = (eve::uint64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+  modified = eve::int64((eve::uint64(data.ftLastWriteTime.dwHighDateTime) << 32)
+    | data.ftLastWriteTime.dwLowDateTime);
+#else
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0)
+    return false;
+  size = eve::uint64(info.st_size);
+  modified = eve::int64(info.st_mtime);
+#endif
+  return true;
+}
+
+cooker::cooker(const std::string& directory)
+  : m_directory(directory)
+  , m_cooked(0)
+  , m_skipped(0)
+  , m_failed(0)
+  , m_uncooked(0)
+{
+  make_directory(m_directory);
+  try
+  {
+    m_manifest = read_manifest(m_directory);
+  } catch (eve::file_not_found_error&)
+  {
+  }
+}
+
+void cooker::cook(const std::string& root)
+{
+  std::vector<std::string> files;
+  list_files(root, files);
+  std::sort(files.begin(), files.end());
+
+  std::string manifest_path = m_directory;
+  eve::path::push(manifest_path, k_manifest);
+
+  resource::cooking_scope cooking;
+  for (auto& path : files)
+  {
+    auto rule = find_rule(path);
+    if (!rule || path == manifest_path)
+      continue;
+
+    try
+    {
+      cook_file(path, *rule);
+    } catch (std::exception& e)
+    {
+      eve::log::error("cooking \"" + path + "\" failed: " + e.what());
+      ++m_failed;
+    }
+  }
+
+  save_manifest();
+}
+
+const cooker::rule* cooker::find_rule(const std::string& path) const
+{
+  const rule* best = nullptr;
+  for (auto& r : m_rules)
+    if (ends_with(path, r.suffix) && (!best || r.suffix.size() > best->suffix.size()))
+      best = &r;
+  return best;
+}
+
+void cooker::cook_file(const std::string& path, const rule& rule)
+{
+  auto hash = hash_file(path);
+  eve::uint64 size = 0;
+  eve::int64 modified = 0;
+  stat_file(path, size, modified);
+  std::string artifact = m_directory;
+  eve::path::push(artifact, hash);
+
+  auto it = std::find_if(m_manifest.entries.begin(), m_manifest.entries.end(),
+    [&path] (const entry& e) { return e.source == path; });
+
+  if (it != m_manifest.entries.end() && it->hash == hash)
+  {
+    // artifacts cooked with another binary format are cooked again
+    std::ifstream existing(artifact.c_str(), std::ios::binary);
+    if (existing.good() && resource::read_cooked_header(existing))
+    {
+      // the source may have been touched without changing
+      it->size = size;
+      it->modified = modified;
+      ++m_skipped;
+      return;
+    }
+  }
+
+  // cook into memory first so that a failure never leaves a partial artifact behind
+  std::ostringstream output;
+  {
+    resource::source source(path);
+    eve::unique_ptr<resource>::type res(rule.create());
+    res->m_path = path;
+    if (!res->cook(*source, output))
+    {
+      eve::log::warning("\"" + path + "\" has no cooked form, it is loaded from source.");
+      ++m_uncooked;
+      return;
+    }
+  }
+
+  std::ofstream file(artifact.c_str(), std::ios::binary);
+  auto data = output.str();
+  file.write(data.data(), data.size());
+  if (!file.good())
+    throw eve::system_error("cannot write \"" + artifact + "\".");
+
+  if (it == m_manifest.entries.end())
+  {
+    m_manifest.entries.push_back(entry());
+    it = m_manifest.entries.end() - 1;
+  }
+  it->source = path;
+  it->hash = hash;
+  it->artifact = hash;
+  it->size = size;
+  it->modified = modified;
+  ++m_cooked;
+}
+
+void cooker::save_manifest() const
+{
+  std::string path = m_directory;
+  eve::path::push(path, k_manifest);
+  std::ofstream file(path.c_str());
+  eve::serialize_as_text(m_manifest, file);
+  if (!file.good())
+    throw eve::system_error("cannot write \"" + path + "\".");
+}
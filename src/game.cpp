@@ -34,6 +34,7 @@ using namespace eve;
 game::game(const std::string& name, eve::flagset<application::module> modules)
   : m_app(modules)
   , m_top(nullptr)
+  , m_load_budget(0.004)
 {
   m_window.title(name);
 }
@@ -76,6 +77,9 @@ void game::mainloop()
     // Make our window active
     m_window.activate();
 
+    // Finish loading resources loaded in background
+    eve::resource::finalize_pending(m_load_budget);
+
     // Update logic
     m_top->update(time);
 
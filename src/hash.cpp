@@ -0,0 +1,288 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/hash.h"
+#include "eve/binary.h"
+#include <cstring>
+
+#ifdef EVE_X86
+#  include <nmmintrin.h>
+#endif
+
+using namespace eve;
+
+static inline uint32 read32(const unsigned char* data)
+{
+  uint32 value;
+  std::memcpy(&value, data, sizeof(value));
+#ifdef EVE_BIG_ENDIAN
+  eve::byteswap(&value, 1, sizeof(value));
+#endif
+  return value;
+}
+
+static inline uint64 read64(const unsigned char* data)
+{
+  uint64 value;
+  std::memcpy(&value, data, sizeof(value));
+#ifdef EVE_BIG_ENDIAN
+  eve::byteswap(&value, 1, sizeof(value));
+#endif
+  return value;
+}
+
+//// CRC32C
+
+typedef uint32 (*crc32c_kernel)(const unsigned char* data, eve::size size, uint32 crc);
+
+/** Slice-by-8 lookup tables of the reflected Castagnoli polynomial. */
+struct crc32c_tables
+{
+  uint32 t[8][256];
+
+  crc32c_tables()
+  {
+    for (uint32 i = 0; i < 256; ++i)
+    {
+      uint32 crc = i;
+      for (int bit = 0; bit < 8; ++bit)
+        crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+      t[0][i] = crc;
+    }
+    for (uint32 i = 0; i < 256; ++i)
+      for (int k = 1; k < 8; ++k)
+        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+  }
+};
+
+static const crc32c_tables s_crc32c_tables;
+
+static uint32 crc32c_slice8(const unsigned char* data, eve::size size, uint32 crc)
+{
+  auto& t = s_crc32c_tables.t;
+  for (; size >= 8; size -= 8, data += 8)
+  {
+    uint32 lo = read32(data) ^ crc;
+    uint32 hi = read32(data + 4);
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+      ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+  }
+  for (; size > 0; --size, ++data)
+    crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+  return crc;
+}
+
+#ifdef EVE_X86
+
+eve_target("sse4.2")
+static uint32 crc32c_sse42(const unsigned char* data, eve::size size, uint32 crc)
+{
+#if defined(_M_X64) || defined(__x86_64__)
+  uint64 crc64 = crc;
+  for (; size >= 8; size -= 8, data += 8)
+  {
+    uint64 value;
+    std::memcpy(&value, data, sizeof(value));
+    crc64 = _mm_crc32_u64(crc64, value);
+  }
+  crc = uint32(crc64);
+#else
+  for (; size >= 4; size -= 4, data += 4)
+  {
+    uint32 value;
+    std::memcpy(&value, data, sizeof(value));
+    crc = _mm_crc32_u32(crc, value);
+  }
+#endif
+  for (; size > 0; --size, ++data)
+    crc = _mm_crc32_u8(crc, *data);
+  return crc;
+}
+
+#endif
+
+static const cpu::variant<crc32c_kernel> k_crc32c_kernels[] =
+{
+  { 0, crc32c_slice8, "slice8" },
+#ifdef EVE_X86
+  { cpu::sse42, crc32c_sse42, "sse42" },
+#endif
+};
+
+static cpu::dispatcher<crc32c_kernel> s_crc32c(k_crc32c_kernels);
+
+uint32 eve::hash::crc32c(const void* data, eve::size size, uint32 crc)
+{
+  return ~s_crc32c.kernel()(static_cast<const unsigned char*>(data), size, ~crc);
+}
+
+//// XXH64
+
+static const uint64 k_prime1 = 11400714785074694791ULL;
+static const uint64 k_prime2 = 14029467366897019727ULL;
+static const uint64 k_prime3 = 1609587929392839161ULL;
+static const uint64 k_prime4 = 9650029242287828579ULL;
+static const uint64 k_prime5 = 2870177450012600261ULL;
+
+static inline uint64 rotl(uint64 value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64 xxh64_round(uint64 acc, uint64 input)
+{
+  acc += input * k_prime2;
+  return rotl(acc, 31) * k_prime1;
+}
+
+static inline uint64 xxh64_merge(uint64 hash, uint64 lane)
+{
+  hash ^= xxh64_round(0, lane);
+  return hash * k_prime1 + k_prime4;
+}
+
+/** Consumes all the whole 32 bytes stripes of @p data into @p lanes. @returns the bytes left. */
+static eve::size xxh64_stripes(uint64 lanes[4], const unsigned char*& data, eve::size size)
+{
+  for (; size >= 32; size -= 32, data += 32)
+  {
+    lanes[0] = xxh64_round(lanes[0], read64(data));
+    lanes[1] = xxh64_round(lanes[1], read64(data + 8));
+    lanes[2] = xxh64_round(lanes[2], read64(data + 16));
+    lanes[3] = xxh64_round(lanes[3], read64(data + 24));
+  }
+  return size;
+}
+
+static uint64 xxh64_finalize(uint64 hash, const unsigned char* data, eve::size size)
+{
+  for (; size >= 8; size -= 8, data += 8)
+  {
+    hash ^= xxh64_round(0, read64(data));
+    hash = rotl(hash, 27) * k_prime1 + k_prime4;
+  }
+  if (size >= 4)
+  {
+    hash ^= uint64(read32(data)) * k_prime1;
+    hash = rotl(hash, 23) * k_prime2 + k_prime3;
+    data += 4;
+    size -= 4;
+  }
+  for (; size > 0; --size, ++data)
+  {
+    hash ^= *data * k_prime5;
+    hash = rotl(hash, 11) * k_prime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= k_prime2;
+  hash ^= hash >> 29;
+  hash *= k_prime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+static void xxh64_init(uint64 lanes[4], uint64 seed)
+{
+  lanes[0] = seed + k_prime1 + k_prime2;
+  lanes[1] = seed + k_prime2;
+  lanes[2] = seed;
+  lanes[3] = seed - k_prime1;
+}
+
+static uint64 xxh64_converge(const uint64 lanes[4])
+{
+  uint64 hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+  for (int i = 0; i < 4; ++i)
+    hash = xxh64_merge(hash, lanes[i]);
+  return hash;
+}
+
+uint64 eve::hash::xxh64(const void* data, eve::size size, uint64 seed)
+{
+  auto bytes = static_cast<const unsigned char*>(data);
+  uint64 hash;
+  eve::size left = size;
+
+  if (size >= 32)
+  {
+    uint64 lanes[4];
+    xxh64_init(lanes, seed);
+    left = xxh64_stripes(lanes, bytes, size);
+    hash = xxh64_converge(lanes);
+  }
+  else
+    hash = seed + k_prime5;
+
+  return xxh64_finalize(hash + size, bytes, left);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+hash::xxh64_state::xxh64_state(uint64 seed)
+{
+  reset(seed);
+}
+
+void hash::xxh64_state::reset(uint64 seed)
+{
+  xxh64_init(m_lanes, seed);
+  m_seed = seed;
+  m_length = 0;
+  m_npending = 0;
+}
+
+void hash::xxh64_state::update(const void* data, eve::size size)
+{
+  auto bytes = static_cast<const unsigned char*>(data);
+  m_length += size;
+
+  // complete the pending stripe first
+  if (m_npending > 0)
+  {
+    eve::size fill = size < 32 - m_npending ? size : 32 - m_npending;
+    std::memcpy(m_pending + m_npending, bytes, fill);
+    m_npending += fill;
+    bytes += fill;
+    size -= fill;
+    if (m_npending < 32)
+      return;
+    const unsigned char* pending = m_pending;
+    xxh64_stripes(m_lanes, pending, 32);
+    m_npending = 0;
+  }
+
+  size = xxh64_stripes(m_lanes, bytes, size);
+  std::memcpy(m_pending, bytes, size);
+  m_npending = size;
+}
+
+uint64 hash::xxh64_state::digest() const
+{
+  uint64 hash = m_length >= 32 ? xxh64_converge(m_lanes) : m_seed + k_prime5;
+  return xxh64_finalize(hash + m_length, m_pending, m_npending);
+}
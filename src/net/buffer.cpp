@@ -28,60 +28,113 @@
 #include "eve/net/buffer.h"
 #include "eve/net/socket.h"
 #include "eve/allocator.h"
+#include <cstring>
 
 using namespace eve::net;
 
-buffer::buffer(eve::socket* socket, eve::size capacity)
-  : m_socket(socket)
+buffer::buffer(stream* stream, eve::size capacity, eve::size max_capacity)
+  : m_stream(stream)
+  , m_input(nullptr)
+  , m_input_capacity(0)
 {
-  capacity = std::max<eve::size>(capacity, 2);
-  auto doublecapacity = capacity * 2;
+  m_capacity = std::max<eve::size>(capacity, 2);
+  m_max_capacity = std::max(max_capacity, m_capacity);
 
-  m_buffer = (char*)eve::allocator::global().allocate(doublecapacity, 1);
-  setg(m_buffer, m_buffer + capacity, m_buffer + capacity);
-  setp(m_buffer + capacity, m_buffer + doublecapacity);
+  m_output = (char*)eve::allocator::global().allocate(m_capacity, 1);
+  setp(m_output, m_output + m_capacity);
+
+  setg(nullptr, nullptr, nullptr);
+  reallocate_input(m_capacity);
 }
 
 buffer::buffer(buffer&& rhs)
-  : m_buffer(nullptr)
+  : m_output(nullptr)
+  , m_input(nullptr)
 {
   *this = std::move(rhs);
 }
 
 buffer::~buffer()
 {
-  if (m_buffer)
-    eve::allocator::global().deallocate(m_buffer);
+  if (m_output)
+    eve::allocator::global().deallocate(m_output);
+  if (m_input)
+    eve::allocator::global().deallocate(m_input);
 }
 
 bool buffer::try_fill()
 {
   validate();
+  fill(false);
+  return gptr() < egptr();
+}
 
-  if (gptr() < egptr())
-    return true;
+void buffer::reserve(eve::size size)
+{
+  if (size > m_input_capacity)
+    reallocate_input(size);
+}
 
-  auto capacity = (epptr() - eback()) >> 1;
-  eve::size bytes = eve::size(capacity);
-  if (!m_socket->try_receive(eback(), bytes))
-    return false;
-  setg(eback(), eback(), eback() + bytes);
+bool buffer::ensure(eve::size size)
+{
+  validate();
+  reserve(size);
+
+  while (available() < size)
+  {
+    if (!fill(true))
+      return false;
+  }
   return true;
 }
 
+void buffer::consume(eve::size size)
+{
+  eve_assert(size <= available());
+  gbump(int(size));
+}
+
+void buffer::write_ref(const char* data, eve::size size)
+{
+  validate();
+  freeze();
+  stream::chunk chunk = { data, size };
+  m_chain.push_back(chunk);
+}
+
+void buffer::cork()
+{
+  validate();
+  m_stream->cork(true);
+}
+
+void buffer::uncork()
+{
+  sync();
+  m_stream->cork(false);
+}
+
 buffer& buffer::operator=(buffer&& rhs)
 {
-  if (m_buffer)
-    eve::allocator::global().deallocate(m_buffer);
+  if (m_output)
+    eve::allocator::global().deallocate(m_output);
+  if (m_input)
+    eve::allocator::global().deallocate(m_input);
 
-  m_socket = rhs.m_socket;
-  m_buffer = rhs.m_buffer;
+  m_stream = rhs.m_stream;
+  m_output = rhs.m_output;
+  m_input = rhs.m_input;
+  m_capacity = rhs.m_capacity;
+  m_input_capacity = rhs.m_input_capacity;
+  m_max_capacity = rhs.m_max_capacity;
+  m_chain = std::move(rhs.m_chain);
   setp(rhs.pbase(), rhs.epptr());
   pbump(int(rhs.pptr() - rhs.pbase()));
   setg(rhs.eback(), rhs.gptr(), rhs.egptr());
 
-  rhs.m_socket = nullptr;
-  rhs.m_buffer = nullptr;
+  rhs.m_stream = nullptr;
+  rhs.m_output = nullptr;
+  rhs.m_input = nullptr;
   rhs.setp(nullptr, nullptr);
   rhs.setg(nullptr, nullptr, nullptr);
 
@@ -92,9 +145,16 @@ int buffer::sync()
 {
   validate();
 
-  if (pbase() < pptr())
+  if (!m_chain.empty())
+  {
+    freeze();
+    m_stream->send_all(m_chain.data(), eve::size(m_chain.size()));
+    m_chain.clear();
+    setp(m_output, m_output + m_capacity);
+  }
+  else if (pbase() < pptr())
   {
-    m_socket->send_all(pbase(), int(pptr() - pbase()));
+    m_stream->send_all(pbase(), int(pptr() - pbase()));
     setp(pbase(), epptr());
   }
   return 0;
@@ -103,10 +163,10 @@ int buffer::sync()
 buffer::int_type buffer::underflow()
 {
   validate();
-  auto capacity = size(epptr() - eback()) >> 1;
-  auto bytes = m_socket->receive(eback(), capacity);
-  setg(eback(), eback(), eback() + bytes);
-  return *eback();
+
+  if (gptr() == egptr() && !fill(true))
+    return traits::eof();
+  return traits::to_int_type(*gptr());
 }
 
 buffer::int_type buffer::overflow(int_type meta)
@@ -124,8 +184,118 @@ buffer::int_type buffer::overflow(int_type meta)
   return meta;
 }
 
+std::streamsize buffer::xsputn(const char_type* data, std::streamsize count)
+{
+  validate();
+
+  // writes larger than the put area are sent from where they are instead of copied in pieces
+  if (count < std::streamsize(m_capacity))
+    return std::streambuf::xsputn(data, count);
+
+  freeze();
+  stream::chunk chunk = { data, eve::size(count) };
+  m_chain.push_back(chunk);
+  sync();
+  return count;
+}
+
+std::streamsize buffer::xsgetn(char_type* data, std::streamsize count)
+{
+  validate();
+
+  std::streamsize done = 0;
+  while (done < count)
+  {
+    auto buffered = std::min(std::streamsize(egptr() - gptr()), count - done);
+    if (buffered > 0)
+    {
+      memcpy(data + done, gptr(), size_t(buffered));
+      gbump(int(buffered));
+      done += buffered;
+      continue;
+    }
+
+    // what does not fit the input buffer is received in place
+    auto left = count - done;
+    if (left >= std::streamsize(m_input_capacity))
+    {
+      auto received = m_stream->receive(data + done, eve::size(left));
+      if (received == 0)
+        break;
+      done += received;
+    }
+    else if (!fill(true))
+      break;
+  }
+  return done;
+}
+
+void buffer::freeze()
+{
+  // written bytes become a chunk and the put area continues after them
+  if (pbase() < pptr())
+  {
+    stream::chunk chunk = { pbase(), eve::size(pptr() - pbase()) };
+    m_chain.push_back(chunk);
+    setp(pptr(), epptr());
+  }
+}
+
+bool buffer::fill(bool block)
+{
+  // move unread bytes to the front once less than half of the buffer is left behind them
+  auto unread = eve::size(egptr() - gptr());
+  if (eve::size(m_input + m_input_capacity - egptr()) < m_input_capacity / 2)
+  {
+    memmove(m_input, gptr(), unread);
+    setg(m_input, m_input, m_input + unread);
+  }
+
+  auto room = eve::size(m_input + m_input_capacity - egptr());
+  if (room == 0)
+  {
+    if (m_input_capacity >= m_max_capacity)
+      return true;
+    reallocate_input(std::min(m_input_capacity * 2, m_max_capacity));
+    room = eve::size(m_input + m_input_capacity - egptr());
+  }
+
+  auto received = room;
+  if (block)
+    received = m_stream->receive(egptr(), room);
+  else if (!m_stream->try_receive(egptr(), received))
+    return false;
+
+  // zero bytes means the peer closed the connection
+  if (received == 0)
+    return false;
+
+  setg(eback(), gptr(), egptr() + received);
+
+  // all the room was used, more was likely waiting: receive more at once next time
+  if (received == room && m_input_capacity < m_max_capacity)
+    reallocate_input(std::min(m_input_capacity * 2, m_max_capacity));
+
+  return true;
+}
+
+void buffer::reallocate_input(eve::size capacity)
+{
+  auto unread = eve::size(egptr() - gptr());
+  auto input = (char*)eve::allocator::global().allocate(capacity, 1);
+  if (unread > 0)
+    memcpy(input, gptr(), unread);
+
+  if (m_input)
+    eve::allocator::global().deallocate(m_input);
+
+  m_input = input;
+  m_input_capacity = capacity;
+  setg(m_input, m_input, m_input + unread);
+}
+
 void buffer::validate() const
 {
-  if (!m_socket)
-    throw std::runtime_error("Network buffer has no socket associated to.");
+  if (!m_stream)
+    throw std::runtime_error("Network buffer has no stream associated to.");
 }
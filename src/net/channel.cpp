@@ -0,0 +1,464 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/channel.h"
+#include "eve/span.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace eve::net;
+
+// sent and received datagrams tracked, and reliable messages in flight per stream
+static const eve::size k_packet_window = 1024;
+static const eve::size k_message_window = 1024;
+
+// unreliable messages still missing fragments are dropped once this much older than the newest
+static const eve::uint16 k_unreliable_window = 32;
+
+// sequence, ack and ack bits / stream, id, fragment, count and length
+static const eve::size k_packet_header = 8;
+static const eve::size k_fragment_header = 9;
+
+static const eve::uint32 k_received = 0x10000;
+
+inline bool sequence_greater(eve::uint16 a, eve::uint16 b)
+{
+  return a != b && eve::uint16(a - b) < 0x8000;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+channel::config::config()
+  : mtu(1200)
+  , max_message_size(1024 * 1024)
+  , min_rto(0.02)
+  , max_rto(1.0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+channel::channel(transmit transmit, const config& configuration)
+  : m_transmit(std::move(transmit))
+  , m_config(configuration)
+  , m_sent_packets(k_packet_window)
+  , m_sequence(0)
+  , m_received(k_packet_window, 0)
+  , m_remote_sequence(0)
+  , m_ack_pending(false)
+  , m_srtt(0)
+  , m_rttvar(0)
+  , m_rto(std::min(std::max(0.1, configuration.min_rto), configuration.max_rto))
+  , m_sent(0)
+  , m_resent(0)
+{
+  if (m_config.mtu <= k_packet_header + k_fragment_header)
+    throw std::runtime_error("Channel mtu too small.");
+
+  for (auto& packet : m_sent_packets)
+    packet.valid = false;
+}
+
+channel::~channel()
+{
+}
+
+eve::uint8 channel::add_stream(delivery delivery)
+{
+  if (m_streams.size() > 255)
+    throw std::runtime_error("Too many channel streams.");
+
+  stream s;
+  s.mode = delivery;
+  s.next_send = 0;
+  s.next_receive = 0;
+  s.newest_receive = 0;
+  m_streams.push_back(std::move(s));
+  return eve::uint8(m_streams.size() - 1);
+}
+
+void channel::send(eve::uint8 index, const char* data, eve::size size)
+{
+  if (index >= m_streams.size())
+    throw std::out_of_range("Invalid channel stream.");
+  if (size > m_config.max_message_size)
+    throw std::runtime_error("Channel message too large.");
+
+  auto& s = m_streams[index];
+  auto fragments = std::max<eve::size>((size + fragment_size() - 1) / fragment_size(), 1);
+  if (fragments > 0xffff)
+    throw std::runtime_error("Channel message too large.");
+
+  outgoing message;
+  message.id = s.next_send++;
+  message.data.assign(data, data + size);
+  message.sent.assign(fragments, -1.0);
+  message.acked.assign(fragments, false);
+  message.unacked = fragments;
+  s.queue.push_back(std::move(message));
+}
+
+bool channel::receive(const char* data, eve::size size, double now)
+{
+  try
+  {
+    eve::span_reader reader(data, size);
+    eve::uint16 sequence, ack;
+    eve::uint32 ack_bits;
+    reader >> sequence >> ack >> ack_bits;
+
+    // drop duplicated and too old datagrams
+    bool any = m_received[m_remote_sequence % k_packet_window] != 0;
+    if (!any || sequence_greater(sequence, m_remote_sequence))
+    {
+      // forget what was received a window ago in the slots about to be reused
+      auto skipped = any ? std::min<eve::size>(eve::uint16(sequence - m_remote_sequence), k_packet_window) : 0;
+      for (eve::size i = 1; i < skipped; ++i)
+        m_received[eve::uint16(m_remote_sequence + i) % k_packet_window] = 0;
+      m_remote_sequence = sequence;
+    }
+    else if (eve::uint16(m_remote_sequence - sequence) >= k_packet_window)
+      return true;
+    else if (m_received[sequence % k_packet_window] == (k_received | sequence))
+      return true;
+
+    m_received[sequence % k_packet_window] = k_received | sequence;
+    m_ack_pending = true;
+
+    for (eve::uint16 i = 0; i < 32; ++i)
+    {
+      if (ack_bits & (1u << i))
+        acknowledge(eve::uint16(ack - i), now);
+    }
+
+    while (reader.remaining() > 0)
+    {
+      eve::uint8 stream;
+      eve::uint16 id, fragment, count, length;
+      reader >> stream >> id >> fragment >> count >> length;
+      if (stream >= m_streams.size() || fragment >= count || length > fragment_size() || length > reader.remaining())
+        return false;
+
+      process(stream, id, fragment, count, data + reader.position(), length);
+      reader.skip(length);
+    }
+  }
+  catch (std::runtime_error&)
+  {
+    return false;
+  }
+
+  return true;
+}
+
+bool channel::pop(message& message)
+{
+  if (m_inbox.empty())
+    return false;
+
+  message = std::move(m_inbox.front());
+  m_inbox.pop_front();
+  return true;
+}
+
+void channel::update(double now)
+{
+  bool open = false;
+  bool timed_out = false;
+  auto payload = fragment_size();
+
+  for (eve::size index = 0; index < m_streams.size(); ++index)
+  {
+    auto& s = m_streams[index];
+    bool reliable = s.mode != delivery::unreliable;
+
+    for (auto& message : s.queue)
+    {
+      // never run further ahead of the oldest unacknowledged message than the peer tracks
+      if (reliable && eve::uint16(message.id - s.queue.front().id) >= k_message_window)
+        break;
+
+      for (eve::size fragment = 0; fragment < message.sent.size(); ++fragment)
+      {
+        if (message.acked[fragment])
+          continue;
+
+        auto sent = message.sent[fragment];
+        if (sent >= 0)
+        {
+          if (now - sent < m_rto)
+            continue;
+          ++m_resent;
+          timed_out = true;
+        }
+
+        auto offset = fragment * payload;
+        auto length = std::min(payload, eve::size(message.data.size() - offset));
+        if (open && m_packet.size() + k_fragment_header + length > m_config.mtu)
+        {
+          flush_packet(now);
+          open = false;
+        }
+        if (!open)
+        {
+          begin_packet();
+          open = true;
+        }
+
+        append(eve::uint8(index), message, eve::uint16(fragment));
+        if (reliable)
+        {
+          fragment_ref ref = { eve::uint8(index), message.id, eve::uint16(fragment) };
+          m_packet_fragments.push_back(ref);
+        }
+        message.sent[fragment] = now;
+      }
+    }
+
+    // unreliable messages get a single chance
+    if (!reliable)
+      s.queue.clear();
+  }
+
+  if (!open && m_ack_pending)
+  {
+    begin_packet();
+    open = true;
+  }
+
+  if (open)
+    flush_packet(now);
+
+  // backs off until the next round trip is measured, as in RFC 6298
+  if (timed_out)
+    m_rto = std::min(m_rto * 2, m_config.max_rto);
+}
+
+eve::size channel::pending() const
+{
+  eve::size count = 0;
+  for (auto& s : m_streams)
+    count += eve::size(s.queue.size());
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+eve::size channel::fragment_size() const
+{
+  return m_config.mtu - k_packet_header - k_fragment_header;
+}
+
+void channel::acknowledge(eve::uint16 sequence, double now)
+{
+  auto& packet = m_sent_packets[sequence % k_packet_window];
+  if (!packet.valid || packet.acked || packet.sequence != sequence)
+    return;
+  packet.acked = true;
+
+  // smoothed round trip time and retransmission timeout as in RFC 6298
+  auto sample = now - packet.time;
+  if (m_srtt == 0)
+  {
+    m_srtt = sample;
+    m_rttvar = sample / 2;
+  }
+  else
+  {
+    m_rttvar = 0.75 * m_rttvar + 0.25 * std::abs(m_srtt - sample);
+    m_srtt = 0.875 * m_srtt + 0.125 * sample;
+  }
+  m_rto = std::min(std::max(m_srtt + 4 * m_rttvar, m_config.min_rto), m_config.max_rto);
+
+  for (auto& ref : packet.fragments)
+  {
+    auto& queue = m_streams[ref.stream].queue;
+    if (queue.empty())
+      continue;
+
+    eve::size index = eve::uint16(ref.id - queue.front().id);
+    if (index >= queue.size())
+      continue;
+
+    auto& message = queue[index];
+    if (!message.acked[ref.fragment])
+    {
+      message.acked[ref.fragment] = true;
+      --message.unacked;
+    }
+  }
+
+  for (auto& ref : packet.fragments)
+  {
+    auto& queue = m_streams[ref.stream].queue;
+    while (!queue.empty() && queue.front().unacked == 0)
+      queue.pop_front();
+  }
+  packet.fragments.clear();
+}
+
+void channel::process(eve::uint8 index, eve::uint16 id, eve::uint16 fragment, eve::uint16 count, const char* data, eve::uint16 size)
+{
+  auto& s = m_streams[index];
+  auto payload = fragment_size();
+
+  if (eve::size(count) * payload > m_config.max_message_size + payload)
+    return;
+  if (fragment + 1 < count && size != payload)
+    return;
+
+  if (s.mode == delivery::unreliable)
+  {
+    if (sequence_greater(id, s.newest_receive) || s.partial.empty())
+    {
+      s.newest_receive = id;
+      for (auto it = s.partial.begin(); it != s.partial.end();)
+      {
+        if (eve::uint16(id - it->first) > k_unreliable_window)
+          it = s.partial.erase(it);
+        else
+          ++it;
+      }
+    }
+    else if (eve::uint16(s.newest_receive - id) > k_unreliable_window)
+      return;
+  }
+  else
+  {
+    // behind the window it's a duplicate, far ahead it's garbage
+    if (eve::uint16(id - s.next_receive) >= k_message_window || s.delivered.count(id) || s.complete.count(id))
+      return;
+  }
+
+  auto it = s.partial.find(id);
+  if (it == s.partial.end())
+  {
+    incoming message;
+    message.data.resize(eve::size(count) * payload);
+    message.received.assign(count, false);
+    message.missing = count;
+    message.size = eve::size(count) * payload;
+    it = s.partial.insert(std::make_pair(id, std::move(message))).first;
+  }
+
+  auto& message = it->second;
+  if (message.received.size() != count || message.received[fragment])
+    return;
+
+  memcpy(message.data.data() + fragment * payload, data, size);
+  message.received[fragment] = true;
+  --message.missing;
+  if (fragment + 1 == count)
+    message.size = eve::size(fragment) * payload + size;
+
+  if (message.missing > 0)
+    return;
+
+  auto complete = std::move(message.data);
+  complete.resize(message.size);
+  s.partial.erase(it);
+
+  switch (s.mode)
+  {
+  case delivery::unreliable:
+    deliver(index, std::move(complete));
+    break;
+
+  case delivery::reliable_unordered:
+    deliver(index, std::move(complete));
+    s.delivered.insert(id);
+    while (s.delivered.erase(s.next_receive))
+      ++s.next_receive;
+    break;
+
+  case delivery::reliable_ordered:
+    s.complete[id] = std::move(complete);
+    for (auto next = s.complete.find(s.next_receive); next != s.complete.end(); next = s.complete.find(s.next_receive))
+    {
+      deliver(index, std::move(next->second));
+      s.complete.erase(next);
+      ++s.next_receive;
+    }
+    break;
+  }
+}
+
+void channel::deliver(eve::uint8 stream, std::vector<char>&& data)
+{
+  message m;
+  m.stream = stream;
+  m.data = std::move(data);
+  m_inbox.push_back(std::move(m));
+}
+
+void channel::begin_packet()
+{
+  // bit n acknowledges the datagram n before the latest one received
+  eve::uint32 ack_bits = 0;
+  for (eve::uint16 i = 0; i < 32; ++i)
+  {
+    eve::uint16 sequence = m_remote_sequence - i;
+    if (m_received[sequence % k_packet_window] == (k_received | sequence))
+      ack_bits |= 1u << i;
+  }
+
+  m_packet.clear();
+  m_packet_fragments.clear();
+  eve::span_writer<std::vector<char>> writer(m_packet);
+  writer.reserve(k_packet_header);
+  writer << m_sequence << m_remote_sequence << ack_bits;
+}
+
+void channel::append(eve::uint8 stream, const outgoing& message, eve::uint16 fragment)
+{
+  auto payload = fragment_size();
+  auto offset = fragment * payload;
+  auto length = std::min(payload, eve::size(message.data.size() - offset));
+
+  eve::span_writer<std::vector<char>> writer(m_packet);
+  writer.reserve(eve::size(k_fragment_header + length));
+  writer << stream << message.id << fragment << eve::uint16(message.sent.size()) << eve::uint16(length);
+  writer.write(message.data.data() + offset, length);
+}
+
+void channel::flush_packet(double now)
+{
+  auto& packet = m_sent_packets[m_sequence % k_packet_window];
+  packet.sequence = m_sequence;
+  packet.valid = true;
+  packet.acked = false;
+  packet.time = now;
+  packet.fragments.swap(m_packet_fragments);
+  m_packet_fragments.clear();
+
+  m_transmit(m_packet.data(), eve::size(m_packet.size()));
+  ++m_sequence;
+  ++m_sent;
+  m_ack_pending = false;
+}
@@ -0,0 +1,277 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/clock.h"
+#include "eve/span.h"
+#include "eve/time.h"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+
+using namespace eve::net;
+
+namespace
+{
+  // 'evts', in front of every message so that stray datagrams are ignored
+  const eve::uint32 k_magic = 0x65767473;
+
+  enum kind : eve::uint8 { k_request, k_response };
+
+  // requests are as large as responses so that the service cannot amplify spoofed traffic
+  struct message
+  {
+    eve::uint8 kind;
+    eve::uint32 sequence;
+    double t0;
+    double t1;
+    double t2;
+  };
+
+  eve::size encode(const message& m, char* data)
+  {
+    std::vector<char> bytes;
+    {
+      eve::span_writer<std::vector<char>> writer(bytes);
+      writer.reserve(clock_sync::message_size);
+      writer << k_magic << m.kind << m.sequence << m.t0 << m.t1 << m.t2;
+    }
+    std::copy(bytes.begin(), bytes.end(), data);
+    return eve::size(bytes.size());
+  }
+
+  bool decode(const char* data, eve::size size, message& m)
+  {
+    if (size != clock_sync::message_size)
+      return false;
+
+    eve::span_reader reader(data, size);
+    eve::uint32 magic;
+    reader >> magic >> m.kind >> m.sequence >> m.t0 >> m.t1 >> m.t2;
+    return magic == k_magic;
+  }
+
+  time_service::clock default_clock(time_service::clock time_source)
+  {
+    if (time_source)
+      return time_source;
+
+    auto stopwatch = std::make_shared<eve::stopwatch>();
+    return [stopwatch] { return stopwatch->elapsed(); };
+  }
+
+  // exchanges whose round trip exceeds the smallest by more than this are queued, not trusted
+  double tolerance(double min_rtt)
+  {
+    return std::max(min_rtt * 0.5, 0.001);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+time_service::time_service(clock time_source)
+  : m_clock(default_clock(std::move(time_source)))
+{
+}
+
+eve::size time_service::respond(const char* data, eve::size size, char* response)
+{
+  message m;
+  if (!decode(data, size, m) || m.kind != k_request)
+    return 0;
+
+  m.kind = k_response;
+  m.t1 = m_clock();
+  m.t2 = m_clock();
+  return encode(m, response);
+}
+
+eve::size time_service::poll(eve::socket& socket)
+{
+  char data[clock_sync::message_size + 1], response[clock_sync::message_size];
+  eve::socket::address from;
+  eve::size answered = 0;
+  for (;;)
+  {
+    eve::size size = sizeof(data);
+    if (!socket.try_receive_from(data, size, from))
+      return answered;
+
+    if (auto length = respond(data, size, response))
+    {
+      socket.try_send_to(response, length, from);
+      ++answered;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const eve::size clock_sync::message_size;
+
+clock_sync::config::config()
+  : window(64)
+  , max_slew(0.05)
+{
+}
+
+clock_sync::clock_sync(const config& configuration, clock time_source)
+  : m_config(configuration)
+  , m_clock(default_clock(std::move(time_source)))
+  , m_sequence(0)
+  , m_min_rtt(0)
+  , m_reference(0)
+  , m_offset(0)
+  , m_drift(0)
+  , m_slewing(false)
+  , m_applied(0)
+  , m_last_local(0)
+  , m_last_server(-std::numeric_limits<double>::infinity())
+{
+}
+
+eve::size clock_sync::request(char* data)
+{
+  message m;
+  m.kind = k_request;
+  m.sequence = ++m_sequence;
+  m.t0 = m_clock();
+  m.t1 = m.t2 = 0;
+
+  // the responses to requests older than the window would not be used anyway
+  m_pending.push_back(std::make_pair(m.sequence, m.t0));
+  if (m_pending.size() > m_config.window)
+    m_pending.pop_front();
+  return encode(m, data);
+}
+
+bool clock_sync::receive(const char* data, eve::size size)
+{
+  auto t3 = m_clock();
+
+  message m;
+  if (!decode(data, size, m) || m.kind != k_response)
+    return false;
+
+  // the origin time is taken from the request sent, never trusted from the wire
+  auto pending = std::find_if(m_pending.begin(), m_pending.end(), [&] (const std::pair<eve::uint32, double>& p) { return p.first == m.sequence; });
+  if (pending == m_pending.end())
+    return false;
+  auto t0 = pending->second;
+  m_pending.erase(pending);
+
+  sample s;
+  s.rtt = std::max((t3 - t0) - (m.t2 - m.t1), 0.0);
+  s.offset = ((m.t1 - t0) + (m.t2 - t3)) / 2;
+  s.local = (t0 + t3) / 2;
+  m_samples.push_back(s);
+  if (m_samples.size() > m_config.window)
+    m_samples.pop_front();
+
+  estimate();
+  return true;
+}
+
+void clock_sync::request(eve::socket& socket, const eve::socket::address& server)
+{
+  char data[message_size];
+  socket.send_to(data, request(data), server);
+}
+
+eve::size clock_sync::poll(eve::socket& socket)
+{
+  char data[message_size + 1];
+  eve::socket::address from;
+  eve::size processed = 0;
+  for (;;)
+  {
+    eve::size size = sizeof(data);
+    if (!socket.try_receive_from(data, size, from))
+      return processed;
+    if (receive(data, size))
+      ++processed;
+  }
+}
+
+double clock_sync::offset() const
+{
+  return m_offset + m_drift * (m_clock() - m_reference);
+}
+
+double clock_sync::server_time()
+{
+  auto now = m_clock();
+  // the local time is not published: the first estimate must not be held back by it
+  if (!synchronized())
+    return now;
+
+  auto target = m_offset + m_drift * (now - m_reference);
+  if (!m_slewing)
+  {
+    // the first estimate is taken as is, there is nothing to be continuous with yet
+    m_applied = target;
+    m_slewing = true;
+  }
+  else
+  {
+    auto limit = m_config.max_slew * std::max(now - m_last_local, 0.0);
+    m_applied += std::min(std::max(target - m_applied, -limit), limit);
+  }
+  m_last_local = now;
+  return m_last_server = std::max(now + m_applied, m_last_server);
+}
+
+void clock_sync::estimate()
+{
+  m_min_rtt = std::numeric_limits<double>::infinity();
+  for (auto& s : m_samples)
+    m_min_rtt = std::min(m_min_rtt, s.rtt);
+  auto limit = m_min_rtt + tolerance(m_min_rtt);
+
+  double n = 0, mean_x = 0, mean_y = 0;
+  for (auto& s : m_samples)
+    if (s.rtt <= limit)
+    {
+      ++n;
+      mean_x += (s.local - mean_x) / n;
+      mean_y += (s.offset - mean_y) / n;
+    }
+
+  double sxx = 0, sxy = 0;
+  for (auto& s : m_samples)
+    if (s.rtt <= limit)
+    {
+      sxx += (s.local - mean_x) * (s.local - mean_x);
+      sxy += (s.local - mean_x) * (s.offset - mean_y);
+    }
+
+  // the drift is kept until the trusted exchanges span long enough to measure it
+  if (n >= 3 && sxx > 1e-6)
+    m_drift = sxy / sxx;
+  m_reference = mean_x;
+  m_offset = mean_y;
+}
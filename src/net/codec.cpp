@@ -0,0 +1,224 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/codec.h"
+#include "eve/net/buffer.h"
+#include "eve/net/socket.h"
+#include "eve/allocator.h"
+#include "eve/debug.h"
+#include <cstring>
+
+using namespace eve::net;
+
+// a varint of a 64 bit length never takes more than 10 bytes
+static const eve::size k_max_header = 10;
+
+// pooled blocks are 64 << size class bytes large
+static const eve::size k_min_block = 64;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+message_codec::message::message()
+  : m_codec(nullptr)
+  , m_data(nullptr)
+  , m_size(0)
+  , m_class(0)
+{
+}
+
+message_codec::message::message(message&& rhs)
+  : m_codec(nullptr)
+  , m_data(nullptr)
+  , m_size(0)
+  , m_class(0)
+{
+  *this = std::move(rhs);
+}
+
+message_codec::message::~message()
+{
+  release();
+}
+
+void message_codec::message::release()
+{
+  if (m_data)
+    m_codec->recycle(m_data, m_class);
+
+  m_data = nullptr;
+  m_size = 0;
+}
+
+message_codec::message& message_codec::message::operator=(message&& rhs)
+{
+  release();
+  m_codec = rhs.m_codec;
+  m_data = rhs.m_data;
+  m_size = rhs.m_size;
+  m_class = rhs.m_class;
+  rhs.m_data = nullptr;
+  rhs.m_size = 0;
+  return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+message_codec::message_codec(eve::net::buffer& buffer, eve::size max_message_size)
+  : m_buffer(&buffer)
+  , m_max_message_size(max_message_size)
+  , m_outstanding(0)
+{
+}
+
+message_codec::~message_codec()
+{
+  eve_assert(m_outstanding == 0);
+  for (auto& blocks : m_pool)
+  {
+    for (auto block : blocks)
+      eve::allocator::global().deallocate(block);
+  }
+}
+
+void message_codec::write(const char* data, eve::size size)
+{
+  // LEB128 length, 7 bits per byte
+  auto length = eve::uint64(size);
+  do
+  {
+    auto byte = char(length & 0x7f);
+    length >>= 7;
+    m_outgoing.push_back(length ? char(byte | 0x80) : byte);
+  } while (length);
+
+  m_outgoing.insert(m_outgoing.end(), data, data + size);
+}
+
+eve::size message_codec::flush()
+{
+  auto size = eve::size(m_outgoing.size());
+  if (size == 0)
+    return 0;
+
+  m_buffer->write_ref(m_outgoing.data(), size);
+  m_buffer->pubsync();
+  m_outgoing.clear();
+  return size;
+}
+
+bool message_codec::try_read(message& message)
+{
+  return decode(message, false);
+}
+
+bool message_codec::read(message& message)
+{
+  return decode(message, true);
+}
+
+eve::size message_codec::pooled() const
+{
+  eve::size count = 0;
+  for (auto& blocks : m_pool)
+    count += eve::size(blocks.size());
+  return count;
+}
+
+bool message_codec::decode(message& message, bool block)
+{
+  for (;;)
+  {
+    auto data = reinterpret_cast<const unsigned char*>(m_buffer->peek());
+    auto available = m_buffer->available();
+
+    eve::uint64 length = 0;
+    eve::size header = 0;
+    bool complete = false;
+    while (header < available && header < k_max_header)
+    {
+      auto byte = data[header];
+      length |= eve::uint64(byte & 0x7f) << (7 * header);
+      ++header;
+      if (!(byte & 0x80))
+      {
+        complete = true;
+        break;
+      }
+    }
+
+    if (!complete && header == k_max_header)
+      throw eve::socket_error("Malformed message frame.");
+    if (complete && length > m_max_message_size)
+      throw eve::socket_error("Message frame exceeds the maximum message size.");
+
+    auto needed = complete ? header + eve::size(length) : available + 1;
+    if (available >= needed)
+    {
+      message.release();
+      message.m_codec = this;
+      message.m_data = acquire(eve::size(length), message.m_class);
+      message.m_size = eve::size(length);
+      memcpy(message.m_data, data + header, message.m_size);
+      m_buffer->consume(needed);
+      return true;
+    }
+
+    m_buffer->reserve(needed);
+    if (block)
+    {
+      if (!m_buffer->ensure(needed))
+        return false;
+    }
+    else if (!m_buffer->try_fill() || m_buffer->available() == available)
+      return false;
+  }
+}
+
+char* message_codec::acquire(eve::size size, eve::uint8& size_class)
+{
+  size_class = 0;
+  while ((k_min_block << size_class) < size)
+    ++size_class;
+
+  if (m_pool.size() <= size_class)
+    m_pool.resize(size_class + 1);
+
+  ++m_outstanding;
+  auto& blocks = m_pool[size_class];
+  if (blocks.empty())
+    return (char*)eve::allocator::global().allocate(eve::size(k_min_block << size_class), 8);
+
+  auto block = blocks.back();
+  blocks.pop_back();
+  return block;
+}
+
+void message_codec::recycle(char* data, eve::uint8 size_class)
+{
+  --m_outstanding;
+  m_pool[size_class].push_back(data);
+}
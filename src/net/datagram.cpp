@@ -0,0 +1,412 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/datagram.h"
+#include "eve/allocator.h"
+#include "eve/memory.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(EVE_LINUX)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+// kernel limits for a single segmented datagram
+static const eve::size k_max_segments = 64;
+static const eve::size k_max_coalesced = 65507;
+static const eve::size k_control_size = CMSG_SPACE(sizeof(int));
+
+#elif defined(EVE_WINDOWS)
+#include <WinSock2.h>
+#endif
+
+using namespace eve::net;
+
+#if defined(EVE_LINUX)
+
+struct packet_ring::backend
+{
+  backend(eve::size capacity)
+    : messages(capacity)
+    , iovecs(capacity)
+    , groups(capacity)
+    , controls(capacity * k_control_size)
+    , pending_offset(0)
+    , pending_end(0)
+    , pending_segment(0)
+  {
+  }
+
+  std::vector<mmsghdr> messages;
+  std::vector<iovec> iovecs;
+  std::vector<eve::size> groups;
+  std::vector<char> controls;
+
+  // last datagram coalesced by GRO, handed out segment by segment
+  std::vector<char> coalesced;
+  eve::socket::address pending_from;
+  eve::size pending_offset;
+  eve::size pending_end;
+  eve::size pending_segment;
+};
+
+#else
+
+struct packet_ring::backend
+{
+  backend(eve::size) { }
+};
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+packet_ring::packet_ring(eve::size capacity, eve::size packet_size)
+  : m_packet_size(packet_size)
+  , m_head(0)
+  , m_count(0)
+  , m_offload(false)
+{
+  capacity = std::max<eve::size>(capacity, 1);
+  m_storage = (char*)eve::allocator::global().allocate(capacity * packet_size, 16);
+
+  m_packets.resize(capacity);
+  for (eve::size i = 0; i < capacity; ++i)
+  {
+    m_packets[i].data = m_storage + i * packet_size;
+    m_packets[i].size = 0;
+  }
+
+  m_backend = eve_new backend(capacity);
+}
+
+packet_ring::~packet_ring()
+{
+  eve::destroy(m_backend);
+  eve::allocator::global().deallocate(m_storage);
+}
+
+packet& packet_ring::back()
+{
+  if (full())
+    throw std::out_of_range("Packet ring is full.");
+  return at(m_count);
+}
+
+void packet_ring::push()
+{
+  if (full())
+    throw std::out_of_range("Packet ring is full.");
+  ++m_count;
+}
+
+void packet_ring::push(const char* data, eve::size size, const eve::socket::address& to)
+{
+  if (size > m_packet_size)
+    throw std::out_of_range("Packet exceeds the ring packet size.");
+
+  auto& p = back();
+  memcpy(p.data, data, size);
+  p.size = size;
+  p.address = to;
+  ++m_count;
+}
+
+packet& packet_ring::front()
+{
+  if (empty())
+    throw std::out_of_range("Packet ring is empty.");
+  return at(0);
+}
+
+void packet_ring::pop()
+{
+  if (empty())
+    throw std::out_of_range("Packet ring is empty.");
+  m_head = (m_head + 1) % capacity();
+  --m_count;
+}
+
+void packet_ring::clear()
+{
+  m_head = 0;
+  m_count = 0;
+}
+
+#if defined(EVE_LINUX)
+
+eve::size packet_ring::receive(eve::socket& socket)
+{
+  if (m_offload)
+    return receive_coalesced(socket);
+
+  auto free = capacity() - m_count;
+  if (free == 0)
+    return 0;
+
+  auto& b = *m_backend;
+  for (eve::size i = 0; i < free; ++i)
+  {
+    auto& p = at(m_count + i);
+    b.iovecs[i].iov_base = p.data;
+    b.iovecs[i].iov_len = m_packet_size;
+
+    auto& header = b.messages[i].msg_hdr;
+    memset(&header, 0, sizeof(header));
+    header.msg_name = &p.address.m_pimpl.as<sockaddr_in6>();
+    header.msg_namelen = sizeof(sockaddr_in6);
+    header.msg_iov = &b.iovecs[i];
+    header.msg_iovlen = 1;
+  }
+
+  int result = recvmmsg(int(socket.native_handle()), b.messages.data(), unsigned(free), MSG_DONTWAIT, nullptr);
+  if (result < 0)
+  {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return 0;
+    throw eve::socket_error("An error occurred while receiving datagrams.", errno);
+  }
+
+  for (int i = 0; i < result; ++i)
+  {
+    auto& p = at(m_count + i);
+    p.size = std::min<eve::size>(b.messages[i].msg_len, m_packet_size);
+    p.address.update_domain();
+  }
+  m_count += result;
+  return eve::size(result);
+}
+
+eve::size packet_ring::receive_coalesced(eve::socket& socket)
+{
+  auto& b = *m_backend;
+  eve::size received = 0;
+
+  for (;;)
+  {
+    // hand out what is left of the last coalesced datagram first
+    while (b.pending_offset < b.pending_end && !full())
+    {
+      auto segment = std::min(b.pending_segment, b.pending_end - b.pending_offset);
+      auto& p = at(m_count);
+      p.size = std::min(segment, m_packet_size);
+      p.address = b.pending_from;
+      memcpy(p.data, b.coalesced.data() + b.pending_offset, p.size);
+      b.pending_offset += segment;
+      ++m_count;
+      ++received;
+    }
+
+    if (full())
+      return received;
+
+    iovec iov = { b.coalesced.data(), b.coalesced.size() };
+    msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_name = &b.pending_from.m_pimpl.as<sockaddr_in6>();
+    header.msg_namelen = sizeof(sockaddr_in6);
+    header.msg_iov = &iov;
+    header.msg_iovlen = 1;
+    header.msg_control = b.controls.data();
+    header.msg_controllen = k_control_size;
+
+    auto result = recvmsg(int(socket.native_handle()), &header, MSG_DONTWAIT);
+    if (result < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return received;
+      throw eve::socket_error("An error occurred while receiving datagrams.", errno);
+    }
+    b.pending_from.update_domain();
+
+    // without the control message the datagram was not coalesced
+    b.pending_segment = eve::size(result);
+    for (auto cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR(&header, cmsg))
+    {
+      if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+        b.pending_segment = eve::size(*(int*)CMSG_DATA(cmsg));
+    }
+    b.pending_offset = 0;
+    b.pending_end = eve::size(result);
+
+    // an empty datagram still makes a packet
+    if (result == 0)
+    {
+      auto& p = at(m_count);
+      p.size = 0;
+      p.address = b.pending_from;
+      ++m_count;
+      ++received;
+    }
+  }
+}
+
+eve::size packet_ring::send(eve::socket& socket)
+{
+  if (empty())
+    return 0;
+
+  auto& b = *m_backend;
+  eve::size messages = 0;
+  for (eve::size i = 0; i < m_count; ++messages)
+  {
+    auto& first = at(i);
+    eve::size group = 1;
+
+    // consecutive packets of the same size and destination leave as one segmented datagram,
+    // only the last segment may be shorter
+    if (m_offload && first.size > 0)
+    {
+      eve::size bytes = first.size;
+      while (i + group < m_count && group < k_max_segments)
+      {
+        auto& next = at(i + group);
+        if (next.size > first.size || next.size == 0 || next.address != first.address || bytes + next.size > k_max_coalesced)
+          break;
+        bytes += next.size;
+        ++group;
+        if (next.size < first.size)
+          break;
+      }
+    }
+
+    for (eve::size g = 0; g < group; ++g)
+    {
+      auto& p = at(i + g);
+      b.iovecs[i + g].iov_base = p.data;
+      b.iovecs[i + g].iov_len = p.size;
+    }
+
+    auto& header = b.messages[messages].msg_hdr;
+    memset(&header, 0, sizeof(header));
+    header.msg_name = &first.address.m_pimpl.as<sockaddr_in6>();
+    header.msg_namelen = socklen_t(first.address.native_size());
+    header.msg_iov = &b.iovecs[i];
+    header.msg_iovlen = group;
+
+    if (group > 1)
+    {
+      header.msg_control = &b.controls[messages * k_control_size];
+      header.msg_controllen = CMSG_SPACE(sizeof(eve::uint16));
+      auto cmsg = CMSG_FIRSTHDR(&header);
+      cmsg->cmsg_level = IPPROTO_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(eve::uint16));
+      *(eve::uint16*)CMSG_DATA(cmsg) = eve::uint16(first.size);
+    }
+
+    b.groups[messages] = group;
+    i += group;
+  }
+
+  int result = sendmmsg(int(socket.native_handle()), b.messages.data(), unsigned(messages), MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (result < 0)
+  {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+      return 0;
+    throw eve::socket_error("An error occurred while sending datagrams.", errno);
+  }
+
+  eve::size sent = 0;
+  for (int i = 0; i < result; ++i)
+    sent += b.groups[i];
+
+  m_head = (m_head + sent) % capacity();
+  m_count -= sent;
+  return sent;
+}
+
+bool packet_ring::enable_offload(eve::socket& socket)
+{
+  auto handle = int(socket.native_handle());
+
+  // probing the segment size option tells whether the kernel knows GSO at all
+  int segment = 0;
+  if (setsockopt(handle, IPPROTO_UDP, UDP_SEGMENT, &segment, sizeof(segment)) < 0)
+    return false;
+
+  int on = 1;
+  if (setsockopt(handle, IPPROTO_UDP, UDP_GRO, &on, sizeof(on)) < 0)
+    return false;
+
+  m_backend->coalesced.resize(65536);
+  m_offload = true;
+  return true;
+}
+
+#else
+
+eve::size packet_ring::receive(eve::socket& socket)
+{
+  eve::size received = 0;
+  while (!full())
+  {
+    auto& p = at(m_count);
+    p.size = m_packet_size;
+    if (!socket.try_receive_from(p.data, p.size, p.address))
+      break;
+    ++m_count;
+    ++received;
+  }
+  return received;
+}
+
+eve::size packet_ring::receive_coalesced(eve::socket& socket)
+{
+  return receive(socket);
+}
+
+eve::size packet_ring::send(eve::socket& socket)
+{
+  eve::size sent = 0;
+  while (!empty())
+  {
+    auto& p = front();
+    auto size = p.size;
+    if (!socket.try_send_to(p.data, size, p.address))
+      break;
+    pop();
+    ++sent;
+  }
+  return sent;
+}
+
+bool packet_ring::enable_offload(eve::socket&)
+{
+  return false;
+}
+
+#endif
@@ -0,0 +1,394 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/deflate.h"
+#include "eve/net/socket.h"
+#include "eve/time.h"
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+using namespace eve::net;
+
+// a frame is a kind byte and the varint size of its payload
+static const eve::uint8 k_raw = 0;
+static const eve::uint8 k_deflated = 1;
+static const eve::size k_max_header = 1 + 10;
+
+// bytes asked from the wrapped stream at once
+static const eve::size k_receive_size = 16 * 1024;
+
+// inflated bytes produced at once, decoding stops there until they are read
+static const eve::size k_inflate_size = 64 * 1024;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+deflate_stream::config::config()
+  : level(Z_DEFAULT_COMPRESSION)
+  , threshold(128)
+  , max_frame(16 * 1024 * 1024)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+deflate_stream::deflate_stream(stream* stream, const config& configuration)
+  : m_stream(stream)
+  , m_config(configuration)
+  , m_sent(0)
+  , m_wire_offset(0)
+  , m_plain_offset(0)
+  , m_frame_kind(k_raw)
+  , m_frame_left(0)
+  , m_frame_plain(0)
+  , m_in_frame(false)
+{
+  memset(&m_stats, 0, sizeof(m_stats));
+
+  auto out = m_deflate.construct<z_stream>();
+  memset(out, 0, sizeof(z_stream));
+  if (deflateInit(out, m_config.level) != Z_OK)
+    throw eve::socket_error("Cannot initialize deflate stream.");
+
+  auto in = m_inflate.construct<z_stream>();
+  memset(in, 0, sizeof(z_stream));
+  if (inflateInit(in) != Z_OK)
+  {
+    deflateEnd(out);
+    throw eve::socket_error("Cannot initialize inflate stream.");
+  }
+}
+
+deflate_stream::~deflate_stream()
+{
+  deflateEnd(&m_deflate.as<z_stream>());
+  inflateEnd(&m_inflate.as<z_stream>());
+  eve::destruct<z_stream>(&m_deflate.as<z_stream>());
+  eve::destruct<z_stream>(&m_inflate.as<z_stream>());
+}
+
+eve::size deflate_stream::send(const char* data, eve::size size)
+{
+  send_all(data, size);
+  return size;
+}
+
+void deflate_stream::send_all(const char* data, eve::size size)
+{
+  chunk unit = { data, size };
+  send_all(&unit, 1);
+}
+
+void deflate_stream::send_all(const chunk* chunks, eve::size count)
+{
+  flush();
+  frame(chunks, count);
+  flush();
+}
+
+eve::size deflate_stream::receive(char* buffer, eve::size size)
+{
+  for (;;)
+  {
+    if (decode() || size == 0)
+      return take(buffer, size);
+
+    auto used = m_wire.size();
+    m_wire.resize(used + k_receive_size);
+    auto received = m_stream->receive(m_wire.data() + used, k_receive_size);
+    m_wire.resize(used + received);
+    m_stats.wire_received += received;
+
+    if (received == 0)
+    {
+      if (m_in_frame || m_wire_offset < m_wire.size())
+        throw eve::socket_error("Compressed stream closed in the middle of a frame.");
+      return 0;
+    }
+  }
+}
+
+bool deflate_stream::try_send(const char* data, eve::size& size)
+{
+  if (!try_flush())
+    return false;
+
+  chunk unit = { data, size };
+  frame(&unit, 1);
+  try_flush();
+  return true;
+}
+
+bool deflate_stream::try_receive(char* buffer, eve::size& size)
+{
+  for (;;)
+  {
+    if (decode() || size == 0)
+    {
+      size = take(buffer, size);
+      return true;
+    }
+
+    auto used = m_wire.size();
+    m_wire.resize(used + k_receive_size);
+    auto received = k_receive_size;
+    if (!m_stream->try_receive(m_wire.data() + used, received))
+    {
+      m_wire.resize(used);
+      return false;
+    }
+    m_wire.resize(used + received);
+    m_stats.wire_received += received;
+
+    if (received == 0)
+    {
+      if (m_in_frame || m_wire_offset < m_wire.size())
+        throw eve::socket_error("Compressed stream closed in the middle of a frame.");
+      size = 0;
+      return true;
+    }
+  }
+}
+
+void deflate_stream::cork(bool corked)
+{
+  m_stream->cork(corked);
+}
+
+void deflate_stream::flush()
+{
+  if (m_sent < m_outgoing.size())
+    m_stream->send_all(m_outgoing.data() + m_sent, eve::size(m_outgoing.size() - m_sent));
+  m_outgoing.clear();
+  m_sent = 0;
+}
+
+void deflate_stream::level(int level)
+{
+  m_config.level = level;
+  deflateParams(&m_deflate.as<z_stream>(), level, Z_DEFAULT_STRATEGY);
+}
+
+void deflate_stream::frame(const chunk* chunks, eve::size count)
+{
+  eve::size total = 0;
+  for (eve::size i = 0; i < count; ++i)
+    total += chunks[i].size;
+  if (total == 0)
+    return;
+
+  // the payload goes after room for the largest header, which is written right before it
+  m_outgoing.resize(k_max_header);
+  eve::uint8 kind = total < m_config.threshold ? k_raw : k_deflated;
+  if (kind == k_raw)
+  {
+    for (eve::size i = 0; i < count; ++i)
+      m_outgoing.insert(m_outgoing.end(), chunks[i].data, chunks[i].data + chunks[i].size);
+    ++m_stats.bypassed;
+  }
+  else
+  {
+    deflate(chunks, count);
+    ++m_stats.deflated;
+  }
+
+  char header[k_max_header];
+  eve::size length = 0;
+  header[length++] = char(kind);
+  for (auto payload = eve::uint64(m_outgoing.size() - k_max_header); ; )
+  {
+    auto byte = char(payload & 0x7f);
+    payload >>= 7;
+    header[length++] = payload ? char(byte | 0x80) : byte;
+    if (!payload)
+      break;
+  }
+
+  m_sent = k_max_header - length;
+  memcpy(m_outgoing.data() + m_sent, header, length);
+
+  m_stats.bytes_in += total;
+  m_stats.bytes_out += m_outgoing.size() - m_sent;
+}
+
+void deflate_stream::deflate(const chunk* chunks, eve::size count)
+{
+  eve::stopwatch stopwatch;
+  auto& zs = m_deflate.as<z_stream>();
+
+  for (eve::size i = 0; i < count; ++i)
+  {
+    zs.next_in = (Bytef*)chunks[i].data;
+    zs.avail_in = uInt(chunks[i].size);
+
+    // the last chunk closes the unit, everything compressed so far is output
+    auto flush = i + 1 == count ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+    do
+    {
+      auto used = m_outgoing.size();
+      auto room = std::max<eve::size>(zs.avail_in / 2 + 64, 4096);
+      m_outgoing.resize(used + room);
+      zs.next_out = (Bytef*)m_outgoing.data() + used;
+      zs.avail_out = uInt(room);
+
+      ::deflate(&zs, flush);
+      m_outgoing.resize(m_outgoing.size() - zs.avail_out);
+    }
+    while (zs.avail_out == 0 || zs.avail_in > 0);
+  }
+
+  m_stats.deflate_time += stopwatch.elapsed();
+}
+
+bool deflate_stream::try_flush()
+{
+  while (m_sent < m_outgoing.size())
+  {
+    auto size = eve::size(m_outgoing.size() - m_sent);
+    if (!m_stream->try_send(m_outgoing.data() + m_sent, size))
+      return false;
+    m_sent += size;
+  }
+  m_outgoing.clear();
+  m_sent = 0;
+  return true;
+}
+
+bool deflate_stream::decode()
+{
+  // what was inflated is read before inflating more, so that a small frame cannot blow up memory
+  while (m_wire_offset < m_wire.size() && m_plain_offset == m_plain.size())
+  {
+    if (!m_in_frame)
+    {
+      // a header split between two receives is decoded once complete
+      auto at = m_wire_offset;
+      auto kind = eve::uint8(m_wire[at++]);
+      eve::uint64 length = 0;
+      bool complete = false;
+      for (int shift = 0; at < m_wire.size() && shift < 64; shift += 7)
+      {
+        auto byte = eve::uint8(m_wire[at++]);
+        length |= eve::uint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+          complete = true;
+          break;
+        }
+      }
+      if (!complete)
+      {
+        if (at - m_wire_offset >= k_max_header)
+          throw eve::socket_error("Malformed compressed frame.");
+        break;
+      }
+      if (kind != k_raw && kind != k_deflated)
+        throw eve::socket_error("Malformed compressed frame.");
+      if (kind == k_raw && length > m_config.max_frame)
+        throw eve::socket_error("Received frame exceeds the maximum size.");
+
+      m_wire_offset = at;
+      m_frame_kind = kind;
+      m_frame_left = eve::size(length);
+      m_frame_plain = 0;
+      m_in_frame = m_frame_left > 0;
+      continue;
+    }
+
+    auto size = std::min(m_frame_left, eve::size(m_wire.size() - m_wire_offset));
+    auto data = m_wire.data() + m_wire_offset;
+    if (m_frame_kind == k_raw)
+    {
+      m_plain.insert(m_plain.end(), data, data + size);
+      m_stats.bytes_received += size;
+    }
+    else
+      size = inflate(data, size);
+
+    m_wire_offset += size;
+    m_frame_left -= size;
+    m_in_frame = m_frame_left > 0;
+  }
+
+  // what is left is a partial header
+  m_wire.erase(m_wire.begin(), m_wire.begin() + m_wire_offset);
+  m_wire_offset = 0;
+
+  return m_plain_offset < m_plain.size();
+}
+
+eve::size deflate_stream::inflate(const char* data, eve::size size)
+{
+  eve::stopwatch stopwatch;
+  auto& zs = m_inflate.as<z_stream>();
+  zs.next_in = (Bytef*)data;
+  zs.avail_in = uInt(size);
+
+  auto before = m_plain.size();
+  do
+  {
+    auto used = m_plain.size();
+    auto room = std::min<eve::size>(std::max<eve::size>(size * 4, 4096), k_inflate_size);
+    m_plain.resize(used + room);
+    zs.next_out = (Bytef*)m_plain.data() + used;
+    zs.avail_out = uInt(room);
+
+    auto result = ::inflate(&zs, Z_SYNC_FLUSH);
+    m_plain.resize(m_plain.size() - zs.avail_out);
+    if (result == Z_BUF_ERROR && zs.avail_out > 0)
+      break;
+    if (result != Z_OK && result != Z_BUF_ERROR)
+      throw eve::socket_error("Corrupted compressed stream.", result);
+    if (m_frame_plain + m_plain.size() - before > m_config.max_frame)
+      throw eve::socket_error("Received frame inflates beyond the maximum size.");
+
+    // the rest of the input waits until what was inflated is read, but the output zlib still
+    // holds for input it consumed is taken now since no more input may come to push it out
+    if (zs.avail_in > 0 && m_plain.size() - m_plain_offset >= k_inflate_size)
+      break;
+  }
+  while (zs.avail_out == 0 || zs.avail_in > 0);
+
+  m_frame_plain += m_plain.size() - before;
+  m_stats.bytes_received += m_plain.size() - before;
+  m_stats.inflate_time += stopwatch.elapsed();
+  return size - zs.avail_in;
+}
+
+eve::size deflate_stream::take(char* buffer, eve::size size)
+{
+  size = std::min(size, eve::size(m_plain.size() - m_plain_offset));
+  memcpy(buffer, m_plain.data() + m_plain_offset, size);
+  m_plain_offset += size;
+
+  if (m_plain_offset == m_plain.size())
+  {
+    m_plain.clear();
+    m_plain_offset = 0;
+  }
+  return size;
+}
@@ -0,0 +1,294 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/poller.h"
+#include "eve/net/socket.h"
+#include "eve/memory.h"
+#include <algorithm>
+
+#if defined(EVE_LINUX)
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#elif defined(EVE_WINDOWS)
+#include <WinSock2.h>
+#endif
+
+using namespace eve::net;
+
+#if defined(EVE_LINUX)
+
+struct poller::backend
+{
+  backend()
+    : ready(256)
+  {
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll < 0)
+      throw eve::socket_error("Could not create epoll instance.", errno);
+  }
+
+  ~backend()
+  {
+    ::close(epoll);
+  }
+
+  void add(entry& e)
+  {
+    control(EPOLL_CTL_ADD, e);
+  }
+
+  void modify(entry& e)
+  {
+    control(EPOLL_CTL_MOD, e);
+  }
+
+  void remove(entry& e)
+  {
+    // fails harmlessly when the socket has already been closed, which deregisters it
+    epoll_event ev = { };
+    epoll_ctl(epoll, EPOLL_CTL_DEL, int(e.socket->native_handle()), &ev);
+  }
+
+  void wait(int timeout)
+  {
+    fired.clear();
+    int count = epoll_wait(epoll, ready.data(), int(ready.size()), timeout < 0 ? -1 : timeout);
+    if (count < 0)
+    {
+      if (errno == EINTR)
+        return;
+      throw eve::socket_error("An error occurred while waiting for socket events.", errno);
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+      auto mask = ready[i].events;
+      eve::flagset<event> events;
+      events.set(event::readable, (mask & EPOLLIN) != 0);
+      events.set(event::writable, (mask & EPOLLOUT) != 0);
+      events.set(event::hangup, (mask & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) != 0);
+      fired.push_back(std::make_pair((entry*)ready[i].data.ptr, events));
+    }
+
+    // a full batch means more events are likely pending, collect more next time
+    if (eve::size(count) == ready.size())
+      ready.resize(ready.size() * 2);
+  }
+
+  void control(int op, entry& e)
+  {
+    epoll_event ev = { };
+    ev.events = EPOLLET | EPOLLRDHUP;
+    if (e.events.isset(event::readable))
+      ev.events |= EPOLLIN;
+    if (e.events.isset(event::writable))
+      ev.events |= EPOLLOUT;
+    ev.data.ptr = &e;
+
+    if (epoll_ctl(epoll, op, int(e.socket->native_handle()), &ev) < 0)
+      throw eve::socket_error("Could not register socket to poller.", errno);
+  }
+
+  int epoll;
+  std::vector<epoll_event> ready;
+  std::vector<std::pair<entry*, eve::flagset<event>>> fired;
+};
+
+#elif defined(EVE_WINDOWS)
+
+struct poller::backend
+{
+  void add(entry& e)
+  {
+    WSAPOLLFD fd = { };
+    fd.fd = SOCKET(e.socket->native_handle());
+    fds.push_back(fd);
+    owners.push_back(&e);
+    modify(e);
+  }
+
+  void modify(entry& e)
+  {
+    auto& fd = fds[index(e)];
+    fd.events = 0;
+    if (e.events.isset(event::readable))
+      fd.events |= POLLRDNORM;
+    if (e.events.isset(event::writable))
+      fd.events |= POLLWRNORM;
+  }
+
+  void remove(entry& e)
+  {
+    auto i = index(e);
+    fds[i] = fds.back();
+    owners[i] = owners.back();
+    fds.pop_back();
+    owners.pop_back();
+  }
+
+  void wait(int timeout)
+  {
+    fired.clear();
+    if (fds.empty())
+    {
+      if (timeout > 0)
+        Sleep(DWORD(timeout));
+      return;
+    }
+
+    int count = WSAPoll(fds.data(), ULONG(fds.size()), timeout < 0 ? -1 : timeout);
+    if (count == SOCKET_ERROR)
+      throw eve::socket_error("An error occurred while waiting for socket events.", WSAGetLastError());
+
+    for (eve::size i = 0; i < fds.size() && count > 0; ++i)
+    {
+      auto mask = fds[i].revents;
+      if (mask == 0)
+        continue;
+
+      eve::flagset<event> events;
+      events.set(event::readable, (mask & POLLRDNORM) != 0);
+      events.set(event::writable, (mask & POLLWRNORM) != 0);
+      events.set(event::hangup, (mask & (POLLHUP | POLLERR)) != 0);
+      fired.push_back(std::make_pair(owners[i], events));
+      --count;
+    }
+  }
+
+  eve::size index(entry& e) const
+  {
+    return eve::size(std::find(owners.begin(), owners.end(), &e) - owners.begin());
+  }
+
+  std::vector<WSAPOLLFD> fds;
+  std::vector<entry*> owners;
+  std::vector<std::pair<entry*, eve::flagset<event>>> fired;
+};
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+poller::poller()
+  : m_backend(eve_new backend)
+  , m_dispatching(false)
+{
+}
+
+poller::~poller()
+{
+  for (auto& e : m_entries)
+    eve::destroy(e.second);
+  for (auto e : m_removed)
+    eve::destroy(e);
+  eve::destroy(m_backend);
+}
+
+void poller::add(eve::socket& socket, eve::flagset<event> events, handler handler)
+{
+  if (m_entries.count(&socket))
+    throw eve::socket_error("Socket already added to poller.");
+
+  entry* e = eve_new entry;
+  e->socket = &socket;
+  e->events = events;
+  e->callback = std::move(handler);
+  e->removed = false;
+
+  try
+  {
+    m_backend->add(*e);
+  }
+  catch (...)
+  {
+    eve::destroy(e);
+    throw;
+  }
+  m_entries[&socket] = e;
+}
+
+void poller::modify(eve::socket& socket, eve::flagset<event> events)
+{
+  auto& e = find(socket);
+  e.events = events;
+  m_backend->modify(e);
+}
+
+void poller::remove(eve::socket& socket)
+{
+  auto& e = find(socket);
+  m_backend->remove(e);
+  m_entries.erase(&socket);
+
+  // events for it may still be queued in the batch being dispatched
+  if (m_dispatching)
+  {
+    e.removed = true;
+    m_removed.push_back(&e);
+  }
+  else
+    eve::destroy(&e);
+}
+
+eve::size poller::poll(int timeout)
+{
+  m_backend->wait(timeout);
+
+  eve::size dispatched = 0;
+  m_dispatching = true;
+  try
+  {
+    for (auto& fired : m_backend->fired)
+    {
+      if (fired.first->removed)
+        continue;
+      fired.first->callback(*fired.first->socket, fired.second);
+      ++dispatched;
+    }
+  }
+  catch (...)
+  {
+    m_dispatching = false;
+    throw;
+  }
+  m_dispatching = false;
+
+  for (auto e : m_removed)
+    eve::destroy(e);
+  m_removed.clear();
+
+  return dispatched;
+}
+
+poller::entry& poller::find(eve::socket& socket)
+{
+  auto it = m_entries.find(&socket);
+  if (it == m_entries.end())
+    throw eve::socket_error("Socket not added to poller.");
+  return *it->second;
+}
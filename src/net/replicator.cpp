@@ -0,0 +1,528 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/replicator.h"
+#include "eve/binary.h"
+#include "eve/span.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <streambuf>
+
+using namespace eve::net;
+
+// the records of a snapshot, after the tick number
+static const eve::uint8 k_enter = 0;
+static const eve::uint8 k_update = 1;
+static const eve::uint8 k_leave = 2;
+
+// the grid cell at @p x, @p y, shifted unsigned as negative values cannot be shifted left
+static eve::int64 cell_key(int x, int y)
+{
+  return eve::int64((eve::uint64(eve::uint32(x)) << 32) | eve::uint32(y));
+}
+
+namespace {
+
+/** Appends what is written to a vector. */
+class vector_buffer : public std::streambuf
+{
+public:
+  vector_buffer(std::vector<char>& bytes) : m_bytes(bytes) { }
+
+protected:
+  int_type overflow(int_type meta) override
+  {
+    if (!traits_type::eq_int_type(meta, traits_type::eof()))
+      m_bytes.push_back(traits_type::to_char_type(meta));
+    return traits_type::not_eof(meta);
+  }
+
+  std::streamsize xsputn(const char_type* data, std::streamsize count) override
+  {
+    m_bytes.insert(m_bytes.end(), data, data + count);
+    return count;
+  }
+
+private:
+  std::vector<char>& m_bytes;
+};
+
+/** Reads bytes in place. */
+class view_buffer : public std::streambuf
+{
+public:
+  view_buffer(const char* data, eve::size size)
+  {
+    auto begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+  }
+};
+
+} // anonymous
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+replicator::config::config()
+  : cell_size(64)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+replicator::replicator(transmit transmit, const config& configuration)
+  : m_transmit(std::move(transmit))
+  , m_config(configuration)
+  , m_next_object(1)
+  , m_next_client(1)
+  , m_tick(0)
+  , m_mark(0)
+{
+  memset(&m_stats, 0, sizeof(m_stats));
+}
+
+replicator::object_id replicator::add(void* instance, const eve::detail::serialization_info_base& info, eve::uint16 type, float x, float y)
+{
+  auto id = m_next_object++;
+  auto& o = m_objects[id];
+  o.instance = instance;
+  o.info = &info;
+  o.type = type;
+  o.cell = cell_of(x, y);
+  o.dirty = false;
+  serialize(o, o.bytes, o.offsets);
+
+  insert(id, o);
+  for (auto watcher : m_cells[o.cell].watchers)
+    enter(m_clients[watcher], id, o);
+
+  ++m_stats.objects;
+  return id;
+}
+
+void replicator::remove(object_id id)
+{
+  auto it = m_objects.find(id);
+  if (it == m_objects.end())
+    return;
+
+  for (auto watcher : m_cells[it->second.cell].watchers)
+    leave(m_clients[watcher], id);
+  erase(it->second);
+  m_objects.erase(it);
+  --m_stats.objects;
+}
+
+void replicator::touch(object_id id)
+{
+  auto& o = m_objects.at(id);
+  if (!o.dirty)
+  {
+    o.dirty = true;
+    m_dirty.push_back(id);
+  }
+}
+
+void replicator::move(object_id id, float x, float y)
+{
+  auto& o = m_objects.at(id);
+  auto target = cell_of(x, y);
+  if (target != o.cell)
+  {
+    // the clients watching only the new cell see it enter as last replicated, then get the
+    // changes with the others at the next tick; those watching only the old one see it leave
+    auto& from = m_cells[o.cell];
+    auto& to = m_cells[target];
+
+    auto in_from = ++m_mark;
+    for (auto watcher : from.watchers)
+      m_clients[watcher].mark = in_from;
+    for (auto watcher : to.watchers)
+    {
+      auto& c = m_clients[watcher];
+      if (c.mark != in_from)
+        enter(c, id, o);
+    }
+
+    auto in_to = ++m_mark;
+    for (auto watcher : to.watchers)
+      m_clients[watcher].mark = in_to;
+    for (auto watcher : from.watchers)
+    {
+      auto& c = m_clients[watcher];
+      if (c.mark != in_to)
+        leave(c, id);
+    }
+
+    erase(o);
+    o.cell = target;
+    insert(id, o);
+  }
+  touch(id);
+}
+
+replicator::client_id replicator::add_client(float x, float y, float radius)
+{
+  auto id = m_next_client++;
+  auto& c = m_clients[id];
+
+  // nothing watched yet
+  c.x0 = c.y0 = 0;
+  c.x1 = c.y1 = -1;
+  c.mark = 0;
+  c.moved = false;
+  view(id, x, y, radius);
+
+  ++m_stats.clients;
+  return id;
+}
+
+void replicator::remove_client(client_id id)
+{
+  auto it = m_clients.find(id);
+  if (it == m_clients.end())
+    return;
+
+  auto& c = it->second;
+  for (int y = c.y0; y <= c.y1; ++y)
+  {
+    for (int x = c.x0; x <= c.x1; ++x)
+    {
+      auto cell = m_cells.find(cell_key(x, y));
+      auto& watchers = cell->second.watchers;
+      watchers.erase(std::find(watchers.begin(), watchers.end(), id));
+      if (watchers.empty() && cell->second.objects.empty())
+        m_cells.erase(cell);
+    }
+  }
+  m_clients.erase(it);
+  --m_stats.clients;
+}
+
+void replicator::view(client_id id, float x, float y, float radius)
+{
+  auto& c = m_clients.at(id);
+  cells(x, y, radius, c.nx0, c.ny0, c.nx1, c.ny1);
+  if (!c.moved)
+  {
+    c.moved = true;
+    m_pending.push_back(id);
+  }
+}
+
+void replicator::tick()
+{
+  ++m_tick;
+  m_stats.cells = eve::size(m_cells.size());
+  m_stats.serialized = 0;
+  m_stats.fields = 0;
+  m_stats.bytes = 0;
+
+  // views first: cells left, then cells entered
+  for (auto id : m_pending)
+  {
+    auto it = m_clients.find(id);
+    if (it == m_clients.end())
+      continue;
+
+    auto& c = it->second;
+    c.moved = false;
+    for (int y = c.y0; y <= c.y1; ++y)
+    {
+      for (int x = c.x0; x <= c.x1; ++x)
+      {
+        if (x < c.nx0 || x > c.nx1 || y < c.ny0 || y > c.ny1)
+          watch(id, c, x, y, false);
+      }
+    }
+    for (int y = c.ny0; y <= c.ny1; ++y)
+    {
+      for (int x = c.nx0; x <= c.nx1; ++x)
+      {
+        if (x < c.x0 || x > c.x1 || y < c.y0 || y > c.y1)
+          watch(id, c, x, y, true);
+      }
+    }
+    c.x0 = c.nx0;
+    c.y0 = c.ny0;
+    c.x1 = c.nx1;
+    c.y1 = c.ny1;
+  }
+  m_pending.clear();
+
+  // then the changed fields of the changed objects
+  for (auto id : m_dirty)
+  {
+    auto it = m_objects.find(id);
+    if (it == m_objects.end())
+      continue;
+
+    auto& o = it->second;
+    o.dirty = false;
+    serialize(o, m_scratch, m_scratch_offsets);
+    ++m_stats.serialized;
+
+    m_changed.clear();
+    for (eve::size i = 0; i + 1 < m_scratch_offsets.size(); ++i)
+    {
+      auto size = m_scratch_offsets[i + 1] - m_scratch_offsets[i];
+      if (size != o.offsets[i + 1] - o.offsets[i] || memcmp(m_scratch.data() + m_scratch_offsets[i], o.bytes.data() + o.offsets[i], size) != 0)
+        m_changed.push_back(eve::uint16(i));
+    }
+    if (m_changed.empty())
+      continue;
+
+    o.bytes.swap(m_scratch);
+    o.offsets.swap(m_scratch_offsets);
+    m_stats.fields += m_changed.size();
+    for (auto watcher : m_cells[o.cell].watchers)
+      update(m_clients[watcher], id, o, m_changed);
+  }
+  m_dirty.clear();
+
+  for (auto& client : m_clients)
+  {
+    auto& snapshot = client.second.snapshot;
+    if (snapshot.empty())
+      continue;
+
+    m_transmit(client.first, snapshot.data(), eve::size(snapshot.size()));
+    m_stats.bytes += snapshot.size();
+    snapshot.clear();
+  }
+}
+
+eve::int64 replicator::cell_of(float x, float y) const
+{
+  auto cx = int(std::floor(x / m_config.cell_size));
+  auto cy = int(std::floor(y / m_config.cell_size));
+  return cell_key(cx, cy);
+}
+
+void replicator::cells(float x, float y, float radius, int& x0, int& y0, int& x1, int& y1) const
+{
+  x0 = int(std::floor((x - radius) / m_config.cell_size));
+  y0 = int(std::floor((y - radius) / m_config.cell_size));
+  x1 = int(std::floor((x + radius) / m_config.cell_size));
+  y1 = int(std::floor((y + radius) / m_config.cell_size));
+}
+
+void replicator::watch(client_id id, client& c, int x, int y, bool watching)
+{
+  auto key = cell_key(x, y);
+  if (watching)
+  {
+    auto& target = m_cells[key];
+    target.watchers.push_back(id);
+    for (auto object : target.objects)
+      enter(c, object, m_objects[object]);
+    return;
+  }
+
+  auto it = m_cells.find(key);
+  if (it == m_cells.end())
+    return;
+
+  auto& watchers = it->second.watchers;
+  watchers.erase(std::find(watchers.begin(), watchers.end(), id));
+  for (auto object : it->second.objects)
+    leave(c, object);
+
+  if (watchers.empty() && it->second.objects.empty())
+    m_cells.erase(it);
+}
+
+void replicator::insert(object_id id, object& o)
+{
+  auto& objects = m_cells[o.cell].objects;
+  o.cell_index = eve::size(objects.size());
+  objects.push_back(id);
+}
+
+void replicator::erase(object& o)
+{
+  // the last object of the cell takes the place of the erased one
+  auto it = m_cells.find(o.cell);
+  auto& objects = it->second.objects;
+  auto last = objects.back();
+  objects[o.cell_index] = last;
+  m_objects[last].cell_index = o.cell_index;
+  objects.pop_back();
+
+  if (objects.empty() && it->second.watchers.empty())
+    m_cells.erase(it);
+}
+
+void replicator::serialize(object& o, std::vector<char>& bytes, std::vector<eve::uint32>& offsets)
+{
+  bytes.clear();
+  offsets.clear();
+
+  vector_buffer buffer(bytes);
+  eve::binarywriter writer(&buffer);
+  for (eve::size i = 0; i < o.info->num_fields(); ++i)
+  {
+    offsets.push_back(eve::uint32(bytes.size()));
+    o.info->field(i)->serialize_as_binary(o.instance, writer);
+  }
+  offsets.push_back(eve::uint32(bytes.size()));
+}
+
+void replicator::enter(client& c, object_id id, const object& o)
+{
+  auto& bytes = snapshot(c);
+  eve::span_writer<std::vector<char>> writer(bytes);
+  auto count = eve::uint16(o.offsets.size() - 1);
+  writer.reserve(1 + 4 + 2 + 2 + count * 6 + o.bytes.size());
+  writer << k_enter << id << o.type << count;
+  for (eve::uint16 i = 0; i < count; ++i)
+  {
+    auto size = o.offsets[i + 1] - o.offsets[i];
+    writer << i << size;
+    writer.write(o.bytes.data() + o.offsets[i], size);
+  }
+}
+
+void replicator::update(client& c, object_id id, const object& o, const std::vector<eve::uint16>& fields)
+{
+  auto& bytes = snapshot(c);
+  eve::span_writer<std::vector<char>> writer(bytes);
+  writer.reserve(1 + 4 + 2);
+  writer << k_update << id << eve::uint16(fields.size());
+  for (auto i : fields)
+  {
+    auto size = o.offsets[i + 1] - o.offsets[i];
+    writer.reserve(2 + 4 + size);
+    writer << i << size;
+    writer.write(o.bytes.data() + o.offsets[i], size);
+  }
+}
+
+void replicator::leave(client& c, object_id id)
+{
+  auto& bytes = snapshot(c);
+  eve::span_writer<std::vector<char>> writer(bytes);
+  writer.reserve(1 + 4);
+  writer << k_leave << id;
+}
+
+std::vector<char>& replicator::snapshot(client& c)
+{
+  if (c.snapshot.empty())
+  {
+    eve::span_writer<std::vector<char>> writer(c.snapshot);
+    writer.reserve(4);
+    writer << m_tick;
+  }
+  return c.snapshot;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+replica::replica()
+  : m_tick(0)
+{
+}
+
+replica::~replica()
+{
+  for (auto& o : m_objects)
+    m_bindings[o.second.type].despawn(o.first, o.second.instance);
+}
+
+void replica::apply(const char* data, eve::size size)
+{
+  eve::span_reader reader(data, size);
+  reader >> m_tick;
+
+  while (reader.remaining() > 0)
+  {
+    eve::uint8 op;
+    object_id id;
+    reader >> op >> id;
+
+    if (op == k_leave)
+    {
+      auto it = m_objects.find(id);
+      if (it != m_objects.end())
+      {
+        m_bindings[it->second.type].despawn(id, it->second.instance);
+        m_objects.erase(it);
+      }
+      continue;
+    }
+
+    local* target = nullptr;
+    if (op == k_enter)
+    {
+      eve::uint16 type;
+      reader >> type;
+      auto binding = m_bindings.find(type);
+      if (binding == m_bindings.end())
+        throw std::runtime_error("Snapshot refers to an unbound object type.");
+
+      auto& o = m_objects[id];
+      if (!o.instance)
+      {
+        o.instance = binding->second.spawn(id);
+        o.type = type;
+      }
+      target = &o;
+    }
+    else if (op == k_update)
+    {
+      auto it = m_objects.find(id);
+      if (it == m_objects.end())
+        throw std::runtime_error("Snapshot updates an object not in view.");
+      target = &it->second;
+    }
+    else
+      throw std::runtime_error("Malformed snapshot.");
+
+    auto info = m_bindings[target->type].info;
+    eve::uint16 count;
+    reader >> count;
+    for (eve::uint16 i = 0; i < count; ++i)
+    {
+      eve::uint16 index;
+      eve::uint32 length;
+      reader >> index >> length;
+      if (length > reader.remaining())
+        throw std::runtime_error("Malformed snapshot.");
+
+      // fields unknown to this side are skipped
+      if (index < info->num_fields())
+      {
+        view_buffer buffer(data + reader.position(), length);
+        eve::binaryreader field_reader(&buffer);
+        info->field(index)->deserialize_as_binary(field_reader, target->instance);
+      }
+      reader.skip(length);
+    }
+  }
+}
@@ -0,0 +1,196 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/resolver.h"
+
+using namespace eve::net;
+
+static std::string make_key(const std::string& hostname, int port)
+{
+  return hostname + ":" + std::to_string(port);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+resolver::resolver(std::chrono::milliseconds ttl)
+  : m_ttl(ttl)
+  , m_stopping(false)
+{
+  m_thread = std::thread([this] { run(); });
+}
+
+resolver::~resolver()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_wakeup.notify_one();
+  m_thread.join();
+
+  // the queries never looked up still owe their futures a result
+  for (auto& pending : m_pending)
+  {
+    result failed;
+    failed.ok = false;
+    failed.error = "Resolver destroyed before resolving '" + pending.second.hostname + "'.";
+    for (auto& promise : pending.second.promises)
+      promise->set_value(failed);
+  }
+}
+
+std::future<resolver::result> resolver::resolve(const std::string& hostname, int port)
+{
+  auto promise = std::make_shared<std::promise<result>>();
+  auto future = promise->get_future();
+
+  if (auto hit = lookup(make_key(hostname, port)))
+    promise->set_value(*hit);
+  else
+    enqueue(hostname, port, promise, nullptr);
+  return future;
+}
+
+void resolver::resolve(const std::string& hostname, int port, callback callback)
+{
+  if (auto hit = lookup(make_key(hostname, port)))
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_completed.emplace_back(std::move(callback), hit);
+  }
+  else
+    enqueue(hostname, port, nullptr, std::move(callback));
+}
+
+eve::size resolver::poll()
+{
+  decltype(m_completed) completed;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    completed.swap(m_completed);
+  }
+
+  for (auto& c : completed)
+    c.first(*c.second);
+  return eve::size(completed.size());
+}
+
+void resolver::clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cache.clear();
+}
+
+bool resolver::cached(const std::string& hostname, int port) const
+{
+  return lookup(make_key(hostname, port)) != nullptr;
+}
+
+std::shared_ptr<const resolver::result> resolver::lookup(const std::string& key) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_cache.find(key);
+  if (it == m_cache.end() || it->second.expiry <= clock::now())
+    return nullptr;
+  return it->second.value;
+}
+
+void resolver::enqueue(const std::string& hostname, int port, promise_ptr promise, callback callback)
+{
+  auto key = make_key(hostname, port);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pending.find(key);
+    if (it == m_pending.end())
+    {
+      query q;
+      q.hostname = hostname;
+      q.port = port;
+      it = m_pending.emplace(key, std::move(q)).first;
+      m_queue.push_back(key);
+    }
+
+    // joins the lookup already queued for the same name
+    if (promise)
+      it->second.promises.push_back(std::move(promise));
+    if (callback)
+      it->second.callbacks.push_back(std::move(callback));
+  }
+  m_wakeup.notify_one();
+}
+
+void resolver::run()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;)
+  {
+    m_wakeup.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+    if (m_stopping)
+      return;
+
+    auto key = std::move(m_queue.front());
+    m_queue.pop_front();
+    auto hostname = m_pending[key].hostname;
+    auto port = m_pending[key].port;
+
+    // getaddrinfo may take seconds, new queries keep coming in meanwhile
+    lock.unlock();
+    auto resolved = std::make_shared<result>();
+    try
+    {
+      resolved->addresses = eve::socket::address::resolve(hostname, port);
+      resolved->ok = !resolved->addresses.empty();
+      if (!resolved->ok)
+        resolved->error = "No address found for '" + hostname + "'.";
+    }
+    catch (const eve::socket_error& e)
+    {
+      resolved->ok = false;
+      resolved->error = e.what();
+    }
+    lock.lock();
+
+    auto it = m_pending.find(key);
+    auto q = std::move(it->second);
+    m_pending.erase(it);
+
+    if (resolved->ok)
+    {
+      entry& e = m_cache[key];
+      e.value = resolved;
+      e.expiry = clock::now() + m_ttl;
+    }
+    for (auto& c : q.callbacks)
+      m_completed.emplace_back(std::move(c), resolved);
+
+    // futures are fulfilled outside the lock, their waiters may immediately resolve again
+    lock.unlock();
+    for (auto& promise : q.promises)
+      promise->set_value(*resolved);
+    lock.lock();
+  }
+}
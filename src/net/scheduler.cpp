@@ -0,0 +1,205 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/scheduler.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace eve::net;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+scheduler::class_config::class_config()
+  : priority(0)
+  , rate(0)
+  , burst(0)
+  , unreliable(false)
+  , max_age(0)
+{
+}
+
+scheduler::config::config()
+  : rate(64 * 1024)
+  , burst(16 * 1024)
+  , aging(1)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+scheduler::scheduler(transmit transmit, const config& configuration)
+  : m_transmit(std::move(transmit))
+  , m_config(configuration)
+  , m_tokens(configuration.burst)
+  , m_now(0)
+  , m_started(false)
+{
+}
+
+eve::uint8 scheduler::add_class(const class_config& configuration)
+{
+  if (m_queues.size() > 0xff)
+    throw std::runtime_error("Too many scheduler classes.");
+
+  queue q;
+  q.config = configuration;
+  q.tokens = configuration.burst;
+  memset(&q.counters, 0, sizeof(q.counters));
+  m_queues.push_back(std::move(q));
+  return eve::uint8(m_queues.size() - 1);
+}
+
+void scheduler::configure(const config& configuration)
+{
+  m_config = configuration;
+  m_tokens = std::min(m_tokens, m_config.burst);
+}
+
+void scheduler::push(eve::uint8 type, const char* data, eve::size size, eve::uint32 key)
+{
+  auto& q = m_queues.at(type);
+
+  if (key != 0 && q.config.unreliable)
+  {
+    auto it = q.keys.find(key);
+    if (it != q.keys.end())
+    {
+      it->second->updated = m_now;
+      auto& queued = it->second->data;
+      q.counters.bytes -= queued.size();
+      if (q.config.merge)
+        q.config.merge(queued, data, size);
+      else
+        queued.assign(data, data + size);
+      q.counters.bytes += queued.size();
+      ++q.counters.superseded;
+      return;
+    }
+  }
+
+  message m;
+  m.data.assign(data, data + size);
+  m.queued = m.updated = m_now;
+  m.key = q.config.unreliable ? key : 0;
+  q.messages.push_back(std::move(m));
+  if (key != 0 && q.config.unreliable)
+    q.keys[key] = std::prev(q.messages.end());
+
+  ++q.counters.messages;
+  q.counters.bytes += size;
+}
+
+eve::size scheduler::update(double now)
+{
+  auto elapsed = m_started ? std::max(0.0, now - m_now) : 0.0;
+  m_started = true;
+  m_now = now;
+
+  // buckets may run into debt by a message larger than what is left, and then wait for it
+  m_tokens = std::min(m_config.burst, m_tokens + m_config.rate * elapsed);
+  for (auto& q : m_queues)
+  {
+    if (q.config.rate > 0)
+      q.tokens = std::min(q.config.burst, q.tokens + q.config.rate * elapsed);
+
+    // superseding refreshes messages anywhere in the queue, so all of them are checked
+    if (q.config.unreliable && q.config.max_age > 0)
+    {
+      for (auto it = q.messages.begin(); it != q.messages.end(); )
+      {
+        if (now - it->updated > q.config.max_age)
+        {
+          erase(q, it++);
+          ++q.counters.expired;
+        }
+        else
+          ++it;
+      }
+    }
+  }
+
+  eve::size transmitted = 0;
+  while (m_tokens > 0)
+  {
+    queue* best = nullptr;
+    double urgency = 0;
+    for (auto& q : m_queues)
+    {
+      if (q.messages.empty() || (q.config.rate > 0 && q.tokens <= 0))
+        continue;
+
+      auto u = q.config.priority + m_config.aging * (now - q.messages.front().queued);
+      if (!best || u > urgency)
+      {
+        best = &q;
+        urgency = u;
+      }
+    }
+    if (!best)
+      break;
+
+    auto& m = best->messages.front();
+    auto size = eve::size(m.data.size());
+    m_tokens -= size;
+    if (best->config.rate > 0)
+      best->tokens -= size;
+
+    m_transmit(eve::uint8(best - m_queues.data()), m.data.data(), size);
+    ++best->counters.sent;
+    best->counters.bytes_sent += size;
+    transmitted += size;
+    pop(*best);
+  }
+  return transmitted;
+}
+
+scheduler::metrics scheduler::statistics(eve::uint8 type) const
+{
+  auto& q = m_queues.at(type);
+  auto result = q.counters;
+  result.oldest = q.messages.empty() ? 0 : m_now - q.messages.front().queued;
+  return result;
+}
+
+eve::size scheduler::queued() const
+{
+  eve::size bytes = 0;
+  for (auto& q : m_queues)
+    bytes += q.counters.bytes;
+  return bytes;
+}
+
+void scheduler::erase(queue& q, std::list<message>::iterator it)
+{
+  if (it->key != 0)
+    q.keys.erase(it->key);
+
+  --q.counters.messages;
+  q.counters.bytes -= it->data.size();
+  q.messages.erase(it);
+}
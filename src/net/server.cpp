@@ -0,0 +1,313 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/server.h"
+#include <algorithm>
+
+using namespace eve::net;
+
+// receive buffer of each worker, connections are drained through it
+static const eve::size k_scratch_size = 16 * 1024;
+
+// how long a worker waits for events before checking whether to stop
+static const int k_poll_timeout = 10;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+server::connection::connection(eve::socket&& socket, eve::size worker)
+  : user(nullptr)
+  , m_socket(std::move(socket))
+  , m_worker(worker)
+  , m_closing(false)
+  , m_poller(nullptr)
+  , m_bytes_sent(nullptr)
+{
+}
+
+void server::connection::send(const char* data, eve::size size)
+{
+  if (m_pending.empty())
+  {
+    while (size > 0)
+    {
+      auto sent = size;
+      if (!m_socket.try_send(data, sent))
+        break;
+      *m_bytes_sent += sent;
+      data += sent;
+      size -= sent;
+    }
+    if (size == 0)
+      return;
+
+    // the socket is full, wait until it drains
+    m_poller->modify(m_socket, poller::event::readable | poller::event::writable);
+  }
+  m_pending.insert(m_pending.end(), data, data + size);
+}
+
+bool server::connection::flush()
+{
+  eve::size done = 0;
+  while (done < m_pending.size())
+  {
+    auto sent = eve::size(m_pending.size() - done);
+    if (!m_socket.try_send(m_pending.data() + done, sent))
+      break;
+    *m_bytes_sent += sent;
+    done += sent;
+  }
+  m_pending.erase(m_pending.begin(), m_pending.begin() + done);
+  return m_pending.empty();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+server::server(factory factory)
+  : m_factory(std::move(factory))
+  , m_running(false)
+  , m_shared_port(true)
+  , m_next(0)
+{
+}
+
+server::~server()
+{
+  stop();
+}
+
+void server::start(eve::uint32 port, eve::size workers)
+{
+  if (m_running)
+    throw eve::socket_error("Server already running.");
+
+  if (workers == 0)
+    workers = std::max<eve::size>(std::thread::hardware_concurrency(), 1);
+
+  // the mode is decided once, every worker listens on its own socket only if all of them can
+  m_shared_port = false;
+  if (workers > 1)
+  {
+    eve::socket probe;
+    probe.create(eve::socket::type::stream);
+    m_shared_port = probe.reuse_port(true);
+  }
+  m_next = 0;
+
+  // every listener is set up before any thread starts, so that failures surface here
+  try
+  {
+    for (eve::size i = 0; i < workers; ++i)
+    {
+      m_workers.push_back(eve::make_unique<worker>());
+      auto& w = *m_workers.back();
+      w.index = i;
+      w.events = m_factory(i);
+      w.scratch.resize(k_scratch_size);
+      w.accepted = 0;
+      w.closed = 0;
+      w.bytes_received = 0;
+      w.bytes_sent = 0;
+      w.count = 0;
+
+      if (i > 0 && !m_shared_port)
+        continue;
+
+      w.listener.create(eve::socket::type::stream);
+      if (m_shared_port)
+        w.listener.reuse_port(true);
+      w.listener.listen(port, 1024);
+
+      auto pw = &w;
+      w.poller.add(w.listener, poller::event::readable, [this, pw] (eve::socket&, eve::flagset<poller::event>) { accept(*pw); });
+    }
+  }
+  catch (...)
+  {
+    m_workers.clear();
+    throw;
+  }
+
+  m_running = true;
+  for (auto& w : m_workers)
+  {
+    auto pw = w.get();
+    w->thread = std::thread([this, pw] { run(*pw); });
+  }
+}
+
+void server::stop()
+{
+  if (!m_running)
+    return;
+
+  m_running = false;
+  for (auto& w : m_workers)
+    w->thread.join();
+  m_workers.clear();
+}
+
+server::stats server::statistics(eve::size index) const
+{
+  auto& w = *m_workers.at(index);
+  stats s;
+  s.accepted = w.accepted;
+  s.closed = w.closed;
+  s.bytes_received = w.bytes_received;
+  s.bytes_sent = w.bytes_sent;
+  s.connections = w.count;
+  return s;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void server::run(worker& w)
+{
+  std::vector<eve::socket> inbox;
+  while (m_running)
+  {
+    w.poller.poll(k_poll_timeout);
+
+    if (!m_shared_port)
+    {
+      {
+        std::lock_guard<std::mutex> lock(w.inbox_mutex);
+        inbox.swap(w.inbox);
+      }
+      for (auto& socket : inbox)
+        attach(w, std::move(socket));
+      inbox.clear();
+    }
+  }
+
+  std::vector<connection*> remaining;
+  for (auto& c : w.connections)
+    remaining.push_back(c.second.get());
+  for (auto c : remaining)
+    detach(w, *c);
+}
+
+void server::accept(worker& w)
+{
+  eve::socket client;
+  while (w.listener.try_accept(client))
+  {
+    if (m_shared_port || m_workers.size() == 1)
+    {
+      attach(w, std::move(client));
+      continue;
+    }
+
+    // without a shared port this is the only listener, deal connections out
+    auto& target = *m_workers[m_next++ % m_workers.size()];
+    if (&target == &w)
+      attach(w, std::move(client));
+    else
+    {
+      std::lock_guard<std::mutex> lock(target.inbox_mutex);
+      target.inbox.push_back(std::move(client));
+    }
+  }
+}
+
+void server::attach(worker& w, eve::socket&& socket)
+{
+  eve::unique_ptr<connection>::type c(eve_new connection(std::move(socket), w.index));
+  c->m_poller = &w.poller;
+  c->m_bytes_sent = &w.bytes_sent;
+
+  auto& ref = *c;
+  w.connections[&ref.m_socket] = std::move(c);
+  ++w.accepted;
+  ++w.count;
+
+  auto pw = &w;
+  auto pc = &ref;
+  w.poller.add(ref.m_socket, poller::event::readable, [this, pw, pc] (eve::socket&, eve::flagset<poller::event> events) { ready(*pw, *pc, events); });
+
+  w.events->connected(ref);
+  ready(w, ref, eve::flagset<poller::event>());
+}
+
+void server::ready(worker& w, connection& c, eve::flagset<poller::event> events)
+{
+  try
+  {
+    // a hang up is flushed too, so that a failing send ends a lingering connection
+    bool drain = events.isset(poller::event::writable) || events.isset(poller::event::hangup);
+    if (drain && !c.m_pending.empty() && c.flush() && !c.m_closing)
+      w.poller.modify(c.m_socket, poller::event::readable);
+    if (!c.m_closing && (events.isset(poller::event::readable) || events.isset(poller::event::hangup)))
+      receive(w, c);
+  }
+  catch (eve::socket_error&)
+  {
+    // nothing more can be sent either
+    c.m_closing = true;
+    c.m_pending.clear();
+  }
+
+  if (!c.m_closing)
+    return;
+
+  // closed connections stop reading and linger until what is pending is sent
+  if (c.m_pending.empty())
+    detach(w, c);
+  else
+    w.poller.modify(c.m_socket, poller::event::writable);
+}
+
+void server::receive(worker& w, connection& c)
+{
+  // edge-triggered, drain the socket
+  while (!c.m_closing)
+  {
+    eve::size size = eve::size(w.scratch.size());
+    if (!c.m_socket.try_receive(w.scratch.data(), size))
+      break;
+
+    if (size == 0)
+    {
+      // the peer hung up, there is no one left to send to
+      c.m_closing = true;
+      c.m_pending.clear();
+      break;
+    }
+
+    w.bytes_received += size;
+    w.events->received(c, w.scratch.data(), size);
+  }
+}
+
+void server::detach(worker& w, connection& c)
+{
+  w.poller.remove(c.m_socket);
+  w.events->disconnected(c);
+  ++w.closed;
+  --w.count;
+  w.connections.erase(&c.m_socket);
+}
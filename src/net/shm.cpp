@@ -0,0 +1,578 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/shm.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+#if defined(EVE_LINUX)
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+
+#elif defined(EVE_WINDOWS)
+
+#include <Windows.h>
+
+#endif
+
+using namespace eve::net;
+
+static const eve::uint32 k_magic = 0x6d687365; // "eshm"
+static const eve::size k_cache_line = 64;
+static const eve::size k_min_capacity = 4096;
+
+// how many times a blocked end yields and checks the ring again before going to sleep: a peer
+// answering within a few microseconds is waited for without the cost of sleeping
+static const int k_spins = 100;
+
+// how long a sleeping end waits before checking that the process of the other end still exists
+static const int k_liveness_ms = 100;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** The indices of one direction, each on its own cache line so that the producer and the consumer
+    do not invalidate each other's writes. The sequences are the words sleeping ends wait on. */
+struct shm_channel::ring
+{
+  // written by the producer
+  std::atomic<eve::uint64> head;
+  std::atomic<eve::uint32> readable;
+  char padding0[k_cache_line - sizeof(eve::uint64) - sizeof(eve::uint32)];
+
+  // written by the consumer
+  std::atomic<eve::uint64> tail;
+  std::atomic<eve::uint32> writable;
+  char padding1[k_cache_line - sizeof(eve::uint64) - sizeof(eve::uint32)];
+
+  // whether either end sleeps
+  std::atomic<eve::uint32> reader_waiting;
+  std::atomic<eve::uint32> writer_waiting;
+  char padding2[k_cache_line - 2 * sizeof(eve::uint32)];
+};
+
+/** Shared header of the segment, the data of both rings follows it. Ring 0 goes from the creator
+    to the opener, ring 1 the other way round. */
+struct shm_channel::segment
+{
+  std::atomic<eve::uint32> magic;
+  eve::uint32 capacity;
+  std::atomic<eve::uint32> closed[2];
+  // process of each end, 0 until it opens, so that a crashed end is told from a busy one
+  std::atomic<eve::uint32> pid[2];
+  char padding[k_cache_line - 6 * sizeof(eve::uint32)];
+
+  ring rings[2];
+
+  char* data(eve::size index) { return (char*)this + sizeof(segment) + index * capacity; }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+#if defined(EVE_LINUX)
+
+/** @returns false if the wait timed out. */
+bool sleep_on(std::atomic<eve::uint32>& sequence, eve::uint32 expected, eve::uintptr)
+{
+  // returns right away if the sequence moved meanwhile
+  timespec timeout = { 0, k_liveness_ms * 1000000L };
+  return syscall(SYS_futex, &sequence, FUTEX_WAIT, expected, &timeout, nullptr, 0) == 0 || errno != ETIMEDOUT;
+}
+
+void wake(std::atomic<eve::uint32>& sequence, eve::uintptr)
+{
+  syscall(SYS_futex, &sequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+#elif defined(EVE_WINDOWS)
+
+bool sleep_on(std::atomic<eve::uint32>&, eve::uint32, eve::uintptr event)
+{
+  // auto-reset events stay signaled when set before the wait
+  return WaitForSingleObject((HANDLE)event, k_liveness_ms) != WAIT_TIMEOUT;
+}
+
+void wake(std::atomic<eve::uint32>&, eve::uintptr event)
+{
+  SetEvent((HANDLE)event);
+}
+
+#endif
+
+eve::uint32 current_process()
+{
+#if defined(EVE_LINUX)
+  return eve::uint32(getpid());
+#elif defined(EVE_WINDOWS)
+  return eve::uint32(GetCurrentProcessId());
+#endif
+}
+
+/** @returns false if the process @p pid exited, true if it runs or has not opened yet (0). */
+bool process_alive(eve::uint32 pid)
+{
+  if (pid == 0)
+    return true;
+#if defined(EVE_LINUX)
+  return kill(pid_t(pid), 0) == 0 || errno == EPERM;
+#elif defined(EVE_WINDOWS)
+  auto process = OpenProcess(SYNCHRONIZE, FALSE, DWORD(pid));
+  if (!process)
+    return GetLastError() == ERROR_ACCESS_DENIED;
+  auto alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+  CloseHandle(process);
+  return alive;
+#endif
+}
+
+/** Blocks until @p ready, spinning a while before sleeping on @p sequence. Gives up when a sleep
+    times out and @p alive tells that the other end is gone. */
+template <class Ready, class Alive>
+void block(std::atomic<eve::uint32>& sequence, std::atomic<eve::uint32>& waiting, eve::uintptr event, Ready ready, Alive alive)
+{
+  // yielding lets the other end run even when both share a core
+  for (int i = 0; i < k_spins; ++i)
+  {
+    if (ready())
+      return;
+    std::this_thread::yield();
+  }
+
+  // the flag is raised before checking again and the other end checks it after publishing, so
+  // either this end sees the update or the other end sees the flag and bumps the sequence
+  for (;;)
+  {
+    auto expected = sequence.load();
+    waiting.store(1);
+    if (ready())
+      break;
+    if (!sleep_on(sequence, expected, event) && !alive())
+      break;
+  }
+  waiting.store(0);
+}
+
+void signal(std::atomic<eve::uint32>& sequence, std::atomic<eve::uint32>& waiting, eve::uintptr event)
+{
+  if (waiting.load())
+  {
+    sequence.fetch_add(1);
+    wake(sequence, event);
+  }
+}
+
+eve::size round_capacity(eve::size capacity)
+{
+  eve::size result = k_min_capacity;
+  while (result < capacity)
+    result *= 2;
+  return result;
+}
+
+#if defined(EVE_WINDOWS)
+
+std::string event_name(const std::string& name, int ring, char which)
+{
+  return "Local\\eve." + name + "." + std::to_string(ring) + which;
+}
+
+#endif
+
+} // anonymous
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+shm_channel::shm_channel()
+  : m_segment(nullptr)
+  , m_size(0)
+  , m_end(0)
+  , m_owner(false)
+{
+  for (auto& handle : m_handles)
+    handle = 0;
+}
+
+shm_channel::~shm_channel()
+{
+  close();
+}
+
+void shm_channel::create(const std::string& name, eve::size capacity)
+{
+  if (m_segment)
+    throw eve::socket_error("Shared memory channel already open.");
+
+  capacity = round_capacity(capacity);
+  auto size = sizeof(segment) + 2 * capacity;
+
+#if defined(EVE_LINUX)
+  auto path = "/eve." + name;
+  int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0 && errno == EEXIST && abandoned(path))
+  {
+    // left behind by a creator that crashed
+    shm_unlink(path.c_str());
+    fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  }
+  if (fd < 0)
+    throw eve::socket_error("Cannot create shared memory segment '" + name + "'.", errno);
+
+  if (ftruncate(fd, off_t(size)) < 0)
+  {
+    auto error = errno;
+    ::close(fd);
+    shm_unlink(path.c_str());
+    throw eve::socket_error("Cannot size shared memory segment '" + name + "'.", error);
+  }
+
+  m_segment = (segment*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (m_segment == MAP_FAILED)
+  {
+    m_segment = nullptr;
+    shm_unlink(path.c_str());
+    throw eve::socket_error("Cannot map shared memory segment '" + name + "'.", errno);
+  }
+#elif defined(EVE_WINDOWS)
+  auto path = "Local\\eve." + name;
+  auto mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(eve::uint64(size) >> 32), DWORD(size), path.c_str());
+  if (!mapping || GetLastError() == ERROR_ALREADY_EXISTS)
+  {
+    auto error = int(GetLastError());
+    if (mapping)
+      CloseHandle(mapping);
+    throw eve::socket_error("Cannot create shared memory segment '" + name + "'.", error);
+  }
+
+  m_segment = (segment*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  if (!m_segment)
+  {
+    auto error = int(GetLastError());
+    CloseHandle(mapping);
+    throw eve::socket_error("Cannot map shared memory segment '" + name + "'.", error);
+  }
+  m_handles[0] = eve::uintptr(mapping);
+#endif
+
+  // a new mapping is zeroed, the magic published last tells the other end it is ready
+  m_segment->capacity = eve::uint32(capacity);
+  m_segment->pid[0].store(current_process());
+  m_segment->magic.store(k_magic);
+
+  m_name = name;
+  m_size = size;
+  m_end = 0;
+  m_owner = true;
+  open_events();
+}
+
+void shm_channel::open(const std::string& name)
+{
+  if (m_segment)
+    throw eve::socket_error("Shared memory channel already open.");
+
+#if defined(EVE_LINUX)
+  auto path = "/eve." + name;
+  int fd = shm_open(path.c_str(), O_RDWR, 0600);
+  if (fd < 0)
+    throw eve::socket_error("Cannot open shared memory segment '" + name + "'.", errno);
+
+  struct stat status;
+  if (fstat(fd, &status) < 0 || eve::size(status.st_size) < sizeof(segment))
+  {
+    ::close(fd);
+    throw eve::socket_error("Shared memory segment '" + name + "' is not ready.");
+  }
+
+  auto size = eve::size(status.st_size);
+  m_segment = (segment*)mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (m_segment == MAP_FAILED)
+  {
+    m_segment = nullptr;
+    throw eve::socket_error("Cannot map shared memory segment '" + name + "'.", errno);
+  }
+#elif defined(EVE_WINDOWS)
+  auto path = "Local\\eve." + name;
+  auto mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path.c_str());
+  if (!mapping)
+    throw eve::socket_error("Cannot open shared memory segment '" + name + "'.", int(GetLastError()));
+
+  m_segment = (segment*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  if (!m_segment)
+  {
+    auto error = int(GetLastError());
+    CloseHandle(mapping);
+    throw eve::socket_error("Cannot map shared memory segment '" + name + "'.", error);
+  }
+  m_handles[0] = eve::uintptr(mapping);
+
+  MEMORY_BASIC_INFORMATION info;
+  VirtualQuery(m_segment, &info, sizeof(info));
+  auto size = eve::size(info.RegionSize);
+#endif
+
+  m_name = name;
+  m_size = size;
+  m_end = 1;
+  m_owner = false;
+
+  if (m_segment->magic.load() != k_magic || size < sizeof(segment) + 2 * eve::size(m_segment->capacity))
+  {
+    close();
+    throw eve::socket_error("Shared memory segment '" + name + "' is not ready.");
+  }
+  m_segment->pid[1].store(current_process());
+  open_events();
+}
+
+void shm_channel::open_events()
+{
+#if defined(EVE_WINDOWS)
+  for (int ring = 0; ring < 2; ++ring)
+  {
+    m_handles[1 + ring * 2] = eve::uintptr(CreateEventA(nullptr, FALSE, FALSE, event_name(m_name, ring, 'r').c_str()));
+    m_handles[2 + ring * 2] = eve::uintptr(CreateEventA(nullptr, FALSE, FALSE, event_name(m_name, ring, 'w').c_str()));
+  }
+#endif
+}
+
+void shm_channel::close()
+{
+  if (!m_segment)
+    return;
+
+  // wakes the other end wherever it sleeps, it will find the channel closed
+  m_segment->closed[m_end].store(1);
+  auto& out = m_segment->rings[m_end];
+  auto& in = m_segment->rings[1 - m_end];
+  out.readable.fetch_add(1);
+  wake(out.readable, m_handles[1 + m_end * 2]);
+  in.writable.fetch_add(1);
+  wake(in.writable, m_handles[2 + (1 - m_end) * 2]);
+
+#if defined(EVE_LINUX)
+  munmap(m_segment, m_size);
+  if (m_owner)
+    shm_unlink(("/eve." + m_name).c_str());
+#elif defined(EVE_WINDOWS)
+  UnmapViewOfFile(m_segment);
+  for (auto& handle : m_handles)
+  {
+    if (handle)
+      CloseHandle((HANDLE)handle);
+  }
+#endif
+
+  for (auto& handle : m_handles)
+    handle = 0;
+  m_segment = nullptr;
+  m_size = 0;
+  m_owner = false;
+}
+
+bool shm_channel::connected() const
+{
+  return m_segment && !peer_closed();
+}
+
+eve::size shm_channel::capacity() const
+{
+  return m_segment ? eve::size(m_segment->capacity) : 0;
+}
+
+eve::size shm_channel::send(const char* data, eve::size size)
+{
+  validate();
+
+  auto& out = m_segment->rings[m_end];
+  auto capacity = m_segment->capacity;
+  for (;;)
+  {
+    if (peer_closed())
+      throw eve::socket_error("Cannot send data through shared memory channel, closed by peer.");
+
+    auto sent = write(data, size);
+    if (sent > 0 || size == 0)
+      return sent;
+
+    block(out.writable, out.writer_waiting, m_handles[2 + m_end * 2], [&]
+    {
+      return out.head.load(std::memory_order_relaxed) - out.tail.load() < capacity || peer_closed();
+    }, [this] { return peer_alive(); });
+  }
+}
+
+eve::size shm_channel::receive(char* buffer, eve::size size)
+{
+  validate();
+
+  auto& in = m_segment->rings[1 - m_end];
+  for (;;)
+  {
+    auto received = read(buffer, size);
+    if (received > 0 || size == 0)
+      return received;
+
+    // everything sent before closing has been read
+    if (peer_closed() && in.head.load() == in.tail.load(std::memory_order_relaxed))
+      return 0;
+
+    block(in.readable, in.reader_waiting, m_handles[1 + (1 - m_end) * 2], [&]
+    {
+      return in.head.load() != in.tail.load(std::memory_order_relaxed) || peer_closed();
+    }, [this] { return peer_alive(); });
+  }
+}
+
+bool shm_channel::try_send(const char* data, eve::size& size)
+{
+  validate();
+
+  if (peer_closed())
+    throw eve::socket_error("Cannot send data through shared memory channel, closed by peer.");
+
+  size = write(data, size);
+  return size > 0;
+}
+
+bool shm_channel::try_receive(char* buffer, eve::size& size)
+{
+  validate();
+
+  auto& in = m_segment->rings[1 - m_end];
+  auto closed = peer_closed();
+  auto received = read(buffer, size);
+  if (received == 0 && !(closed && in.head.load() == in.tail.load(std::memory_order_relaxed)))
+    return false;
+
+  size = received;
+  return true;
+}
+
+eve::size shm_channel::write(const char* data, eve::size size)
+{
+  auto& out = m_segment->rings[m_end];
+  auto capacity = eve::size(m_segment->capacity);
+  auto head = out.head.load(std::memory_order_relaxed);
+  auto tail = out.tail.load(std::memory_order_acquire);
+
+  auto count = std::min(size, capacity - eve::size(head - tail));
+  if (count == 0)
+    return 0;
+
+  auto offset = eve::size(head & (capacity - 1));
+  auto first = std::min(count, capacity - offset);
+  auto ring = m_segment->data(m_end);
+  memcpy(ring + offset, data, first);
+  memcpy(ring, data + first, count - first);
+
+  out.head.store(head + count);
+  signal(out.readable, out.reader_waiting, m_handles[1 + m_end * 2]);
+  return count;
+}
+
+eve::size shm_channel::read(char* buffer, eve::size size)
+{
+  auto& in = m_segment->rings[1 - m_end];
+  auto capacity = eve::size(m_segment->capacity);
+  auto tail = in.tail.load(std::memory_order_relaxed);
+  auto head = in.head.load(std::memory_order_acquire);
+
+  auto count = std::min(size, eve::size(head - tail));
+  if (count == 0)
+    return 0;
+
+  auto offset = eve::size(tail & (capacity - 1));
+  auto first = std::min(count, capacity - offset);
+  auto ring = m_segment->data(1 - m_end);
+  memcpy(buffer, ring + offset, first);
+  memcpy(buffer + first, ring, count - first);
+
+  in.tail.store(tail + count);
+  signal(in.writable, in.writer_waiting, m_handles[2 + (1 - m_end) * 2]);
+  return count;
+}
+
+bool shm_channel::peer_closed() const
+{
+  return m_segment->closed[1 - m_end].load() != 0;
+}
+
+bool shm_channel::peer_alive()
+{
+  if (process_alive(m_segment->pid[1 - m_end].load()))
+    return true;
+
+  // a crashed end never closes, it is closed on its behalf
+  m_segment->closed[1 - m_end].store(1);
+  return false;
+}
+
+bool shm_channel::abandoned(const std::string& path)
+{
+#if defined(EVE_LINUX)
+  int fd = shm_open(path.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+
+  struct stat status;
+  bool result = false;
+  if (fstat(fd, &status) == 0 && eve::size(status.st_size) >= sizeof(segment))
+  {
+    auto header = (segment*)mmap(nullptr, sizeof(segment), PROT_READ, MAP_SHARED, fd, 0);
+    if (header != MAP_FAILED)
+    {
+      result = header->magic.load() == k_magic && !process_alive(header->pid[0].load());
+      munmap(header, sizeof(segment));
+    }
+  }
+  ::close(fd);
+  return result;
+#else
+  // names of other systems go away with the last process using them
+  (void)path;
+  return false;
+#endif
+}
+
+void shm_channel::validate() const
+{
+  if (!m_segment)
+    throw eve::socket_error("Shared memory channel not open.");
+}
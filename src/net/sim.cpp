@@ -0,0 +1,342 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/net/sim.h"
+#include "eve/time.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+using namespace eve::net;
+
+// stream sends are cut in segments so that bytes arrive progressively on slow links
+static const eve::size k_segment_size = 1400;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+sim_link::config::config()
+  : latency(0)
+  , jitter(0)
+  , delay(distribution::constant)
+  , loss(0)
+  , reorder(0)
+  , bandwidth(0)
+  , queue_limit(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+eve::size sim_link::endpoint::send(const char* data, eve::size size)
+{
+  std::unique_lock<std::mutex> lock(m_link->m_mutex);
+  auto& out = m_link->m_directions[m_index];
+  auto& in = m_link->m_directions[1 - m_index];
+
+  for (;;)
+  {
+    if (out.closed || in.closed)
+      throw eve::socket_error("Cannot send data through simulated link, closed.");
+
+    auto now = m_link->m_clock();
+    auto room = m_link->queue_room(out, now);
+    if (room > 0 || size == 0)
+    {
+      size = std::min(size, room);
+      for (eve::size done = 0; done < size; done += k_segment_size)
+        m_link->transmit(out, data + done, std::min(k_segment_size, size - done), false, false, now);
+      return size;
+    }
+
+    // until the queue drained enough for a byte
+    auto& c = m_link->m_config;
+    m_link->wait(lock, out.busy_until - c.queue_limit / c.bandwidth, now);
+  }
+}
+
+eve::size sim_link::endpoint::receive(char* buffer, eve::size size)
+{
+  std::unique_lock<std::mutex> lock(m_link->m_mutex);
+  auto& in = m_link->m_directions[1 - m_index];
+
+  for (;;)
+  {
+    auto now = m_link->m_clock();
+    m_link->deliver(in, now);
+
+    if (!in.bytes.empty() || size == 0)
+    {
+      size = std::min(size, eve::size(in.bytes.size()));
+      std::copy(in.bytes.begin(), in.bytes.begin() + size, buffer);
+      in.bytes.erase(in.bytes.begin(), in.bytes.begin() + size);
+      return size;
+    }
+
+    auto streaming = std::find_if(in.flying.begin(), in.flying.end(), [] (const flight& f) { return !f.datagram; });
+    if (streaming == in.flying.end())
+    {
+      if (in.closed)
+        return 0;
+      m_link->wait(lock, -1, now);
+    }
+    else
+      m_link->wait(lock, streaming->arrival, now);
+  }
+}
+
+bool sim_link::endpoint::try_send(const char* data, eve::size& size)
+{
+  std::lock_guard<std::mutex> lock(m_link->m_mutex);
+  auto& out = m_link->m_directions[m_index];
+  if (out.closed || m_link->m_directions[1 - m_index].closed)
+    throw eve::socket_error("Cannot send data through simulated link, closed.");
+
+  auto now = m_link->m_clock();
+  size = std::min(size, m_link->queue_room(out, now));
+  for (eve::size done = 0; done < size; done += k_segment_size)
+    m_link->transmit(out, data + done, std::min(k_segment_size, size - done), false, false, now);
+  return size > 0;
+}
+
+bool sim_link::endpoint::try_receive(char* buffer, eve::size& size)
+{
+  std::lock_guard<std::mutex> lock(m_link->m_mutex);
+  auto& in = m_link->m_directions[1 - m_index];
+  m_link->deliver(in, m_link->m_clock());
+
+  if (in.bytes.empty())
+  {
+    // the other end closed and everything it sent arrived
+    auto streaming = std::find_if(in.flying.begin(), in.flying.end(), [] (const flight& f) { return !f.datagram; });
+    if (!in.closed || streaming != in.flying.end())
+      return false;
+    size = 0;
+    return true;
+  }
+
+  size = std::min(size, eve::size(in.bytes.size()));
+  std::copy(in.bytes.begin(), in.bytes.begin() + size, buffer);
+  in.bytes.erase(in.bytes.begin(), in.bytes.begin() + size);
+  return true;
+}
+
+void sim_link::endpoint::send_datagram(const char* data, eve::size size)
+{
+  std::lock_guard<std::mutex> lock(m_link->m_mutex);
+  auto& out = m_link->m_directions[m_index];
+  if (out.closed)
+    throw eve::socket_error("Cannot send datagram through simulated link, closed.");
+
+  auto now = m_link->m_clock();
+  ++out.counters.sent;
+  if (m_link->queue_room(out, now) < size)
+  {
+    ++out.counters.dropped;
+    return;
+  }
+
+  // lost datagrams still take their share of the bandwidth
+  std::uniform_real_distribution<double> uniform;
+  auto lost = m_link->m_config.loss > 0 && uniform(m_link->m_random) < m_link->m_config.loss;
+  m_link->transmit(out, data, size, true, lost, now);
+}
+
+bool sim_link::endpoint::try_receive_datagram(char* buffer, eve::size& size)
+{
+  std::lock_guard<std::mutex> lock(m_link->m_mutex);
+  auto& in = m_link->m_directions[1 - m_index];
+  m_link->deliver(in, m_link->m_clock());
+
+  if (in.datagrams.empty())
+    return false;
+
+  auto& datagram = in.datagrams.front();
+  size = std::min(size, eve::size(datagram.size()));
+  std::copy(datagram.begin(), datagram.begin() + size, buffer);
+  in.datagrams.pop_front();
+  return true;
+}
+
+void sim_link::endpoint::close()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_link->m_mutex);
+    m_link->m_directions[m_index].closed = true;
+  }
+  m_link->m_changed.notify_all();
+}
+
+sim_link::stats sim_link::endpoint::statistics() const
+{
+  std::lock_guard<std::mutex> lock(m_link->m_mutex);
+  return m_link->m_directions[m_index].counters;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+sim_link::sim_link(const config& configuration, unsigned seed, clock time_source)
+  : m_config(configuration)
+  , m_clock(std::move(time_source))
+  , m_manual(bool(m_clock))
+  , m_random(seed)
+  , m_order(0)
+{
+  if (!m_clock)
+  {
+    auto stopwatch = std::make_shared<eve::stopwatch>();
+    m_clock = [stopwatch] { return stopwatch->elapsed(); };
+  }
+
+  for (eve::size i = 0; i < 2; ++i)
+  {
+    m_endpoints[i].m_link = this;
+    m_endpoints[i].m_index = i;
+
+    auto& d = m_directions[i];
+    d.busy_until = 0;
+    d.last_stream_arrival = 0;
+    d.closed = false;
+    memset(&d.counters, 0, sizeof(d.counters));
+  }
+}
+
+void sim_link::configure(const config& configuration)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_config = configuration;
+}
+
+double sim_link::next_arrival() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  double next = -1;
+  for (auto& d : m_directions)
+  {
+    if (!d.flying.empty() && (next < 0 || d.flying.front().arrival < next))
+      next = d.flying.front().arrival;
+  }
+  return next;
+}
+
+double sim_link::sample_delay()
+{
+  auto latency = m_config.latency;
+  auto jitter = m_config.jitter;
+  if (jitter <= 0)
+    return latency;
+
+  switch (m_config.delay)
+  {
+  case distribution::uniform:
+    return latency + std::uniform_real_distribution<double>(0, jitter)(m_random);
+  case distribution::normal:
+    return std::max(0.0, latency + std::normal_distribution<double>(0, jitter)(m_random));
+  case distribution::exponential:
+    return latency + std::exponential_distribution<double>(1 / jitter)(m_random);
+  default:
+    return latency;
+  }
+}
+
+eve::size sim_link::queue_room(const direction& d, double now) const
+{
+  if (m_config.queue_limit == 0 || m_config.bandwidth <= 0)
+    return std::numeric_limits<eve::size>::max();
+
+  auto queued = std::max(0.0, d.busy_until - now) * m_config.bandwidth;
+  auto limit = double(m_config.queue_limit);
+  return queued < limit ? eve::size(limit - queued) : 0;
+}
+
+void sim_link::transmit(direction& d, const char* data, eve::size size, bool datagram, bool lost, double now)
+{
+  // bytes leave one after the other at the bandwidth, then travel for the delay
+  auto start = std::max(now, d.busy_until);
+  d.busy_until = m_config.bandwidth > 0 ? start + size / m_config.bandwidth : start;
+
+  if (lost)
+  {
+    ++d.counters.dropped;
+    return;
+  }
+
+  flight f;
+  f.arrival = d.busy_until + sample_delay();
+  f.order = m_order++;
+  f.datagram = datagram;
+  f.data.assign(data, data + size);
+
+  if (datagram)
+  {
+    std::uniform_real_distribution<double> uniform;
+    if (m_config.reorder > 0 && uniform(m_random) < m_config.reorder)
+      f.arrival += m_config.latency;
+  }
+  else
+  {
+    // stream bytes never overtake each other
+    f.arrival = std::max(f.arrival, d.last_stream_arrival);
+    d.last_stream_arrival = f.arrival;
+    ++d.counters.sent;
+  }
+
+  auto position = std::upper_bound(d.flying.begin(), d.flying.end(), f, [] (const flight& a, const flight& b)
+  {
+    return a.arrival < b.arrival || (a.arrival == b.arrival && a.order < b.order);
+  });
+  d.flying.insert(position, std::move(f));
+  m_changed.notify_all();
+}
+
+void sim_link::deliver(direction& d, double now)
+{
+  while (!d.flying.empty() && d.flying.front().arrival <= now)
+  {
+    auto& f = d.flying.front();
+    ++d.counters.delivered;
+    d.counters.bytes_delivered += f.data.size();
+
+    if (f.datagram)
+      d.datagrams.push_back(std::move(f.data));
+    else
+      d.bytes.insert(d.bytes.end(), f.data.begin(), f.data.end());
+    d.flying.pop_front();
+  }
+}
+
+void sim_link::wait(std::unique_lock<std::mutex>& lock, double until, double now)
+{
+  if (m_manual)
+    throw eve::socket_error("Cannot block on a simulated link driven by a manual clock.");
+
+  if (until < 0)
+    m_changed.wait(lock);
+  else
+    m_changed.wait_for(lock, std::chrono::duration<double>(std::max(until - now, 1e-4)));
+}
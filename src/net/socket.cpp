@@ -26,27 +26,92 @@
 \******************************************************************************/
 
 #include "eve/net/socket.h"
+#include <algorithm>
+#include <cstring>
 
-#ifdef EVE_WINDOWS
+#if defined(EVE_WINDOWS)
 
 #include <WinSock2.h>
+#include <WS2tcpip.h>
+
+typedef SOCKET native_socket;
+typedef int native_socklen;
+static const native_socket k_invalid_socket = INVALID_SOCKET;
+
+inline int last_error() { return WSAGetLastError(); }
+inline bool would_block(int error) { return error == WSAEWOULDBLOCK; }
+inline bool connect_pending(int error) { return error == WSAEWOULDBLOCK || error == WSAEALREADY || error == WSAEINVAL; }
+inline bool already_connected(int error) { return error == WSAEISCONN; }
+inline void close_socket(native_socket s) { closesocket(s); }
+inline void set_nonblocking(native_socket s, bool nonblocking) { u_long value = u_long(nonblocking); ioctlsocket(s, FIONBIO, &value); }
+
+// accepted sockets inherit the blocking mode of the listening socket
+static const bool k_accept_inherits_blocking = true;
+static const int k_send_flags = 0;
+
+#elif defined(EVE_LINUX)
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+typedef int native_socket;
+typedef socklen_t native_socklen;
+static const native_socket k_invalid_socket = -1;
+static const int SOCKET_ERROR = -1;
+
+inline int last_error() { return errno; }
+inline bool would_block(int error) { return error == EAGAIN || error == EWOULDBLOCK; }
+inline bool connect_pending(int error) { return error == EINPROGRESS || error == EALREADY; }
+inline bool already_connected(int error) { return error == EISCONN; }
+inline void close_socket(native_socket s) { close(s); }
+inline void set_nonblocking(native_socket s, bool nonblocking)
+{
+  int flags = fcntl(s, F_GETFL, 0);
+  fcntl(s, F_SETFL, nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+}
+
+// accepted sockets are always blocking, whatever the listening socket is
+static const bool k_accept_inherits_blocking = false;
+
+// a peer closing the connection must not raise SIGPIPE
+static const int k_send_flags = MSG_NOSIGNAL;
+
+#endif
+
+#if defined(EVE_WINDOWS) || defined(EVE_LINUX)
+
+// chunks handed to a single gathering call, the rest waits for the next one
+static const eve::size k_max_gather = 64;
 
 // Namespace used for wrapping system functions in order to avoid naming collision
-inline SOCKET sys_socket(int a, int b, int c) { return socket(a, b, c); }
-inline int sys_listen(SOCKET socket, int conns) { return listen(socket, conns); }
-inline SOCKET sys_accept(SOCKET socket, sockaddr* addr, int* len) { return accept(socket, addr, len); }
-inline int sys_connect(SOCKET s, sockaddr* name, int namelen) { return connect(s, name, namelen); }
-inline int sys_send(SOCKET s, const char* buf, int len, int flags) { return send(s, buf, len, flags); }
-inline int sys_recv(SOCKET s, char* buf, int len, int flags) { return recv(s, buf, len, flags); }
-inline int sys_shutdown(SOCKET s, int how) { return shutdown(s, how); }
+inline native_socket sys_socket(int a, int b, int c) { return socket(a, b, c); }
+inline int sys_bind(native_socket s, const sockaddr* name, int namelen) { return bind(s, name, namelen); }
+inline int sys_listen(native_socket socket, int conns) { return listen(socket, conns); }
+inline native_socket sys_accept(native_socket socket, sockaddr* addr, native_socklen* len) { return accept(socket, addr, len); }
+inline int sys_connect(native_socket s, sockaddr* name, int namelen) { return connect(s, name, namelen); }
+inline int sys_send(native_socket s, const char* buf, int len, int flags) { return int(send(s, buf, len, flags)); }
+inline int sys_recv(native_socket s, char* buf, int len, int flags) { return int(recv(s, buf, len, flags)); }
+inline int sys_sendto(native_socket s, const char* buf, int len, int flags, const sockaddr* to, int tolen) { return int(sendto(s, buf, len, flags, to, tolen)); }
+inline int sys_recvfrom(native_socket s, char* buf, int len, int flags, sockaddr* from, native_socklen* fromlen) { return int(recvfrom(s, buf, len, flags, from, fromlen)); }
+inline int sys_shutdown(native_socket s, int how) { return shutdown(s, how); }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 namespace eve {
 
-static WSADATA s_WSAdata;
 static bool s_net_initialised = false;
 
+#ifdef EVE_WINDOWS
+
+static WSADATA s_WSAdata;
+
 void initialize_net()
 {
   WSAStartup(MAKEWORD(2, 0), &s_WSAdata);
@@ -59,76 +124,172 @@ void terminate_net()
   s_net_initialised = false;
 }
 
+#else
+
+void initialize_net()
+{
+  s_net_initialised = true;
+}
+
+void terminate_net()
+{
+  s_net_initialised = false;
+}
+
+#endif
+
 } // eve
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 eve::socket::address::address(domain domain)
 {
-  m_pimpl.construct<sockaddr_in>();
+  m_pimpl.construct<sockaddr_in6>();
   initialize(domain); 
 }
 
 eve::socket::address::address(int port, domain domain)
 {
-  m_pimpl.construct<sockaddr_in>();
+  m_pimpl.construct<sockaddr_in6>();
   set(port, domain);
 }
 
 eve::socket::address::address(const std::string& hostname, int port, domain domain)
 {
-  m_pimpl.construct<sockaddr_in>();
+  m_pimpl.construct<sockaddr_in6>();
   set(hostname, port, domain);
 }
 
 eve::socket::address::address(const address& rhs)
 {
   m_domain = rhs.m_domain;
-  m_pimpl.construct<sockaddr_in>();
-  memcpy(&m_pimpl, rhs.m_pimpl, sizeof(sockaddr_in));
+  m_pimpl.construct<sockaddr_in6>();
+  memcpy(&m_pimpl, rhs.m_pimpl, sizeof(sockaddr_in6));
 }
 
 eve::socket::address::~address()
 {
-  eve::destruct<sockaddr_in>(&m_pimpl.as<sockaddr_in>());
+  eve::destruct<sockaddr_in6>(&m_pimpl.as<sockaddr_in6>());
 }
 
 void eve::socket::address::set(int port, domain domain)
 {
   initialize(domain);
 
-  auto& addr = m_pimpl.as<sockaddr_in>(); 
-  addr.sin_addr.s_addr = INADDR_ANY;
-  addr.sin_port = htons(port);
+  if (domain == domain::IPv4)
+  {
+    auto& addr = m_pimpl.as<sockaddr_in>(); 
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+  }
+  else
+  {
+    auto& addr = m_pimpl.as<sockaddr_in6>(); 
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+  }
 }
 
 void eve::socket::address::set(const std::string& hostname, int port, domain domain)
 {
-  set(port, domain);
+  for (auto& resolved : resolve(hostname, port))
+  {
+    if (resolved.m_domain == domain)
+    {
+      *this = resolved;
+      return;
+    }
+  }
+  throw eve::socket_error("Could not resolve hostname '" + hostname + "' to an address of the requested family.");
+}
+
+int eve::socket::address::port() const
+{
+  if (m_domain == domain::IPv4)
+    return ntohs(m_pimpl.as<sockaddr_in>().sin_port);
+  return ntohs(m_pimpl.as<sockaddr_in6>().sin6_port);
+}
+
+std::string eve::socket::address::host() const
+{
+  char text[64];
+  const void* addr = m_domain == domain::IPv4
+    ? (const void*)&m_pimpl.as<sockaddr_in>().sin_addr
+    : (const void*)&m_pimpl.as<sockaddr_in6>().sin6_addr;
+  if (!inet_ntop(m_domain == domain::IPv4 ? AF_INET : AF_INET6, const_cast<void*>(addr), text, sizeof(text)))
+    return std::string();
+  return text;
+}
+
+std::vector<eve::socket::address> eve::socket::address::resolve(const std::string& hostname, int port)
+{
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  // one entry per address rather than one per address and protocol
+  hints.ai_socktype = SOCK_STREAM;
+
+  addrinfo* info = nullptr;
+  auto error = getaddrinfo(hostname.c_str(), std::to_string(port).c_str(), &hints, &info);
+  if (error != 0)
+    throw eve::socket_error("Could not resolve hostname '" + hostname + "'.", error);
 
-  auto& addr = m_pimpl.as<sockaddr_in>(); 
-  // resolve hostname
-  hostent* he;
-  if ( (he = gethostbyname(hostname.c_str()) ) == NULL )
-    throw eve::socket_error("Could not resolve hostname '" + hostname + "'.");
+  std::vector<address> addresses;
+  for (auto i = info; i; i = i->ai_next)
+  {
+    if (i->ai_family != AF_INET && i->ai_family != AF_INET6)
+      continue;
 
-  // copy the network address to sockaddr_in structure
-  memcpy(&addr.sin_addr, he->h_addr_list[0], he->h_length);
+    address resolved;
+    memcpy(&resolved.m_pimpl, i->ai_addr, std::min<eve::size>(eve::size(i->ai_addrlen), sizeof(sockaddr_in6)));
+    resolved.update_domain();
+    addresses.push_back(resolved);
+  }
+  freeaddrinfo(info);
+  return addresses;
+}
+
+bool eve::socket::address::operator==(const address& rhs) const
+{
+  if (m_domain != rhs.m_domain)
+    return false;
+
+  if (m_domain == domain::IPv4)
+  {
+    auto& a = m_pimpl.as<sockaddr_in>();
+    auto& b = rhs.m_pimpl.as<sockaddr_in>();
+    return a.sin_port == b.sin_port && a.sin_addr.s_addr == b.sin_addr.s_addr;
+  }
+
+  auto& a = m_pimpl.as<sockaddr_in6>();
+  auto& b = rhs.m_pimpl.as<sockaddr_in6>();
+  return a.sin6_port == b.sin6_port && a.sin6_scope_id == b.sin6_scope_id && memcmp(&a.sin6_addr, &b.sin6_addr, sizeof(a.sin6_addr)) == 0;
 }
 
 eve::socket::address& eve::socket::address::operator=(const address& rhs)
 {
   m_domain = rhs.m_domain;
-  memcpy(&m_pimpl, rhs.m_pimpl, sizeof(sockaddr_in));
+  memcpy(&m_pimpl, rhs.m_pimpl, sizeof(sockaddr_in6));
   return *this;
 }
 
 void eve::socket::address::initialize(domain domain)
 {
   m_domain = domain;
-  auto& addr = m_pimpl.as<sockaddr_in>(); 
-  memset(&addr, 0, sizeof(sockaddr_in));
-  addr.sin_family = m_domain == domain::IPv4 ? AF_INET : AF_INET6;
+  auto& addr = m_pimpl.as<sockaddr_in6>(); 
+  memset(&addr, 0, sizeof(sockaddr_in6));
+  m_pimpl.as<sockaddr>().sa_family = m_domain == domain::IPv4 ? AF_INET : AF_INET6;
+}
+
+void eve::socket::address::update_domain()
+{
+  // after the system filled the address in
+  m_domain = m_pimpl.as<sockaddr>().sa_family == AF_INET6 ? domain::IPv6 : domain::IPv4;
+}
+
+eve::size eve::socket::address::native_size() const
+{
+  return m_domain == domain::IPv4 ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -138,7 +299,7 @@ eve::socket::socket()
   , m_address(domain::IPv4)
   , m_blocking(true)
 {
-  m_pimpl.as<SOCKET>() = 0;
+  m_pimpl.as<native_socket>() = k_invalid_socket;
 }
 
 eve::socket::socket(type type, domain domain)
@@ -153,19 +314,15 @@ eve::socket::socket(socket&& rhs)
   m_type = rhs.m_type;
   m_state = rhs.m_state;
   m_blocking = rhs.m_blocking;
-  m_pimpl.as<SOCKET>() = rhs.m_pimpl.as<SOCKET>();
-  rhs.m_pimpl.as<SOCKET>() = 0;
+  m_address = rhs.m_address;
+  m_pimpl.as<native_socket>() = rhs.m_pimpl.as<native_socket>();
+  rhs.m_pimpl.as<native_socket>() = k_invalid_socket;
   rhs.m_state = state::invalid;
 }
 
 eve::socket::~socket()
 {
-  if (m_state != state::invalid)
-  {
-    eve_assert(m_pimpl.as<SOCKET>() != 0);
-    shutdown();
-    closesocket(m_pimpl.as<SOCKET>());
-  }
+  close();
 }
 
 void eve::socket::create(type type, domain domain)
@@ -173,22 +330,23 @@ void eve::socket::create(type type, domain domain)
   if (!s_net_initialised)
     throw socket_error("Networking module not initialised.");
 
-  if (m_pimpl.as<SOCKET>() != 0)
+  if (m_pimpl.as<native_socket>() != k_invalid_socket)
     throw socket_error("Socket already created.");
 
   m_address = address(domain);
 
-  m_pimpl.as<SOCKET>() = sys_socket(
+  m_pimpl.as<native_socket>() = sys_socket(
     domain == domain::IPv4 ? AF_INET : AF_INET6,
     type == type::stream ? SOCK_STREAM : SOCK_DGRAM,
     0
   );
 
-  if (m_pimpl.as<SOCKET>() == INVALID_SOCKET)
-    throw eve::socket_error("Could not create new socket.", WSAGetLastError());
+  if (m_pimpl.as<native_socket>() == k_invalid_socket)
+    throw eve::socket_error("Could not create new socket.", last_error());
 
   m_type = type;
   m_state = state::closed;
+  m_blocking = true;
 }
 
 void eve::socket::listen(eve::uint32 port, eve::size backlog)
@@ -199,17 +357,44 @@ void eve::socket::listen(eve::uint32 port, eve::size backlog)
   make_blocking(true);
   m_address.set(port, m_address.m_domain);
 
-  auto& sa = m_address.m_pimpl.as<sockaddr_in>();
+  auto& sock = m_pimpl.as<native_socket>();
+
+#ifndef EVE_WINDOWS
+  // lets a restarted server bind while old connections linger in TIME_WAIT
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
 
-  if (bind(m_pimpl.as<SOCKET>(), (sockaddr*)&sa, sizeof(address)) < 0)
-    throw eve::socket_error("Cannot bind socket to address.", WSAGetLastError());
+  if (sys_bind(sock, &m_address.m_pimpl.as<sockaddr>(), int(m_address.native_size())) < 0)
+    throw eve::socket_error("Cannot bind socket to address.", last_error());
 
-  if (sys_listen(m_pimpl.as<SOCKET>(), backlog))
-    throw eve::socket_error("Cannot set socket in listen mode.", WSAGetLastError());
+  if (sys_listen(sock, int(backlog)))
+    throw eve::socket_error("Cannot set socket in listen mode.", last_error());
 
   m_state = state::listening;
 }
 
+void eve::socket::bind(eve::uint32 port)
+{
+  if (m_state != state::closed)
+    throw eve::socket_error("Cannot bind socket, not closed.");
+
+  m_address.set(port, m_address.m_domain);
+
+  if (sys_bind(m_pimpl.as<native_socket>(), &m_address.m_pimpl.as<sockaddr>(), int(m_address.native_size())) < 0)
+    throw eve::socket_error("Cannot bind socket to address.", last_error());
+}
+
+eve::socket::address eve::socket::local_address() const
+{
+  address result(m_address.m_domain);
+  native_socklen size = sizeof(sockaddr_in6);
+  if (getsockname(m_pimpl.as<native_socket>(), &result.m_pimpl.as<sockaddr>(), &size) < 0)
+    throw eve::socket_error("Cannot retrieve socket address.", last_error());
+  result.update_domain();
+  return result;
+}
+
 eve::socket eve::socket::accept()
 {
   socket client;
@@ -247,7 +432,62 @@ void eve::socket::receive_all(char* buffer, eve::size size)
   char* ptr = buffer;
   char* end = buffer + size;
   while (ptr < end)
-    ptr += receive(ptr, eve::size(end - ptr));
+  {
+    auto bytes = receive(ptr, eve::size(end - ptr));
+    if (bytes == 0)
+      throw eve::socket_error("Connection closed by peer while receiving data.");
+    ptr += bytes;
+  }
+}
+
+eve::size eve::socket::send_to(const char* data, eve::size size, const address& to)
+{
+  do_send_to(data, size, to, true);
+  return size;
+}
+
+eve::size eve::socket::receive_from(char* buffer, eve::size size, address& from)
+{
+  do_receive_from(buffer, size, from, true);
+  return size;
+}
+
+eve::size eve::socket::send(const chunk* chunks, eve::size count)
+{
+  eve::size size;
+  do_send_gather(chunks, count, size, true);
+  return size;
+}
+
+void eve::socket::send_all(const chunk* chunks, eve::size count)
+{
+  chunk pending[k_max_gather];
+  while (count > 0)
+  {
+    auto batch = std::min(count, k_max_gather);
+    std::copy(chunks, chunks + batch, pending);
+
+    // resume after partial sends from the first chunk not completely sent
+    chunk* first = pending;
+    while (batch > 0)
+    {
+      auto sent = send(first, batch);
+      while (batch > 0 && sent >= first->size)
+      {
+        sent -= first->size;
+        ++first;
+        --batch;
+      }
+      if (batch > 0)
+      {
+        first->data += sent;
+        first->size -= sent;
+      }
+    }
+
+    chunks += std::min(count, k_max_gather);
+    count -= std::min(count, k_max_gather);
+  }
 }
 
 bool eve::socket::try_accept(socket& client)
@@ -255,6 +495,11 @@ bool eve::socket::try_accept(socket& client)
   return do_accept(client, false);
 }
 
+bool eve::socket::try_connect(const address& address)
+{
+  return do_connect(address, false);
+}
+
 bool eve::socket::try_send(const char* data, eve::size& size)
 {
   return do_send(data, size, false);
@@ -265,6 +510,45 @@ bool eve::socket::try_receive(char* buffer, eve::size& size)
   return do_receive(buffer, size, false);
 }
 
+bool eve::socket::try_send(const chunk* chunks, eve::size count, eve::size& size)
+{
+  return do_send_gather(chunks, count, size, false);
+}
+
+bool eve::socket::try_send_to(const char* data, eve::size& size, const address& to)
+{
+  return do_send_to(data, size, to, false);
+}
+
+bool eve::socket::try_receive_from(char* buffer, eve::size& size, address& from)
+{
+  return do_receive_from(buffer, size, from, false);
+}
+
+void eve::socket::cork(bool corked)
+{
+#ifdef TCP_CORK
+  set_option(IPPROTO_TCP, TCP_CORK, corked);
+#else
+  set_option(IPPROTO_TCP, TCP_NODELAY, !corked);
+#endif
+}
+
+bool eve::socket::reuse_port(bool enabled)
+{
+#ifdef SO_REUSEPORT
+  set_option(SOL_SOCKET, SO_REUSEPORT, enabled);
+  return true;
+#else
+  return !enabled;
+#endif
+}
+
+void eve::socket::nodelay(bool enabled)
+{
+  set_option(IPPROTO_TCP, TCP_NODELAY, enabled);
+}
+
 void eve::socket::shutdown()
 {
   if (m_state == state::invalid)
@@ -272,20 +556,38 @@ void eve::socket::shutdown()
 
   if (m_state != state::closed)
   {
-    sys_shutdown(m_pimpl.as<SOCKET>(), 2);
+    sys_shutdown(m_pimpl.as<native_socket>(), 2);
     m_state = state::closed;
   }
 }
 
-eve::socket& eve::socket::operator=(socket&& rhs)
+void eve::socket::close()
 {
+  if (m_state == state::invalid)
+    return;
+
+  eve_assert(m_pimpl.as<native_socket>() != k_invalid_socket);
   shutdown();
+  close_socket(m_pimpl.as<native_socket>());
+  m_pimpl.as<native_socket>() = k_invalid_socket;
+  m_state = state::invalid;
+}
+
+eve::uintptr eve::socket::native_handle() const
+{
+  return eve::uintptr(m_pimpl.as<native_socket>());
+}
+
+eve::socket& eve::socket::operator=(socket&& rhs)
+{
+  close();
   m_type = rhs.m_type;
   m_state = rhs.m_state;
+  m_blocking = rhs.m_blocking;
   m_address = rhs.m_address;
-  m_pimpl.as<SOCKET>() = rhs.m_pimpl.as<SOCKET>();
+  m_pimpl.as<native_socket>() = rhs.m_pimpl.as<native_socket>();
   rhs.m_state = state::invalid;
-  rhs.m_pimpl.as<SOCKET>() = 0;
+  rhs.m_pimpl.as<native_socket>() = k_invalid_socket;
   return *this;
 }
 
@@ -297,13 +599,22 @@ bool eve::socket::do_connect(const address& address, bool block)
     throw eve::socket_error("Cannot connect socket, not closed.");
   
   make_blocking(block);
-  auto& sock = m_pimpl.as<SOCKET>();
+  auto& sock = m_pimpl.as<native_socket>();
 
   m_address = address;
-  auto result = sys_connect(sock, &m_address.m_pimpl.as<sockaddr>(), sizeof(sockaddr_in));
+  auto result = sys_connect(sock, &m_address.m_pimpl.as<sockaddr>(), int(m_address.native_size()));
   
-  if (check_result(result, block, "An error occurred while connecting socket."))
-    return false;
+  if (result == SOCKET_ERROR && !block)
+  {
+    // a non-blocking connect completes in the background, calling again reports its progress
+    auto error = last_error();
+    if (connect_pending(error))
+      return false;
+    if (already_connected(error))
+      result = 0;
+  }
+
+  check_result(result, block, "An error occurred while connecting socket.");
 
   m_state = state::connected;
   return true;
@@ -315,22 +626,25 @@ bool eve::socket::do_accept(socket& client, bool block)
     throw eve::socket_error("Cannot connect socket, not in listening state.");
 
   make_blocking(block);
-  auto& sock = m_pimpl.as<SOCKET>();
+  auto& sock = m_pimpl.as<native_socket>();
 
-  int size = sizeof(sockaddr_in);
-  SOCKET& client_sock = client.m_pimpl.as<SOCKET>();
+  if (client.m_state != state::invalid)
+    client.close();
+
+  native_socklen size = sizeof(sockaddr_in6);
+  native_socket& client_sock = client.m_pimpl.as<native_socket>();
   client_sock = sys_accept(
     sock, 
     &client.m_address.m_pimpl.as<sockaddr>(),
     &size);
 
-  if (check_result(int(client_sock), block, "An error occurred while accepting new clients."))
+  if (check_result(client_sock == k_invalid_socket ? SOCKET_ERROR : 0, block, "An error occurred while accepting new clients."))
     return false;
 
   client.m_type = m_type;
   client.m_state = state::connected;
-  m_address.m_domain = m_address.m_domain;
-  m_blocking = false;
+  client.m_address.update_domain();
+  client.m_blocking = k_accept_inherits_blocking ? m_blocking : true;
   return true;
 }
 
@@ -340,9 +654,9 @@ bool eve::socket::do_send(const char* data, eve::size& size, bool block)
     throw eve::socket_error("Cannot send data through socket, not connected.");
   
   make_blocking(block);
-  auto& sock = m_pimpl.as<SOCKET>();
+  auto& sock = m_pimpl.as<native_socket>();
 
-  auto result = sys_send(sock, data, size, 0);
+  auto result = sys_send(sock, data, int(size), k_send_flags);
   if (check_result(result, block, "An error occurred while sending data."))
     return false;
 
@@ -356,9 +670,9 @@ bool eve::socket::do_receive(char* buffer, eve::size& size, bool block)
     throw eve::socket_error("Cannot receive data through socket, not connected.");
   
   make_blocking(block);
-  auto& sock = m_pimpl.as<SOCKET>();
+  auto& sock = m_pimpl.as<native_socket>();
 
-  auto result = sys_recv(sock, buffer, size, 0);
+  auto result = sys_recv(sock, buffer, int(size), 0);
   if (check_result(result, block, "An error occurred while receiving data."))
     return false;
 
@@ -366,29 +680,121 @@ bool eve::socket::do_receive(char* buffer, eve::size& size, bool block)
   return true;
 }
 
+bool eve::socket::do_send_gather(const chunk* chunks, eve::size count, eve::size& size, bool block)
+{
+  if (m_state != state::connected)
+    throw eve::socket_error("Cannot send data through socket, not connected.");
+
+  make_blocking(block);
+  auto& sock = m_pimpl.as<native_socket>();
+  count = std::min(count, k_max_gather);
+
+#ifdef EVE_WINDOWS
+  WSABUF buffers[k_max_gather];
+  for (eve::size i = 0; i < count; ++i)
+  {
+    buffers[i].buf = const_cast<char*>(chunks[i].data);
+    buffers[i].len = ULONG(chunks[i].size);
+  }
+
+  DWORD sent = 0;
+  auto result = WSASend(sock, buffers, DWORD(count), &sent, 0, nullptr, nullptr);
+  if (check_result(result, block, "An error occurred while sending data."))
+    return false;
+  size = eve::size(sent);
+#else
+  iovec buffers[k_max_gather];
+  for (eve::size i = 0; i < count; ++i)
+  {
+    buffers[i].iov_base = const_cast<char*>(chunks[i].data);
+    buffers[i].iov_len = chunks[i].size;
+  }
+
+  msghdr header;
+  memset(&header, 0, sizeof(header));
+  header.msg_iov = buffers;
+  header.msg_iovlen = count;
+
+  auto result = int(sendmsg(sock, &header, k_send_flags));
+  if (check_result(result, block, "An error occurred while sending data."))
+    return false;
+  size = eve::size(result);
+#endif
+
+  return true;
+}
+
+bool eve::socket::do_send_to(const char* data, eve::size& size, const address& to, bool block)
+{
+  if (m_type != type::datagram || m_state == state::invalid)
+    throw eve::socket_error("Cannot send datagram through socket, not a datagram socket.");
+
+  make_blocking(block);
+  auto& sock = m_pimpl.as<native_socket>();
+
+  auto result = sys_sendto(sock, data, int(size), k_send_flags, &to.m_pimpl.as<sockaddr>(), int(to.native_size()));
+  if (check_result(result, block, "An error occurred while sending datagram."))
+    return false;
+
+  size = result;
+  return true;
+}
+
+bool eve::socket::do_receive_from(char* buffer, eve::size& size, address& from, bool block)
+{
+  if (m_type != type::datagram || m_state == state::invalid)
+    throw eve::socket_error("Cannot receive datagram through socket, not a datagram socket.");
+
+  make_blocking(block);
+  auto& sock = m_pimpl.as<native_socket>();
+
+  native_socklen fromsize = sizeof(sockaddr_in6);
+  auto result = sys_recvfrom(sock, buffer, int(size), 0, &from.m_pimpl.as<sockaddr>(), &fromsize);
+  from.update_domain();
+
+#ifdef EVE_WINDOWS
+  // the truncated part of a datagram larger than the buffer is discarded, like elsewhere
+  if (result == SOCKET_ERROR && last_error() == WSAEMSGSIZE)
+    result = int(size);
+#endif
+
+  if (check_result(result, block, "An error occurred while receiving datagram."))
+    return false;
+
+  size = result;
+  return true;
+}
+
 bool eve::socket::check_result(int result, bool block, const std::string& errormsg)
 {
   if (result == SOCKET_ERROR)
   {
-    auto error = WSAGetLastError();
-    eve_assert(!(block && error == WSAEWOULDBLOCK));
-    if (error == WSAEWOULDBLOCK)
+    auto error = last_error();
+    eve_assert(!(block && would_block(error)));
+    if (would_block(error))
       return true;
     else
-      throw eve::socket_error("An error occurred while accepting new clients.", WSAGetLastError());
+      throw eve::socket_error(errormsg, error);
   }
   return false;
 }
 
+void eve::socket::set_option(int level, int option, int value)
+{
+  if (m_state == state::invalid)
+    throw eve::socket_error("Cannot set option of socket, not created.");
+
+  if (setsockopt(m_pimpl.as<native_socket>(), level, option, (const char*)&value, sizeof(value)) < 0)
+    throw eve::socket_error("Cannot set socket option.", last_error());
+}
+
 void eve::socket::make_blocking(bool blocking)
 {
   if (m_blocking == blocking)
     return;
 
   m_blocking = blocking;
-  u_long nNoBlock = u_long(!blocking);
-  ioctlsocket(m_pimpl.as<SOCKET>(), FIONBIO, &nNoBlock);
+  set_nonblocking(m_pimpl.as<native_socket>(), !blocking);
 }
 
 #endif
-
@@ -26,6 +26,7 @@
 \******************************************************************************/
 
 #include "eve/pixelbuffer.h"
+#include "eve/binary.h"
 #include "eve/exceptions.h"
 
 #include <png.h>
@@ -48,10 +49,42 @@ pixelbuffer::~pixelbuffer()
 }
 
 void pixelbuffer::load(std::istream& source)
+{
+  if (resource::read_cooked_header(source))
+  {
+    load_raw(source);
+    return;
+  }
+  if (!validatePNG(source))
+    throw eve::system_error("Image is not a valid PNG.");
+  loadPNG(source);
+}
+
+bool pixelbuffer::cook(std::istream& source, std::ostream& output)
 {
   if (!validatePNG(source))
     throw eve::system_error("Image is not a valid PNG.");
   loadPNG(source);
+  resource::write_cooked_header(output);
+  save_raw(output);
+  unload();
+  return true;
+}
+
+void pixelbuffer::load_raw(std::istream& source)
+{
+  binaryreader reader(source.rdbuf());
+  reader >> m_size.x >> m_size.y >> m_channels >> m_bits_per_channel >> m_bits_per_pixel;
+  m_data = new char[data_size()];
+  reader.read(m_data, data_size());
+}
+
+void pixelbuffer::save_raw(std::ostream& output) const
+{
+  binarywriter writer(output.rdbuf());
+  writer << m_size.x << m_size.y << m_channels << m_bits_per_channel << m_bits_per_pixel;
+  writer.write(m_data, data_size());
+  writer.flush();
 }
 
 void pixelbuffer::unload()
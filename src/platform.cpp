@@ -51,6 +51,133 @@ eve::id eve::unique_id()
 
 static bool s_initialized = false;
 
+//// CPU FEATURES
+
+#ifdef EVE_X86
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+static eve::uint32 s_cpu_features = 0;
+static eve::uint32 s_cpu_mask = ~0u;
+static eve::cpu::dispatcher_base* s_dispatchers = nullptr;
+
+#ifdef EVE_X86
+
+static void cpuid(int info[4], int leaf)
+{
+#ifdef _MSC_VER
+  __cpuidex(info, leaf, 0);
+#else
+  __cpuid_count(leaf, 0, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+/** @returns the register state saving bits enabled by the OS (XCR0). */
+static eve::uint64 xgetbv()
+{
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  eve::uint32 eax, edx;
+  __asm__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+  return (eve::uint64(edx) << 32) | eax;
+#endif
+}
+
+#endif
+
+static eve::uint32 detect_cpu_features()
+{
+  using namespace eve::cpu;
+  eve::uint32 features = 0;
+
+#ifdef EVE_X86
+  int info[4];
+  cpuid(info, 0);
+  int leaves = info[0];
+
+  cpuid(info, 1);
+  int ecx = info[2], edx = info[3];
+  if (edx & (1 << 26)) features |= sse2;
+  if (ecx & (1 << 0))  features |= sse3;
+  if (ecx & (1 << 9))  features |= ssse3;
+  if (ecx & (1 << 19)) features |= sse41;
+  if (ecx & (1 << 20)) features |= sse42;
+  if (ecx & (1 << 23)) features |= popcnt;
+
+  // AVX registers are only usable if the OS saves them on context switches
+  bool osxsave = (ecx & (1 << 27)) != 0;
+  eve::uint64 xcr0 = osxsave ? xgetbv() : 0;
+  bool ymm = (xcr0 & 0x6) == 0x6;
+  bool zmm = (xcr0 & 0xE6) == 0xE6;
+
+  if (ymm && (ecx & (1 << 28)))
+  {
+    features |= avx;
+    if (ecx & (1 << 12)) features |= fma;
+  }
+
+  if (leaves >= 7)
+  {
+    cpuid(info, 7);
+    int ebx = info[1];
+    if (ymm && (ebx & (1 << 5)))  features |= avx2;
+    if (ebx & (1 << 8))           features |= bmi2;
+    if (zmm && (ebx & (1 << 16))) features |= avx512f;
+    if (zmm && (ebx & (1 << 30))) features |= avx512bw;
+  }
+#endif
+
+  return features;
+}
+
+static void initialize_cpu()
+{
+  s_cpu_features = detect_cpu_features();
+  eve::cpu::dispatcher_base::rebind_all();
+}
+
+eve::uint32 eve::cpu::features()
+{
+  return s_cpu_features & s_cpu_mask;
+}
+
+void eve::cpu::limit(uint32 mask)
+{
+  s_cpu_mask = mask;
+  dispatcher_base::rebind_all();
+}
+
+eve::cpu::dispatcher_base::dispatcher_base()
+  : m_next(s_dispatchers)
+{
+  s_dispatchers = this;
+}
+
+eve::cpu::dispatcher_base::~dispatcher_base()
+{
+  for (auto it = &s_dispatchers; *it; it = &(*it)->m_next)
+  {
+    if (*it == this)
+    {
+      *it = m_next;
+      break;
+    }
+  }
+}
+
+void eve::cpu::dispatcher_base::rebind_all()
+{
+  for (auto it = s_dispatchers; it; it = it->m_next)
+    it->bind();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 #ifdef _MSC_VER
 
 #include <Windows.h>
@@ -62,6 +189,8 @@ namespace eve
 {
   void initialize_platform()
   {
+    initialize_cpu();
+
   #ifndef EVE_RELEASE
     HANDLE process = GetCurrentProcess();
 
@@ -78,6 +207,17 @@ namespace eve
   }
 }
 
+#elif defined(EVE_LINUX)
+
+namespace eve
+{
+  void initialize_platform()
+  {
+    initialize_cpu();
+    s_initialized = true;
+  }
+}
+
 #else
 #error Implement platform specific functions.
 #endif
\ No newline at end of file
@@ -26,9 +26,17 @@
 \******************************************************************************/
 
 #include "eve/resource.h"
+#include "eve/cooker.h"
 #include "eve/debug.h"
 #include "eve/exceptions.h"
 #include "eve/log.h"
+#include "eve/time.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <functional>
@@ -40,12 +48,35 @@ using namespace eve;
 //// STATIC RESOURCES DATA
 static eve::size s_version = 0;
 static std::unordered_map<std::string, eve::resource*> s_resources;
+static std::string s_cache_directory;
+static resource::cache_check s_cache_check = resource::cache_check::stamp;
+static std::unordered_map<std::string, cooker::entry> s_cooked;
+
+//// LOADER THREADS DATA
+// guards the resource library, the references and the loading state of resources
+static std::mutex s_mutex;
+static std::condition_variable s_work;
+static std::condition_variable s_loaded;
+static std::deque<eve::resource*> s_jobs;
+static std::deque<eve::resource*> s_finalize;
+static std::vector<std::thread> s_threads;
+static eve::size s_thread_count = 0;
+static eve::size s_loading = 0;
+static bool s_stopping = false;
+static eve_thread_local bool s_worker = false;
+
+eve_thread_local bool resource::s_cooking = false;
+
+// bumped whenever the binary serialization format changes: artifacts with another magic are
+// ignored when loading and cooked again by the cooker
+static const char kCookedMagic[4] = { 'e', 'v', 'c', '3' };
 
 namespace eve
 {
   /** Called by eve::application. */
   void terminate_resources()
   {
+    resource::stop_loaders();
     eve_assert(s_resources.size() == 0);
   }
 }
@@ -84,6 +115,9 @@ void resource::source::open(const std::string& path)
 
 resource::resource()
   : m_references(0)
+  , m_valid(false)
+  , m_status(status::ready)
+  , m_loader_reference(false)
 {
 }
 
@@ -127,11 +161,101 @@ void resource::reload()
     (*it)->on_reload();
 }
 
+void resource::finalize()
+{
+}
+
 void resource::unload()
 {
   m_valid = false;
 }
 
+bool resource::cook(std::istream&, std::ostream&)
+{
+  return false;
+}
+
+void resource::write_cooked_header(std::ostream& output)
+{
+  output.write(kCookedMagic, sizeof(kCookedMagic));
+}
+
+bool resource::read_cooked_header(std::istream& source)
+{
+  char magic[sizeof(kCookedMagic)];
+  source.read(magic, sizeof(magic));
+  if (source.gcount() == sizeof(magic) && std::memcmp(magic, kCookedMagic, sizeof(magic)) == 0)
+    return true;
+  source.clear();
+  source.seekg(-source.gcount(), std::ios::cur);
+  return false;
+}
+
+void resource::use_cache(const std::string& directory, cache_check check)
+{
+  s_cache_directory = directory;
+  s_cache_check = check;
+  s_cooked.clear();
+
+  cooker::manifest manifest;
+  try
+  {
+    manifest = cooker::read_manifest(directory);
+  } catch (std::exception& e)
+  {
+    eve::log::warning("resource cache \"" + directory + "\" ignored: " + e.what());
+    return;
+  }
+
+  for (auto& entry : manifest.entries)
+    s_cooked[entry.source] = entry;
+}
+
+/** Opens the cooked artifact of @p path if there is one and its source did not change since
+    it was cooked. */
+static bool open_cooked(const std::string& path, resource::source& source)
+{
+  auto it = s_cooked.find(path);
+  if (it == s_cooked.end())
+    return false;
+
+  try
+  {
+    switch (s_cache_check)
+    {
+    case resource::cache_check::trust:
+      break;
+    case resource::cache_check::stamp:
+    {
+      eve::uint64 size;
+      eve::int64 modified;
+      if (!cooker::stat_file(path, size, modified) || size != it->second.size
+        || modified != it->second.modified)
+        return false;
+      break;
+    }
+    case resource::cache_check::content:
+      if (cooker::hash_file(path) != it->second.hash)
+        return false;
+      break;
+    }
+    std::string artifact = s_cache_directory;
+    eve::path::push(artifact, it->second.artifact);
+
+    char magic[sizeof(kCookedMagic)];
+    std::ifstream check(artifact.c_str(), std::ios::binary);
+    check.read(magic, sizeof(magic));
+    if (check.gcount() != sizeof(magic) || std::memcmp(magic, kCookedMagic, sizeof(magic)) != 0)
+      return false;
+
+    source.open(artifact);
+  } catch (eve::file_not_found_error&)
+  {
+    return false;
+  }
+  return true;
+}
+
 resource* resource::find(const std::string& path)
 {
   auto it = s_resources.find(path);
@@ -140,12 +264,97 @@ resource* resource::find(const std::string& path)
   return it->second;
 }
 
-resource* resource::process_new(eve::unique_ptr<resource>::type res)
+resource* resource::acquire(const std::string& path, const std::function<resource*()>& create, bool async, resource_host* host)
+{
+  std::unique_lock<std::mutex> lock(s_mutex);
+  bool created_here = false;
+  auto res = find(path);
+  if (!res)
+  {
+    // created unlocked, the constructor may load other resources
+    lock.unlock();
+    eve::unique_ptr<resource>::type created(create());
+    lock.lock();
+
+    res = find(path);
+    if (!res)
+    {
+      res = created.release();
+      res->m_path = path;
+      res->m_valid = false;
+      s_resources[path] = res;
+      created_here = true;
+      if (async)
+      {
+        res->m_status = status::queued;
+        res->m_loader_reference = true;
+        ++res->m_references;
+        s_jobs.push_back(res);
+        if (s_threads.empty())
+        {
+          auto count = s_thread_count ? s_thread_count : std::max(std::thread::hardware_concurrency(), 2u) - 1;
+          for (eve::size i = 0; i < count; ++i)
+            s_threads.emplace_back(&resource::run_loader);
+        }
+        s_work.notify_one();
+      }
+      else
+      {
+        res->m_status = status::loading;
+        ++s_loading;
+      }
+    }
+    else
+    {
+      // another thread inserted it meanwhile
+      lock.unlock();
+      created.reset();
+      lock.lock();
+    }
+  }
+
+  ++res->m_references;
+  if (host)
+    res->add_dependant(host);
+  lock.unlock();
+
+  if (!async)
+  {
+    if (created_here)
+      load_source(res);
+    finish(res);
+  }
+  return res;
+}
+
+void resource::retain(resource* res, resource_host* host)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  ++res->m_references;
+  if (host)
+    res->add_dependant(host);
+}
+
+void resource::release(resource* res, resource_host* host)
+{
+  {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (host)
+      res->remove_dependant(host);
+    if (--res->m_references > 0)
+      return;
+    s_resources.erase(res->path());
+  }
+  dispose(res);
+}
+
+void resource::load_source(resource* res)
 {
-  res->m_valid = false;
   try
   {
-    resource::source source(res->m_path);
+    resource::source source;
+    if (!open_cooked(res->m_path, source))
+      source.open(res->m_path);
     if (!(*source).good())
       throw std::runtime_error("file \"" + res->m_path + "\" not good for reading.");
     res->load(*source);
@@ -154,13 +363,210 @@ resource* resource::process_new(eve::unique_ptr<resource>::type res)
   {
     eve::log::error("resource \"" + res->path() + "\"loading error: " + e.what());
   }
-  s_resources[res->m_path] = res.get();
-  return res.release();
+
+  std::lock_guard<std::mutex> lock(s_mutex);
+  res->m_status = status::loaded;
+  --s_loading;
+
+  // finalized in loading order, after what it depends on
+  if (s_worker)
+  {
+    s_finalize.push_back(res);
+    if (!res->m_loader_reference)
+    {
+      res->m_loader_reference = true;
+      ++res->m_references;
+    }
+  }
+  s_loaded.notify_all();
+}
+
+void resource::finalize_loaded(resource* res)
+{
+  if (res->m_valid)
+  {
+    try
+    {
+      res->finalize();
+    } catch (std::exception& e)
+    {
+      res->m_valid = false;
+      eve::log::error("resource \"" + res->path() + "\"loading error: " + e.what());
+    }
+  }
+
+  std::vector<std::function<void()>> callbacks;
+  bool loader_reference;
+  {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    res->m_status = status::ready;
+    callbacks.swap(res->m_callbacks);
+    loader_reference = res->m_loader_reference;
+    res->m_loader_reference = false;
+  }
+
+  for (auto& callback : callbacks)
+    callback();
+  if (loader_reference)
+    release(res, nullptr);
+}
+
+void resource::finish(resource* res)
+{
+  std::unique_lock<std::mutex> lock(s_mutex);
+  for (;;)
+  {
+    switch (res->m_status)
+    {
+      case status::ready:
+      case status::cancelled:
+        return;
+
+      case status::queued:
+        // no loader thread took it yet, load it here rather than wait
+        s_jobs.erase(std::find(s_jobs.begin(), s_jobs.end(), res));
+        res->m_status = status::loading;
+        ++s_loading;
+        lock.unlock();
+        load_source(res);
+        lock.lock();
+        break;
+
+      case status::loading:
+        s_loaded.wait(lock);
+        break;
+
+      case status::loaded:
+      {
+        // loader threads leave finalization to the main thread
+        if (s_worker)
+          return;
+
+        // what was loaded before may be needed by this, finalize it first
+        auto next = res;
+        auto queued = std::find(s_finalize.begin(), s_finalize.end(), res);
+        if (queued != s_finalize.end())
+        {
+          next = s_finalize.front();
+          s_finalize.pop_front();
+        }
+        lock.unlock();
+        finalize_loaded(next);
+        lock.lock();
+        break;
+      }
+    }
+  }
+}
+
+bool resource::is_ready(const resource* res)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  return res->m_status == status::ready || res->m_status == status::cancelled;
+}
+
+void resource::when_ready(resource* res, std::function<void()> callback)
+{
+  {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (res->m_status != status::ready && res->m_status != status::cancelled)
+    {
+      res->m_callbacks.push_back(std::move(callback));
+      return;
+    }
+  }
+  callback();
+}
+
+eve::size resource::finalize_pending(double budget)
+{
+  stopwatch stopwatch;
+  eve::size finalized = 0;
+  do
+  {
+    resource* res;
+    {
+      std::lock_guard<std::mutex> lock(s_mutex);
+      if (s_finalize.empty())
+        break;
+      res = s_finalize.front();
+      s_finalize.pop_front();
+    }
+    finalize_loaded(res);
+    ++finalized;
+  } while (stopwatch.elapsed() < budget);
+  return finalized;
+}
+
+eve::size resource::pending()
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  return eve::size(s_jobs.size() + s_loading + s_finalize.size());
+}
+
+void resource::loader_threads(eve::size count)
+{
+  std::lock_guard<std::mutex> lock(s_mutex);
+  s_thread_count = count;
+}
+
+void resource::run_loader()
+{
+  s_worker = true;
+  std::unique_lock<std::mutex> lock(s_mutex);
+  for (;;)
+  {
+    s_work.wait(lock, [] { return s_stopping || !s_jobs.empty(); });
+    if (s_stopping)
+      return;
+
+    auto res = s_jobs.front();
+    s_jobs.pop_front();
+    res->m_status = status::loading;
+    ++s_loading;
+    lock.unlock();
+    load_source(res);
+    lock.lock();
+  }
+}
+
+void resource::stop_loaders()
+{
+  {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_stopping = true;
+    s_work.notify_all();
+  }
+  for (auto& thread : s_threads)
+    thread.join();
+  s_threads.clear();
+  s_stopping = false;
+
+  // what is still queued or not finalized is cancelled, its callbacks told so before the loader
+  // references are released
+  std::deque<resource*> abandoned;
+  abandoned.swap(s_jobs);
+  abandoned.insert(abandoned.end(), s_finalize.begin(), s_finalize.end());
+  s_finalize.clear();
+  for (auto res : abandoned)
+  {
+    std::vector<std::function<void()>> callbacks;
+    {
+      std::lock_guard<std::mutex> lock(s_mutex);
+      res->m_valid = false;
+      res->m_status = status::cancelled;
+      res->m_loader_reference = false;
+      callbacks.swap(res->m_callbacks);
+    }
+
+    for (auto& callback : callbacks)
+      callback();
+    release(res, nullptr);
+  }
 }
 
 void resource::dispose(resource* resource)
 {
-  s_resources.erase(resource->path());
   resource->unload();
   eve::destroy(resource);
 }
@@ -26,10 +26,23 @@
 \******************************************************************************/
 
 #include "eve/serialization.h"
+#include "eve/serialization/packed.h"
 #include "eve/debug.h"
+#include "eve/memory.h"
 #include <istream>
 #include <ostream>
+#include <sstream>
+#include <iterator>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef EVE_X86
+#  include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
 
 using namespace eve::detail;
 
@@ -47,6 +60,30 @@ void eve::detail::field::deserialize_as_text(serialization::parser& parser, void
   m_table->deserialize_as_text(parser, ptr);
 }
 
+void eve::detail::field::serialize_as_binary(const void* object, binarywriter& writer) const
+{
+  auto ptr = static_cast<const char*>(object) + m_offset;
+  m_table->serialize_as_binary(ptr, writer);
+}
+
+void eve::detail::field::deserialize_as_binary(binaryreader& reader, void* object) const
+{
+  auto ptr = static_cast<char*>(object) + m_offset;
+  m_table->deserialize_as_binary(reader, ptr);
+}
+
+void eve::detail::field::serialize_as_json(const void* object, std::ostream& output, const std::string& tab) const
+{
+  auto ptr = static_cast<const char*>(object) + m_offset;
+  m_table->serialize_as_json(ptr, output, tab);
+}
+
+void eve::detail::field::deserialize_as_json(serialization::json_reader& reader, void* object) const
+{
+  auto ptr = static_cast<char*>(object) + m_offset;
+  m_table->deserialize_as_json(reader, ptr);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 const eve::detail::field* eve::detail::serialization_info_base::field(const std::string& name) const
@@ -65,6 +102,59 @@ const eve::detail::field* eve::detail::serialization_info_base::field(eve::size
   return &m_fields.begin()[index];
 }
 
+const eve::detail::field* eve::detail::serialization_info_base::field(const char* name, eve::size length) const
+{
+  for (auto& field : m_fields)
+    if (field.name().size() == length && memcmp(field.name().data(), name, length) == 0)
+      return &field;
+  return nullptr;
+}
+
+const eve::detail::field* eve::detail::serialization_info_base::field_by_id(eve::uint16 id) const
+{
+  for (eve::size i = 0; i < num_fields(); ++i)
+    if (field_id(i) == id)
+      return field(i);
+  return nullptr;
+}
+
+eve::uint16 eve::detail::serialization_info_base::field_id(eve::size index) const
+{
+  auto id = field(index)->id();
+  return id ? id : eve::uint16(index + 1);
+}
+
+eve::uint32 eve::detail::serialization_info_base::schema_version() const
+{
+  if (m_version)
+    return m_version;
+
+  // FNV-1a of the field tags in declaration order
+  eve::uint32 hash = 2166136261U;
+  for (eve::size i = 0; i < num_fields(); ++i)
+  {
+    auto id = field_id(i);
+    eve_debug_code(for (eve::size j = 0; j < i; ++j) eve_assert(field_id(j) != id));
+    hash = (hash ^ (id & 0xFF)) * 16777619U;
+    hash = (hash ^ (id >> 8)) * 16777619U;
+  }
+  m_version = hash;
+  return hash;
+}
+
+const eve::detail::serialization_info_base::read_plan* eve::detail::serialization_info_base::plan(eve::uint32 version) const
+{
+  std::lock_guard<std::mutex> lock(m_plans_mutex);
+  auto it = m_plans.find(version);
+  return it == m_plans.end() ? nullptr : &it->second;
+}
+
+void eve::detail::serialization_info_base::publish_plan(eve::uint32 version, read_plan plan) const
+{
+  std::lock_guard<std::mutex> lock(m_plans_mutex);
+  m_plans.insert(std::make_pair(version, std::move(plan)));
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void eve::detail::serialize_class_as_text
@@ -110,6 +200,141 @@ void eve::detail::deserialize_class_as_text(const serialization_info_base& info,
   parser.expect('}');
 }
 
+void eve::detail::serialize_class_as_binary(const serialization_info_base& info, const void* instance, binarywriter& writer)
+{
+  writer << info.schema_version() << eve::uint16(info.num_fields());
+
+  // each field is written as (id, length, payload), the payload is first written to a scratch
+  // buffer in order to know its length.
+  std::stringbuf scratch;
+  binarywriter fieldwriter(&scratch);
+  for (eve::size i = 0; i < info.num_fields(); ++i)
+  {
+    scratch.str(std::string());
+    info.field(i)->serialize_as_binary(instance, fieldwriter);
+    const std::string& payload = scratch.str();
+    writer << info.field_id(i) << eve::uint32(payload.size());
+    writer.write(payload.data(), eve::size(payload.size()));
+  }
+}
+
+void eve::detail::deserialize_class_as_binary(const serialization_info_base& info, binaryreader& reader, void* instance)
+{
+  eve::uint32 version;
+  eve::uint16 nfields;
+  reader >> version >> nfields;
+
+  // the plan of a known schema version maps stream positions to fields without any lookup, the
+  // first stream of a version builds it
+  auto cached = info.plan(version);
+  serialization_info_base::read_plan built;
+  for (eve::size i = 0; i < nfields; ++i)
+  {
+    eve::uint16 id;
+    eve::uint32 length;
+    reader >> id >> length;
+
+    const detail::field* field;
+    if (cached && i < cached->ids.size() && cached->ids[i] == id)
+      field = cached->fields[i];
+    else
+    {
+      field = info.field_by_id(id);
+      if (!cached)
+      {
+        built.ids.push_back(id);
+        built.fields.push_back(field);
+      }
+    }
+
+    if (!field)
+    {
+      reader.skip(length);
+      continue;
+    }
+
+    // a field whose type changed may not read all of its payload, never more
+    auto start = reader.position();
+    field->deserialize_as_binary(reader, instance);
+    auto consumed = reader.position() - start;
+    if (consumed > length)
+      throw std::runtime_error("Cannot deserialize class '" + info.name() + "', field " + std::to_string(id) + " read past its " + std::to_string(length) + " bytes.");
+    if (consumed < length)
+      reader.skip(eve::size(length - consumed));
+  }
+
+  if (!cached)
+    info.publish_plan(version, std::move(built));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Writes @p length characters at @p str as a quoted JSON string escaping them as needed. */
+static void write_json_string(const char* str, eve::size length, std::ostream& output)
+{
+  static const char k_hex[] = "0123456789abcdef";
+  output << '"';
+  const char* run = str;
+  const char* end = str + length;
+  for (const char* p = str; p < end; ++p)
+  {
+    unsigned char c = *p;
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    output.write(run, p - run);
+    run = p + 1;
+    switch (c)
+    {
+      case '"': output << "\\\""; break;
+      case '\\': output << "\\\\"; break;
+      case '\n': output << "\\n"; break;
+      case '\r': output << "\\r"; break;
+      case '\t': output << "\\t"; break;
+      default: output << "\\u00" << k_hex[c >> 4] << k_hex[c & 0xF];
+    }
+  }
+  output.write(run, end - run);
+  output << '"';
+}
+
+void eve::detail::serialize_class_as_json(const serialization_info_base& info, const void* instance, std::ostream& output, const std::string& tab)
+{
+  output << "{\n";
+  const std::string& newtab = tab + "  ";
+  eve::size i = 0;
+  for (auto& field : info.fields())
+  {
+    output << newtab;
+    write_json_string(field.name().data(), eve::size(field.name().size()), output);
+    output << ": ";
+    field.serialize_as_json(instance, output, newtab);
+    if (++i < info.num_fields())
+      output << ',';
+    output << '\n';
+  }
+  output << tab << '}';
+}
+
+void eve::detail::deserialize_class_as_json(const serialization_info_base& info, serialization::json_reader& reader, void* instance)
+{
+  reader.expect('{');
+  if (reader.accept('}'))
+    return;
+
+  do
+  {
+    auto key = reader.string();
+    auto field = info.field(key.begin(), eve::size(key.end() - key.begin()));
+    reader.expect(':');
+    if (field)
+      field->deserialize_as_json(reader, instance);
+    else
+      reader.skip(); // keys unknown to this class are ignored
+  } while (reader.accept(','));
+  reader.expect('}');
+}
+
 eve::serialization_error::serialization_error(const std::string& file, eve::size line, eve::size column, const std::string& message)
   : std::runtime_error("in file \"" + file + "\" at " + std::to_string(line) + ":" + std::to_string(column) + ": " + message)
   , m_file(file)
@@ -148,6 +373,18 @@ unsigned eve::detail::deserialize_enum_as_text(const char* name, const enum_valu
   throw std::runtime_error("Cannot serialize '"+ std::string(name) + "', " + parser.token() + " is not a valid value.");
 }
 
+unsigned eve::detail::deserialize_enum_as_json(const char* name, const enum_value* values, serialization::json_reader& reader)
+{
+  auto value = reader.string();
+  auto length = eve::size(value.end() - value.begin());
+  for (unsigned i = 0; values[i].str; ++i)
+  {
+    if (strlen(values[i].str) == length && memcmp(values[i].str, value.begin(), length) == 0)
+      return values[i].id;
+  }
+  throw std::runtime_error("Cannot deserialize '"+ std::string(name) + "', " + std::string(value.begin(), value.end()) + " is not a valid value.");
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 using namespace eve::serialization;
@@ -481,6 +718,708 @@ void parser::semanic_error(const std::string& diagnostic) const
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+enum json_char_class : eve::uint8
+{
+  json_space,
+  json_structural,
+  json_quote,
+  json_atom
+};
+
+/** Classifies every byte so that indexing needs a single lookup per character. */
+struct json_class_table
+{
+  eve::uint8 values[256];
+  json_class_table()
+  {
+    memset(values, json_atom, sizeof(values));
+    values[(unsigned char)' '] = values[(unsigned char)'\t'] = json_space;
+    values[(unsigned char)'\n'] = values[(unsigned char)'\r'] = json_space;
+    values[(unsigned char)'{'] = values[(unsigned char)'}'] = json_structural;
+    values[(unsigned char)'['] = values[(unsigned char)']'] = json_structural;
+    values[(unsigned char)':'] = values[(unsigned char)','] = json_structural;
+    values[(unsigned char)'"'] = json_quote;
+  }
+} s_json_classes;
+
+/** @returns the closing quote of the string whose content starts at @p begin or nullptr. */
+const char* find_string_end(const char* begin, const char* end)
+{
+  const char* p = begin;
+  while ((p = static_cast<const char*>(memchr(p, '"', end - p))) != nullptr)
+  {
+    // the quote is escaped only if preceded by an odd number of backslashes
+    const char* q = p;
+    while (q > begin && q[-1] == '\\')
+      --q;
+    if (((p - q) & 1) == 0)
+      return p;
+    ++p;
+  }
+  return nullptr;
+}
+
+/** Appends the code point @p cp to @p output encoded as UTF-8. */
+void append_utf8(eve::uint32 cp, std::string& output)
+{
+  if (cp < 0x80)
+    output += char(cp);
+  else if (cp < 0x800)
+  {
+    output += char(0xC0 | (cp >> 6));
+    output += char(0x80 | (cp & 0x3F));
+  }
+  else if (cp < 0x10000)
+  {
+    output += char(0xE0 | (cp >> 12));
+    output += char(0x80 | ((cp >> 6) & 0x3F));
+    output += char(0x80 | (cp & 0x3F));
+  }
+  else
+  {
+    output += char(0xF0 | (cp >> 18));
+    output += char(0x80 | ((cp >> 12) & 0x3F));
+    output += char(0x80 | ((cp >> 6) & 0x3F));
+    output += char(0x80 | (cp & 0x3F));
+  }
+}
+
+/** Indexes the tokens of the @p size bytes at @p data: the offset of each structural character,
+    opening quote and first character of other values.
+    @returns false if a string is not terminated. */
+typedef bool (*json_index_kernel)(const char* data, eve::size size, std::vector<eve::uint32>& index);
+
+bool json_index_scalar(const char* data, eve::size size, std::vector<eve::uint32>& index)
+{
+  const char* end = data + size;
+  bool inatom = false;
+  for (const char* p = data; p < end; ++p)
+  {
+    switch (s_json_classes.values[(unsigned char)*p])
+    {
+      case json_atom:
+        if (!inatom)
+          index.push_back(eve::uint32(p - data));
+        inatom = true;
+        continue;
+
+      case json_structural:
+        index.push_back(eve::uint32(p - data));
+        break;
+
+      case json_quote:
+      {
+        index.push_back(eve::uint32(p - data));
+        p = find_string_end(p + 1, end);
+        if (!p)
+          return false;
+        break;
+      }
+    }
+    inatom = false;
+  }
+  return true;
+}
+
+#ifdef EVE_X86
+
+/** Character classes of a 64 byte block, one bit per byte. */
+struct json_block
+{
+  eve::uint64 quote;
+  eve::uint64 backslash;
+  eve::uint64 structural;
+  eve::uint64 space;
+};
+
+/** What a block carries over to the next one. */
+struct json_scan_state
+{
+  eve::uint64 escaped;    // 1 if the first byte of the next block is escaped
+  eve::uint64 in_string;  // all ones if the next block starts inside a string
+  eve::uint64 in_atom;    // 1 if the next block starts inside a number or literal
+};
+
+inline eve::uint32 lowest_bit(eve::uint64 mask)
+{
+#ifdef _MSC_VER
+  unsigned long bit;
+#  if defined(_M_X64)
+  _BitScanForward64(&bit, mask);
+#  else
+  if (!_BitScanForward(&bit, eve::uint32(mask)))
+  {
+    _BitScanForward(&bit, eve::uint32(mask >> 32));
+    bit += 32;
+  }
+#  endif
+  return bit;
+#else
+  return eve::uint32(__builtin_ctzll(mask));
+#endif
+}
+
+/** Turns the classes of a block into tokens, as simdjson does: escaped characters are found with
+    carries over backslash runs, strings with a prefix xor of the unescaped quotes. */
+inline void json_index_block(const json_block& block, json_scan_state& state, eve::uint32 base, std::vector<eve::uint32>& index)
+{
+  const eve::uint64 even_bits = 0x5555555555555555ULL;
+  auto backslash = block.backslash & ~state.escaped;
+  auto follows_escape = (backslash << 1) | state.escaped;
+  auto odd_starts = backslash & ~even_bits & ~follows_escape;
+  auto even_sequences = odd_starts + backslash;
+  state.escaped = even_sequences < odd_starts ? 1 : 0;
+  auto escaped = (even_bits ^ (even_sequences << 1)) & follows_escape;
+
+  // set from each opening quote up to its closing quote excluded
+  auto quote = block.quote & ~escaped;
+  auto in_string = quote;
+  in_string ^= in_string << 1;
+  in_string ^= in_string << 2;
+  in_string ^= in_string << 4;
+  in_string ^= in_string << 8;
+  in_string ^= in_string << 16;
+  in_string ^= in_string << 32;
+  in_string ^= state.in_string;
+  state.in_string = (in_string >> 63) ? ~0ULL : 0;
+
+  auto atom = ~(block.structural | block.space | quote | in_string);
+  auto atom_starts = atom & ~((atom << 1) | state.in_atom);
+  state.in_atom = atom >> 63;
+
+  auto tokens = (block.structural & ~in_string) | (quote & in_string) | atom_starts;
+  while (tokens)
+  {
+    index.push_back(base + lowest_bit(tokens));
+    tokens &= tokens - 1;
+  }
+}
+
+/** Runs @p Classify over the 64 byte blocks of @p data, the last one padded with spaces. */
+template <void (*Classify)(const char*, json_block&)>
+bool json_index_blocks(const char* data, eve::size size, std::vector<eve::uint32>& index)
+{
+  json_scan_state state = { 0, 0, 0 };
+  json_block block;
+  eve::size i = 0;
+  for (; i + 64 <= size; i += 64)
+  {
+    Classify(data + i, block);
+    json_index_block(block, state, i, index);
+  }
+  if (i < size)
+  {
+    char tail[64];
+    memset(tail, ' ', sizeof(tail));
+    memcpy(tail, data + i, size - i);
+    Classify(tail, block);
+    json_index_block(block, state, i, index);
+  }
+  return state.in_string == 0;
+}
+
+eve_target("sse2")
+inline eve::uint64 json_mask_sse2(__m128i a, __m128i b, __m128i c, __m128i d, char ch)
+{
+  auto v = _mm_set1_epi8(ch);
+  return eve::uint64(eve::uint16(_mm_movemask_epi8(_mm_cmpeq_epi8(a, v))))
+    | (eve::uint64(eve::uint16(_mm_movemask_epi8(_mm_cmpeq_epi8(b, v)))) << 16)
+    | (eve::uint64(eve::uint16(_mm_movemask_epi8(_mm_cmpeq_epi8(c, v)))) << 32)
+    | (eve::uint64(eve::uint16(_mm_movemask_epi8(_mm_cmpeq_epi8(d, v)))) << 48);
+}
+
+eve_target("sse2")
+void json_classify_sse2(const char* p, json_block& block)
+{
+  auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+  auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+  auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48));
+
+  // '[' and ']' become '{' and '}' once the 0x20 bit is set
+  auto k20 = _mm_set1_epi8(0x20);
+  auto la = _mm_or_si128(a, k20), lb = _mm_or_si128(b, k20), lc = _mm_or_si128(c, k20), ld = _mm_or_si128(d, k20);
+
+  block.quote = json_mask_sse2(a, b, c, d, '"');
+  block.backslash = json_mask_sse2(a, b, c, d, '\\');
+  block.structural = json_mask_sse2(la, lb, lc, ld, '{') | json_mask_sse2(la, lb, lc, ld, '}')
+    | json_mask_sse2(a, b, c, d, ':') | json_mask_sse2(a, b, c, d, ',');
+  block.space = json_mask_sse2(a, b, c, d, ' ') | json_mask_sse2(a, b, c, d, '\t')
+    | json_mask_sse2(a, b, c, d, '\n') | json_mask_sse2(a, b, c, d, '\r');
+}
+
+eve_target("avx2")
+inline eve::uint64 json_mask_avx2(__m256i lo, __m256i hi, char ch)
+{
+  auto v = _mm256_set1_epi8(ch);
+  return eve::uint64(eve::uint32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v))))
+    | (eve::uint64(eve::uint32(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v)))) << 32);
+}
+
+eve_target("avx2")
+void json_classify_avx2(const char* p, json_block& block)
+{
+  auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+  auto k20 = _mm256_set1_epi8(0x20);
+  auto llo = _mm256_or_si256(lo, k20), lhi = _mm256_or_si256(hi, k20);
+
+  block.quote = json_mask_avx2(lo, hi, '"');
+  block.backslash = json_mask_avx2(lo, hi, '\\');
+  block.structural = json_mask_avx2(llo, lhi, '{') | json_mask_avx2(llo, lhi, '}')
+    | json_mask_avx2(lo, hi, ':') | json_mask_avx2(lo, hi, ',');
+  block.space = json_mask_avx2(lo, hi, ' ') | json_mask_avx2(lo, hi, '\t')
+    | json_mask_avx2(lo, hi, '\n') | json_mask_avx2(lo, hi, '\r');
+}
+
+#endif
+
+const eve::cpu::variant<json_index_kernel> k_json_index_kernels[] =
+{
+  { 0, json_index_scalar, "scalar" },
+#ifdef EVE_X86
+  { eve::cpu::sse2, json_index_blocks<json_classify_sse2>, "sse2" },
+  { eve::cpu::avx2, json_index_blocks<json_classify_avx2>, "avx2" },
+#endif
+};
+
+eve::cpu::dispatcher<json_index_kernel> s_json_index(k_json_index_kernels);
+
+} // anonymous
+
+eve::serialization::json_reader::json_reader(std::istream* source, const std::string& file)
+  : m_source(std::istreambuf_iterator<char>(*source), std::istreambuf_iterator<char>())
+  , m_file(file)
+  , m_cursor(0)
+{
+  index();
+}
+
+void eve::serialization::json_reader::index()
+{
+  m_index.reserve(m_source.size() / 4);
+  if (!s_json_index.kernel()(m_source.data(), eve::size(m_source.size()), m_index))
+  {
+    // the opening quote is the last token indexed
+    m_cursor = eve::size(m_index.size() - 1);
+    error("unterminated string.");
+  }
+}
+
+eve::size eve::serialization::json_reader::line() const
+{
+  auto offset = m_cursor < m_index.size() ? m_index[m_cursor] : m_source.size();
+  return eve::size(std::count(m_source.begin(), m_source.begin() + offset, '\n') + 1);
+}
+
+eve::size eve::serialization::json_reader::column() const
+{
+  auto offset = m_cursor < m_index.size() ? m_index[m_cursor] : m_source.size();
+  auto linestart = m_source.rfind('\n', offset ? offset - 1 : 0);
+  return eve::size(linestart == std::string::npos ? offset : offset - linestart - 1);
+}
+
+bool eve::serialization::json_reader::accept(char c)
+{
+  if (peek() != c)
+    return false;
+  ++m_cursor;
+  return true;
+}
+
+void eve::serialization::json_reader::expect(char c)
+{
+  if (!accept(c))
+    error(std::string("expected '") + c + "'.");
+}
+
+eve::serialization::json_reader::string_range eve::serialization::json_reader::string()
+{
+  if (peek() != '"')
+    error("expected a string.");
+
+  const char* begin = m_source.data() + m_index[m_cursor] + 1;
+  const char* end = find_string_end(begin, m_source.data() + m_source.size());
+  ++m_cursor;
+
+  const char* escape = static_cast<const char*>(memchr(begin, '\\', end - begin));
+  if (!escape)
+    return string_range(begin, end);
+
+  m_scratch.assign(begin, escape);
+  for (const char* p = escape; p < end; ++p)
+  {
+    if (*p != '\\')
+    {
+      m_scratch += *p;
+      continue;
+    }
+
+    switch (*++p)
+    {
+      case 'b': m_scratch += '\b'; break;
+      case 'f': m_scratch += '\f'; break;
+      case 'n': m_scratch += '\n'; break;
+      case 'r': m_scratch += '\r'; break;
+      case 't': m_scratch += '\t'; break;
+      case 'u':
+      {
+        auto cp = read_hex4(p + 1, end);
+        p += 4;
+
+        // characters beyond the BMP are escaped as a high then a low surrogate
+        if (cp >= 0xDC00 && cp <= 0xDFFF)
+          error("unpaired low surrogate in unicode escape sequence.");
+        if (cp >= 0xD800 && cp <= 0xDBFF)
+        {
+          auto low = end - p > 2 && p[1] == '\\' && p[2] == 'u' ? read_hex4(p + 3, end) : 0;
+          if (low < 0xDC00 || low > 0xDFFF)
+            error("unpaired high surrogate in unicode escape sequence.");
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          p += 6;
+        }
+        append_utf8(cp, m_scratch);
+        break;
+      }
+      default: m_scratch += *p; break;
+    }
+  }
+  return string_range(m_scratch.data(), m_scratch.data() + m_scratch.size());
+}
+
+eve::uint32 eve::serialization::json_reader::read_hex4(const char* p, const char* end) const
+{
+  if (end - p < 4)
+    error("invalid unicode escape sequence.");
+
+  eve::uint32 value = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    char c = p[i];
+    eve::uint32 digit = 0;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+    else
+      error("invalid unicode escape sequence.");
+    value = (value << 4) | digit;
+  }
+  return value;
+}
+
+double eve::serialization::json_reader::number()
+{
+  const char* begin = m_source.data() + (m_cursor < m_index.size() ? m_index[m_cursor] : 0);
+  char* end;
+  double value = peek() ? strtod(begin, &end) : 0;
+  if (!peek() || end == begin)
+    error("expected a number.");
+  ++m_cursor;
+  return value;
+}
+
+bool eve::serialization::json_reader::boolean()
+{
+  const char* token = m_source.data() + (m_cursor < m_index.size() ? m_index[m_cursor] : 0);
+  bool value = peek() == 't';
+  if (!peek() || strncmp(token, value ? "true" : "false", value ? 4 : 5) != 0)
+    error("expected a boolean.");
+  ++m_cursor;
+  return value;
+}
+
+bool eve::serialization::json_reader::accept_null()
+{
+  if (peek() != 'n' || strncmp(m_source.data() + m_index[m_cursor], "null", 4) != 0)
+    return false;
+  ++m_cursor;
+  return true;
+}
+
+void eve::serialization::json_reader::skip()
+{
+  char c = peek();
+  if (c == 0)
+    error("expected a value.");
+
+  if (c != '{' && c != '[')
+  {
+    ++m_cursor;
+    return;
+  }
+
+  // strings are single entries of the index, so brackets can be matched by counting
+  eve::size depth = 0;
+  do
+  {
+    c = peek();
+    if (c == '{' && is_token(m_cursor + 1, "\"$id\"") && is_token(m_cursor + 5, "\"$value\""))
+    {
+      // {"$id": id, "$value": value}
+      auto id = eve::uint32(strtoul(m_source.data() + m_index[m_cursor + 3], nullptr, 10));
+      m_skipped_shared.insert(std::make_pair(id, m_cursor + 7));
+    }
+    if (c == '{' || c == '[')
+      ++depth;
+    else if (c == '}' || c == ']')
+      --depth;
+    else if (c == 0)
+      error("unexpected end of source.");
+    ++m_cursor;
+  } while (depth > 0);
+}
+
+eve::size eve::serialization::json_reader::skipped_shared(eve::uint32 id) const
+{
+  auto it = m_skipped_shared.find(id);
+  return it == m_skipped_shared.end() ? 0 : it->second;
+}
+
+bool eve::serialization::json_reader::is_token(eve::size position, const char* text) const
+{
+  return position < m_index.size() && strncmp(m_source.data() + m_index[position], text, strlen(text)) == 0;
+}
+
+void eve::serialization::json_reader::error(const std::string& diagnostic) const
+{
+  throw eve::serialization_error(m_file, line(), column(), diagnostic);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static eve_thread_local eve::serialization::identity_table* s_identity_table = nullptr;
+
+// the most read at once of the payload of a shared instance
+static const eve::size k_shared_chunk = 64 * 1024;
+
+eve::serialization::identity_table& eve::serialization::identity_table::current()
+{
+  eve_assert(s_identity_table);
+  return *s_identity_table;
+}
+
+eve::uint32 eve::serialization::identity_table::find(const void* ptr, const std::type_info& type) const
+{
+  auto it = m_written.find(written_key(ptr, std::type_index(type)));
+  return it == m_written.end() ? 0 : it->second;
+}
+
+eve::uint32 eve::serialization::identity_table::insert(const void* ptr, const std::type_info& type)
+{
+  auto id = eve::uint32(m_written.size() + 1);
+  m_written[written_key(ptr, std::type_index(type))] = id;
+  return id;
+}
+
+std::shared_ptr<void> eve::serialization::identity_table::get(eve::uint32 id) const
+{
+  auto it = m_read.find(id);
+  return it == m_read.end() ? std::shared_ptr<void>() : it->second.instance;
+}
+
+const std::type_info* eve::serialization::identity_table::type(eve::uint32 id) const
+{
+  auto it = m_read.find(id);
+  return it == m_read.end() ? nullptr : it->second.type;
+}
+
+bool eve::serialization::identity_table::insert(eve::uint32 id, const std::type_info& type, std::shared_ptr<void> instance)
+{
+  read_entry entry = { std::move(instance), &type };
+  return id != 0 && m_read.insert(std::make_pair(id, std::move(entry))).second;
+}
+
+void eve::serialization::identity_table::defer(eve::uint32 id, std::function<void(binarywriter&)> write)
+{
+  m_writes.push_back(std::make_pair(id, std::move(write)));
+}
+
+void eve::serialization::identity_table::defer(eve::uint32 id, std::function<void(binaryreader&)> read)
+{
+  m_reads[id] = std::move(read);
+}
+
+void eve::serialization::identity_table::write_shared(binarywriter& writer)
+{
+  // instances met while writing others are deferred in turn, hence the index
+  std::stringbuf scratch;
+  binarywriter body(&scratch);
+  for (eve::size i = 0; i < m_writes.size(); ++i)
+  {
+    auto id = m_writes[i].first;
+    auto write = std::move(m_writes[i].second);
+    scratch.str(std::string());
+    write(body);
+    const std::string& payload = scratch.str();
+    writer << id << eve::uint32(payload.size());
+    writer.write(payload.data(), eve::size(payload.size()));
+  }
+  writer << eve::uint32(0);
+  m_writes.clear();
+}
+
+void eve::serialization::identity_table::read_shared(binaryreader& reader)
+{
+  // an instance may refer to one written before it that nothing else referred to, so payloads
+  // are kept until every deferred instance is read
+  std::unordered_map<eve::uint32, std::string> payloads;
+  for (;;)
+  {
+    eve::uint32 id, length;
+    reader >> id;
+    if (id == 0)
+      break;
+    reader >> length;
+
+    // read in chunks, a corrupt length then fails on the end of the stream rather than allocating
+    auto& payload = payloads[id];
+    while (payload.size() < length)
+    {
+      auto offset = payload.size();
+      payload.resize(offset + std::min<eve::size>(length - eve::size(offset), k_shared_chunk));
+      reader.read(&payload[offset], eve::size(payload.size() - offset));
+    }
+  }
+
+  while (!m_reads.empty())
+  {
+    auto it = m_reads.begin();
+    auto id = it->first;
+    auto read = std::move(it->second);
+    m_reads.erase(it);
+
+    auto payload = payloads.find(id);
+    if (payload == payloads.end())
+      throw std::runtime_error("Unresolved reference to shared instance " + std::to_string(id) + ".");
+    std::stringbuf buffer(payload->second, std::ios::in);
+    binaryreader body(&buffer);
+    read(body);
+  }
+}
+
+eve::serialization::identity_scope::identity_scope()
+  : m_table(eve_new identity_table)
+  , m_previous(s_identity_table)
+{
+  s_identity_table = m_table;
+}
+
+eve::serialization::identity_scope::~identity_scope()
+{
+  s_identity_table = m_previous;
+  eve::destroy(m_table);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const char k_base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/** Maps each character to its 6 bit value, or to 0xFF when the character is not in the alphabet. */
+static struct base64_table
+{
+  eve::uint8 values[256];
+  base64_table()
+  {
+    memset(values, 0xFF, sizeof(values));
+    for (eve::uint8 i = 0; i < 64; ++i)
+      values[(unsigned char)k_base64_chars[i]] = i;
+  }
+} s_base64_table;
+
+void eve::serialization::encode_base64(const void* data, eve::size size, std::ostream& output)
+{
+  auto bytes = static_cast<const unsigned char*>(data);
+  char quad[4];
+  eve::size i = 0;
+  for (; i + 3 <= size; i += 3)
+  {
+    eve::uint32 group = (bytes[i] << 16) | (bytes[i + 1] << 8) | bytes[i + 2];
+    quad[0] = k_base64_chars[group >> 18];
+    quad[1] = k_base64_chars[(group >> 12) & 0x3F];
+    quad[2] = k_base64_chars[(group >> 6) & 0x3F];
+    quad[3] = k_base64_chars[group & 0x3F];
+    output.write(quad, 4);
+  }
+
+  if (i < size)
+  {
+    eve::uint32 group = bytes[i] << 16;
+    if (i + 1 < size)
+      group |= bytes[i + 1] << 8;
+    quad[0] = k_base64_chars[group >> 18];
+    quad[1] = k_base64_chars[(group >> 12) & 0x3F];
+    quad[2] = i + 1 < size ? k_base64_chars[(group >> 6) & 0x3F] : '=';
+    quad[3] = '=';
+    output.write(quad, 4);
+  }
+}
+
+eve::size eve::serialization::decoded_size(const std::string& input)
+{
+  if (input.size() < 4)
+    return 0;
+  auto padding = (input[input.size() - 1] == '=') + (input[input.size() - 2] == '=');
+  return eve::size(input.size() / 4 * 3 - padding);
+}
+
+bool eve::serialization::decode_base64(const std::string& input, void* data)
+{
+  if (input.size() % 4)
+    return false;
+
+  auto out = static_cast<unsigned char*>(data);
+  auto in = reinterpret_cast<const unsigned char*>(input.data());
+  auto& table = s_base64_table.values;
+  eve::size nquads = eve::size(input.size() / 4);
+
+  // only text sources go through base64, cooked binary copies packed arrays as they are, so this
+  // stays a portable scalar loop rather than another eve::cpu kernel.
+  // full quads are decoded without branches, invalid characters are detected by or-ing all
+  // looked up values together and checking the 0x80 bit once at the end.
+  eve::uint8 invalid = 0;
+  eve::size nfull = nquads - (input[input.size() - 1] == '=' ? 1 : 0);
+  for (eve::size q = 0; q < nfull; ++q, in += 4, out += 3)
+  {
+    eve::uint8 a = table[in[0]], b = table[in[1]], c = table[in[2]], d = table[in[3]];
+    invalid |= a | b | c | d;
+    eve::uint32 group = (a << 18) | (b << 12) | (c << 6) | d;
+    out[0] = eve::uint8(group >> 16);
+    out[1] = eve::uint8(group >> 8);
+    out[2] = eve::uint8(group);
+  }
+
+  if (nfull < nquads)
+  {
+    eve::uint8 a = table[in[0]], b = table[in[1]];
+    invalid |= a | b;
+    out[0] = eve::uint8((a << 2) | (b >> 4));
+    if (in[2] != '=')
+    {
+      eve::uint8 c = table[in[2]];
+      invalid |= c;
+      out[1] = eve::uint8((b << 4) | (c >> 2));
+    }
+  }
+
+  return (invalid & 0x80) == 0;
+}
+
+void eve::serialization::swap_little_endian(void* data, eve::size count, eve::size width)
+{
+#ifdef EVE_BIG_ENDIAN
+  eve::byteswap(data, count, width);
+#else
+  (void)data; (void)count; (void)width;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void eve::text_serializer<std::string>::serialize(const std::string& instance, std::ostream& output, const std::string& tab)
 {
   output << '\"' << instance << '\"';
@@ -492,3 +1431,24 @@ void eve::text_serializer<std::string>::deserialize(eve::serialization::parser&
   instance = parser.token();
   parser.scan();
 }
+
+void eve::binary_serializer<std::string>::serialize(const std::string& instance, binarywriter& writer)
+{
+  writer << instance;
+}
+
+void eve::binary_serializer<std::string>::deserialize(binaryreader& reader, std::string& instance)
+{
+  reader >> instance;
+}
+
+void eve::json_serializer<std::string>::serialize(const std::string& instance, std::ostream& output, const std::string& /*tab*/)
+{
+  write_json_string(instance.data(), eve::size(instance.size()), output);
+}
+
+void eve::json_serializer<std::string>::deserialize(eve::serialization::json_reader& reader, std::string& instance)
+{
+  auto value = reader.string();
+  instance.assign(value.begin(), value.end());
+}
@@ -88,7 +88,10 @@ shader::stage::~stage()
 void shader::stage::load(std::istream& source)
 {
   text::load(source);
-  
+}
+
+void shader::stage::finalize()
+{
   if (m_id == 0)
     m_id = glCreateShader(gl_shader_type[(int)m_type]);
 
@@ -105,7 +108,7 @@ void shader::stage::unload()
 void shader::stage::on_reload()
 {
   text::on_reload();
-  compile();
+  finalize();
 }
 
 void shader::stage::compile()
@@ -188,7 +191,10 @@ void shader::load(std::istream& source)
 
   if (!m_fragment)
     throw std::runtime_error("No fragment shader specified.");
+}
 
+void shader::finalize()
+{
   if (m_id)
     return;
   m_id = glCreateProgram();
@@ -205,6 +211,8 @@ void shader::load(std::istream& source)
 
 void shader::unload()
 {
+  if (m_id == 0)
+    return;
   glDeleteProgram(m_id);
   m_id = 0;
 }
@@ -0,0 +1,67 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include "eve/span.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace eve;
+
+span_reader::span_reader(const void* data, eve::size size)
+  : m_begin(reinterpret_cast<const char*>(data))
+  , m_cursor(m_begin)
+  , m_end(m_begin + size)
+{
+}
+
+span_reader& span_reader::operator>>(std::string& rhs)
+{
+  uint16 size;
+  *this >> size;
+  check(size);
+  rhs.assign(m_cursor, size);
+  m_cursor += size;
+  return *this;
+}
+
+void span_reader::read(void* data, eve::size size)
+{
+  check(size);
+  std::memcpy(data, m_cursor, size);
+  m_cursor += size;
+}
+
+void span_reader::skip(eve::size size)
+{
+  check(size);
+  m_cursor += size;
+}
+
+void span_reader::overflow() const
+{
+  throw std::runtime_error("span_reader: unexpected end of data.");
+}
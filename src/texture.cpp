@@ -182,7 +182,10 @@ struct texture_info
 void texture::load(std::istream& source)
 {
   texture_info info;
-  eve::deserialize_as_text(source, info);
+  if (resource::read_cooked_header(source))
+    eve::deserialize_as_binary(source, info);
+  else
+    eve::deserialize_as_text(source, info);
   
   switch (info.type)
   {
@@ -193,7 +196,12 @@ void texture::load(std::istream& source)
       eve::path::pop(path);
       eve::path::push(path, info.pixelbuffer);
       m_pixelbuffer.load(path);
-      create(info.type, *m_pixelbuffer, info.filtermode, info.wrapmode, info.mipmapped);
+
+      // created by finalize(), on the main thread
+      m_type = info.type;
+      m_filtermode = info.filtermode;
+      m_wrapmode = info.wrapmode;
+      m_mipmapped = info.mipmapped;
       break;
     }
 
@@ -219,17 +227,32 @@ void texture::load(std::istream& source)
   }
 }
 
+void texture::finalize()
+{
+  create(m_type, *m_pixelbuffer, m_filtermode, m_wrapmode, m_mipmapped);
+}
+
 void texture::unload()
 {
   destroy();
 }
 
+bool texture::cook(std::istream& source, std::ostream& output)
+{
+  texture_info info;
+  eve::deserialize_as_text(source, info);
+  resource::write_cooked_header(output);
+  eve::serialize_as_binary(info, output);
+  return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void texture::on_reload()
 {
   eve::resource::source source(this->path());
   load(*source);
+  finalize();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -264,6 +287,8 @@ void texture::bind(unsigned unit) const
 
 void texture::destroy()
 {
+  if (!created())
+    return;
   glDeleteTextures(1, &m_id);
   m_id = 0;
 }
@@ -27,13 +27,17 @@
 
 #include <gtest/gtest.h>
 #include <eve/application.h>
+#include <eve/cooker.h>
 #include <eve/resource.h>
+#include <eve/serialization/shared_ptr.h>
 #include <eve/window.h>
 #include <eve/hwbuffer.h>
 #include <eve/vertexarray.h>
 #include <eve/time.h>
 #include <eve/texture.h>
 #include <eve/shader.h>
+#include <chrono>
+#include <thread>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -42,11 +46,14 @@ struct dummy_res : public eve::deserializable_resource<dummy_res>
 {
 public:
   dummy_res(int param)
-    : param(param) {}
+    : param(param), finalized(false) {}
   
   int param;
+  bool finalized;
   std::string name;
 
+  void finalize() override { finalized = true; }
+
   eve_serializable(dummy_res, name);
 };
 
@@ -54,16 +61,44 @@ struct dummy_host : public eve::deserializable_resource<dummy_host>
 {
 public:
   dummy_host()
-    : dummy((eve::resource_host*)this, 3)
+    : dummy((eve::resource_host*)this, 3), dependency_finalized(false)
   {
   }
 
   int value;
   eve::resource::ptr<dummy_res, int> dummy;
+  bool dependency_finalized;
+
+  void finalize() override { dependency_finalized = dummy && dummy->finalized; }
 
   eve_serializable(dummy_host, value, dummy);
 };
 
+struct dummy_shared : public eve::deserializable_resource<dummy_shared>
+{
+public:
+  std::shared_ptr<int> first;
+  std::shared_ptr<int> second;
+
+  eve_serializable(dummy_shared, first, second);
+};
+
+struct dummy_shared_host : public eve::deserializable_resource<dummy_shared_host>
+{
+public:
+  dummy_shared_host()
+    : dependency((eve::resource_host*)this)
+  {
+  }
+
+  std::shared_ptr<int> own;
+  std::shared_ptr<int> again;
+  eve::resource::ptr<dummy_shared> dependency;
+  std::shared_ptr<int> last;
+
+  eve_serializable(dummy_shared_host, own, again, dependency, last);
+};
+
 TEST(Application, application)
 {
   eve::application app(eve::application::module::memory_debugger);
@@ -79,6 +114,128 @@ TEST(Application, application)
   EXPECT_EQ("Foo", host->dummy->name);
 }
 
+TEST(Application, nested_shared)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  // the dependency is read while its host is, both number their shared instances from 1
+  eve::resource::ptr<dummy_shared_host> host;
+  host.load("data/dummy_shared_host.txt");
+  ASSERT_TRUE(host->valid());
+  ASSERT_TRUE(host->dependency->valid());
+  EXPECT_EQ(7, *host->own);
+  EXPECT_EQ(host->own, host->again);
+  EXPECT_EQ(host->own, host->last);
+  EXPECT_EQ(5, *host->dependency->first);
+  EXPECT_EQ(host->dependency->first, host->dependency->second);
+}
+
+TEST(Application, cooker)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  eve::cooker cooker("cooked");
+  cooker.add<dummy_host>("dummy_host.txt");
+  cooker.cook("data");
+  EXPECT_EQ(0u, cooker.failed());
+  EXPECT_EQ(0u, cooker.uncooked());
+  EXPECT_EQ(1u, cooker.cooked() + cooker.skipped());
+
+  // cooking again only checks the content hash
+  eve::cooker again("cooked");
+  again.add<dummy_host>("dummy_host.txt");
+  again.cook("data");
+  EXPECT_EQ(0u, again.cooked());
+  EXPECT_EQ(1u, again.skipped());
+
+  auto manifest = eve::cooker::read_manifest("cooked");
+  ASSERT_EQ(1u, manifest.entries.size());
+  EXPECT_EQ("data/dummy_host.txt", manifest.entries[0].source);
+  EXPECT_EQ(eve::cooker::hash_file("data/dummy_host.txt"), manifest.entries[0].hash);
+  eve::uint64 size;
+  eve::int64 modified;
+  ASSERT_TRUE(eve::cooker::stat_file("data/dummy_host.txt", size, modified));
+  EXPECT_EQ(size, manifest.entries[0].size);
+  EXPECT_EQ(modified, manifest.entries[0].modified);
+  EXPECT_FALSE(eve::resource::cooking());
+
+  eve::resource::use_cache("cooked");
+
+  eve::resource::ptr<dummy_host> host;
+  host.load("data/dummy_host.txt");
+  EXPECT_EQ(42, host->value);
+  EXPECT_EQ("Foo", host->dummy->name);
+}
+
+TEST(Application, async_loading)
+{
+  eve::application app(eve::application::module::memory_debugger);
+  eve::resource::loader_threads(2);
+
+  // loaded off-thread, finalized by the main thread after its dependency
+  int called = 0;
+  eve::resource::ptr<dummy_host> host;
+  host.load_async("data/dummy_host.txt", [&] (const dummy_host& h) { EXPECT_EQ(&h, host.get()); ++called; });
+  ASSERT_TRUE(bool(host));
+  for (int i = 0; i < 1000 && !host.ready(); ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    eve::resource::finalize_pending(0.001);
+  }
+  ASSERT_TRUE(host.ready());
+  EXPECT_TRUE(host->valid());
+  EXPECT_EQ(42, host->value);
+  EXPECT_EQ("Foo", host->dummy->name);
+  EXPECT_TRUE(host->dependency_finalized);
+  EXPECT_EQ(1, called);
+  EXPECT_EQ(0u, eve::resource::pending());
+
+  // once ready, callbacks are called at once
+  host.on_ready([&] (const dummy_host&) { ++called; });
+  EXPECT_EQ(2, called);
+
+  // nor ever without a resource
+  eve::resource::ptr<dummy_host> empty;
+  empty.on_ready([&] (const dummy_host&) { ++called; });
+  EXPECT_EQ(2, called);
+
+  // a synchronous load of a resource being loaded waits for it
+  host.reset();
+  host.load_async("data/dummy_host.txt");
+  eve::resource::ptr<dummy_res, int> res(3);
+  res.load("data/dummy_res.txt");
+  EXPECT_TRUE(res.ready());
+  EXPECT_TRUE(res->finalized);
+  host.wait();
+  EXPECT_TRUE(host.ready());
+  EXPECT_EQ(res.get(), host->dummy.get());
+  EXPECT_TRUE(host->dependency_finalized);
+
+  // failures are ready but not valid
+  eve::resource::ptr<dummy_res, int> missing(3);
+  missing.load_async("data/missing.txt");
+  missing.wait();
+  EXPECT_TRUE(missing.ready());
+  EXPECT_FALSE(missing->valid());
+  EXPECT_FALSE(missing->finalized);
+}
+
+TEST(Application, cancelled)
+{
+  int called = 0;
+  bool valid = true;
+  {
+    eve::application app(eve::application::module::memory_debugger);
+
+    // loads never finalized are cancelled and released when the application terminates
+    eve::resource::ptr<dummy_host> abandoned;
+    abandoned.load_async("data/dummy_host.txt", [&] (const dummy_host& h) { ++called; valid = h.valid(); });
+    abandoned.reset();
+  }
+  EXPECT_EQ(1, called);
+  EXPECT_FALSE(valid);
+}
+
 TEST(Application, window)
 {
   eve::application app(eve::application::module::graphics | eve::application::module::memory_debugger);
@@ -32,10 +32,16 @@
 #include <eve/application.h>
 #include <eve/path.h>
 #include <eve/binary.h>
+#include <eve/bitstream.h>
+#include <eve/span.h>
 #include <eve/callstack.h>
+#include <eve/hash.h>
 #include <eve/log.h>
+#include <eve/math.h>
+#include <eve/time.h>
 #include <sstream>
 #include <fstream>
+#include <vector>
 
 struct Foo
 {
@@ -163,6 +169,280 @@ TEST(Lib, binary)
   EXPECT_EQ("hello", str);
 }
 
+TEST(Lib, binary_array)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  std::vector<float> floats;
+  std::vector<eve::vec3> points;
+  for (int i = 0; i < 100; ++i)
+  {
+    floats.push_back(i * 0.5f);
+    points.push_back(eve::vec3(float(i), i * 2.f, i * -3.f));
+  }
+
+  std::stringstream arrays, values;
+  {
+    eve::binarywriter bw(arrays.rdbuf());
+    bw.write_array(floats.data(), eve::size(floats.size()));
+    bw.write_array(points.data(), eve::size(points.size()));
+  }
+  {
+    eve::binarywriter bw(values.rdbuf());
+    for (auto f : floats)
+      bw << f;
+    for (auto& p : points)
+      bw << p.x << p.y << p.z;
+  }
+  EXPECT_EQ(values.str(), arrays.str());
+
+  std::vector<float> floats2(floats.size());
+  std::vector<eve::vec3> points2(points.size());
+  eve::binaryreader br(arrays.rdbuf());
+  br.read_array(floats2.data(), eve::size(floats2.size()));
+  br.read_array(points2.data(), eve::size(points2.size()));
+  EXPECT_EQ(floats, floats2);
+  EXPECT_EQ(0, memcmp(points.data(), points2.data(), points.size() * sizeof(eve::vec3)));
+
+  // every kernel big endian targets may pick and every width, with counts that exercise the
+  // vector loops and their tails
+  const eve::uint32 k_masks[] = { 0, eve::cpu::sse2 | eve::cpu::ssse3, ~0u };
+  for (auto mask : k_masks)
+  {
+    eve::cpu::limit(mask);
+    for (eve::size width = 2; width <= 8; width *= 2)
+    {
+      for (eve::size count = 0; count < 40; ++count)
+      {
+        std::vector<char> data(count * width), expected;
+        for (eve::size i = 0; i < data.size(); ++i)
+          data[i] = char(i * 7 + 1);
+        expected = data;
+        for (eve::size i = 0; i < count; ++i)
+          std::reverse(expected.begin() + i * width, expected.begin() + (i + 1) * width);
+
+        eve::byteswap(data.data(), count, width);
+        EXPECT_EQ(expected, data) << "mask " << mask << ", width " << width << ", count " << count;
+      }
+    }
+  }
+  eve::cpu::limit(~0u);
+}
+
+static int generic_kernel() { return 0; }
+static int sse2_kernel() { return 1; }
+static int avx2_kernel() { return 2; }
+
+TEST(Lib, cpu)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  typedef int (*kernel_fn)();
+  static const eve::cpu::variant<kernel_fn> k_variants[] =
+  {
+    { 0, generic_kernel, "generic" },
+    { eve::cpu::sse2, sse2_kernel, "sse2" },
+    { eve::cpu::avx2, avx2_kernel, "avx2" },
+  };
+  eve::cpu::dispatcher<kernel_fn> dispatcher(k_variants);
+
+  auto detected = eve::cpu::features();
+  std::cout << "cpu features: " << std::hex << detected << std::dec << '\n';
+
+  // force each variant the CPU supports, the library kernels must agree with each other
+  const eve::uint32 k_masks[] = { 0, eve::cpu::sse2, eve::cpu::sse2 | eve::cpu::ssse3 | eve::cpu::sse42, ~0u };
+  for (auto mask : k_masks)
+  {
+    eve::cpu::limit(mask);
+    EXPECT_EQ(detected & mask, eve::cpu::features());
+
+    eve::size expected = 0;
+    for (eve::size i = 1; i < 3; ++i)
+      if ((detected & mask & k_variants[i].features) == k_variants[i].features)
+        expected = i;
+    EXPECT_STREQ(k_variants[expected].name, dispatcher.name());
+    EXPECT_EQ(int(expected), dispatcher.kernel()());
+
+    EXPECT_EQ(0xE3069283u, eve::hash::crc32c("123456789", 9));
+
+    eve::uint32 words[9] = { 0x01020304, 0x05060708, 0x090A0B0C, 0x0D0E0F10, 0x11121314, 0x15161718, 0x191A1B1C, 0x1D1E1F20, 0x21222324 };
+    eve::byteswap(words, 9, 4);
+    EXPECT_EQ(0x04030201u, words[0]);
+    EXPECT_EQ(0x24232221u, words[8]);
+  }
+  eve::cpu::limit(~0u);
+}
+
+TEST(Lib, hash)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  EXPECT_EQ(0xE3069283u, eve::hash::crc32c("123456789", 9));
+  EXPECT_EQ(0u, eve::hash::crc32c("", 0));
+  EXPECT_EQ(0xEF46DB3751D8E999ull, eve::hash::xxh64("", 0));
+  EXPECT_EQ(0x44BC2CF5AD770999ull, eve::hash::xxh64(std::string("abc")));
+
+  unsigned char bytes[100];
+  for (int i = 0; i < 100; ++i)
+    bytes[i] = (unsigned char)i;
+  EXPECT_EQ(0x6AC1E58032166597ull, eve::hash::xxh64(bytes, 100));
+  EXPECT_EQ(0x80653E7E9B887CDDull, eve::hash::xxh64(bytes, 100, 7));
+
+  // streaming in uneven pieces gives the one-shot results
+  eve::hash::crc32c_state crc;
+  eve::hash::xxh64_state xxh(7);
+  for (eve::size offset = 0, piece = 1; offset < 100; offset += piece, piece = piece * 2 + 1)
+  {
+    auto size = std::min<eve::size>(piece, 100 - offset);
+    crc.update(bytes + offset, size);
+    xxh.update(bytes + offset, size);
+  }
+  EXPECT_EQ(eve::hash::crc32c(bytes, 100), crc.digest());
+  EXPECT_EQ(0x80653E7E9B887CDDull, xxh.digest());
+
+  // checksummed binary sections
+  std::stringstream ss;
+  {
+    eve::binarywriter bw(ss.rdbuf());
+    bw.begin_checksum();
+    bw << 3.14f << "hello";
+    bw.end_checksum();
+  }
+  std::string data = ss.str();
+
+  std::stringstream good(data);
+  eve::binaryreader br(good.rdbuf());
+  float f;
+  std::string str;
+  br.begin_checksum();
+  br >> f >> str;
+  EXPECT_TRUE(br.end_checksum());
+
+  data[2] ^= 0x10;
+  std::stringstream bad(data);
+  eve::binaryreader corrupted(bad.rdbuf());
+  corrupted.begin_checksum();
+  corrupted >> f >> str;
+  EXPECT_FALSE(corrupted.end_checksum());
+}
+
+TEST(Lib, span)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  std::stringstream ss;
+  {
+    eve::binarywriter bw(ss.rdbuf());
+    bw << 3.14f << "hello" << eve::uint64(42) << true;
+  }
+
+  std::vector<char> sink;
+  {
+    eve::span_writer<std::vector<char>> sw(sink);
+    sw.reserve(4 + 2 + 5 + 8 + 1);
+    sw << 3.14f << "hello" << eve::uint64(42) << true;
+  }
+  EXPECT_EQ(ss.str(), std::string(sink.begin(), sink.end()));
+
+  eve::span_reader sr(sink);
+  float f;
+  std::string str;
+  eve::uint64 u;
+  bool b;
+  sr >> f >> str >> u >> b;
+
+  EXPECT_FLOAT_EQ(3.14f, f);
+  EXPECT_EQ("hello", str);
+  EXPECT_EQ(42u, u);
+  EXPECT_TRUE(b);
+  EXPECT_EQ(0u, sr.remaining());
+  EXPECT_THROW(sr >> f, std::runtime_error);
+}
+
+TEST(Lib, bitstream)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  std::stringstream ss;
+  {
+    eve::bitwriter bw(ss.rdbuf());
+    bw << true << eve::bits(5u, 3) << eve::bits(-3, 4) << eve::uint32(300) << eve::int32(-2)
+      << eve::uint64(1ULL << 60) << 3.14f << "hello" << eve::quantized(1.234f, -10.f, 10.f, 0.01f)
+      << eve::bits(0x123456789ABCull, 48);
+    EXPECT_EQ(1 + 3 + 4 + 16 + 8 + 72 + 32 + 48 + 11 + 48, bw.position());
+  }
+
+  EXPECT_EQ(1u, eve::zigzag_encode(-1));
+  EXPECT_EQ(-2, eve::zigzag_decode(eve::zigzag_encode(-2)));
+
+  eve::bitreader br(ss.rdbuf());
+  bool b;
+  unsigned three;
+  int four;
+  eve::uint32 u;
+  eve::int32 i;
+  eve::uint64 big;
+  float f, q;
+  std::string str;
+  eve::uint64 wide;
+  br >> b >> eve::bits(three, 3) >> eve::bits(four, 4) >> u >> i >> big >> f >> str
+    >> eve::quantized(q, -10.f, 10.f, 0.01f) >> eve::bits(wide, 48);
+
+  EXPECT_TRUE(b);
+  EXPECT_EQ(5u, three);
+  EXPECT_EQ(-3, four);
+  EXPECT_EQ(300u, u);
+  EXPECT_EQ(-2, i);
+  EXPECT_EQ(1ULL << 60, big);
+  EXPECT_FLOAT_EQ(3.14f, f);
+  EXPECT_EQ("hello", str);
+  EXPECT_NEAR(1.234f, q, 0.005f);
+  EXPECT_EQ(0x123456789ABCull, wide);
+  EXPECT_THROW(br.read_bits(8), std::runtime_error);
+}
+
+TEST(Lib, bitstream_benchmark)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  // a typical entity update: small id, position, flags and health
+  const int k_updates = 100000;
+  std::stringstream bytes, bits;
+
+  eve::stopwatch stopwatch;
+  {
+    eve::binarywriter bw(bytes.rdbuf());
+    for (int n = 0; n < k_updates; ++n)
+      bw << eve::uint32(n % 1000) << n * 0.01f << -n * 0.02f << (n % 3 == 0) << eve::int16(100 - n % 100);
+  }
+  auto bytetime = stopwatch.reset();
+  {
+    eve::bitwriter bw(bits.rdbuf());
+    for (int n = 0; n < k_updates; ++n)
+      bw << eve::uint32(n % 1000) << eve::quantized(n * 0.01f, -2048.f, 2048.f, 0.01f)
+        << eve::quantized(-n * 0.02f, -2048.f, 2048.f, 0.01f) << (n % 3 == 0) << eve::int16(100 - n % 100);
+  }
+  auto bittime = stopwatch.reset();
+
+  eve::bitreader br(bits.rdbuf());
+  for (int n = 0; n < k_updates; ++n)
+  {
+    eve::uint32 id;
+    float x, y;
+    bool flag;
+    eve::int16 health;
+    br >> id >> eve::quantized(x, -2048.f, 2048.f, 0.01f) >> eve::quantized(y, -2048.f, 2048.f, 0.01f) >> flag >> health;
+    if (id != eve::uint32(n % 1000) || flag != (n % 3 == 0) || health != 100 - n % 100)
+      FAIL() << "mismatch at update " << n;
+  }
+  auto readtime = stopwatch.reset();
+
+  EXPECT_LT(bits.str().size(), bytes.str().size());
+  std::cout << "binarywriter: " << bytes.str().size() << " bytes in " << bytetime * 1000 << " ms\n";
+  std::cout << "bitwriter:    " << bits.str().size() << " bytes in " << bittime * 1000 << " ms\n";
+  std::cout << "bitreader:    " << readtime * 1000 << " ms\n";
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 eve::callstack* foo()
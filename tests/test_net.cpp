@@ -29,7 +29,31 @@
 #include <eve/application.h>
 #include <eve/net/socket.h>
 #include <eve/net/buffer.h>
+#include <eve/net/poller.h>
+#include <eve/net/datagram.h>
+#include <eve/net/channel.h>
+#include <eve/net/codec.h>
+#include <eve/net/server.h>
+#include <eve/net/resolver.h>
+#include <eve/net/shm.h>
+#include <eve/net/sim.h>
+#include <eve/net/deflate.h>
+#include <eve/net/scheduler.h>
+#include <eve/net/replicator.h>
+#include <eve/net/clock.h>
+#include <eve/time.h>
 #include <eve/binary.h>
+#include <eve/span.h>
+#include <deque>
+#include <random>
+#include <set>
+#include <thread>
+
+#ifdef EVE_LINUX
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 TEST(Net, SocketAndBuffer)
 {
@@ -60,3 +84,1580 @@ TEST(Net, SocketAndBuffer)
 
   EXPECT_EQ("hello foo", data);
 }
+
+TEST(Net, BufferGather)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  eve::socket server(eve::socket::type::stream);
+  server.listen(10002, 4);
+
+  eve::socket client(eve::socket::type::stream);
+  client.connect(eve::socket::address("localhost", 10002));
+  auto peer = server.accept();
+
+  std::vector<char> payload(1 << 20), tail(4096, 'x');
+  for (eve::size i = 0; i < payload.size(); ++i)
+    payload[i] = char(i * 13);
+
+  std::vector<char> received(4 + payload.size() + 4 + tail.size());
+  std::thread reader([&] { peer.receive_all(received.data(), eve::size(received.size())); });
+
+  {
+    eve::net::buffer buf(&client, 64);
+    buf.cork();
+    {
+      eve::binarywriter bw(&buf);
+      bw << eve::uint32(payload.size());
+      buf.write_ref(payload.data(), eve::size(payload.size()));
+      bw << eve::uint32(0xfeedface);
+
+      // larger than the put area, it is sent in place
+      buf.sputn(tail.data(), tail.size());
+    }
+    buf.uncork();
+  }
+  reader.join();
+
+  eve::uint32 size, marker;
+  memcpy(&size, received.data(), 4);
+  memcpy(&marker, received.data() + 4 + payload.size(), 4);
+  EXPECT_EQ(payload.size(), size);
+  EXPECT_EQ(0xfeedface, marker);
+  EXPECT_TRUE(std::equal(payload.begin(), payload.end(), received.begin() + 4));
+  EXPECT_TRUE(std::equal(tail.begin(), tail.end(), received.end() - tail.size()));
+}
+
+TEST(Net, BufferInput)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  eve::socket server(eve::socket::type::stream);
+  server.listen(10003, 4);
+
+  eve::socket client(eve::socket::type::stream);
+  client.connect(eve::socket::address("localhost", 10003));
+  auto peer = server.accept();
+
+  const int k_messages = 1000;
+  {
+    eve::net::buffer buf(&peer, 4096);
+    eve::binarywriter bw(&buf);
+    for (int i = 0; i < k_messages; ++i)
+      bw << eve::uint32(i) << "message";
+  }
+
+  eve::net::buffer buf(&client, 2, 1024);
+
+  // once enough is buffered, messages are parsed in place
+  ASSERT_TRUE(buf.ensure(13));
+  eve::span_reader view(buf.peek(), buf.available());
+  eve::uint32 first;
+  std::string text;
+  view >> first >> text;
+  buf.consume(view.position());
+  EXPECT_EQ(0u, first);
+  EXPECT_EQ("message", text);
+
+  eve::binaryreader br(&buf);
+  for (int i = 1; i < k_messages; ++i)
+  {
+    eve::uint32 value;
+    br >> value >> text;
+    ASSERT_EQ(eve::uint32(i), value);
+    ASSERT_EQ("message", text);
+  }
+
+  // receives filling the buffer made it grow up to its cap
+  EXPECT_EQ(1024u, buf.input_capacity());
+  EXPECT_EQ(0u, buf.available());
+  EXPECT_FALSE(buf.try_fill());
+}
+
+TEST(Net, MessageCodec)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  eve::socket server(eve::socket::type::stream);
+  server.listen(10004, 4);
+
+  eve::socket client(eve::socket::type::stream);
+  client.connect(eve::socket::address("localhost", 10004));
+  auto peer = server.accept();
+
+  eve::net::buffer out(&client), in(&peer);
+  eve::net::message_codec writer(out), reader(in);
+
+  std::vector<char> large(40000);
+  for (eve::size i = 0; i < large.size(); ++i)
+    large[i] = char(i * 3);
+
+  eve::size pooled = 0;
+  for (int round = 0; round < 2; ++round)
+  {
+    // a tick worth of messages leaves in a single send
+    const int k_messages = 500;
+    for (int i = 0; i < k_messages; ++i)
+    {
+      std::vector<char> payload;
+      {
+        eve::span_writer<std::vector<char>> sw(payload);
+        sw.reserve(4);
+        sw << eve::uint32(i) << std::string(eve::size(i % 200), 'a');
+      }
+      writer.write(payload);
+    }
+    writer.write(large);
+    writer.write(nullptr, 0);
+    EXPECT_GT(writer.flush(), large.size());
+    EXPECT_EQ(0u, writer.flush());
+
+    std::vector<eve::net::message_codec::message> messages;
+    for (int i = 0; i < k_messages; ++i)
+    {
+      eve::net::message_codec::message message;
+      if (!reader.try_read(message))
+        ASSERT_TRUE(reader.read(message));
+
+      eve::uint32 value;
+      std::string text;
+      message.reader() >> value >> text;
+      ASSERT_EQ(eve::uint32(i), value);
+      ASSERT_EQ(eve::size(i % 200), text.size());
+      messages.push_back(std::move(message));
+    }
+
+    eve::net::message_codec::message message;
+    ASSERT_TRUE(reader.read(message));
+    EXPECT_TRUE(std::equal(large.begin(), large.end(), message.data()));
+    ASSERT_TRUE(reader.read(message));
+    EXPECT_EQ(0u, message.size());
+    eve::net::message_codec::message none;
+    EXPECT_FALSE(reader.try_read(none));
+    EXPECT_TRUE(none.empty());
+
+    // the second round is served entirely from blocks released by the first one
+    messages.clear();
+    if (round == 0)
+      pooled = reader.pooled();
+    else
+      EXPECT_EQ(pooled, reader.pooled());
+  }
+}
+
+namespace {
+
+/** Echoes everything back and checks that connections never change thread. */
+class echo_handler : public eve::net::server::handler
+{
+public:
+  echo_handler(std::atomic<int>* errors) : m_errors(errors) { }
+
+  void connected(eve::net::server::connection& c) override
+  {
+    c.user = new std::thread::id(std::this_thread::get_id());
+  }
+
+  void received(eve::net::server::connection& c, const char* data, eve::size size) override
+  {
+    if (*(std::thread::id*)c.user != std::this_thread::get_id())
+      ++*m_errors;
+    c.send(data, size);
+  }
+
+  void disconnected(eve::net::server::connection& c) override
+  {
+    delete (std::thread::id*)c.user;
+  }
+
+private:
+  std::atomic<int>* m_errors;
+};
+
+} // anonymous
+
+TEST(Net, Server)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  std::atomic<int> errors(0);
+  eve::net::server server([&] (eve::size) -> eve::unique_ptr<eve::net::server::handler>::type
+  {
+    return eve::unique_ptr<eve::net::server::handler>::type(eve_new echo_handler(&errors));
+  });
+  server.start(10005, 4);
+  ASSERT_EQ(4u, server.workers());
+
+  const eve::size k_clients = 64;
+  std::deque<eve::socket> clients;
+  eve::socket::address address("127.0.0.1", 10005);
+  for (eve::size i = 0; i < k_clients; ++i)
+  {
+    clients.emplace_back(eve::socket::type::stream);
+    clients.back().connect(address);
+  }
+
+  for (int round = 0; round < 3; ++round)
+  {
+    for (auto& client : clients)
+      client.send_all("hello", 5);
+    for (auto& client : clients)
+    {
+      char reply[5];
+      client.receive_all(reply, 5);
+      EXPECT_EQ(0, memcmp(reply, "hello", 5));
+    }
+  }
+
+  // a worker counts sent bytes right after the echo may have been read
+  eve::uint64 accepted, received, sent;
+  eve::size busy;
+  for (int attempt = 0; attempt < 100; ++attempt)
+  {
+    accepted = received = sent = 0;
+    busy = 0;
+    for (eve::size i = 0; i < server.workers(); ++i)
+    {
+      auto stats = server.statistics(i);
+      accepted += stats.accepted;
+      received += stats.bytes_received;
+      sent += stats.bytes_sent;
+      busy += stats.connections > 0;
+    }
+    if (sent == received)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(k_clients, accepted);
+  EXPECT_EQ(k_clients * 15, received);
+  EXPECT_EQ(received, sent);
+  EXPECT_GT(busy, 1u);
+  EXPECT_EQ(0, errors);
+
+  clients.clear();
+  server.stop();
+  EXPECT_EQ(0u, server.workers());
+}
+
+TEST(Net, ServerSlowPeer)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  std::atomic<int> errors(0);
+  eve::net::server server([&] (eve::size) -> eve::unique_ptr<eve::net::server::handler>::type
+  {
+    return eve::unique_ptr<eve::net::server::handler>::type(eve_new echo_handler(&errors));
+  });
+  server.start(10006, 1);
+  eve::socket::address address("127.0.0.1", 10006);
+
+  // a peer sending without reading its echoes until the server has to queue them
+  eve::socket stalled(eve::socket::type::stream);
+  stalled.connect(address);
+  std::vector<char> flood(64 * 1024, 'f');
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  for (;;)
+  {
+    auto stats = server.statistics(0);
+    if (stats.bytes_received - stats.bytes_sent > 1024 * 1024 || std::chrono::steady_clock::now() > deadline)
+      break;
+    eve::size size = eve::size(flood.size());
+    if (!stalled.try_send(flood.data(), size))
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  auto stats = server.statistics(0);
+  ASSERT_GT(stats.bytes_received - stats.bytes_sent, 1024u * 1024u);
+
+  // does not stall the other connections of its worker
+  eve::socket client(eve::socket::type::stream);
+  client.connect(address);
+  client.send_all("hello", 5);
+  char reply[5];
+  eve::size received = 0;
+  deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (received < 5 && std::chrono::steady_clock::now() < deadline)
+  {
+    eve::size size = 5 - received;
+    if (client.try_receive(reply + received, size))
+      received += size;
+    else
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(5u, received);
+  EXPECT_EQ(0, memcmp(reply, "hello", 5));
+
+  // hanging up drops what was queued for it
+  stalled.close();
+  for (int attempt = 0; attempt < 500 && server.statistics(0).connections > 1; ++attempt)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(1u, server.statistics(0).connections);
+  EXPECT_EQ(0, errors);
+
+  server.stop();
+}
+
+TEST(Net, PollerManyConnections)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  eve::size connections = 10000;
+#ifdef EVE_LINUX
+  // every loopback connection costs two descriptors in this process
+  rlimit limit;
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  getrlimit(RLIMIT_NOFILE, &limit);
+  connections = std::min(connections, eve::size((limit.rlim_cur - 64) / 2));
+#endif
+
+  typedef eve::net::poller::event event;
+  eve::net::poller poller;
+  std::deque<eve::socket> peers;
+  eve::size echoed = 0;
+
+  auto echo = [&] (eve::socket& peer, eve::flagset<event>)
+  {
+    // edge-triggered: drain everything that arrived
+    char data[64];
+    eve::size size = sizeof(data);
+    while (peer.try_receive(data, size) && size > 0)
+    {
+      EXPECT_TRUE(peer.try_send(data, size));
+      echoed += size;
+      size = sizeof(data);
+    }
+  };
+
+  eve::socket server(eve::socket::type::stream);
+  server.listen(10001, 1024);
+  poller.add(server, event::readable, [&] (eve::socket& listener, eve::flagset<event>)
+  {
+    eve::socket peer;
+    while (listener.try_accept(peer))
+    {
+      peers.push_back(std::move(peer));
+      poller.add(peers.back(), event::readable, echo);
+    }
+  });
+
+  eve::socket::address address("127.0.0.1", 10001);
+  std::deque<eve::socket> clients;
+  for (eve::size i = 0; i < connections; ++i)
+  {
+    clients.emplace_back(eve::socket::type::stream);
+    clients.back().connect(address);
+
+    // keep the backlog from filling up
+    if (i % 256 == 255)
+      poller.poll(0);
+  }
+
+  for (int i = 0; i < 100 && peers.size() < connections; ++i)
+    poller.poll(100);
+  ASSERT_EQ(connections, peers.size());
+  EXPECT_EQ(connections + 1, poller.size());
+
+  for (auto& client : clients)
+    client.send_all("ping", 4);
+
+  for (int i = 0; i < 100 && echoed < 4 * connections; ++i)
+    poller.poll(100);
+  EXPECT_EQ(4 * connections, echoed);
+
+  for (auto& client : clients)
+  {
+    char reply[4];
+    client.receive_all(reply, 4);
+    EXPECT_EQ(0, memcmp(reply, "ping", 4));
+  }
+
+  poller.remove(server);
+  EXPECT_EQ(connections, poller.size());
+}
+
+TEST(Net, Datagram)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  eve::socket receiver(eve::socket::type::datagram);
+  receiver.bind(0);
+  eve::socket::address to("127.0.0.1", receiver.local_address().port());
+
+  eve::socket sender(eve::socket::type::datagram);
+  sender.bind(0);
+  auto port = sender.local_address().port();
+
+  EXPECT_EQ(5u, sender.send_to("hello", 5, to));
+
+  char data[64];
+  eve::socket::address from;
+  EXPECT_EQ(5u, receiver.receive_from(data, sizeof(data), from));
+  EXPECT_EQ(0, memcmp(data, "hello", 5));
+  EXPECT_EQ(port, from.port());
+
+  eve::size size = sizeof(data);
+  EXPECT_FALSE(receiver.try_receive_from(data, size, from));
+
+  // the same with rings, once plain and once with segmentation offload
+  for (int offload = 0; offload < 2; ++offload)
+  {
+    eve::net::packet_ring out(64, 256), in(64, 256);
+    if (offload && !(out.enable_offload(sender) && in.enable_offload(receiver)))
+      break;
+
+    for (int i = 0; i < 40; ++i)
+    {
+      // runs of equally sized packets, each ending with a shorter one
+      char payload[200];
+      eve::size length = i % 8 == 7 ? 10 : 100;
+      memset(payload, i, length);
+      out.push(payload, length, to);
+    }
+    EXPECT_EQ(40u, out.send(sender));
+    EXPECT_TRUE(out.empty());
+
+    EXPECT_EQ(40u, in.receive(receiver));
+    for (int i = 0; i < 40; ++i)
+    {
+      auto& p = in.front();
+      EXPECT_EQ(i % 8 == 7 ? 10u : 100u, p.size);
+      EXPECT_EQ(char(i), p.data[p.size - 1]);
+      EXPECT_EQ(port, p.address.port());
+      in.pop();
+    }
+    EXPECT_EQ(0u, in.receive(receiver));
+  }
+}
+
+TEST(Net, DatagramBenchmark)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  eve::socket receiver(eve::socket::type::datagram);
+  receiver.bind(0);
+  eve::socket::address to("127.0.0.1", receiver.local_address().port());
+  eve::socket sender(eve::socket::type::datagram);
+
+  // bursts small enough to never overflow the receive buffer
+  const eve::size k_burst = 64;
+  const eve::size k_packets = 64000;
+  char payload[64] = { };
+
+  eve::stopwatch stopwatch;
+  eve::size received = 0;
+  for (eve::size n = 0; n < k_packets; n += k_burst)
+  {
+    for (eve::size i = 0; i < k_burst; ++i)
+      sender.send_to(payload, sizeof(payload), to);
+
+    char data[64];
+    eve::size size = sizeof(data);
+    eve::socket::address from;
+    while (receiver.try_receive_from(data, size, from))
+      ++received;
+  }
+  auto single = received / stopwatch.reset();
+
+  auto batched = [&] (bool offload) -> double
+  {
+    eve::net::packet_ring out(k_burst, sizeof(payload)), in(k_burst, sizeof(payload));
+    if (offload && !(out.enable_offload(sender) && in.enable_offload(receiver)))
+      return 0;
+
+    eve::size received = 0;
+    eve::stopwatch stopwatch;
+    for (eve::size n = 0; n < k_packets; n += k_burst)
+    {
+      while (!out.full())
+        out.push(payload, sizeof(payload), to);
+      out.send(sender);
+
+      while (in.receive(receiver))
+      {
+        received += in.size();
+        in.clear();
+      }
+    }
+    return received / stopwatch.elapsed();
+  };
+  auto batch = batched(false);
+  auto offload = batched(true);
+
+  EXPECT_GT(batch, 0.0);
+  std::cout << "send_to/receive_from: " << eve::size(single) << " packets/s\n";
+  std::cout << "sendmmsg/recvmmsg:    " << eve::size(batch) << " packets/s\n";
+  std::cout << "GSO/GRO:              " << eve::size(offload) << " packets/s\n";
+}
+
+namespace {
+
+/** Stands in for a network link: delays datagrams and randomly drops, duplicates and reorders them. */
+class lossy_wire
+{
+public:
+  lossy_wire(unsigned seed, double latency, double jitter, double loss, double duplication)
+    : m_random(seed), m_latency(latency), m_jitter(jitter), m_loss(loss), m_duplication(duplication) { }
+
+  void send(double now, const char* data, eve::size size)
+  {
+    std::uniform_real_distribution<double> uniform;
+    if (uniform(m_random) < m_loss)
+      return;
+
+    int copies = uniform(m_random) < m_duplication ? 2 : 1;
+    for (int i = 0; i < copies; ++i)
+      m_flying.push_back(std::make_pair(now + m_latency + m_jitter * uniform(m_random), std::vector<char>(data, data + size)));
+  }
+
+  template <class Receive>
+  void deliver(double now, Receive receive)
+  {
+    auto flying = std::move(m_flying);
+    m_flying.clear();
+    for (auto& datagram : flying)
+    {
+      if (datagram.first <= now)
+        receive(datagram.second.data(), eve::size(datagram.second.size()));
+      else
+        m_flying.push_back(std::move(datagram));
+    }
+  }
+
+private:
+  std::mt19937 m_random;
+  double m_latency, m_jitter, m_loss, m_duplication;
+  std::vector<std::pair<double, std::vector<char>>> m_flying;
+};
+
+} // anonymous
+
+TEST(Net, Channel)
+{
+  typedef eve::net::channel channel;
+
+  double now = 0;
+  lossy_wire ab(1, 0.05, 0.02, 0.2, 0.05), ba(2, 0.05, 0.02, 0.2, 0.05);
+  channel a([&] (const char* data, eve::size size) { ab.send(now, data, size); });
+  channel b([&] (const char* data, eve::size size) { ba.send(now, data, size); });
+
+  for (auto c : { &a, &b })
+  {
+    c->add_stream(channel::delivery::unreliable);
+    c->add_stream(channel::delivery::reliable_unordered);
+    c->add_stream(channel::delivery::reliable_ordered);
+  }
+
+  // spans a few dozen datagrams
+  std::vector<char> large(40000);
+  for (eve::size i = 0; i < large.size(); ++i)
+    large[i] = char(i * 7);
+
+  const int k_messages = 200;
+  std::vector<int> unreliable, unordered, ordered;
+  bool large_received = false;
+  for (int step = 0; step < 2000 && (step <= k_messages || a.pending() > 0 || !large_received); ++step)
+  {
+    // one message per stream and update, each in its own datagram
+    if (step < k_messages)
+    {
+      for (eve::uint8 stream = 0; stream < 3; ++stream)
+        a.send(stream, (const char*)&step, sizeof(step));
+    }
+    else if (step == k_messages)
+      a.send(2, large.data(), eve::size(large.size()));
+
+    now += 0.005;
+    ab.deliver(now, [&] (const char* data, eve::size size) { EXPECT_TRUE(b.receive(data, size, now)); });
+    ba.deliver(now, [&] (const char* data, eve::size size) { EXPECT_TRUE(a.receive(data, size, now)); });
+    a.update(now);
+    b.update(now);
+
+    channel::message message;
+    while (b.pop(message))
+    {
+      if (message.data.size() == large.size())
+      {
+        EXPECT_EQ(large, message.data);
+        EXPECT_EQ(2, message.stream);
+        EXPECT_EQ(k_messages, int(ordered.size()));
+        large_received = true;
+        continue;
+      }
+
+      ASSERT_EQ(sizeof(int), message.data.size());
+      int value;
+      memcpy(&value, message.data.data(), sizeof(value));
+      (message.stream == 0 ? unreliable : message.stream == 1 ? unordered : ordered).push_back(value);
+    }
+  }
+
+  EXPECT_EQ(0u, a.pending());
+  EXPECT_TRUE(large_received);
+  EXPECT_GT(a.resent(), 0u);
+  EXPECT_NEAR(0.11, a.rtt(), 0.05);
+
+  // some unreliable messages are lost, the reliable ones are all there once
+  EXPECT_LT(int(unreliable.size()), k_messages);
+  EXPECT_GT(int(unreliable.size()), k_messages / 2);
+  ASSERT_EQ(k_messages, int(ordered.size()));
+  ASSERT_EQ(k_messages, int(unordered.size()));
+  EXPECT_EQ(k_messages, int(std::set<int>(unordered.begin(), unordered.end()).size()));
+  for (int i = 0; i < k_messages; ++i)
+    EXPECT_EQ(i, ordered[i]);
+
+  EXPECT_FALSE(b.receive("xy", 2, now));
+
+  // the retransmission timeout backs off while nothing is acknowledged
+  {
+    std::vector<std::vector<char>> wire;
+    channel c([&] (const char* data, eve::size size) { wire.push_back(std::vector<char>(data, data + size)); });
+    channel d([&] (const char* data, eve::size size) { EXPECT_TRUE(c.receive(data, size, now)); });
+    c.add_stream(channel::delivery::reliable_ordered);
+    d.add_stream(channel::delivery::reliable_ordered);
+
+    c.send(0, "x", 1);
+    c.update(now);
+    EXPECT_DOUBLE_EQ(0.1, c.rto());
+    for (double expected : { 0.2, 0.4, 0.8, 1.0, 1.0 })
+    {
+      now += c.rto() + 0.001;
+      c.update(now);
+      EXPECT_DOUBLE_EQ(expected, c.rto());
+    }
+    EXPECT_EQ(5u, c.resent());
+
+    // and is computed afresh from the next round trip measured
+    wire.clear();
+    now += c.rto() + 0.001;
+    c.update(now);
+    now += 0.01;
+    for (auto& datagram : wire)
+      EXPECT_TRUE(d.receive(datagram.data(), eve::size(datagram.size()), now));
+    d.update(now);
+    EXPECT_NEAR(0.03, c.rto(), 1e-9);
+    EXPECT_EQ(0u, c.pending());
+  }
+}
+
+TEST(Net, Resolver)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  using eve::net::resolver;
+  typedef eve::socket::domain domain;
+
+  resolver r(std::chrono::seconds(5));
+
+  auto localhost = r.resolve("localhost", 10500).get();
+  ASSERT_TRUE(localhost.ok);
+  ASSERT_FALSE(localhost.addresses.empty());
+  bool loopback = false;
+  for (auto& a : localhost.addresses)
+  {
+    EXPECT_EQ(10500, a.port());
+    loopback |= a.family() == domain::IPv4 && a.host() == "127.0.0.1";
+  }
+  EXPECT_TRUE(loopback);
+
+  // the second lookup is served from the cache, the port being part of the key
+  EXPECT_TRUE(r.cached("localhost", 10500));
+  EXPECT_FALSE(r.cached("localhost", 10501));
+  EXPECT_EQ(localhost.addresses.size(), r.resolve("localhost", 10500).get().addresses.size());
+  r.clear();
+  EXPECT_FALSE(r.cached("localhost", 10500));
+
+  // failures are reported and not cached
+  auto invalid = r.resolve("", 10500).get();
+  EXPECT_FALSE(invalid.ok);
+  EXPECT_FALSE(invalid.error.empty());
+  EXPECT_FALSE(r.cached("", 10500));
+
+  // callbacks run on the polling thread only
+  int called = 0;
+  eve::socket::address v6;
+  r.resolve("::1", 10501, [&] (const resolver::result& result)
+  {
+    ++called;
+    ASSERT_TRUE(result.ok);
+    v6 = result.addresses.front();
+  });
+  for (int i = 0; i < 500 && called == 0; ++i)
+  {
+    if (r.poll() == 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  ASSERT_EQ(1, called);
+  EXPECT_EQ(domain::IPv6, v6.family());
+  EXPECT_EQ("::1", v6.host());
+  EXPECT_EQ(eve::socket::address("::1", 10501, domain::IPv6), v6);
+
+  // the addresses are usable as is
+  eve::socket server(eve::socket::type::stream, domain::IPv6);
+  server.listen(10501, 4);
+
+  eve::socket client(eve::socket::type::stream, domain::IPv6);
+  client.connect(v6);
+  auto peer = server.accept();
+  EXPECT_EQ(domain::IPv6, peer.local_address().family());
+
+  client.send_all("ping", 4);
+  char data[4];
+  peer.receive_all(data, 4);
+  EXPECT_EQ(0, memcmp("ping", data, 4));
+}
+
+TEST(Net, ShmChannel)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  eve::net::shm_channel server, client;
+  server.create("test_net", 1000);
+  client.open("test_net");
+  EXPECT_EQ(4096u, server.capacity());
+  EXPECT_EQ(4096u, client.capacity());
+  EXPECT_TRUE(client.connected());
+  EXPECT_THROW(eve::net::shm_channel().open("test_net_missing"), eve::socket_error);
+
+  // buffers and serialization work as over sockets
+  {
+    eve::net::buffer buf(&server, 64);
+    eve::binarywriter bw(&buf);
+    bw << (unsigned char)1 << "hello foo";
+  }
+  {
+    unsigned char ch;
+    std::string data;
+    eve::net::buffer buf(&client, 64);
+    eve::binaryreader br(&buf);
+    br >> ch >> data;
+    EXPECT_EQ(1, ch);
+    EXPECT_EQ("hello foo", data);
+  }
+
+  // many times the ring capacity, the sender blocking whenever it is full
+  std::vector<char> sent(1 << 20);
+  for (eve::size i = 0; i < sent.size(); ++i)
+    sent[i] = char(i * 7 + i / 4096);
+
+  std::thread sender([&]
+  {
+    client.send_all(sent.data(), eve::size(sent.size()));
+    client.close();
+  });
+
+  std::vector<char> received;
+  char data[3000];
+  for (;;)
+  {
+    auto size = server.receive(data, sizeof(data));
+    if (size == 0)
+      break;
+    received.insert(received.end(), data, data + size);
+  }
+  sender.join();
+
+  EXPECT_TRUE(sent == received);
+  EXPECT_FALSE(server.connected());
+  EXPECT_THROW(server.send("x", 1), eve::socket_error);
+
+  eve::size size = sizeof(data);
+  EXPECT_TRUE(server.try_receive(data, size));
+  EXPECT_EQ(0u, size);
+}
+
+#ifdef EVE_LINUX
+TEST(Net, ShmChannelDeadPeer)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  // a creator that crashes leaves its segment behind, which the next creator replaces
+  auto crashed = fork();
+  ASSERT_LE(0, crashed);
+  if (crashed == 0)
+  {
+    eve::net::shm_channel orphan;
+    orphan.create("test_net_dead");
+    _exit(0);
+  }
+  waitpid(crashed, nullptr, 0);
+
+  eve::net::shm_channel server;
+  server.create("test_net_dead");
+
+  // a peer that crashes without closing wakes up the end waiting for it
+  auto peer = fork();
+  ASSERT_LE(0, peer);
+  if (peer == 0)
+  {
+    eve::net::shm_channel client;
+    client.open("test_net_dead");
+    client.send("x", 1);
+    _exit(0);
+  }
+  waitpid(peer, nullptr, 0);
+
+  char data[16];
+  EXPECT_EQ(1u, server.receive(data, sizeof(data)));
+  eve::stopwatch stopwatch;
+  EXPECT_EQ(0u, server.receive(data, sizeof(data)));
+  EXPECT_LT(stopwatch.elapsed(), 1.0);
+  EXPECT_FALSE(server.connected());
+  EXPECT_THROW(server.send("x", 1), eve::socket_error);
+}
+#endif
+
+TEST(Net, ShmChannelBenchmark)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  const int k_round_trips = 20000;
+  char message[64] = { };
+
+  // a request answered by an echo on another thread, one at a time
+  auto ping_pong = [&] (eve::net::stream& local, eve::net::stream& remote) -> double
+  {
+    std::thread echo([&]
+    {
+      char data[sizeof(message)];
+      for (int i = 0; i < k_round_trips; ++i)
+      {
+        eve::size done = 0;
+        while (done < sizeof(data))
+          done += remote.receive(data + done, sizeof(data) - done);
+        remote.send_all(data, sizeof(data));
+      }
+    });
+
+    eve::stopwatch stopwatch;
+    char data[sizeof(message)];
+    for (int i = 0; i < k_round_trips; ++i)
+    {
+      local.send_all(message, sizeof(message));
+      eve::size done = 0;
+      while (done < sizeof(data))
+        done += local.receive(data + done, sizeof(data) - done);
+    }
+    auto elapsed = stopwatch.elapsed();
+    echo.join();
+    return elapsed / k_round_trips * 1e6;
+  };
+
+  eve::net::shm_channel server, client;
+  server.create("test_net_benchmark");
+  client.open("test_net_benchmark");
+  auto shm = ping_pong(client, server);
+
+  eve::socket listener(eve::socket::type::stream);
+  listener.listen(10600, 1);
+  eve::socket tcp_client(eve::socket::type::stream);
+  tcp_client.connect(eve::socket::address("127.0.0.1", 10600));
+  auto tcp_server = listener.accept();
+  tcp_client.nodelay(true);
+  tcp_server.nodelay(true);
+  auto tcp = ping_pong(tcp_client, tcp_server);
+
+  EXPECT_GT(shm, 0.0);
+  std::cout << "shm_channel round trip:  " << shm << " us\n";
+  std::cout << "loopback TCP round trip: " << tcp << " us\n";
+}
+
+TEST(Net, SimLink)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  using eve::net::sim_link;
+
+  double now = 0;
+  auto manual = [&] { return now; };
+
+  // 100 bytes at 1000 bytes/s take 0.1s to leave, then 0.05s to arrive
+  {
+    sim_link::config c;
+    c.latency = 0.05;
+    c.bandwidth = 1000;
+    c.queue_limit = 150;
+    sim_link link(c, 0, manual);
+
+    char data[200] = { };
+    eve::size size = sizeof(data);
+    EXPECT_TRUE(link.at(0).try_send(data, size));
+    EXPECT_EQ(150u, size);
+
+    now = 0.14;
+    size = sizeof(data);
+    EXPECT_FALSE(link.at(1).try_receive(data, size));
+    EXPECT_THROW(link.at(1).receive(data, sizeof(data)), eve::socket_error);
+
+    now = 0.2;
+    size = sizeof(data);
+    ASSERT_TRUE(link.at(1).try_receive(data, size));
+    EXPECT_EQ(150u, size);
+    EXPECT_EQ(-1, link.next_arrival());
+
+    // the queue is full: datagrams are dropped
+    for (int i = 0; i < 4; ++i)
+      link.at(1).send_datagram(data, 100);
+    EXPECT_EQ(4u, link.at(1).statistics().sent);
+    EXPECT_EQ(3u, link.at(1).statistics().dropped);
+  }
+
+  // the same seed and time source lose and reorder the same datagrams on every run
+  auto run = [&] (unsigned seed) -> std::vector<int>
+  {
+    sim_link::config c;
+    c.latency = 0.03;
+    c.jitter = 0.01;
+    c.delay = sim_link::distribution::normal;
+    c.loss = 0.1;
+    c.reorder = 0.1;
+    sim_link link(c, seed, manual);
+
+    std::vector<int> received;
+    for (now = 0; now < 2; now += 0.01)
+    {
+      int sent = int(now * 100 + 0.5);
+      link.at(0).send_datagram((const char*)&sent, sizeof(sent));
+
+      int value;
+      eve::size size = sizeof(value);
+      while (link.at(1).try_receive_datagram((char*)&value, size))
+        received.push_back(value);
+    }
+    return received;
+  };
+
+  auto first = run(7);
+  EXPECT_TRUE(first == run(7));
+  EXPECT_FALSE(first == run(8));
+  EXPECT_GT(first.size(), 150u);
+  EXPECT_LT(first.size(), 190u);
+  EXPECT_FALSE(std::is_sorted(first.begin(), first.end()));
+
+  // a reliable protocol over a lossy link, reproducible to the last datagram
+  auto transfer = [&] (unsigned seed) -> std::pair<double, eve::uint64>
+  {
+    sim_link::config c;
+    c.latency = 0.04;
+    c.jitter = 0.01;
+    c.delay = sim_link::distribution::exponential;
+    c.loss = 0.05;
+    c.bandwidth = 256 * 1024;
+    c.queue_limit = 64 * 1024;
+    sim_link link(c, seed, manual);
+
+    using eve::net::channel;
+    channel a([&] (const char* data, eve::size size) { link.at(0).send_datagram(data, size); });
+    channel b([&] (const char* data, eve::size size) { link.at(1).send_datagram(data, size); });
+    a.add_stream(channel::delivery::reliable_ordered);
+    b.add_stream(channel::delivery::reliable_ordered);
+
+    std::vector<char> payload(1000, 'x');
+    const int k_messages = 500;
+    int sent = 0, delivered = 0;
+    for (now = 0; delivered < k_messages && now < 60; now += 0.005)
+    {
+      for (; sent < k_messages && a.pending() < 64; ++sent)
+        a.send(0, payload.data(), eve::size(payload.size()));
+
+      char data[2048];
+      eve::size size = sizeof(data);
+      while (link.at(1).try_receive_datagram(data, size))
+      {
+        b.receive(data, size, now);
+        size = sizeof(data);
+      }
+      size = sizeof(data);
+      while (link.at(0).try_receive_datagram(data, size))
+      {
+        a.receive(data, size, now);
+        size = sizeof(data);
+      }
+      a.update(now);
+      b.update(now);
+
+      channel::message message;
+      while (b.pop(message))
+        ++delivered;
+    }
+    EXPECT_EQ(k_messages, delivered);
+    return std::make_pair(now, a.resent());
+  };
+
+  auto reference = transfer(1);
+  EXPECT_EQ(reference, transfer(1));
+  EXPECT_GT(reference.second, 0u);
+  std::cout << "channel over 5% loss: " << eve::size(500 * 1000 / reference.first / 1024) << " KB/s, "
+            << reference.second << " fragments resent\n";
+
+  // blocking calls over the stopwatch, with buffers on top
+  {
+    sim_link::config c;
+    c.latency = 0.002;
+    c.jitter = 0.001;
+    c.delay = sim_link::distribution::uniform;
+    sim_link link(c);
+
+    std::thread writer([&]
+    {
+      eve::net::buffer buf(&link.at(0), 64);
+      eve::binarywriter bw(&buf);
+      bw << (unsigned char)1 << "hello foo";
+      buf.pubsync();
+      link.at(0).close();
+    });
+
+    unsigned char ch;
+    std::string data;
+    eve::net::buffer buf(&link.at(1), 64);
+    eve::binaryreader br(&buf);
+    br >> ch >> data;
+    writer.join();
+
+    EXPECT_EQ(1, ch);
+    EXPECT_EQ("hello foo", data);
+    char rest[4];
+    EXPECT_EQ(0u, link.at(1).receive(rest, sizeof(rest)));
+  }
+}
+
+TEST(Net, Deflate)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  eve::net::sim_link link;
+  eve::net::deflate_stream out(&link.at(0)), in(&link.at(1));
+  eve::net::buffer writer(&out, 4096), reader(&in, 4096);
+
+  // game state updates compress well
+  std::vector<std::string> updates;
+  for (int i = 0; i < 2000; ++i)
+  {
+    std::stringstream ss;
+    ss << "{\"entity\":" << i % 64 << ",\"position\":[" << i * 3 % 100 << ",0," << i % 7 << "],\"state\":\"running\"}";
+    updates.push_back(ss.str());
+  }
+
+  {
+    eve::binarywriter bw(&writer);
+    for (auto& update : updates)
+      bw << update;
+    writer.pubsync();
+
+    // a single small unit is not worth deflating
+    bw << (unsigned char)42;
+    writer.pubsync();
+  }
+
+  {
+    eve::binaryreader br(&reader);
+    std::string update;
+    for (auto& expected : updates)
+    {
+      br >> update;
+      ASSERT_EQ(expected, update);
+    }
+    unsigned char ch = 0;
+    br >> ch;
+    EXPECT_EQ(42, ch);
+  }
+
+  auto& stats = out.statistics();
+  EXPECT_GT(stats.deflated, 0u);
+  EXPECT_EQ(1u, stats.bypassed);
+  EXPECT_GT(out.bytes_saved(), eve::int64(stats.bytes_in / 2));
+  EXPECT_EQ(stats.bytes_out, in.statistics().wire_received);
+  EXPECT_EQ(stats.bytes_in, in.statistics().bytes_received);
+
+  // incompressible data still round trips, through the non-blocking calls
+  std::mt19937 random(3);
+  std::vector<char> noise(100000);
+  for (auto& c : noise)
+    c = char(random());
+
+  eve::size size = eve::size(noise.size());
+  ASSERT_TRUE(out.try_send(noise.data(), size));
+  out.flush();
+
+  std::vector<char> received;
+  char data[1000];
+  size = sizeof(data);
+  while (received.size() < noise.size() && in.try_receive(data, size))
+  {
+    received.insert(received.end(), data, data + size);
+    size = sizeof(data);
+  }
+  EXPECT_TRUE(noise == received);
+
+  std::cout << "deflate: " << stats.bytes_in << " bytes sent as " << stats.bytes_out << ", "
+            << out.deflate_cost() * 1000 << " ms per MB\n";
+
+  link.at(0).close();
+  EXPECT_EQ(0u, in.receive(data, sizeof(data)));
+}
+
+TEST(Net, DeflateBomb)
+{
+  eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+  // a few kilobytes on the wire that inflate to 4 MB
+  std::vector<char> zeros(4 * 1024 * 1024, 0);
+
+  {
+    eve::net::sim_link link;
+    eve::net::deflate_stream out(&link.at(0)), in(&link.at(1));
+    out.send_all(zeros.data(), eve::size(zeros.size()));
+    EXPECT_LT(out.statistics().bytes_out, 64u * 1024);
+
+    // inflated only as it is read
+    char data[1000];
+    EXPECT_EQ(sizeof(data), in.receive(data, sizeof(data)));
+    EXPECT_LE(in.statistics().bytes_received, 256u * 1024);
+
+    eve::size total = sizeof(data);
+    while (total < zeros.size())
+      total += in.receive(data, sizeof(data));
+    EXPECT_EQ(zeros.size(), total);
+    EXPECT_EQ(zeros.size(), in.statistics().bytes_received);
+  }
+
+  {
+    eve::net::deflate_stream::config config;
+    config.max_frame = 1024 * 1024;
+    eve::net::sim_link link;
+    eve::net::deflate_stream out(&link.at(0)), in(&link.at(1), config);
+    out.send_all(zeros.data(), eve::size(zeros.size()));
+
+    char data[1000];
+    EXPECT_THROW(
+      for (;;)
+        in.receive(data, sizeof(data)),
+      eve::socket_error);
+  }
+}
+
+TEST(Net, Scheduler)
+{
+  using eve::net::scheduler;
+
+  std::vector<std::pair<eve::uint8, std::string>> sent;
+  scheduler::config c;
+  c.rate = 1000;
+  c.burst = 1000;
+  c.aging = 1;
+  scheduler s([&] (eve::uint8 type, const char* data, eve::size size) { sent.push_back(std::make_pair(type, std::string(data, size))); }, c);
+
+  scheduler::class_config bulk_config;
+  auto bulk = s.add_class(bulk_config);
+
+  scheduler::class_config events_config;
+  events_config.priority = 10;
+  auto events = s.add_class(events_config);
+
+  scheduler::class_config state_config;
+  state_config.priority = 5;
+  state_config.unreliable = true;
+  state_config.max_age = 0.5;
+  auto state = s.add_class(state_config);
+
+  scheduler::class_config chat_config;
+  chat_config.priority = 20;
+  chat_config.rate = 100;
+  chat_config.burst = 100;
+  chat_config.unreliable = true;
+  chat_config.merge = [] (std::vector<char>& queued, const char* data, eve::size size) { queued.insert(queued.end(), data, data + size); };
+  auto chat = s.add_class(chat_config);
+
+  std::string block(400, 'b');
+  for (int i = 0; i < 10; ++i)
+    s.push(bulk, block.data(), eve::size(block.size()));
+  s.push(events, "hit", 3);
+
+  // the newest position supersedes the queued one, chat lines are merged
+  for (char i = '0'; i <= '4'; ++i)
+  {
+    s.push(state, &i, 1, 7);
+    s.push(chat, &i, 1, 1);
+  }
+  EXPECT_EQ(4u, s.statistics(state).superseded);
+  EXPECT_EQ(1u, s.statistics(state).messages);
+  EXPECT_EQ(4000u + 3 + 1 + 5, s.queued());
+
+  // the most urgent first, then as much as the budget allows, a message running it into debt
+  EXPECT_EQ(5u + 3 + 1 + 1200, s.update(0));
+  ASSERT_EQ(6u, sent.size());
+  EXPECT_EQ(chat, sent[0].first);
+  EXPECT_EQ("01234", sent[0].second);
+  EXPECT_EQ(events, sent[1].first);
+  EXPECT_EQ(state, sent[2].first);
+  EXPECT_EQ("4", sent[2].second);
+  EXPECT_EQ(bulk, sent[3].first);
+  EXPECT_EQ(7u, s.statistics(bulk).messages);
+
+  // the connection is in debt until its budget refilled
+  sent.clear();
+  EXPECT_EQ(0u, s.update(0.2));
+  EXPECT_EQ(400u, s.update(0.5));
+
+  // stale unreliable messages are dropped
+  s.push(state, "x", 1, 7);
+  EXPECT_EQ(0u, s.update(0.6));
+  EXPECT_EQ(800u, s.update(1.3));
+  EXPECT_EQ(1u, s.statistics(state).expired);
+
+  // a flow of events saturating the link slows bulk transfers down without starving them
+  sent.clear();
+  std::string event(100, 'e');
+  double now = 1.3;
+  for (int tick = 0; tick < 300; ++tick)
+  {
+    now += 0.1;
+    s.push(events, event.data(), eve::size(event.size()));
+    s.update(now);
+  }
+  EXPECT_EQ(0u, s.statistics(bulk).messages);
+  EXPECT_GT(s.statistics(events).sent, 250u);
+  EXPECT_LT(s.statistics(events).oldest, 5.0);
+
+  // classes with a rate of their own never exceed it
+  sent.clear();
+  std::string line(50, 'c');
+  for (int i = 0; i < 100; ++i)
+    s.push(chat, line.data(), eve::size(line.size()));
+  for (int tick = 0; tick < 10; ++tick)
+  {
+    now += 0.1;
+    s.update(now);
+  }
+  EXPECT_LE(s.statistics(chat).bytes_sent, 5u + 100 + 100 + 50);
+
+  // on a saturated link a position superseded every tick never expires, its content being fresh
+  scheduler::config saturated;
+  saturated.rate = 0;
+  saturated.burst = 0;
+  scheduler stalled([] (eve::uint8, const char*, eve::size) { }, saturated);
+  auto positions = stalled.add_class(state_config);
+  for (int tick = 0; tick < 20; ++tick)
+  {
+    char position = char('a' + tick);
+    stalled.push(positions, &position, 1, 7);
+    stalled.update(tick * 0.1);
+  }
+  EXPECT_EQ(0u, stalled.statistics(positions).expired);
+  EXPECT_EQ(1u, stalled.statistics(positions).messages);
+  EXPECT_GT(stalled.statistics(positions).oldest, 1.5);
+
+  // once no longer superseded it does
+  stalled.update(2.6);
+  EXPECT_EQ(1u, stalled.statistics(positions).expired);
+  EXPECT_EQ(0u, stalled.statistics(positions).messages);
+}
+
+namespace {
+
+struct entity
+{
+  float x;
+  float y;
+  eve::int32 health;
+  std::string name;
+
+  eve_serializable(entity, x, y, health, name);
+};
+
+} // anonymous
+
+TEST(Net, Replicator)
+{
+  using eve::net::replicator;
+  using eve::net::replica;
+
+  replica near, far;
+  std::unordered_map<replicator::client_id, replica*> clients;
+  replicator server([&] (replicator::client_id id, const char* data, eve::size size) { clients[id]->apply(data, size); });
+
+  std::vector<std::unique_ptr<entity>> spawned;
+  int despawned = 0;
+  for (auto r : { &near, &far })
+  {
+    r->bind<entity>(1, [&] (replicator::object_id) { spawned.emplace_back(new entity()); return spawned.back().get(); },
+                       [&] (replicator::object_id, entity*) { ++despawned; });
+  }
+
+  entity a = { 10, 10, 100, "a" }, b = { 500, 500, 50, "b" };
+  auto ida = server.add(&a, 1, a.x, a.y);
+  auto idb = server.add(&b, 1, b.x, b.y);
+  clients[server.add_client(0, 0, 100)] = &near;
+  clients[server.add_client(1000, 1000, 100)] = &far;
+
+  // each client sees only what is around it
+  server.tick();
+  ASSERT_EQ(1u, near.size());
+  ASSERT_NE(nullptr, near.get<entity>(ida));
+  EXPECT_EQ("a", near.get<entity>(ida)->name);
+  EXPECT_EQ(100, near.get<entity>(ida)->health);
+  EXPECT_EQ(0u, far.size());
+
+  // only the changed fields are sent
+  a.health = 90;
+  server.touch(ida);
+  server.tick();
+  EXPECT_EQ(1u, server.statistics().serialized);
+  EXPECT_EQ(1u, server.statistics().fields);
+  EXPECT_EQ(90, near.get<entity>(ida)->health);
+
+  // touching unchanged objects sends nothing
+  server.touch(ida);
+  server.tick();
+  EXPECT_EQ(0u, server.statistics().bytes);
+
+  // moving across the world leaves a view and enters the other
+  a.x = a.y = 990;
+  a.name = "moved";
+  server.move(ida, a.x, a.y);
+  server.tick();
+  EXPECT_EQ(0u, near.size());
+  EXPECT_EQ(1, despawned);
+  ASSERT_NE(nullptr, far.get<entity>(ida));
+  EXPECT_EQ("moved", far.get<entity>(ida)->name);
+  EXPECT_EQ(990, far.get<entity>(ida)->x);
+
+  // moving a view does the same
+  server.view(1, 500, 500, 50);
+  server.tick();
+  ASSERT_EQ(1u, near.size());
+  EXPECT_EQ(50, near.get<entity>(idb)->health);
+
+  server.remove(idb);
+  server.tick();
+  EXPECT_EQ(0u, near.size());
+  EXPECT_EQ(2, despawned);
+  EXPECT_EQ(1u, server.statistics().objects);
+
+  // negative coordinates have cells of their own
+  entity c = { -10, -10, 20, "c" };
+  auto idc = server.add(&c, 1, c.x, c.y);
+  server.view(1, -50, -50, 60);
+  server.tick();
+  ASSERT_EQ(1u, near.size());
+  EXPECT_EQ("c", near.get<entity>(idc)->name);
+
+  // cells are dropped once nothing is in them or watches them
+  server.remove(ida);
+  server.remove(idc);
+  server.remove_client(1);
+  server.remove_client(2);
+  server.tick();
+  EXPECT_EQ(0u, server.statistics().cells);
+}
+
+TEST(Net, ReplicatorBenchmark)
+{
+  using eve::net::replicator;
+
+  const int k_objects = 50000;
+  const int k_clients = 100;
+  const float k_world = 4000;
+
+  eve::size sent = 0;
+  replicator server([&] (replicator::client_id, const char*, eve::size size) { sent += size; });
+
+  std::mt19937 random(5);
+  std::uniform_real_distribution<float> position(0, k_world);
+  std::vector<entity> entities(k_objects);
+  std::vector<replicator::object_id> ids;
+  for (auto& e : entities)
+  {
+    e.x = position(random);
+    e.y = position(random);
+    e.health = 100;
+    e.name = "entity";
+    ids.push_back(server.add(&e, 1, e.x, e.y));
+  }
+  for (int i = 0; i < k_clients; ++i)
+    server.add_client(position(random), position(random), 200);
+  server.tick();
+
+  // a tick with some of the objects moving costs the same however many objects exist
+  auto run = [&] (int changed) -> double
+  {
+    eve::stopwatch stopwatch;
+    const int k_ticks = 10;
+    for (int tick = 0; tick < k_ticks; ++tick)
+    {
+      for (int i = 0; i < changed; ++i)
+      {
+        auto index = random() % k_objects;
+        auto& e = entities[index];
+        e.x = std::min(std::max(e.x + float(int(random() % 21) - 10), 0.0f), k_world);
+        e.health = int(random() % 100);
+        server.move(ids[index], e.x, e.y);
+      }
+      server.tick();
+    }
+    return stopwatch.elapsed() / k_ticks * 1000;
+  };
+
+  auto idle = run(0);
+  auto few = run(500);
+  auto many = run(5000);
+  EXPECT_LT(idle, few);
+  std::cout << "replicator, " << k_objects << " objects and " << k_clients << " clients: "
+            << idle << " ms idle, " << few << " ms with 500 changed, " << many << " ms with 5000 changed per tick\n";
+}
+
+TEST(Net, ClockSync)
+{
+  // the server clock runs 5 s ahead and gains 1 ms per second
+  double local = 0;
+  auto server_clock = [&] { return 5 + local * 1.001; };
+  eve::net::time_service service(server_clock);
+  eve::net::clock_sync sync(eve::net::clock_sync::config(), [&] { return local; });
+  EXPECT_FALSE(sync.synchronized());
+
+  // one way delays of 10 to 15 ms, with one exchange in five queued for up to 200 ms more
+  std::mt19937 random(7);
+  std::uniform_real_distribution<double> delay(0.010, 0.015), queuing(0, 0.2);
+  auto one_way = [&] { return delay(random) + (random() % 5 == 0 ? queuing(random) : 0); };
+
+  char request[eve::net::clock_sync::message_size], response[eve::net::clock_sync::message_size];
+  double last = 0, previous_local = 0;
+  for (int i = 0; i < 240; ++i)
+  {
+    sync.request(request);
+    local += one_way();
+    auto size = service.respond(request, sizeof(request), response);
+    ASSERT_EQ(eve::net::clock_sync::message_size, size);
+    local += one_way();
+    EXPECT_TRUE(sync.receive(response, size));
+    EXPECT_FALSE(sync.receive(response, size));
+
+    // monotonic, and continuous once the first estimate is applied
+    for (int step = 0; step < 10; ++step)
+    {
+      local += 0.025;
+      auto now = sync.server_time();
+      EXPECT_GE(now, last);
+      if (i > 0)
+        EXPECT_LE(now - last, (local - previous_local) * 1.06);
+      last = now;
+      previous_local = local;
+    }
+  }
+
+  EXPECT_TRUE(sync.synchronized());
+  EXPECT_NEAR(0.001, sync.drift(), 0.0003);
+  EXPECT_NEAR(server_clock() - local, sync.offset(), 0.003);
+  EXPECT_NEAR(server_clock(), sync.server_time(), 0.003);
+  EXPECT_NEAR(0.020, sync.rtt(), 0.002);
+
+  // stray datagrams are not responses
+  EXPECT_EQ(0u, service.respond("hello", 5, response));
+  EXPECT_FALSE(sync.receive("hello", 5));
+
+  // a server clock behind the local one is followed as soon as it is known
+  {
+    local = 100;
+    auto behind = [&] { return local - 30; };
+    eve::net::time_service late_service(behind);
+    eve::net::clock_sync late(eve::net::clock_sync::config(), [&] { return local; });
+    EXPECT_EQ(100, late.server_time());
+
+    late.request(request);
+    local += 0.01;
+    auto size = late_service.respond(request, sizeof(request), response);
+    local += 0.01;
+    ASSERT_TRUE(late.receive(response, size));
+
+    double previous = late.server_time();
+    EXPECT_NEAR(behind(), previous, 0.001);
+    for (int step = 0; step < 10; ++step)
+    {
+      local += 0.025;
+      auto now = late.server_time();
+      EXPECT_NEAR(behind(), now, 0.001);
+      EXPECT_GT(now, previous);
+      previous = now;
+    }
+  }
+
+  // over the loopback, against the same clock
+  {
+    eve::application app(eve::application::module::networking | eve::application::module::memory_debugger);
+
+    auto stopwatch = std::make_shared<eve::stopwatch>();
+    auto shared_clock = [stopwatch] { return stopwatch->elapsed(); };
+    eve::net::time_service server(shared_clock);
+    eve::net::clock_sync client(eve::net::clock_sync::config(), shared_clock);
+
+    eve::socket server_socket(eve::socket::type::datagram), client_socket(eve::socket::type::datagram);
+    server_socket.bind(0);
+    client_socket.bind(0);
+    eve::socket::address address("127.0.0.1", server_socket.local_address().port());
+
+    eve::size received = 0;
+    for (int i = 0; i < 200 && received < 8; ++i)
+    {
+      client.request(client_socket, address);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      server.poll(server_socket);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      received += client.poll(client_socket);
+    }
+    EXPECT_EQ(8u, received);
+    EXPECT_NEAR(0, client.offset(), 0.002);
+  }
+}
+
+TEST(Net, JitterBuffer)
+{
+  // states produced every 50 ms, arriving after 30 to 80 ms
+  eve::net::jitter_buffer<int> buffer(0.05, 0.5);
+  std::mt19937 random(11);
+  std::uniform_real_distribution<double> transit(0.03, 0.08);
+
+  std::vector<std::pair<double, int>> arrivals;
+  for (int i = 0; i < 200; ++i)
+    arrivals.push_back(std::make_pair(i * 0.05 + transit(random), i));
+  std::sort(arrivals.begin(), arrivals.end());
+
+  // replayed as discrete events in order, the rendered time never jumping
+  std::vector<int> played;
+  eve::size next = 0;
+  for (double now = 0; now < 12; now += 0.005)
+  {
+    for (; next < arrivals.size() && arrivals[next].first <= now; ++next)
+      buffer.push(arrivals[next].second * 0.05, arrivals[next].first, arrivals[next].second);
+
+    int state;
+    while (buffer.pop(now, state))
+      played.push_back(state);
+  }
+
+  ASSERT_FALSE(played.empty());
+  EXPECT_TRUE(std::is_sorted(played.begin(), played.end()));
+  EXPECT_GE(played.size() + buffer.late(), 199u);
+  EXPECT_LE(buffer.late(), 4u);
+  EXPECT_GT(buffer.delay(), 0.1);
+  EXPECT_LT(buffer.delay(), 0.2);
+  EXPECT_GT(buffer.jitter(), 0.005);
+
+  // late and duplicated states are dropped
+  EXPECT_FALSE(buffer.push(played.back() * 0.05, 12, played.back()));
+
+  // interpolation between the states around the playout time
+  eve::net::jitter_buffer<double> positions(0.1, 0.1);
+  const double* from, * to;
+  double alpha;
+  EXPECT_FALSE(positions.sample(0, from, to, alpha));
+  for (int i = 0; i < 4; ++i)
+    positions.push(i * 0.05, i * 0.05 + 0.01, i * 10.0);
+  ASSERT_TRUE(positions.sample(0.175, from, to, alpha));
+  EXPECT_EQ(10.0, *from);
+  EXPECT_EQ(20.0, *to);
+  EXPECT_NEAR(0.5, alpha, 1e-9);
+  EXPECT_EQ(3u, positions.size());
+  ASSERT_TRUE(positions.sample(1, from, to, alpha));
+  EXPECT_EQ(30.0, *from);
+  EXPECT_EQ(from, to);
+}
@@ -28,7 +28,14 @@
 #include <gtest/gtest.h>
 #include <eve/application.h>
 #include <eve/serialization/vector.h>
+#include <eve/serialization/shared_ptr.h>
 #include <eve/serialization.h>
+#include <eve/math.h>
+#include <eve/time.h>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <thread>
 
 struct Boo
 {
@@ -72,3 +79,449 @@ TEST(Lib, serialization)
   EXPECT_DOUBLE_EQ(1.41, foo.d);
   EXPECT_EQ(11, foo.boos[0].j);
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST(Lib, binary_serialization)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  Fooo foo;
+  foo.i = 42;
+  foo.f = 3.14f;
+  foo.d = 1.41;
+  foo.boos.push_back(Boo(11));
+  foo.boos.push_back(Boo(12));
+
+  std::stringstream ss;
+  eve::serialize_as_binary(foo, ss);
+
+  Fooo bar;
+  eve::deserialize_as_binary(ss, bar);
+
+  EXPECT_EQ(42, bar.i);
+  EXPECT_FLOAT_EQ(3.14f, bar.f);
+  EXPECT_DOUBLE_EQ(1.41, bar.d);
+  ASSERT_EQ(2, bar.boos.size());
+  EXPECT_EQ(12, bar.boos[1].j);
+}
+
+struct Save1
+{
+  int level;
+  std::string name;
+  eve_serializable_named(Save1, (level, "level", 1), (name, "name", 2))
+};
+
+struct Save2
+{
+  int level;
+  std::vector<Boo> inventory;
+  std::string name;
+  eve_serializable_named(Save2, (level, "level", 1), (inventory, "inventory", 3), (name, "name", 2))
+};
+
+struct Save3
+{
+  long long level;
+  std::string name;
+  eve_serializable_named(Save3, (level, "level", 1), (name, "name", 2))
+};
+
+TEST(Lib, binary_serialization_schema)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  Save2 save2;
+  save2.level = 7;
+  save2.inventory.push_back(Boo(1));
+  save2.name = "hero";
+
+  std::stringstream ss;
+  eve::serialize_as_binary(save2, ss);
+  eve::serialize_as_binary(save2, ss);
+
+  // read twice so that the second read goes through the cached read plan
+  for (int i = 0; i < 2; ++i)
+  {
+    Save1 save1;
+    eve::deserialize_as_binary(ss, save1);
+    EXPECT_EQ(7, save1.level);
+    EXPECT_EQ("hero", save1.name);
+  }
+
+  // a field which became narrower leaves the rest of its payload unread, it is skipped
+  Save3 save3;
+  save3.level = 9;
+  save3.name = "wide";
+  std::stringstream wide;
+  eve::serialize_as_binary(save3, wide);
+  Save1 narrow;
+  eve::deserialize_as_binary(wide, narrow);
+  EXPECT_EQ(9, narrow.level);
+  EXPECT_EQ("wide", narrow.name);
+
+  // read plans are built once whichever thread reads a schema version first
+  std::string bytes = ss.str();
+  std::vector<std::thread> threads;
+  std::atomic<int> failures(0);
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&]
+    {
+      for (int i = 0; i < 100; ++i)
+      {
+        std::stringstream input(bytes);
+        Save1 save1;
+        eve::deserialize_as_binary(input, save1);
+        if (save1.level != 7 || save1.name != "hero")
+          ++failures;
+      }
+    });
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(0, failures);
+
+  // truncated streams fail rather than read what is left in the buffer, also when a skipped
+  // field is cut short in a file, where seeking past the end succeeds
+  std::stringstream single;
+  eve::serialize_as_binary(save2, single);
+  std::string full = single.str();
+  for (eve::size size = 0; size < full.size(); ++size)
+  {
+    std::stringstream input(full.substr(0, size));
+    Save1 save1;
+    EXPECT_THROW(eve::deserialize_as_binary(input, save1), eve::serialization_error);
+
+    {
+      std::ofstream file("truncated.bin", std::ios::binary);
+      file.write(full.data(), size);
+    }
+    std::ifstream file("truncated.bin", std::ios::binary);
+    EXPECT_THROW(eve::deserialize_as_binary(file, save1), eve::serialization_error);
+  }
+  std::remove("truncated.bin");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Curve
+{
+  std::vector<float> keys;
+  std::vector<int> small;
+  eve_serializable(Curve, keys, small)
+};
+
+TEST(Lib, packed_serialization)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  Curve curve;
+  for (int i = 0; i < 100; ++i)
+    curve.keys.push_back(i * 0.5f);
+  curve.small.push_back(3);
+
+  std::stringstream text;
+  eve::serialize_as_text(curve, text);
+  EXPECT_NE(std::string::npos, text.str().find("base64"));
+
+  std::stringstream binary;
+  eve::serialize_as_binary(curve, binary);
+
+  Curve fromtext, frombinary;
+  eve::deserialize_as_text(text, fromtext);
+  eve::deserialize_as_binary(binary, frombinary);
+
+  EXPECT_EQ(curve.keys, fromtext.keys);
+  EXPECT_EQ(curve.small, fromtext.small);
+  EXPECT_EQ(curve.keys, frombinary.keys);
+  EXPECT_EQ(curve.small, frombinary.small);
+}
+
+struct Mesh
+{
+  std::vector<eve::vec3> positions;
+  eve_serializable(Mesh, positions)
+};
+
+TEST(Lib, packed_serialization_vectors)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  Mesh mesh;
+  mesh.positions.push_back(eve::vec3(1, 2, 3));
+  mesh.positions.push_back(eve::vec3(4, 5, 6));
+
+  std::stringstream text;
+  eve::serialize_as_text(mesh, text);
+
+  Mesh loaded;
+  eve::deserialize_as_text(text, loaded);
+
+  ASSERT_EQ(2, loaded.positions.size());
+  EXPECT_FLOAT_EQ(6, loaded.positions[1].z);
+
+  // a corrupt count fails on the missing elements instead of allocating them
+  std::stringstream binary;
+  eve::serialize_as_binary(mesh.positions, binary);
+  std::string bytes = binary.str();
+  bytes[3] = char(0x7F);
+  std::stringstream corrupt(bytes);
+  std::vector<eve::vec3> positions;
+  EXPECT_THROW(eve::deserialize_as_binary(corrupt, positions), eve::serialization_error);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum class Color { red, green, blue };
+eve_define_enum(Color, red, green, blue)
+
+struct Styled
+{
+  Color color;
+  std::string label;
+  std::vector<Fooo> children;
+  eve_serializable(Styled, color, label, children)
+};
+
+TEST(Lib, json_serialization)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  Styled styled;
+  styled.color = Color::blue;
+  styled.label = "say \"hi\"\n";
+  styled.children.resize(1);
+  styled.children[0].i = 42;
+  styled.children[0].f = 3.14f;
+  styled.children[0].d = 1.41;
+  styled.children[0].boos.push_back(Boo(11));
+
+  std::stringstream ss;
+  eve::serialize_as_json(styled, ss);
+
+  Styled loaded;
+  eve::deserialize_as_json(ss, loaded);
+
+  EXPECT_EQ(Color::blue, loaded.color);
+  EXPECT_EQ(styled.label, loaded.label);
+  ASSERT_EQ(1, loaded.children.size());
+  EXPECT_EQ(42, loaded.children[0].i);
+  EXPECT_FLOAT_EQ(3.14f, loaded.children[0].f);
+  EXPECT_EQ(11, loaded.children[0].boos[0].j);
+
+  // keys unknown to the class are skipped
+  std::stringstream external("{ \"extra\": { \"a\": [1, {\"b\": \"}\"}] }, \"label\": \"caf\\u00e9\" }");
+  eve::deserialize_as_json(external, loaded);
+  EXPECT_EQ("caf\xc3\xa9", loaded.label);
+
+  // characters beyond the BMP are surrogate pairs, lone surrogates are errors
+  std::stringstream emoji("{ \"label\": \"\\ud83d\\ude00!\" }");
+  eve::deserialize_as_json(emoji, loaded);
+  EXPECT_EQ("\xf0\x9f\x98\x80!", loaded.label);
+  for (auto lone : { "{ \"label\": \"\\ud83d\" }", "{ \"label\": \"\\ude00\" }", "{ \"label\": \"\\ud83dx\\u0041\" }" })
+  {
+    std::stringstream invalid(lone);
+    EXPECT_THROW(eve::deserialize_as_json(invalid, loaded), eve::serialization_error);
+  }
+
+  // every structural scan kernel indexes the same tokens, escapes and strings crossing blocks
+  std::string label(100, 'x');
+  for (eve::size i = 0; i < label.size(); i += 7)
+    label[i] = '"';
+  for (eve::size i = 3; i < label.size(); i += 11)
+    label[i] = '\\';
+  styled.label = label;
+  std::stringstream tricky;
+  eve::serialize_as_json(styled, tricky);
+  const eve::uint32 k_masks[] = { 0, eve::cpu::sse2, ~0u };
+  for (auto mask : k_masks)
+  {
+    eve::cpu::limit(mask);
+    std::stringstream input(tricky.str());
+    Styled scanned;
+    eve::deserialize_as_json(input, scanned);
+    EXPECT_EQ(label, scanned.label);
+    ASSERT_EQ(1, scanned.children.size());
+    EXPECT_EQ(11, scanned.children[0].boos[0].j);
+
+    std::stringstream unterminated("{ \"label\": \"abc\\\" }");
+    EXPECT_THROW(eve::deserialize_as_json(unterminated, scanned), eve::serialization_error);
+  }
+  eve::cpu::limit(~0u);
+}
+
+TEST(Lib, json_benchmark)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  Styled styled;
+  styled.color = Color::green;
+  styled.label = "benchmark";
+  styled.children.resize(20000);
+  for (int i = 0; i < 20000; ++i)
+  {
+    styled.children[i].i = i;
+    styled.children[i].f = i * 0.25f;
+    styled.children[i].d = i * 0.125;
+    styled.children[i].boos.push_back(Boo(i));
+  }
+
+  std::stringstream text, json;
+  eve::serialize_as_text(styled, text);
+  eve::serialize_as_json(styled, json);
+
+  eve::stopwatch stopwatch;
+  Styled fromtext;
+  eve::deserialize_as_text(text, fromtext);
+  auto texttime = stopwatch.reset();
+
+  Styled fromjson;
+  eve::deserialize_as_json(json, fromjson);
+  auto jsontime = stopwatch.reset();
+
+  EXPECT_EQ(fromtext.children.size(), fromjson.children.size());
+  std::cout << "text: " << text.str().size() << " bytes read in " << texttime * 1000 << " ms\n";
+  std::cout << "json: " << json.str().size() << " bytes read in " << jsontime * 1000 << " ms\n";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Prefab
+{
+  std::shared_ptr<Boo> first;
+  std::shared_ptr<Boo> second;
+  std::shared_ptr<Boo> none;
+  std::vector<std::shared_ptr<const std::string>> names;
+  eve_serializable(Prefab, first, second, none, names)
+};
+
+template <typename Serialize, typename Deserialize>
+void check_prefab_identity(Serialize serialize, Deserialize deserialize)
+{
+  Prefab prefab;
+  prefab.first = std::make_shared<Boo>(5);
+  prefab.second = prefab.first;
+  auto name = std::make_shared<const std::string>("a rather long shared name");
+  prefab.names.push_back(name);
+  prefab.names.push_back(name);
+
+  std::stringstream ss;
+  serialize(prefab, ss);
+
+  Prefab loaded;
+  deserialize(ss, loaded);
+
+  ASSERT_TRUE(loaded.first != nullptr);
+  EXPECT_EQ(5, loaded.first->j);
+  EXPECT_EQ(loaded.first, loaded.second);
+  EXPECT_EQ(nullptr, loaded.none);
+  ASSERT_EQ(2, loaded.names.size());
+  EXPECT_EQ(*name, *loaded.names[0]);
+  EXPECT_EQ(loaded.names[0], loaded.names[1]);
+}
+
+struct Level2
+{
+  std::shared_ptr<Boo> removed;
+  std::shared_ptr<Boo> spawn;
+  std::shared_ptr<Boo> camera;
+  eve_serializable_named(Level2, (removed, "removed", 3), (spawn, "spawn", 1), (camera, "camera", 2))
+};
+
+struct Level1
+{
+  std::shared_ptr<Boo> spawn;
+  std::shared_ptr<Boo> camera;
+  eve_serializable_named(Level1, (spawn, "spawn", 1), (camera, "camera", 2))
+};
+
+template <typename Serialize, typename Deserialize>
+void check_skipped_shared(Serialize serialize, Deserialize deserialize)
+{
+  // the first shared instance is in a field the reader no longer knows
+  Level2 level2;
+  level2.removed = std::make_shared<Boo>(1);
+  level2.spawn = std::make_shared<Boo>(2);
+  level2.camera = level2.spawn;
+
+  std::stringstream ss;
+  serialize(level2, ss);
+
+  Level1 level1;
+  deserialize(ss, level1);
+  ASSERT_TRUE(level1.spawn != nullptr);
+  EXPECT_EQ(2, level1.spawn->j);
+  EXPECT_EQ(level1.spawn, level1.camera);
+}
+
+template <typename Serialize, typename Deserialize>
+void check_removed_definition(Serialize serialize, Deserialize deserialize)
+{
+  // the only definition of the instance is in a field the reader no longer knows
+  Level2 level2;
+  level2.removed = level2.spawn = level2.camera = std::make_shared<Boo>(3);
+
+  std::stringstream ss;
+  serialize(level2, ss);
+
+  Level1 level1;
+  deserialize(ss, level1);
+  ASSERT_TRUE(level1.spawn != nullptr);
+  EXPECT_EQ(3, level1.spawn->j);
+  EXPECT_EQ(level1.spawn, level1.camera);
+}
+
+struct Named
+{
+  std::string name;
+  int n;
+  eve_serializable(Named, name, n)
+};
+
+struct Aliased
+{
+  std::shared_ptr<std::string> name;
+  std::shared_ptr<Named> named;
+  eve_serializable(Aliased, name, named)
+};
+
+template <typename Serialize, typename Deserialize>
+void check_aliased_shared(Serialize serialize, Deserialize deserialize)
+{
+  // a pointer to the first member has the address of the object but not its type
+  Aliased aliased;
+  aliased.named = std::make_shared<Named>();
+  aliased.named->name = "alias";
+  aliased.named->n = 7;
+  aliased.name = std::shared_ptr<std::string>(aliased.named, &aliased.named->name);
+
+  std::stringstream ss;
+  serialize(aliased, ss);
+
+  Aliased loaded;
+  deserialize(ss, loaded);
+  ASSERT_TRUE(loaded.name != nullptr);
+  ASSERT_TRUE(loaded.named != nullptr);
+  EXPECT_EQ("alias", *loaded.name);
+  EXPECT_EQ("alias", loaded.named->name);
+  EXPECT_EQ(7, loaded.named->n);
+}
+
+TEST(Lib, shared_serialization)
+{
+  eve::application app(eve::application::module::memory_debugger);
+
+  check_prefab_identity(eve::serialize_as_text<Prefab>, eve::deserialize_as_text<Prefab>);
+  check_prefab_identity(eve::serialize_as_binary<Prefab>, eve::deserialize_as_binary<Prefab>);
+  check_prefab_identity(eve::serialize_as_json<Prefab>, eve::deserialize_as_json<Prefab>);
+
+  check_skipped_shared(eve::serialize_as_binary<Level2>, eve::deserialize_as_binary<Level1>);
+  check_skipped_shared(eve::serialize_as_json<Level2>, eve::deserialize_as_json<Level1>);
+
+  check_removed_definition(eve::serialize_as_binary<Level2>, eve::deserialize_as_binary<Level1>);
+  check_removed_definition(eve::serialize_as_json<Level2>, eve::deserialize_as_json<Level1>);
+
+  check_aliased_shared(eve::serialize_as_text<Aliased>, eve::deserialize_as_text<Aliased>);
+  check_aliased_shared(eve::serialize_as_binary<Aliased>, eve::deserialize_as_binary<Aliased>);
+  check_aliased_shared(eve::serialize_as_json<Aliased>, eve::deserialize_as_json<Aliased>);
+}
@@ -0,0 +1,59 @@
+/******************************************************************************\
+* This source file is part of the 'eve' framework.                             *
+* (A linear, elegant, modular engine for rapid game development)               *
+*                                                                              *
+* The MIT License (MIT)                                                        *
+*                                                                              *
+* Copyright (c) 2013                                                           *
+*                                                                              *
+* Permission is hereby granted, free of charge, to any person obtaining a copy *
+* of this software and associated documentation files (the "Software"), to deal*
+* in the Software without restriction, including without limitation the rights *
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell    *
+* copies of the Software, and to permit persons to whom the Software is        *
+* furnished to do so, subject to the following conditions:                     *
+*                                                                              *
+* The above copyright notice and this permission notice shall be included in   *
+* all copies or substantial portions of the Software.                          *
+*                                                                              *
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR   *
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,     *
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE  *
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER       *
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,*
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN    *
+* THE SOFTWARE.                                                                *
+\******************************************************************************/
+
+#include <eve/application.h>
+#include <eve/cooker.h>
+#include <eve/pixelbuffer.h>
+#include <eve/shader.h>
+#include <eve/texture.h>
+#include <iostream>
+
+/** evecook <asset root> <cache directory>
+  *
+  * Cooks every resource under the asset root into the cache directory. Point the game at the
+  * same directory with eve::resource::use_cache() to load the cooked artifacts. */
+int main(int argc, char** argv)
+{
+  if (argc != 3)
+  {
+    std::cerr << "usage: evecook <asset root> <cache directory>" << std::endl;
+    return 2;
+  }
+
+  eve::application app(eve::application::module::memory_debugger);
+
+  eve::cooker cooker(argv[2]);
+  cooker.add<eve::shader>(".fx.evedat");
+  cooker.add<eve::texture>(".evedat");
+  cooker.add<eve::pixelbuffer>(".png");
+  cooker.cook(argv[1]);
+
+  std::cout << cooker.cooked() << " cooked, " << cooker.skipped() << " up to date, "
+    << cooker.uncooked() << " without cooked form, " << cooker.failed() << " failed." << std::endl;
+
+  return cooker.failed() == 0 ? 0 : 1;
+}